@@ -1,6 +1,7 @@
 #!/usr/bin/env python3
 """
-Plot Frequency Response Function (FRF) from real_tract_frf.csv
+Plot Frequency Response Function (FRF) from real_tract_frf.frf (binary)
+or real_tract_frf.csv
 """
 
 import pandas as pd
@@ -9,6 +10,68 @@ import numpy as np
 import sys
 from pathlib import Path
 
+FRF_HEADER = np.dtype([
+    ('magic', 'S4'), ('version', '<u4'), ('header_size', '<u4'), ('num_bins', '<u4'),
+    ('nfft', '<u4'), ('num_arrays', '<u4'), ('sample_rate', '<f8'),
+    ('amplitude', '<f4'), ('start_freq', '<f4'), ('end_freq', '<f4'), ('duration', '<f4'),
+    ('tgap', '<f4'), ('tfade', '<f4'), ('type', '<i4'), ('grid_type', '<u4'),
+])
+FRF_GRID = np.dtype([('f_min', '<f8'), ('f_max', '<f8')])
+FRF_GRID_LOG = 1
+
+
+def load_frf_binary(frf_file):
+    """
+    Load a binary FRF container (see src/storage/frf_io.h) into the same
+    columns as the CSV export, plus the chirp band from its header.
+    """
+    header = np.fromfile(frf_file, dtype=FRF_HEADER, count=1)
+    if len(header) != 1 or header['magic'][0] != b'VTFR':
+        raise ValueError(f"'{frf_file}' is not an FRF file")
+    header = header[0]
+    num_bins = int(header['num_bins'])
+    h_lips = np.fromfile(frf_file, dtype='<c8', count=num_bins, offset=int(header['header_size']))
+    if len(h_lips) != num_bins:
+        raise ValueError(f"'{frf_file}' is truncated")
+
+    if header['version'] >= 2:
+        grid = np.fromfile(frf_file, dtype=FRF_GRID, count=1, offset=FRF_HEADER.itemsize)[0]
+        if header['grid_type'] == FRF_GRID_LOG:
+            frequency = np.geomspace(grid['f_min'], grid['f_max'], num_bins)
+        else:
+            frequency = np.linspace(grid['f_min'], grid['f_max'], num_bins)
+    else:
+        frequency = np.arange(num_bins) * header['sample_rate'] / header['nfft']
+    magnitude = np.maximum(np.abs(h_lips), 1e-9)
+    df = pd.DataFrame({
+        'Frequency_Hz': frequency,
+        'Magnitude_dB': 20.0 * np.log10(magnitude),
+        'Resistance_dB': h_lips.real,
+        'Reactance_dB': h_lips.imag,
+        'Phase_Rad': np.angle(h_lips),
+    })
+    return df, float(header['start_freq']), float(header['end_freq'])
+
+
+def read_chirp_bounds(param_file):
+    """Read the chirp start/end frequencies from a parameters text file."""
+    lower_bound = None
+    upper_bound = None
+    try:
+        with open(param_file, 'r') as f:
+            for line in f:
+                if "Chirp Start Frequency" in line:
+                    lower_bound = float(line.split(":")[1].strip().split()[0])
+                elif "Chirp End Frequency" in line:
+                    upper_bound = float(line.split(":")[1].strip().split()[0])
+        if lower_bound is None or upper_bound is None:
+            print("Warning: Could not find frequency bounds in calibration parameters. Using default x-axis limits.")
+    except Exception as e:
+        print(f"Error reading calibration parameters: {e}")
+        print("Using default x-axis limits.")
+    return lower_bound, upper_bound
+
+
 def plot_frf(csv_file):
     """
     Load and plot FRF data from CSV file.
@@ -25,10 +88,15 @@ def plot_frf(csv_file):
         sys.exit(1)
     
     # Load data
+    lower_bound = None
+    upper_bound = None
     try:
-        df = pd.read_csv(csv_file)
+        if csv_file.endswith('.frf'):
+            df, lower_bound, upper_bound = load_frf_binary(csv_file)
+        else:
+            df = pd.read_csv(csv_file)
     except Exception as e:
-        print(f"Error reading CSV file: {e}")
+        print(f"Error reading FRF file: {e}")
         sys.exit(1)
     
     # Validate that Frequency_Hz column exists
@@ -44,21 +112,9 @@ def plot_frf(csv_file):
     all_columns = [col for col in df.columns if col != 'Frequency_Hz']
 
     # Get lower and upper frequency bounds for plotting in ../output/calibration_parameters.txt
-    try:
-        with open('../output/calibration_parameters.txt', 'r') as f:
-            lines = f.readlines()
-            lower_bound = None
-            upper_bound = None
-            for line in lines:
-                if "Chirp Start Frequency" in line:
-                    lower_bound = float(line.split(":")[1].strip().split()[0])
-                elif "Chirp End Frequency" in line:
-                    upper_bound = float(line.split(":")[1].strip().split()[0])
-            else:
-                print("Warning: Could not find frequency bounds in calibration parameters. Using default x-axis limits.")
-    except Exception as e:
-        print(f"Error reading calibration parameters: {e}")
-        print("Using default x-axis limits.")
+    # (the binary format already carries them)
+    if lower_bound is None or upper_bound is None:
+        lower_bound, upper_bound = read_chirp_bounds('../output/calibration_parameters.txt')
     
     # Filter to only plot Magnitude, Reactance, and Phase
     measurement_columns = [col for col in all_columns if any(keyword in col for keyword in ['Magnitude', 'Reactance', 'Phase'])]
@@ -103,7 +159,7 @@ def plot_frf(csv_file):
     plt.tight_layout()
     
     # Save figure
-    output_file = csv_file.replace('.csv', '.png')
+    output_file = str(Path(csv_file).with_suffix('.png'))
     try:
         plt.savefig(output_file, dpi=300, bbox_inches='tight')
         print(f"Plot saved to: {output_file}")
@@ -127,7 +183,7 @@ def plot_frf(csv_file):
 
 
 if __name__ == '__main__':
-    csv_file = '../output/real_tract_frf.csv'
+    csv_file = '../output/real_tract_frf.frf'
     
     if len(sys.argv) > 1:
         csv_file = sys.argv[1]
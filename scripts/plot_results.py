@@ -1,12 +1,21 @@
 import numpy as np
 import matplotlib.pyplot as plt
 from scipy.signal import spectrogram
+from scipy.io import wavfile
+
+
+def read_capture(path):
+    """Read a capture WAV file and scale integer samples to [-1, 1)."""
+    rate, data = wavfile.read(path)
+    if np.issubdtype(data.dtype, np.integer):
+        data = data.astype(np.float32) / float(np.iinfo(data.dtype).max + 1)
+    return rate, data.astype(np.float32)
 
-# Read the data from the file
-ref_chirp = np.fromfile('../output/measurement_chirp.raw', dtype=np.float32)
 
-data_measured = np.fromfile('../output/measurement_response.raw', dtype=np.float32)
-data_calibration = np.fromfile('../output/calibration_response.raw', dtype=np.float32)
+# Read the captures (sample rate and format come from the WAV headers)
+fs, ref_chirp = read_capture('../output/measurement_chirp.wav')
+_, data_measured = read_capture('../output/measurement_response.wav')
+_, data_calibration = read_capture('../output/calibration_response.wav')
 
 data_deconv_open = np.fromfile('../output/deconvolved_measurement_response.raw', dtype=np.float32)
 data_deconv_closed = np.fromfile('../output/deconvolved_calibration_response.raw', dtype=np.float32)
@@ -16,14 +25,8 @@ data_deconv_temp_windowed = np.fromfile('../output/windowed_calibration_response
 
 
 # Only keep 200 ms of the deconvolved responses, as the rest is none
-# data_deconv_open = data_deconv_open[:int(0.2 * 44100)]
-# data_deconv_closed = data_deconv_closed[:int(0.2 * 44100)]
-
-# Save both data to .wav files for easier hearing
-from scipy.io import wavfile
-wavfile.write('../output/measurement_response.wav', 44100, data_measured)
-wavfile.write('../output/calibration_response.wav', 44100, data_calibration)
-wavfile.write('../output/measurement_chirp.wav', 44100, ref_chirp)
+# data_deconv_open = data_deconv_open[:int(0.2 * fs)]
+# data_deconv_closed = data_deconv_closed[:int(0.2 * fs)]
 
 # Plot the time data (ref chirp, measure and calibration)
 plt.figure(figsize=(12, 8))
@@ -72,8 +75,8 @@ plt.show()
 
 # Plot frequency: magnitude spectrogram of the measured reponse and the deconvolved response (open)
 # The spectrogram of the deconvolved response must be zoomed in, as only 18 ms are kept
-f_meas, t_meas, Sxx_meas = spectrogram(data_measured, fs=44100, nperseg=1024)
-f_deconv, t_deconv, Sxx_deconv = spectrogram(data_deconv_open, fs=44100, nperseg=256)
+f_meas, t_meas, Sxx_meas = spectrogram(data_measured, fs=fs, nperseg=1024)
+f_deconv, t_deconv, Sxx_deconv = spectrogram(data_deconv_open, fs=fs, nperseg=256)
 plt.figure(figsize=(12, 8))
 plt.subplot(2, 1, 1)
 plt.pcolormesh(t_meas, f_meas, 10 * np.log10(Sxx_meas), shading='gouraud')
@@ -0,0 +1,253 @@
+#!/usr/bin/env python3
+"""
+ctypes binding of libvtimpedance.so (see src/api/vtimpedance.h).
+
+Captures are passed to the library as float32 numpy arrays and the FRF is
+written straight into complex64 numpy arrays, so nothing is copied or
+written to disk. Build the library with `make shared`.
+
+    import numpy as np
+    from vtimpedance import Processor
+
+    proc = Processor(sample_rate=48000, start_freq=100, end_freq=2000, duration=10)
+    proc.set_output(band_limited=True, grid='log', num_points=500)
+    proc.set_calibration(closed_capture)
+    freq, h_lips = proc.frequencies(), proc.process(open_capture)
+
+DaemonClient talks to `./main --mode daemon` instead, which keeps the
+contexts warm across processes:
+
+    with DaemonClient('output/vtimpedance.sock') as daemon:
+        freq, h_lips, open_ir, closed_ir = daemon.process('output/calibration_response.wav',
+                                                          'output/measurement_response.wav', grid='log', points=500)
+
+LiveFrames maps the frame file of `./main --mode live` and reads the
+latest frame:
+
+    with LiveFrames('output/live_frf.bin') as live:
+        frame = live.latest()  # None until the first frame
+"""
+
+import ctypes
+import mmap
+import socket
+import struct
+import time
+import numpy as np
+from pathlib import Path
+
+VT_API_VERSION = 1
+GRIDS = {'bins': 0, 'linear': 1, 'log': 2}
+
+
+class VtSweep(ctypes.Structure):
+    _fields_ = [
+        ('sample_rate', ctypes.c_double),
+        ('start_freq', ctypes.c_float),
+        ('end_freq', ctypes.c_float),
+        ('duration', ctypes.c_float),
+        ('amplitude', ctypes.c_float),
+        ('type', ctypes.c_int),
+    ]
+
+
+def load_library(path=None):
+    """
+    Load libvtimpedance.so from the given path, else from the repository
+    root, else from the system library path.
+    """
+    if path is None:
+        local = Path(__file__).resolve().parent.parent / 'libvtimpedance.so'
+        path = str(local) if local.exists() else 'libvtimpedance.so'
+    lib = ctypes.CDLL(path)
+
+    float_array = np.ctypeslib.ndpointer(dtype=np.float32, flags='C_CONTIGUOUS')
+    double_array = np.ctypeslib.ndpointer(dtype=np.float64, flags='C_CONTIGUOUS')
+
+    lib.vt_api_version.restype = ctypes.c_int
+    lib.vt_context_create.argtypes = [ctypes.POINTER(VtSweep)]
+    lib.vt_context_create.restype = ctypes.c_void_p
+    lib.vt_context_destroy.argtypes = [ctypes.c_void_p]
+    lib.vt_capture_length.argtypes = [ctypes.c_void_p]
+    lib.vt_capture_length.restype = ctypes.c_int64
+    lib.vt_set_output.argtypes = [ctypes.c_void_p, ctypes.c_int, ctypes.c_int, ctypes.c_int]
+    lib.vt_output_points.argtypes = [ctypes.c_void_p]
+    lib.vt_output_frequencies.argtypes = [ctypes.c_void_p, double_array]
+    lib.vt_set_calibration.argtypes = [ctypes.c_void_p, float_array, ctypes.c_int64]
+    # Optional outputs: None or a complex64 array viewed as float32 pairs
+    lib.vt_process.argtypes = [ctypes.c_void_p, float_array, ctypes.c_int64,
+                               ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p]
+
+    if lib.vt_api_version() != VT_API_VERSION:
+        raise RuntimeError(f"libvtimpedance API version {lib.vt_api_version()}, expected {VT_API_VERSION}")
+    return lib
+
+
+def _samples(capture):
+    """A float32 C-contiguous view of a mono capture (copies only if the dtype differs)."""
+    return np.ascontiguousarray(capture, dtype=np.float32)
+
+
+class Processor:
+    """One sweep's processing context; reuse it for every capture of that sweep."""
+
+    def __init__(self, sample_rate, start_freq, end_freq, duration, amplitude=0.5, sweep_type='exponential',
+                 library=None):
+        self.lib = library or load_library()
+        sweep = VtSweep(sample_rate, start_freq, end_freq, duration, amplitude,
+                        1 if sweep_type == 'exponential' else 0)
+        self.ctx = self.lib.vt_context_create(ctypes.byref(sweep))
+        if not self.ctx:
+            raise ValueError("Invalid sweep parameters or out of memory")
+
+    def close(self):
+        if self.ctx:
+            self.lib.vt_context_destroy(self.ctx)
+            self.ctx = None
+
+    def __del__(self):
+        self.close()
+
+    @property
+    def capture_length(self):
+        return self.lib.vt_capture_length(self.ctx)
+
+    @property
+    def num_points(self):
+        return self.lib.vt_output_points(self.ctx)
+
+    def set_output(self, band_limited=True, grid='bins', num_points=0):
+        if self.lib.vt_set_output(self.ctx, int(band_limited), GRIDS[grid], num_points) != 0:
+            raise ValueError(f"Invalid output grid '{grid}' with {num_points} points")
+
+    def frequencies(self):
+        freq = np.empty(self.num_points, dtype=np.float64)
+        self.lib.vt_output_frequencies(self.ctx, freq)
+        return freq
+
+    def set_calibration(self, capture):
+        capture = _samples(capture)
+        if self.lib.vt_set_calibration(self.ctx, capture, len(capture)) != 0:
+            raise ValueError("Calibration capture rejected (too short?)")
+
+    def process(self, capture, spectra=False):
+        """
+        H_lips of a measurement capture against the calibration, as a
+        complex64 array; with spectra=True also the open and closed
+        linear IR spectra.
+        """
+        capture = _samples(capture)
+        h_lips = np.empty(self.num_points, dtype=np.complex64)
+        open_ir = np.empty_like(h_lips) if spectra else None
+        closed_ir = np.empty_like(h_lips) if spectra else None
+        ptr = lambda a: a.ctypes.data if a is not None else None
+        if self.lib.vt_process(self.ctx, capture, len(capture), ptr(h_lips), ptr(open_ir), ptr(closed_ir)) != 0:
+            raise ValueError("Measurement capture rejected (no calibration, or too short?)")
+        return (h_lips, open_ir, closed_ir) if spectra else h_lips
+
+
+class DaemonClient:
+    """Client of the processing daemon (see src/orchestration/daemon.h); one connection serves many jobs."""
+
+    def __init__(self, socket_path='output/vtimpedance.sock'):
+        self.sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        self.sock.connect(socket_path)
+        self.stream = self.sock.makefile('rb')
+        self.last_reply = {}
+
+    def close(self):
+        self.stream.close()
+        self.sock.close()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+    def _request(self, line):
+        self.sock.sendall(line.encode() + b'\n')
+        reply = self.stream.readline().decode().strip()
+        if not reply.startswith('ok'):
+            raise RuntimeError(f"Daemon: {reply or 'connection closed'}")
+        return reply
+
+    def ping(self):
+        return self._request('ping') == 'ok pong'
+
+    def shutdown(self):
+        self._request('shutdown')
+
+    def process(self, calibration, measurement, band='sweep', grid='bins', points=0, raw_sweep=None):
+        """
+        Process a calibration/measurement pair. WAV paths by default; with
+        raw_sweep (dict of sample_rate, start_freq, end_freq, duration and
+        optionally chirp_type, amplitude) the paths are raw float32 files,
+        e.g. numpy.memmap arrays in /dev/shm. Returns frequencies (float64)
+        and H_lips, open and closed spectra (complex64).
+        """
+        if raw_sweep is None:
+            line = f'process calibration={calibration} measurement={measurement}'
+        else:
+            line = f'process calibration_raw={calibration} measurement_raw={measurement} '
+            line += ' '.join(f'{key}={value}' for key, value in raw_sweep.items())
+        line += f' band={band} grid={grid}' + (f' points={points}' if grid != 'bins' else '')
+
+        reply = self._request(line)
+        self.last_reply = dict(field.split('=', 1) for field in reply.split()[1:])
+        n = int(self.last_reply['points'])
+        freq = np.frombuffer(self.stream.read(8 * n), dtype=np.float64)
+        spectra = np.frombuffer(self.stream.read(24 * n), dtype=np.complex64).reshape(3, n)
+        return freq, spectra[0], spectra[1], spectra[2]
+
+
+class LiveFrames:
+    """Reader of the live mode frame file (see src/storage/live_frames.h)."""
+
+    HEADER = struct.Struct('=4s7Id Q')
+    SLOT = struct.Struct('=QQdfI')
+    HEADER_SIZE = 64
+    SLOT_HEADER_SIZE = 32
+
+    def __init__(self, path='output/live_frf.bin'):
+        with open(path, 'rb') as file:
+            self.map = mmap.mmap(file.fileno(), 0, access=mmap.ACCESS_READ)
+        (magic, version, header_size, self.num_points, self.num_slots, self.slot_size, self.period,
+         self.first_bin, self.sample_rate, _) = self.HEADER.unpack_from(self.map, 0)
+        if magic != b'VTLV' or version != 1 or header_size != self.HEADER_SIZE:
+            self.map.close()
+            raise ValueError(f"'{path}' is not a live frame file")
+        self.freq = (self.first_bin + np.arange(self.num_points)) * self.sample_rate / self.period
+
+    def close(self):
+        self.map.close()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+    def count(self):
+        return struct.unpack_from('=Q', self.map, 40)[0]
+
+    def latest(self, tries=100):
+        """
+        Latest complete frame as a dict of frame, time, process_ms, periods
+        and the H_lips, open and closed spectra (complex64), or None if no
+        frame has been published yet.
+        """
+        for _ in range(tries):
+            count = self.count()
+            if count == 0:
+                return None
+            offset = self.HEADER_SIZE + (count - 1) % self.num_slots * self.slot_size
+            sequence, frame, t, process_ms, periods = self.SLOT.unpack_from(self.map, offset)
+            start = offset + self.SLOT_HEADER_SIZE
+            spectra = np.frombuffer(self.map[start:start + 24 * self.num_points], dtype=np.complex64)
+            if sequence == 2 * count and struct.unpack_from('=Q', self.map, offset)[0] == sequence:
+                spectra = spectra.reshape(3, self.num_points)
+                return {'frame': frame, 'time': t, 'process_ms': process_ms, 'periods': periods,
+                        'h_lips': spectra[0], 'open': spectra[1], 'closed': spectra[2]}
+            time.sleep(0.001)
+        return None
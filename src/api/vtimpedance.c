@@ -0,0 +1,213 @@
+#include "vtimpedance.h"
+#include "processing.h"
+#include "frf_grid.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct VtContext {
+    VtSweep sweep;
+    int n_samples;   /* Capture samples deconvolved */
+    int nfft;
+    int npre, npost; /* IR window */
+    int band_first, band_bins; /* Sweep band, where the inverse filter is non-zero */
+    kiss_fft_cfg cfg_fwd;
+    kiss_fft_cfg cfg_inv;
+    kiss_fft_cpx *inv_filter;
+    kiss_fft_cpx *closed; /* Calibration linear IR spectrum */
+    kiss_fft_cpx *open;   /* Last measurement linear IR spectrum */
+    kiss_fft_cpx *h;      /* H_lips before resampling */
+    kiss_fft_scalar *epsilon; /* Over the non-negative frequencies */
+    int has_calibration;
+
+    /* Output axis */
+    FrfGrid grid;
+    int first_bin;
+    int resample;
+    int active_first, num_active; /* Bins the output reads */
+    kiss_fft_cpx *points; /* Output points before narrowing to float32 (double builds only) */
+};
+
+int vt_api_version(void) {
+    return VT_API_VERSION;
+}
+
+VtContext *vt_context_create(const VtSweep *sweep) {
+    if (!sweep || sweep->sample_rate <= 0.0 || sweep->start_freq <= 0.0f || sweep->end_freq <= sweep->start_freq
+        || sweep->duration <= 0.0f || (sweep->type != 0 && sweep->type != 1)) {
+        fprintf(stderr, "vt_context_create: invalid sweep parameters\n");
+        return NULL;
+    }
+
+    VtContext *ctx = (VtContext*)calloc(1, sizeof(VtContext));
+    if (!ctx) {
+        fprintf(stderr, "vt_context_create: out of memory\n");
+        return NULL;
+    }
+    ctx->sweep = *sweep;
+    ctx->n_samples = (int)(sweep->sample_rate * sweep->duration);
+    ctx->nfft = calculate_next_power_of_two(ctx->n_samples);
+    linear_ir_window(sweep->start_freq, sweep->end_freq, sweep->duration, sweep->sample_rate, &ctx->npre, &ctx->npost);
+    ctx->band_first = sweep_band_bins(sweep->start_freq, sweep->end_freq, sweep->sample_rate, ctx->nfft,
+                                      &ctx->band_bins);
+
+    ctx->cfg_fwd = kiss_fft_alloc(ctx->nfft, 0, NULL, NULL);
+    ctx->cfg_inv = kiss_fft_alloc(ctx->nfft, 1, NULL, NULL);
+    ctx->inv_filter = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * ctx->nfft);
+    ctx->closed = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * ctx->nfft);
+    ctx->open = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * ctx->nfft);
+    ctx->h = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * ctx->nfft / 2);
+    ctx->epsilon = (kiss_fft_scalar*)malloc(sizeof(kiss_fft_scalar) * ctx->nfft / 2);
+    if (!ctx->cfg_fwd || !ctx->cfg_inv || !ctx->inv_filter || !ctx->closed || !ctx->open || !ctx->h || !ctx->epsilon) {
+        fprintf(stderr, "vt_context_create: failed to allocate FFT buffers (nfft %d)\n", ctx->nfft);
+        vt_context_destroy(ctx);
+        return NULL;
+    }
+
+    generate_inverse_filter(ctx->inv_filter, sweep->amplitude, sweep->start_freq, sweep->end_freq,
+                            sweep->duration, (float)sweep->sample_rate, ctx->nfft, sweep->type);
+    generate_epsilon_bins(ctx->epsilon, sweep->start_freq, sweep->end_freq, (float)sweep->sample_rate, ctx->nfft,
+                          EPSILON_TRANSITION_HZ, 0, ctx->nfft / 2);
+    vt_set_output(ctx, 0, VT_OUTPUT_BINS, 0);
+    return ctx;
+}
+
+void vt_context_destroy(VtContext *ctx) {
+    if (!ctx) {
+        return;
+    }
+    kiss_fft_free(ctx->cfg_fwd);
+    kiss_fft_free(ctx->cfg_inv);
+    free(ctx->inv_filter);
+    free(ctx->closed);
+    free(ctx->open);
+    free(ctx->h);
+    free(ctx->epsilon);
+    free(ctx->points);
+    free(ctx);
+}
+
+int64_t vt_capture_length(const VtContext *ctx) {
+    return ctx->n_samples;
+}
+
+int vt_fft_size(const VtContext *ctx) {
+    return ctx->nfft;
+}
+
+int vt_set_output(VtContext *ctx, int band_limited, VtOutputGrid grid, int num_points) {
+    if ((grid != VT_OUTPUT_BINS && grid != VT_OUTPUT_LINEAR && grid != VT_OUTPUT_LOG)
+        || (grid != VT_OUTPUT_BINS && num_points < 2)) {
+        fprintf(stderr, "vt_set_output: invalid grid\n");
+        return -1;
+    }
+
+    /* Same band and grid as the FRF file written by processing mode */
+    double fs = ctx->sweep.sample_rate;
+    double bin_hz = fs / ctx->nfft;
+    double f_lo = 0.0;
+    double f_hi = (ctx->nfft / 2 - 1) * bin_hz;
+    if (band_limited) {
+        double margin = pow(2.0, FRF_BAND_MARGIN_OCTAVES);
+        f_lo = ctx->sweep.start_freq / margin;
+        f_hi = ctx->sweep.end_freq * margin;
+    }
+    ctx->first_bin = frf_grid_band_bins(&ctx->grid, f_lo, f_hi, fs, ctx->nfft);
+    ctx->resample = grid != VT_OUTPUT_BINS;
+    if (ctx->resample) {
+        ctx->grid.type = grid == VT_OUTPUT_LOG ? FRF_GRID_LOG : FRF_GRID_LINEAR;
+        ctx->grid.num_points = num_points;
+        if (ctx->grid.type == FRF_GRID_LOG && ctx->grid.f_min <= 0.0) {
+            ctx->grid.f_min = bin_hz; /* log grid cannot start at DC */
+        }
+        ctx->active_first = frf_resample_bins(&ctx->grid, ctx->nfft / 2, bin_hz, &ctx->num_active);
+    } else {
+        ctx->active_first = ctx->first_bin;
+        ctx->num_active = ctx->grid.num_points;
+    }
+
+    /* Outputs are float32 pairs; wider builds compute each one aside first */
+    if (sizeof(kiss_fft_cpx) != sizeof(float_cpx)) {
+        kiss_fft_cpx *points = (kiss_fft_cpx*)realloc(ctx->points, sizeof(kiss_fft_cpx) * ctx->grid.num_points);
+        if (!points) {
+            fprintf(stderr, "vt_set_output: out of memory\n");
+            return -1;
+        }
+        ctx->points = points;
+    }
+    return 0;
+}
+
+int vt_output_points(const VtContext *ctx) {
+    return ctx->grid.num_points;
+}
+
+void vt_output_frequencies(const VtContext *ctx, double *frequencies) {
+    for (int k = 0; k < ctx->grid.num_points; k++) {
+        frequencies[k] = frf_grid_frequency(&ctx->grid, k);
+    }
+}
+
+/* Deconvolves a capture into the windowed linear IR spectrum dst (nfft bins) */
+static int deconvolve(VtContext *ctx, const float *samples, int64_t num_samples, kiss_fft_cpx *dst) {
+    if (!samples || num_samples < ctx->n_samples) {
+        fprintf(stderr, "Capture has %lld samples, the sweep needs %d\n", (long long)num_samples, ctx->n_samples);
+        return -1;
+    }
+    for (int i = 0; i < ctx->nfft; i++) {
+        dst[i].r = i < ctx->n_samples ? samples[i] : 0.0f;
+        dst[i].i = 0.0f;
+    }
+    kiss_fft(ctx->cfg_fwd, dst, dst);
+    perform_deconvolution_bins(dst, ctx->inv_filter, ctx->nfft, ctx->band_first, ctx->band_bins);
+    extract_linear_ir(dst, ctx->cfg_inv, ctx->cfg_fwd, ctx->nfft, ctx->n_samples, ctx->npre, ctx->npost,
+                      ctx->sweep.sample_rate, 0);
+    return 0;
+}
+
+int vt_set_calibration(VtContext *ctx, const float *calibration, int64_t num_samples) {
+    ctx->has_calibration = deconvolve(ctx, calibration, num_samples, ctx->closed) == 0;
+    return ctx->has_calibration ? 0 : -1;
+}
+
+/* Writes one spectrum on the output axis into caller memory, as float32 pairs */
+static void write_output(const VtContext *ctx, const kiss_fft_cpx *bins, float *out) {
+    const kiss_fft_cpx *points = bins + ctx->first_bin;
+    if (ctx->resample) {
+        kiss_fft_cpx *dst = ctx->points ? ctx->points : (kiss_fft_cpx *)out;
+        frf_resample(bins, ctx->nfft / 2, ctx->sweep.sample_rate / ctx->nfft, &ctx->grid, dst);
+        points = dst;
+    }
+    if (points != (const kiss_fft_cpx *)out) {
+        complex_to_float32((float_cpx *)out, points, (size_t)ctx->grid.num_points);
+    }
+}
+
+int vt_process(VtContext *ctx, const float *measurement, int64_t num_samples,
+               float *h_lips, float *open, float *closed) {
+    if (!ctx->has_calibration) {
+        fprintf(stderr, "vt_process: no calibration set\n");
+        return -1;
+    }
+    if (deconvolve(ctx, measurement, num_samples, ctx->open) != 0) {
+        return -1;
+    }
+
+    if (h_lips && !ctx->resample && !ctx->points) {
+        /* Bin output of float builds: H_lips is computed straight into the caller's array */
+        int first = ctx->first_bin;
+        compute_h_lips((kiss_fft_cpx *)h_lips, ctx->open + first, ctx->closed + first, ctx->epsilon + first,
+                       ctx->grid.num_points);
+    } else if (h_lips) {
+        int first = ctx->active_first;
+        compute_h_lips(ctx->h + first, ctx->open + first, ctx->closed + first, ctx->epsilon + first, ctx->num_active);
+        write_output(ctx, ctx->h, h_lips);
+    }
+    if (open) {
+        write_output(ctx, ctx->open, open);
+    }
+    if (closed) {
+        write_output(ctx, ctx->closed, closed);
+    }
+    return 0;
+}
@@ -0,0 +1,133 @@
+#ifndef VTIMPEDANCE_H
+#define VTIMPEDANCE_H
+
+/*
+ * Public C API of libvtimpedance.so: the processing core without audio
+ * devices or files. Callers own every sample and output buffer; the
+ * library reads captures in place and writes the FRF straight into the
+ * caller's memory. Only symbols declared here are exported.
+ *
+ * Complex outputs are interleaved float32 pairs (re, im), the layout of
+ * C99 float complex and of numpy complex64.
+ */
+
+#include <stdint.h>
+
+#if defined(__GNUC__)
+#define VT_API __attribute__((visibility("default")))
+#else
+#define VT_API
+#endif
+
+/* Bumped when a declaration below changes incompatibly (also the .so version) */
+#define VT_API_VERSION 1
+
+typedef struct VtContext VtContext;
+
+/* Sweep that excited the captures */
+typedef struct {
+    double sample_rate; /* Hz */
+    float start_freq;   /* Hz */
+    float end_freq;     /* Hz */
+    float duration;     /* Chirp length (s), without padding */
+    float amplitude;
+    int type;           /* 0 = linear, 1 = exponential */
+} VtSweep;
+
+/* Output frequency axis, as in the FRF file */
+typedef enum {
+    VT_OUTPUT_BINS = 0,   /* FFT bins, k * sample_rate / nfft */
+    VT_OUTPUT_LINEAR = 1, /* num_points linearly spaced points */
+    VT_OUTPUT_LOG = 2     /* num_points log-spaced points */
+} VtOutputGrid;
+
+/**
+ * Version of the library's API (VT_API_VERSION it was built with).
+ */
+VT_API int vt_api_version(void);
+
+/**
+ * Creates a context for one sweep: FFT plans, the inverse filter and
+ * the regularization are prepared once and reused by every call.
+ * Output defaults to all FFT bins below Nyquist.
+ *
+ * Parameters:
+ *   sweep: Sweep parameters
+ *
+ * Returns:
+ *   New context (release with vt_context_destroy()), or NULL on failure
+ */
+VT_API VtContext *vt_context_create(const VtSweep *sweep);
+
+/**
+ * Releases a context and its working buffers.
+ */
+VT_API void vt_context_destroy(VtContext *ctx);
+
+/**
+ * Number of samples of each capture the deconvolution reads. Captures
+ * passed in must hold at least this many.
+ */
+VT_API int64_t vt_capture_length(const VtContext *ctx);
+
+/**
+ * FFT size of the deconvolution; FFT bin k is at k * sample_rate / size.
+ */
+VT_API int vt_fft_size(const VtContext *ctx);
+
+/**
+ * Selects the output frequency axis.
+ *
+ * Parameters:
+ *   band_limited: Non-zero to keep the sweep band plus 1/3 octave on each side
+ *   grid: VT_OUTPUT_BINS, or a linear/log grid over the kept band
+ *   num_points: Points of a linear/log grid (ignored for VT_OUTPUT_BINS)
+ *
+ * Returns:
+ *   0 on success, -1 on invalid parameters
+ */
+VT_API int vt_set_output(VtContext *ctx, int band_limited, VtOutputGrid grid, int num_points);
+
+/**
+ * Number of complex points each output array holds.
+ */
+VT_API int vt_output_points(const VtContext *ctx);
+
+/**
+ * Writes the frequency (Hz) of each output point.
+ *
+ * Parameters:
+ *   frequencies: vt_output_points() values
+ */
+VT_API void vt_output_frequencies(const VtContext *ctx, double *frequencies);
+
+/**
+ * Deconvolves the calibration (closed-mouth) capture and keeps its
+ * linear IR spectrum for the following vt_process() calls.
+ *
+ * Parameters:
+ *   calibration: Mono float samples, read in place
+ *   num_samples: At least vt_capture_length()
+ *
+ * Returns:
+ *   0 on success, -1 on failure
+ */
+VT_API int vt_set_calibration(VtContext *ctx, const float *calibration, int64_t num_samples);
+
+/**
+ * Deconvolves a measurement (open-mouth) capture and computes H_lips
+ * against the current calibration. Any output may be NULL.
+ *
+ * Parameters:
+ *   measurement: Mono float samples, read in place
+ *   num_samples: At least vt_capture_length()
+ *   h_lips: Output, vt_output_points() complex values
+ *   open, closed: Output linear IR spectra, vt_output_points() complex values
+ *
+ * Returns:
+ *   0 on success, -1 on failure (e.g. no calibration set)
+ */
+VT_API int vt_process(VtContext *ctx, const float *measurement, int64_t num_samples,
+                      float *h_lips, float *open, float *closed);
+
+#endif
@@ -2,11 +2,25 @@
 #define CONFIG_H
 
 #include <portaudio.h>
+#include "sample_format.h"
+#include "audio_io.h"
+
+/* Clock drift correction of duplex takes (see clock_drift.h) */
+typedef enum {
+    DRIFT_AUTO = 0, /* When the input and output devices differ */
+    DRIFT_OFF = 1,
+    DRIFT_ON = 2
+} DriftPolicy;
 
 /* Audio configuration */
 typedef struct {
     PaDeviceIndex input_device;
     PaDeviceIndex output_device;
+    double sample_rate; /* Capture/playback rate (Hz), validated against both devices */
+    SampleFormat capture_format; /* Native input format, stored as-is on disk */
+    AudioStreamTuning tuning; /* Buffer size/latencies for duplex takes (zeroed = defaults) */
+    int interactive; /* 0 for batch runs: no chirp preview, no "press Enter" pause */
+    DriftPolicy clock_drift; /* Whether takes are fitted for clock drift and resampled */
 } AudioConfig;
 
 /* Chirp parameters */
@@ -15,20 +29,31 @@ typedef struct {
     float start_freq;
     float end_freq;
     float duration;
-    int type; /* 0 = linear, 1 = exponential */
+    int type; /* 0 = linear, 1 = exponential, 2 = maximum-length sequence (see mls.h) */
     float Tgap; /* Silence padding (s) - split equally before and after chirp */
     float Tfade; /* Fade-in/fade-out duration (s) */
+    int num_sweeps; /* Staggered exponential sweeps per take (0 or 1: single sweep, see multi_sweep.h) */
+    float sweep_stagger; /* Start-to-start spacing of the sweeps (s) */
+    float sweep_level_step; /* Level of each sweep below the one before (dB) */
+    int mls_order; /* MLS period 2^mls_order - 1 samples (0: shortest covering duration) */
+    int mls_periods; /* MLS periods averaged after the lead-in one */
 } ChirpParams;
 
 /* Processing modes */
 typedef enum {
     MODE_CALIBRATION = 1,
     MODE_MEASUREMENT = 2,
-    MODE_PROCESSING = 3
+    MODE_PROCESSING = 3,
+    MODE_DAEMON = 4, /* Command line only: serves processing jobs over a socket */
+    MODE_PARAM_SWEEP = 5, /* Command line only: evaluates a grid of processing settings */
+    MODE_LIVE = 6, /* Command line only: live FRF monitoring with a periodic excitation */
+    MODE_PEAKS = 7 /* Command line only: resonances of the FRF database entries */
 } ProcessingMode;
 
 /* Global constants */
-#define SAMPLE_RATE 44100
+#define DEFAULT_SAMPLE_RATE 44100.0
+#define NUM_STANDARD_SAMPLE_RATES 6
+#define STANDARD_SAMPLE_RATES { 44100.0, 48000.0, 88200.0, 96000.0, 176400.0, 192000.0 }
 #define NUM_CHANNELS 1
 #define DEFAULT_FFT_PADDING_FACTOR 1 /* FFT size = smallest power of 2 >= n_samples */
 
@@ -1,7 +1,13 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <math.h>
 #include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
 
 #include "audio_io.h"
 
@@ -56,6 +62,71 @@ const PaDeviceInfo* audio_get_device_info(PaDeviceIndex device_index) {
     return info;
 }
 
+unsigned long audio_frames_per_buffer(double sample_rate) {
+    double target = FRAMES_PER_BUFFER * sample_rate / FRAMES_PER_BUFFER_REFERENCE_RATE;
+    unsigned long frames = 64;
+    while ((double)frames * 1.5 < target) {
+        frames *= 2;
+    }
+    return frames;
+}
+
+PaSampleFormat audio_pa_sample_format(SampleFormat format) {
+    switch (format) {
+        case SAMPLE_FORMAT_INT16: return paInt16;
+        case SAMPLE_FORMAT_INT24: return paInt24;
+        case SAMPLE_FORMAT_INT32: return paInt32;
+        case SAMPLE_FORMAT_FLOAT32:
+        default: return paFloat32;
+    }
+}
+
+int audio_is_capture_format_supported(PaDeviceIndex input_device, double sample_rate,
+                                      SampleFormat format, int num_channels) {
+    const PaDeviceInfo *info = Pa_GetDeviceInfo(input_device);
+    if (!info) return 0;
+
+    PaStreamParameters input_params;
+    input_params.device = input_device;
+    input_params.channelCount = num_channels;
+    input_params.sampleFormat = audio_pa_sample_format(format);
+    input_params.suggestedLatency = info->defaultLowInputLatency;
+    input_params.hostApiSpecificStreamInfo = NULL;
+
+    return Pa_IsFormatSupported(&input_params, NULL, sample_rate) == paFormatIsSupported;
+}
+
+int audio_is_sample_rate_supported(PaDeviceIndex input_device, PaDeviceIndex output_device,
+                                   double sample_rate, int num_channels) {
+    PaStreamParameters input_params, output_params;
+    PaStreamParameters *input_ptr = NULL;
+    PaStreamParameters *output_ptr = NULL;
+
+    if (input_device != paNoDevice) {
+        const PaDeviceInfo *info = Pa_GetDeviceInfo(input_device);
+        if (!info) return 0;
+        input_params.device = input_device;
+        input_params.channelCount = num_channels;
+        input_params.sampleFormat = paFloat32;
+        input_params.suggestedLatency = info->defaultLowInputLatency;
+        input_params.hostApiSpecificStreamInfo = NULL;
+        input_ptr = &input_params;
+    }
+
+    if (output_device != paNoDevice) {
+        const PaDeviceInfo *info = Pa_GetDeviceInfo(output_device);
+        if (!info) return 0;
+        output_params.device = output_device;
+        output_params.channelCount = num_channels;
+        output_params.sampleFormat = paFloat32;
+        output_params.suggestedLatency = info->defaultLowOutputLatency;
+        output_params.hostApiSpecificStreamInfo = NULL;
+        output_ptr = &output_params;
+    }
+
+    return Pa_IsFormatSupported(input_ptr, output_ptr, sample_rate) == paFormatIsSupported;
+}
+
 int audio_play(PaDeviceIndex output_device, float sample_rate, 
                const float *buffer, int num_samples, int num_channels) {
     if (!buffer || num_samples <= 0 || num_channels <= 0) {
@@ -78,7 +149,7 @@ int audio_play(PaDeviceIndex output_device, float sample_rate,
         NULL,  // No input
         &output_params,
         sample_rate,
-        FRAMES_PER_BUFFER,
+        audio_frames_per_buffer(sample_rate),
         paClipOff,  // Don't clip
         NULL,       // Use blocking I/O
         NULL
@@ -98,13 +169,14 @@ int audio_play(PaDeviceIndex output_device, float sample_rate,
     }
 
     // Write audio data in chunks
+    int frames_per_buffer = (int)audio_frames_per_buffer(sample_rate);
     int samples_written = 0;
     int total_frames = num_samples;
     
     while (samples_written < total_frames) {
-        int frames_to_write = (total_frames - samples_written < FRAMES_PER_BUFFER) 
+        int frames_to_write = (total_frames - samples_written < frames_per_buffer) 
                                ? (total_frames - samples_written) 
-                               : FRAMES_PER_BUFFER;
+                               : frames_per_buffer;
         
         err = Pa_WriteStream(stream, 
                             &buffer[samples_written * num_channels], 
@@ -159,7 +231,7 @@ int audio_record(PaDeviceIndex input_device, float sample_rate,
         &input_params,
         NULL,  // No output
         sample_rate,
-        FRAMES_PER_BUFFER,
+        audio_frames_per_buffer(sample_rate),
         paClipOff,
         NULL,  // Use blocking I/O
         NULL
@@ -179,13 +251,14 @@ int audio_record(PaDeviceIndex input_device, float sample_rate,
     }
 
     // Read audio data in chunks
+    int frames_per_buffer = (int)audio_frames_per_buffer(sample_rate);
     int samples_read = 0;
     int total_frames = num_samples;
     
     while (samples_read < total_frames) {
-        int frames_to_read = (total_frames - samples_read < FRAMES_PER_BUFFER) 
+        int frames_to_read = (total_frames - samples_read < frames_per_buffer) 
                               ? (total_frames - samples_read) 
-                              : FRAMES_PER_BUFFER;
+                              : frames_per_buffer;
         
         err = Pa_ReadStream(stream, 
                            &buffer[samples_read * num_channels], 
@@ -221,11 +294,17 @@ int audio_record(PaDeviceIndex input_device, float sample_rate,
 // Callback data structure
 typedef struct {
     const float *playback_buffer;
-    float *record_buffer;
+    void *record_buffer;     // Native capture format, see record_frame_bytes
+    int record_frame_bytes;  // Bytes per recorded frame (all channels)
     int frame_index;
     int max_frames;
     int num_channels;
     int finished;
+    int input_overflows;     // xrun counters, reported after the take
+    int output_underflows;
+    int loop_frames;         // Loop streams: playback_buffer period, repeated until the stream is stopped
+    int ring_frames;         // Loop streams: record_buffer is a float ring of this many frames
+    long long frames_done;   // Loop streams: frames recorded so far, published with release ordering
 } CallbackData;
 
 // Audio callback function for duplex operation
@@ -235,17 +314,17 @@ static int duplex_callback(const void *input_buffer, void *output_buffer,
                           PaStreamCallbackFlags status_flags,
                           void *user_data) {
     CallbackData *data = (CallbackData *)user_data;
-    const float *in = (const float *)input_buffer;
+    const void *in = input_buffer;
     float *out = (float *)output_buffer;
     
     (void)time_info; // Prevent unused variable warning
     
-    // Check for buffer issues
+    // Count buffer issues (no I/O on the audio thread)
     if (status_flags & paInputOverflow) {
-        fprintf(stderr, "Warning: Input overflow detected in callback\n");
+        data->input_overflows++;
     }
     if (status_flags & paOutputUnderflow) {
-        fprintf(stderr, "Warning: Output underflow detected in callback\n");
+        data->output_underflows++;
     }
     
     unsigned long frames_to_process = frames_per_buffer;
@@ -255,14 +334,10 @@ static int duplex_callback(const void *input_buffer, void *output_buffer,
         frames_to_process = frames_left;
     }
     
-    // Copy input to record buffer
+    // Copy input to record buffer, keeping the device's native sample format
     if (in != NULL) {
-        for (unsigned long i = 0; i < frames_to_process; i++) {
-            for (int ch = 0; ch < data->num_channels; ch++) {
-                data->record_buffer[(data->frame_index + i) * data->num_channels + ch] = 
-                    in[i * data->num_channels + ch];
-            }
-        }
+        memcpy((char *)data->record_buffer + (size_t)data->frame_index * data->record_frame_bytes,
+               in, frames_to_process * data->record_frame_bytes);
     }
     
     // Copy playback buffer to output
@@ -295,86 +370,330 @@ static int duplex_callback(const void *input_buffer, void *output_buffer,
     return paContinue;
 }
 
-int audio_duplex_callback(PaDeviceIndex output_device, PaDeviceIndex input_device,
-                          float sample_rate,
-                          const float *playback_buffer, float *record_buffer,
-                          int num_samples, int num_channels) {
-    if (!playback_buffer || !record_buffer || num_samples <= 0 || num_channels <= 0) {
-        fprintf(stderr, "audio_duplex_callback: Invalid parameters\n");
-        return -1;
+// Audio callback of loop streams: the playback period repeats and the input goes round the ring
+static int duplex_loop_callback(const void *input_buffer, void *output_buffer,
+                                unsigned long frames_per_buffer,
+                                const PaStreamCallbackTimeInfo *time_info,
+                                PaStreamCallbackFlags status_flags,
+                                void *user_data) {
+    CallbackData *data = (CallbackData *)user_data;
+    const float *in = (const float *)input_buffer;
+    float *out = (float *)output_buffer;
+    float *ring = (float *)data->record_buffer;
+    
+    (void)time_info;
+    
+    if (status_flags & paInputOverflow) {
+        data->input_overflows++;
     }
+    if (status_flags & paOutputUnderflow) {
+        data->output_underflows++;
+    }
+    
+    // Only this thread writes frames_done; readers load it with acquire ordering
+    long long done = data->frames_done;
+    for (unsigned long i = 0; i < frames_per_buffer; i++) {
+        long long n = done + (long long)i;
+        int r = (int)(n % data->ring_frames);
+        int p = (int)(n % data->loop_frames);
+        for (int ch = 0; ch < data->num_channels; ch++) {
+            if (in != NULL) {
+                ring[r * data->num_channels + ch] = in[i * data->num_channels + ch];
+            }
+            if (out != NULL) {
+                out[i * data->num_channels + ch] = data->playback_buffer[p * data->num_channels + ch];
+            }
+        }
+    }
+    __atomic_store_n(&data->frames_done, done + (long long)frames_per_buffer, __ATOMIC_RELEASE);
+    
+    return paContinue;
+}
 
-    // Initialize callback data
+// Asynchronous duplex take: stream, callback state and completion signal
+struct AudioDuplexHandle {
+    PaStream *stream;
     CallbackData callback_data;
-    callback_data.playback_buffer = playback_buffer;
-    callback_data.record_buffer = record_buffer;
-    callback_data.frame_index = 0;
-    callback_data.max_frames = num_samples;
-    callback_data.num_channels = num_channels;
-    callback_data.finished = 0;
+    pthread_mutex_t lock;
+    pthread_cond_t done_cond;
+    int done;
+};
+
+// Called by PortAudio once the stream becomes inactive (paComplete or stop/abort).
+// user_data is the stream's callback data, embedded in the handle.
+static void duplex_finished_callback(void *user_data) {
+    AudioDuplexHandle *handle = (AudioDuplexHandle *)((char *)user_data - offsetof(AudioDuplexHandle, callback_data));
+    
+    pthread_mutex_lock(&handle->lock);
+    handle->done = 1;
+    pthread_cond_broadcast(&handle->done_cond);
+    pthread_mutex_unlock(&handle->lock);
+}
+
+AudioDuplexHandle *audio_duplex_start(PaDeviceIndex output_device, PaDeviceIndex input_device,
+                                      float sample_rate,
+                                      const float *playback_buffer, float *record_buffer,
+                                      int num_samples, int num_channels) {
+    return audio_duplex_start_native(output_device, input_device, sample_rate, playback_buffer,
+                                     record_buffer, SAMPLE_FORMAT_FLOAT32, num_samples, num_channels, NULL);
+}
+
+/* Opens and starts a duplex stream running callback on a copy of data */
+static AudioDuplexHandle *open_duplex_stream(PaDeviceIndex output_device, PaDeviceIndex input_device,
+                                             float sample_rate, SampleFormat record_format, int num_channels,
+                                             const AudioStreamTuning *tuning, PaStreamCallback *callback,
+                                             const CallbackData *data) {
+    AudioDuplexHandle *handle = (AudioDuplexHandle *)calloc(1, sizeof(AudioDuplexHandle));
+    if (!handle) {
+        fprintf(stderr, "audio_duplex_start: Failed to allocate handle\n");
+        return NULL;
+    }
+
+    if (pthread_mutex_init(&handle->lock, NULL) != 0) {
+        free(handle);
+        return NULL;
+    }
+    if (pthread_cond_init(&handle->done_cond, NULL) != 0) {
+        pthread_mutex_destroy(&handle->lock);
+        free(handle);
+        return NULL;
+    }
+
+    handle->callback_data = *data;
+    handle->done = 0;
+
+    const PaDeviceInfo *input_info = Pa_GetDeviceInfo(input_device);
+    const PaDeviceInfo *output_info = Pa_GetDeviceInfo(output_device);
+    if (!input_info || !output_info) {
+        fprintf(stderr, "audio_duplex_start: Invalid device index\n");
+        pthread_cond_destroy(&handle->done_cond);
+        pthread_mutex_destroy(&handle->lock);
+        free(handle);
+        return NULL;
+    }
 
     // Open full-duplex stream with callback
-    PaStream *stream;
     PaStreamParameters input_params, output_params;
     
-    // Configure input parameters with higher latency for different devices
+    // Configure input parameters; untuned streams use high latency for stability across devices
     input_params.device = input_device;
     input_params.channelCount = num_channels;
-    input_params.sampleFormat = paFloat32;
-    // Always use high latency for better stability and to prevent overflow
-    // input_params.suggestedLatency = Pa_GetDeviceInfo(input_device)->defaultHighInputLatency;
+    input_params.sampleFormat = audio_pa_sample_format(record_format);
+    input_params.suggestedLatency = (tuning && tuning->input_latency > 0.0)
+                                    ? tuning->input_latency : input_info->defaultHighInputLatency;
     input_params.hostApiSpecificStreamInfo = NULL;
 
     // Configure output parameters
     output_params.device = output_device;
     output_params.channelCount = num_channels;
     output_params.sampleFormat = paFloat32;
-    // output_params.suggestedLatency = Pa_GetDeviceInfo(output_device)->defaultHighOutputLatency;
+    output_params.suggestedLatency = (tuning && tuning->output_latency > 0.0)
+                                     ? tuning->output_latency : output_info->defaultHighOutputLatency;
     output_params.hostApiSpecificStreamInfo = NULL;
 
+    unsigned long frames_per_buffer = (tuning && tuning->frames_per_buffer > 0)
+                                      ? tuning->frames_per_buffer : audio_frames_per_buffer(sample_rate);
+
     PaError err = Pa_OpenStream(
-        &stream,
+        &handle->stream,
         &input_params,
         &output_params,
         sample_rate,
-        FRAMES_PER_BUFFER,
+        frames_per_buffer,
         paClipOff,  // Don't clip, let us handle it
-        duplex_callback,
-        &callback_data
+        callback,
+        &handle->callback_data
     );
 
     if (err != paNoError) {
         fprintf(stderr, "Failed to open callback-based full-duplex stream: %s\n", Pa_GetErrorText(err));
-        return -1;
+        pthread_cond_destroy(&handle->done_cond);
+        pthread_mutex_destroy(&handle->lock);
+        free(handle);
+        return NULL;
+    }
+
+    err = Pa_SetStreamFinishedCallback(handle->stream, duplex_finished_callback);
+    if (err != paNoError) {
+        fprintf(stderr, "Failed to set stream finished callback: %s\n", Pa_GetErrorText(err));
+        Pa_CloseStream(handle->stream);
+        pthread_cond_destroy(&handle->done_cond);
+        pthread_mutex_destroy(&handle->lock);
+        free(handle);
+        return NULL;
     }
 
     // Start stream
-    err = Pa_StartStream(stream);
+    err = Pa_StartStream(handle->stream);
     if (err != paNoError) {
         fprintf(stderr, "Failed to start callback-based full-duplex stream: %s\n", Pa_GetErrorText(err));
-        Pa_CloseStream(stream);
+        Pa_CloseStream(handle->stream);
+        pthread_cond_destroy(&handle->done_cond);
+        pthread_mutex_destroy(&handle->lock);
+        free(handle);
+        return NULL;
+    }
+
+    return handle;
+}
+
+AudioDuplexHandle *audio_duplex_start_native(PaDeviceIndex output_device, PaDeviceIndex input_device,
+                                             float sample_rate,
+                                             const float *playback_buffer,
+                                             void *record_buffer, SampleFormat record_format,
+                                             int num_samples, int num_channels,
+                                             const AudioStreamTuning *tuning) {
+    if (!playback_buffer || !record_buffer || num_samples <= 0 || num_channels <= 0) {
+        fprintf(stderr, "audio_duplex_start: Invalid parameters\n");
+        return NULL;
+    }
+
+    CallbackData data;
+    memset(&data, 0, sizeof(data));
+    data.playback_buffer = playback_buffer;
+    data.record_buffer = record_buffer;
+    data.record_frame_bytes = sample_format_bytes(record_format) * num_channels;
+    data.max_frames = num_samples;
+    data.num_channels = num_channels;
+
+    return open_duplex_stream(output_device, input_device, sample_rate, record_format, num_channels, tuning,
+                              duplex_callback, &data);
+}
+
+AudioDuplexHandle *audio_duplex_start_loop(PaDeviceIndex output_device, PaDeviceIndex input_device,
+                                           float sample_rate,
+                                           const float *playback_buffer, int period_frames,
+                                           float *record_ring, int ring_frames, int num_channels,
+                                           const AudioStreamTuning *tuning) {
+    if (!playback_buffer || !record_ring || period_frames <= 0 || ring_frames <= 0 || num_channels <= 0) {
+        fprintf(stderr, "audio_duplex_start_loop: Invalid parameters\n");
+        return NULL;
+    }
+
+    CallbackData data;
+    memset(&data, 0, sizeof(data));
+    data.playback_buffer = playback_buffer;
+    data.record_buffer = record_ring;
+    data.record_frame_bytes = (int)sizeof(float) * num_channels;
+    data.num_channels = num_channels;
+    data.loop_frames = period_frames;
+    data.ring_frames = ring_frames;
+
+    return open_duplex_stream(output_device, input_device, sample_rate, SAMPLE_FORMAT_FLOAT32, num_channels, tuning,
+                              duplex_loop_callback, &data);
+}
+
+long long audio_duplex_frames_recorded(AudioDuplexHandle *handle) {
+    return __atomic_load_n(&handle->callback_data.frames_done, __ATOMIC_ACQUIRE);
+}
+
+int audio_duplex_is_done(AudioDuplexHandle *handle) {
+    pthread_mutex_lock(&handle->lock);
+    int done = handle->done;
+    pthread_mutex_unlock(&handle->lock);
+    return done;
+}
+
+int audio_duplex_wait(AudioDuplexHandle *handle, double timeout_seconds) {
+    if (!handle) {
+        return -1;
+    }
+
+    int ret = 0;
+    pthread_mutex_lock(&handle->lock);
+
+    if (timeout_seconds <= 0.0) {
+        while (!handle->done) {
+            pthread_cond_wait(&handle->done_cond, &handle->lock);
+        }
+    } else {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        double whole = floor(timeout_seconds);
+        deadline.tv_sec += (time_t)whole;
+        deadline.tv_nsec += (long)((timeout_seconds - whole) * 1e9);
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec += 1;
+            deadline.tv_nsec -= 1000000000L;
+        }
+
+        while (!handle->done) {
+            int err = pthread_cond_timedwait(&handle->done_cond, &handle->lock, &deadline);
+            if (err == ETIMEDOUT) {
+                ret = handle->done ? 0 : 1;
+                break;
+            }
+        }
+    }
+
+    pthread_mutex_unlock(&handle->lock);
+    return ret;
+}
+
+void audio_duplex_get_stats(AudioDuplexHandle *handle, AudioDuplexStats *stats) {
+    const PaStreamInfo *info = Pa_GetStreamInfo(handle->stream);
+
+    stats->input_overflows = handle->callback_data.input_overflows;
+    stats->output_underflows = handle->callback_data.output_underflows;
+
+    stats->input_latency = info ? info->inputLatency : 0.0;
+    stats->output_latency = info ? info->outputLatency : 0.0;
+}
+
+int audio_duplex_close(AudioDuplexHandle *handle) {
+    if (!handle) {
         return -1;
     }
 
-    // Wait for stream to complete
-    while (Pa_IsStreamActive(stream) == 1) {
-        Pa_Sleep(10); // Sleep for 10ms to avoid busy waiting
+    int ret = 0;
+    PaError err;
+
+    if (handle->callback_data.input_overflows > 0) {
+        fprintf(stderr, "Warning: %d input overflow(s) detected during take\n", handle->callback_data.input_overflows);
+    }
+    if (handle->callback_data.output_underflows > 0) {
+        fprintf(stderr, "Warning: %d output underflow(s) detected during take\n", handle->callback_data.output_underflows);
     }
 
-    // Stop and close stream
-    err = Pa_StopStream(stream);
+    // Loop streams only end here; stopping lets the queued buffers play out
+    if (audio_duplex_is_done(handle) || handle->callback_data.loop_frames > 0) {
+        err = Pa_StopStream(handle->stream);
+    } else {
+        fprintf(stderr, "Aborting unfinished full-duplex stream\n");
+        err = Pa_AbortStream(handle->stream);
+        ret = -1;
+    }
     if (err != paNoError && err != paStreamIsStopped) {
         fprintf(stderr, "Error stopping callback-based stream: %s\n", Pa_GetErrorText(err));
-        Pa_CloseStream(stream);
-        return -1;
+        ret = -1;
     }
 
-    err = Pa_CloseStream(stream);
+    err = Pa_CloseStream(handle->stream);
     if (err != paNoError) {
         fprintf(stderr, "Error closing callback-based stream: %s\n", Pa_GetErrorText(err));
-        return -1;
+        ret = -1;
     }
 
-    return 0;
+    pthread_cond_destroy(&handle->done_cond);
+    pthread_mutex_destroy(&handle->lock);
+    free(handle);
+
+    return ret;
 }
 
+int audio_duplex_callback(PaDeviceIndex output_device, PaDeviceIndex input_device,
+                          float sample_rate,
+                          const float *playback_buffer, float *record_buffer,
+                          int num_samples, int num_channels) {
+    AudioDuplexHandle *handle = audio_duplex_start(output_device, input_device, sample_rate,
+                                                   playback_buffer, record_buffer,
+                                                   num_samples, num_channels);
+    if (!handle) {
+        return -1;
+    }
+
+    // Block until the stream finished callback fires
+    audio_duplex_wait(handle, 0.0);
+
+    return audio_duplex_close(handle);
+}
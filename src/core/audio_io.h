@@ -1,10 +1,29 @@
 #ifndef AUDIO_IO_H
 #define AUDIO_IO_H
 
-#define SAMPLE_RATE 44100
-#define FRAMES_PER_BUFFER 1024
+#define FRAMES_PER_BUFFER 1024 /* Buffer size at FRAMES_PER_BUFFER_REFERENCE_RATE */
+#define FRAMES_PER_BUFFER_REFERENCE_RATE 44100.0
 
 #include <portaudio.h>
+#include "sample_format.h"
+
+/* Opaque handle for an asynchronous full-duplex take */
+typedef struct AudioDuplexHandle AudioDuplexHandle;
+
+/* Stream buffer size and suggested latencies (0 fields fall back to defaults) */
+typedef struct {
+    unsigned long frames_per_buffer; /* 0 = audio_frames_per_buffer(sample_rate) */
+    double input_latency;            /* Suggested input latency (s), 0 = device default high */
+    double output_latency;           /* Suggested output latency (s), 0 = device default high */
+} AudioStreamTuning;
+
+/* Health and timing of a duplex take */
+typedef struct {
+    int input_overflows;   /* Callbacks flagged paInputOverflow */
+    int output_underflows; /* Callbacks flagged paOutputUnderflow */
+    double input_latency;  /* Actual input latency reported by the stream (s) */
+    double output_latency; /* Actual output latency reported by the stream (s) */
+} AudioDuplexStats;
 
 /**
  * Initializes PortAudio library.
@@ -56,6 +75,55 @@ int audio_list_devices(void);
  */
 const PaDeviceInfo* audio_get_device_info(PaDeviceIndex device_index);
 
+/**
+ * Computes the stream buffer size for a given sample rate.
+ * Scales FRAMES_PER_BUFFER so that the buffer duration stays roughly
+ * constant (~23 ms), rounded to the nearest power of two.
+ * 
+ * Parameters:
+ *   sample_rate: Sampling rate in Hz
+ * 
+ * Returns:
+ *   Frames per buffer to use when opening streams at this rate
+ */
+unsigned long audio_frames_per_buffer(double sample_rate);
+
+/**
+ * Checks whether the device pair supports a sample rate.
+ * Uses Pa_IsFormatSupported() with float32 samples on both directions.
+ * 
+ * Parameters:
+ *   input_device: Device index for recording (paNoDevice to skip input check)
+ *   output_device: Device index for playback (paNoDevice to skip output check)
+ *   sample_rate: Sampling rate in Hz to test
+ *   num_channels: Number of channels on each direction
+ * 
+ * Returns:
+ *   1 if the rate is supported, 0 otherwise
+ */
+int audio_is_sample_rate_supported(PaDeviceIndex input_device, PaDeviceIndex output_device,
+                                   double sample_rate, int num_channels);
+
+/**
+ * Maps a native capture format to the PortAudio sample format.
+ */
+PaSampleFormat audio_pa_sample_format(SampleFormat format);
+
+/**
+ * Checks whether an input device can capture in a given native format.
+ * 
+ * Parameters:
+ *   input_device: Device index for recording
+ *   sample_rate: Sampling rate in Hz
+ *   format: Native capture format to test
+ *   num_channels: Number of input channels
+ * 
+ * Returns:
+ *   1 if the format is supported, 0 otherwise
+ */
+int audio_is_capture_format_supported(PaDeviceIndex input_device, double sample_rate,
+                                      SampleFormat format, int num_channels);
+
 /**
  * Plays audio data from a buffer to a specified output device.
  * 
@@ -140,4 +208,110 @@ int audio_duplex_callback(PaDeviceIndex output_device, PaDeviceIndex input_devic
                           const float *playback_buffer, float *record_buffer,
                           int num_samples, int num_channels);
 
+/**
+ * Starts a callback-based full-duplex take and returns immediately.
+ * Completion is signalled by the stream finished callback, so the caller
+ * can do other work (prepare the next sweep, process the previous take)
+ * and then block on audio_duplex_wait().
+ * 
+ * Parameters:
+ *   Same as audio_duplex_callback(). Both buffers must stay valid until
+ *   audio_duplex_close() returns.
+ * 
+ * Returns:
+ *   Handle to the running take, or NULL on failure
+ */
+AudioDuplexHandle *audio_duplex_start(PaDeviceIndex output_device, PaDeviceIndex input_device,
+                                      float sample_rate,
+                                      const float *playback_buffer, float *record_buffer,
+                                      int num_samples, int num_channels);
+
+/**
+ * Same as audio_duplex_start(), but records in the device's native format.
+ * Samples are stored as delivered (e.g. packed 24-bit for
+ * SAMPLE_FORMAT_INT24) with no conversion on the audio thread.
+ * 
+ * Parameters:
+ *   record_buffer: Must hold num_samples * num_channels samples of
+ *                  sample_format_bytes(record_format) bytes each
+ *   record_format: Native input format (playback stays float32)
+ *   tuning: Buffer size and latencies to request, or NULL for defaults
+ * 
+ * Returns:
+ *   Handle to the running take, or NULL on failure
+ */
+AudioDuplexHandle *audio_duplex_start_native(PaDeviceIndex output_device, PaDeviceIndex input_device,
+                                             float sample_rate,
+                                             const float *playback_buffer,
+                                             void *record_buffer, SampleFormat record_format,
+                                             int num_samples, int num_channels,
+                                             const AudioStreamTuning *tuning);
+
+/**
+ * Starts an endless full-duplex stream for periodic excitation: the
+ * period_frames frames of playback_buffer are played over and over, and
+ * the input is written, as float32, round a ring of ring_frames frames.
+ * The stream runs until audio_duplex_close(), which stops it without
+ * reporting an error; audio_duplex_wait() never returns before that.
+ *
+ * Parameters:
+ *   playback_buffer: One period (period_frames * num_channels samples)
+ *   record_ring: Ring of ring_frames * num_channels samples; frame n of
+ *                the stream lands at n % ring_frames
+ *   tuning: Buffer size and latencies to request, or NULL for defaults
+ *
+ * Returns:
+ *   Handle to the running stream, or NULL on failure
+ */
+AudioDuplexHandle *audio_duplex_start_loop(PaDeviceIndex output_device, PaDeviceIndex input_device,
+                                           float sample_rate,
+                                           const float *playback_buffer, int period_frames,
+                                           float *record_ring, int ring_frames, int num_channels,
+                                           const AudioStreamTuning *tuning);
+
+/**
+ * Frames a loop stream has recorded so far. Frames up to the returned
+ * count are complete in the ring until the stream has moved
+ * ring_frames past them. Safe to call from any thread.
+ */
+long long audio_duplex_frames_recorded(AudioDuplexHandle *handle);
+
+/**
+ * Non-blocking completion check.
+ * 
+ * Returns:
+ *   1 if all frames have been played/recorded, 0 otherwise
+ */
+int audio_duplex_is_done(AudioDuplexHandle *handle);
+
+/**
+ * Waits for a take to complete.
+ * 
+ * Parameters:
+ *   handle: Handle returned by audio_duplex_start()
+ *   timeout_seconds: Maximum wait; <= 0 waits indefinitely
+ * 
+ * Returns:
+ *   0 if the take completed
+ *   1 if the timeout expired first (handle is still valid)
+ *   -1 on invalid handle
+ */
+int audio_duplex_wait(AudioDuplexHandle *handle, double timeout_seconds);
+
+/**
+ * Reads xrun counters and the stream's actual latencies.
+ * Valid at any time before audio_duplex_close().
+ */
+void audio_duplex_get_stats(AudioDuplexHandle *handle, AudioDuplexStats *stats);
+
+/**
+ * Stops (or aborts, if still running) and closes the stream, then frees
+ * the handle.
+ * 
+ * Returns:
+ *   0 if the take completed and the stream closed cleanly
+ *   Non-zero otherwise
+ */
+int audio_duplex_close(AudioDuplexHandle *handle);
+
 #endif
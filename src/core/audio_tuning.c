@@ -0,0 +1,188 @@
+#include "audio_tuning.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TUNING_LINE_MAX 1024
+#define TUNING_MAX_ENTRIES 256
+
+/* Runs one silent take and reports whether it was stable and its round-trip latency */
+static int probe_configuration(PaDeviceIndex output_device, PaDeviceIndex input_device,
+                               double sample_rate, int num_channels,
+                               const AudioStreamTuning *tuning, double *round_trip) {
+    int n_samples = (int)(TUNING_PROBE_SECONDS * sample_rate);
+    float *silence = (float*)calloc((size_t)n_samples * num_channels, sizeof(float));
+    float *record = (float*)malloc(sizeof(float) * n_samples * num_channels);
+
+    if (!silence || !record) {
+        free(silence);
+        free(record);
+        return 0;
+    }
+
+    AudioDuplexHandle *take = audio_duplex_start_native(output_device, input_device, (float)sample_rate,
+                                                        silence, record, SAMPLE_FORMAT_FLOAT32,
+                                                        n_samples, num_channels, tuning);
+    if (!take) {
+        free(silence);
+        free(record);
+        return 0;
+    }
+
+    int completed = audio_duplex_wait(take, TUNING_PROBE_SECONDS + 2.0) == 0;
+
+    AudioDuplexStats stats;
+    audio_duplex_get_stats(take, &stats);
+    audio_duplex_close(take);
+
+    free(silence);
+    free(record);
+
+    *round_trip = stats.input_latency + stats.output_latency;
+    return completed && stats.input_overflows == 0 && stats.output_underflows == 0;
+}
+
+int audio_tune_duplex(PaDeviceIndex output_device, PaDeviceIndex input_device,
+                      double sample_rate, int num_channels, AudioStreamTuning *tuning) {
+    const PaDeviceInfo *input_info = Pa_GetDeviceInfo(input_device);
+    const PaDeviceInfo *output_info = Pa_GetDeviceInfo(output_device);
+    if (!input_info || !output_info) {
+        fprintf(stderr, "audio_tune_duplex: Invalid device index\n");
+        return -1;
+    }
+
+    int found = 0;
+    double best_round_trip = 0.0;
+
+    printf("Probing stream configurations (%.1f s silent take each)...\n", TUNING_PROBE_SECONDS);
+    for (unsigned long frames = TUNING_MIN_FRAMES; frames <= TUNING_MAX_FRAMES; frames *= 2) {
+        for (int step = 0; step < TUNING_LATENCY_STEPS; step++) {
+            double t = (TUNING_LATENCY_STEPS > 1) ? (double)step / (TUNING_LATENCY_STEPS - 1) : 0.0;
+
+            AudioStreamTuning candidate;
+            candidate.frames_per_buffer = frames;
+            candidate.input_latency = input_info->defaultLowInputLatency
+                + t * (input_info->defaultHighInputLatency - input_info->defaultLowInputLatency);
+            candidate.output_latency = output_info->defaultLowOutputLatency
+                + t * (output_info->defaultHighOutputLatency - output_info->defaultLowOutputLatency);
+
+            double round_trip = 0.0;
+            int stable = probe_configuration(output_device, input_device, sample_rate, num_channels,
+                                             &candidate, &round_trip);
+            printf("  %5lu frames, latency in %.1f ms / out %.1f ms: %s (round trip %.1f ms)\n",
+                   frames, candidate.input_latency * 1000, candidate.output_latency * 1000,
+                   stable ? "stable" : "xruns", round_trip * 1000);
+
+            if (stable && (!found || round_trip < best_round_trip)) {
+                *tuning = candidate;
+                best_round_trip = round_trip;
+                found = 1;
+            }
+        }
+    }
+
+    if (!found) {
+        fprintf(stderr, "No stable stream configuration found\n");
+        return -1;
+    }
+
+    printf("Selected %lu frames per buffer, round trip %.1f ms\n", tuning->frames_per_buffer, best_round_trip * 1000);
+    return 0;
+}
+
+/* Splits a tab-separated tuning line in place; returns the number of fields */
+static int split_fields(char *line, char **fields, int max_fields) {
+    int n = 0;
+    char *p = line;
+    line[strcspn(line, "\r\n")] = '\0';
+    while (n < max_fields) {
+        fields[n++] = p;
+        char *tab = strchr(p, '\t');
+        if (!tab) break;
+        *tab = '\0';
+        p = tab + 1;
+    }
+    return n;
+}
+
+int audio_tuning_load(const char *filename, PaDeviceIndex output_device, PaDeviceIndex input_device,
+                      double sample_rate, AudioStreamTuning *tuning) {
+    const PaDeviceInfo *input_info = Pa_GetDeviceInfo(input_device);
+    const PaDeviceInfo *output_info = Pa_GetDeviceInfo(output_device);
+    if (!input_info || !output_info) {
+        return -1;
+    }
+
+    FILE *file = fopen(filename, "r");
+    if (!file) {
+        return -1;
+    }
+
+    char line[TUNING_LINE_MAX];
+    int found = 0;
+    while (!found && fgets(line, sizeof(line), file)) {
+        char *fields[6];
+        if (line[0] == '#' || split_fields(line, fields, 6) != 6) continue;
+
+        if (strcmp(fields[0], input_info->name) == 0 && strcmp(fields[1], output_info->name) == 0
+            && atof(fields[2]) == sample_rate) {
+            tuning->frames_per_buffer = strtoul(fields[3], NULL, 10);
+            tuning->input_latency = atof(fields[4]);
+            tuning->output_latency = atof(fields[5]);
+            found = 1;
+        }
+    }
+    fclose(file);
+
+    return found ? 0 : -1;
+}
+
+int audio_tuning_save(const char *filename, PaDeviceIndex output_device, PaDeviceIndex input_device,
+                      double sample_rate, const AudioStreamTuning *tuning) {
+    const PaDeviceInfo *input_info = Pa_GetDeviceInfo(input_device);
+    const PaDeviceInfo *output_info = Pa_GetDeviceInfo(output_device);
+    if (!input_info || !output_info) {
+        return -1;
+    }
+
+    /* Keep every other entry, then rewrite the file with the new one appended */
+    char (*kept)[TUNING_LINE_MAX] = malloc(sizeof(*kept) * TUNING_MAX_ENTRIES);
+    if (!kept) {
+        return -1;
+    }
+    int n_kept = 0;
+
+    FILE *file = fopen(filename, "r");
+    if (file) {
+        char line[TUNING_LINE_MAX];
+        while (n_kept < TUNING_MAX_ENTRIES && fgets(line, sizeof(line), file)) {
+            char copy[TUNING_LINE_MAX];
+            char *fields[6];
+            strcpy(copy, line);
+            if (line[0] == '#' || split_fields(copy, fields, 6) != 6) continue;
+            if (strcmp(fields[0], input_info->name) == 0 && strcmp(fields[1], output_info->name) == 0
+                && atof(fields[2]) == sample_rate) continue;
+            strcpy(kept[n_kept++], line);
+        }
+        fclose(file);
+    }
+
+    file = fopen(filename, "w");
+    if (!file) {
+        fprintf(stderr, "Failed to open '%s' for writing stream tuning\n", filename);
+        free(kept);
+        return -1;
+    }
+
+    fprintf(file, "# input_device\toutput_device\tsample_rate\tframes_per_buffer\tinput_latency_s\toutput_latency_s\n");
+    for (int i = 0; i < n_kept; i++) {
+        fputs(kept[i], file);
+    }
+    fprintf(file, "%s\t%s\t%.0f\t%lu\t%.6f\t%.6f\n", input_info->name, output_info->name, sample_rate,
+            tuning->frames_per_buffer, tuning->input_latency, tuning->output_latency);
+    fclose(file);
+    free(kept);
+
+    printf("Stream tuning saved to '%s'\n", filename);
+    return 0;
+}
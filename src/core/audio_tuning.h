@@ -0,0 +1,68 @@
+#ifndef AUDIO_TUNING_H
+#define AUDIO_TUNING_H
+
+#include "audio_io.h"
+
+#define DEFAULT_TUNING_FILE "output/stream_tuning.txt"
+#define TUNING_PROBE_SECONDS 0.5 /* Length of each silent probe take */
+#define TUNING_MIN_FRAMES 64
+#define TUNING_MAX_FRAMES 4096
+#define TUNING_LATENCY_STEPS 3 /* Suggested latencies tried per buffer size (low .. high) */
+
+/* Whether to run the stream tuner when no saved tuning exists */
+typedef enum {
+    TUNER_ASK = 0,  /* Prompt (interactive runs) */
+    TUNER_SKIP = 1, /* Use default stream settings */
+    TUNER_RUN = 2   /* Run the tuner and save its result */
+} TunerPolicy;
+
+/**
+ * Probes a device pair for the smallest stable stream configuration.
+ * Runs silent full-duplex takes for every buffer size from
+ * TUNING_MIN_FRAMES to TUNING_MAX_FRAMES (powers of two) and
+ * TUNING_LATENCY_STEPS suggested latencies between the devices' default
+ * low and high latencies. A configuration is stable when its take
+ * completes with no input overflow or output underflow; among stable
+ * ones, the lowest reported round-trip latency wins (ties go to the
+ * smaller buffer).
+ * 
+ * Parameters:
+ *   output_device: Device index for playback
+ *   input_device: Device index for recording
+ *   sample_rate: Sampling rate in Hz
+ *   num_channels: Number of channels
+ *   tuning: Output configuration
+ * 
+ * Returns:
+ *   0 if a stable configuration was found, -1 otherwise
+ */
+int audio_tune_duplex(PaDeviceIndex output_device, PaDeviceIndex input_device,
+                      double sample_rate, int num_channels, AudioStreamTuning *tuning);
+
+/**
+ * Loads the saved tuning for a device pair at a sample rate.
+ * Entries are keyed by device names, so they survive index changes.
+ * 
+ * Parameters:
+ *   filename: Tuning file (see DEFAULT_TUNING_FILE)
+ *   output_device, input_device: Device pair to look up
+ *   sample_rate: Sampling rate in Hz
+ *   tuning: Output configuration
+ * 
+ * Returns:
+ *   0 if an entry was found, -1 otherwise
+ */
+int audio_tuning_load(const char *filename, PaDeviceIndex output_device, PaDeviceIndex input_device,
+                      double sample_rate, AudioStreamTuning *tuning);
+
+/**
+ * Saves the tuning for a device pair, replacing any previous entry for
+ * the same pair and sample rate.
+ * 
+ * Returns:
+ *   0 on success, -1 on failure
+ */
+int audio_tuning_save(const char *filename, PaDeviceIndex output_device, PaDeviceIndex input_device,
+                      double sample_rate, const AudioStreamTuning *tuning);
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef AUDIO_VIEW_H
+#define AUDIO_VIEW_H
+
+#include <stddef.h>
+#include "sample_format.h"
+
+/**
+ * Non-owning window onto a mono sample buffer in any native SampleFormat.
+ * Alignment and trimming only move offset/length; the samples are copied
+ * at I/O boundaries (file writes) and nowhere else.
+ */
+typedef struct {
+    const void *data;    /* Underlying buffer (not owned) */
+    SampleFormat format; /* Native layout of data */
+    int offset;          /* First sample of the view within data */
+    int length;          /* Number of samples visible through the view */
+    double sample_rate;  /* Sampling rate of the underlying buffer (Hz) */
+} AudioView;
+
+/**
+ * Creates a view covering a whole buffer.
+ */
+static inline AudioView audio_view_make(const void *data, SampleFormat format, int length, double sample_rate) {
+    AudioView view;
+    view.data = data;
+    view.format = format;
+    view.offset = 0;
+    view.length = length > 0 ? length : 0;
+    view.sample_rate = sample_rate;
+    return view;
+}
+
+/**
+ * Drops the first n samples of the view (n <= 0 leaves it unchanged).
+ * Clamped so the view never extends past the end of the buffer.
+ */
+static inline AudioView audio_view_advance(AudioView view, int n) {
+    if (n <= 0) return view;
+    if (n > view.length) n = view.length;
+    view.offset += n;
+    view.length -= n;
+    return view;
+}
+
+/**
+ * Keeps at most the first n samples of the view.
+ */
+static inline AudioView audio_view_trim(AudioView view, int n) {
+    if (n < 0) n = 0;
+    if (n < view.length) view.length = n;
+    return view;
+}
+
+/**
+ * Pointer to the first sample of the view (native format).
+ */
+static inline const void *audio_view_ptr(AudioView view) {
+    return (const char *)view.data + (size_t)view.offset * sample_format_bytes(view.format);
+}
+
+/**
+ * Duration of the view in seconds.
+ */
+static inline double audio_view_duration(AudioView view) {
+    return (double)view.length / view.sample_rate;
+}
+
+#endif
@@ -0,0 +1,182 @@
+#include "clock_drift.h"
+#include "processing.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Lag of reference[first, first + length) in the recording, searched over
+ * coarse_delay +- search: the peak of the analytic cross-correlation's
+ * magnitude (its envelope), refined by a parabola. The segment is
+ * Hann-tapered so the sweep around it does not skew the envelope. Returns
+ * the normalized correlation at the peak (at most 0.82, the taper's
+ * Cauchy-Schwarz bound), 0 if the peak is at the end of
+ * the search; *sharpness is the envelope's curvature there relative to
+ * its height (1 / samples^2), which grows with the segment's bandwidth.
+ * rec and ref are scratch buffers of nfft.
+ */
+static double segment_lag(const float *recording, const float *reference, int n_samples, int first, int length,
+                          int coarse_delay, int search, kiss_fft_cpx *rec, kiss_fft_cpx *ref, int nfft,
+                          kiss_fft_cfg cfg_fwd, kiss_fft_cfg cfg_inv, double *lag, double *sharpness) {
+    int rec_first = first + coarse_delay - search;
+    double e_ref = 0.0;
+    for (int i = 0; i < nfft; i++) {
+        int j = rec_first + i;
+        rec[i].r = i < length + 2 * search && j >= 0 && j < n_samples ? recording[j] : 0.0f;
+        rec[i].i = 0.0f;
+        double r = i < length ? reference[first + i] * 0.5 * (1.0 - cos(2.0 * M_PI * (i + 0.5) / length)) : 0.0;
+        ref[i].r = (kiss_fft_scalar)r;
+        ref[i].i = 0.0f;
+        e_ref += r * r;
+    }
+    kiss_fft(cfg_fwd, rec, rec);
+    kiss_fft(cfg_fwd, ref, ref);
+
+    /* rec * conj(ref), positive frequencies only (doubled): the analytic correlation */
+    for (int k = 0; k < nfft; k++) {
+        double scale = (k == 0 || k == nfft / 2) ? 1.0 : (k < nfft / 2 ? 2.0 : 0.0);
+        double re = (double)rec[k].r * ref[k].r + (double)rec[k].i * ref[k].i;
+        double im = (double)rec[k].i * ref[k].r - (double)rec[k].r * ref[k].i;
+        rec[k].r = (kiss_fft_scalar)(scale * re / nfft);
+        rec[k].i = (kiss_fft_scalar)(scale * im / nfft);
+    }
+    kiss_fft(cfg_inv, rec, rec);
+
+    /* Envelope peak over lags 0 .. 2 search (no circular wrap there) */
+    int peak = 0;
+    double best = -1.0;
+    for (int k = 0; k <= 2 * search; k++) {
+        double m = hypot(rec[k].r, rec[k].i);
+        if (m > best) {
+            best = m;
+            peak = k;
+        }
+    }
+    if (peak == 0 || peak == 2 * search) {
+        return 0.0;
+    }
+    double a = hypot(rec[peak - 1].r, rec[peak - 1].i);
+    double c = hypot(rec[peak + 1].r, rec[peak + 1].i);
+    double curvature = a - 2.0 * best + c;
+    if (!(curvature < 0.0)) {
+        return 0.0;
+    }
+    *lag = coarse_delay - search + peak + 0.5 * (a - c) / curvature;
+    *sharpness = -curvature / best;
+
+    double e_rec = 0.0;
+    for (int i = 0; i < length; i++) {
+        int j = rec_first + peak + i;
+        double x = j >= 0 && j < n_samples ? recording[j] : 0.0;
+        e_rec += x * x;
+    }
+    return e_ref > 0.0 && e_rec > 0.0 ? best / sqrt(e_ref * e_rec) : 0.0;
+}
+
+/*
+ * Clock model from the line m0 + m1 t fitted to the envelope lags. The
+ * faster clock scales the recording's frequencies (per sample) by
+ * 1 / ratio, and the envelope peaks where they match the segment's. For
+ * the sweep laws of generate_chirp() (tau: time into the sweep, s0: its
+ * first sample):
+ *   exponential, f0 e^(tau / L): m1 = ratio - 1, m0 = offset + ratio fs L ln(ratio)
+ *   linear, f0 + k tau: m1 = ratio^2 - 1, m0 = offset - ratio (ratio - 1) (s0 - fs f0 / k)
+ */
+static void clock_from_lags(ClockDrift *drift, double m0, double m1, const ChirpParams *chirp, double fs,
+                            int sweep_first) {
+    double f0 = chirp->start_freq, f1 = chirp->end_freq;
+    if (chirp->type == 0) {
+        double r = sqrt(1.0 + m1);
+        double k = (f1 - f0) / chirp->duration;
+        drift->ratio = r;
+        drift->offset = m0 + r * (r - 1.0) * (sweep_first - fs * f0 / k);
+    } else {
+        double r = 1.0 + m1;
+        double L = (1 / f0) * ceil(f0 * chirp->duration / log(f1 / f0));
+        drift->ratio = r;
+        drift->offset = m0 - r * fs * L * log(r);
+    }
+}
+
+int estimate_clock_drift(const float *recording, const float *reference, int n_samples, const ChirpParams *chirp,
+                         double fs, int sweep_first, int coarse_delay, ClockDrift *drift) {
+    memset(drift, 0, sizeof(*drift));
+    drift->ratio = 1.0;
+    drift->offset = coarse_delay;
+
+    int length = (int)(chirp->duration * fs) / DRIFT_NUM_SEGMENTS;
+    int search = (int)ceil(DRIFT_MAX_PPM * 1e-6 * n_samples) + DRIFT_SEARCH_MARGIN;
+    if (length <= 0) {
+        return -1;
+    }
+    int nfft = calculate_next_power_of_two(length + 2 * search);
+    kiss_fft_cpx *rec = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * nfft);
+    kiss_fft_cpx *ref = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * nfft);
+    kiss_fft_cfg cfg_fwd = kiss_fft_alloc(nfft, 0, NULL, NULL);
+    kiss_fft_cfg cfg_inv = kiss_fft_alloc(nfft, 1, NULL, NULL);
+    if (!rec || !ref || !cfg_fwd || !cfg_inv) {
+        fprintf(stderr, "Failed to allocate clock drift buffers\n");
+        free(rec);
+        free(ref);
+        kiss_fft_free(cfg_fwd);
+        kiss_fft_free(cfg_inv);
+        return -1;
+    }
+
+    /* Lag at each segment center */
+    double t[DRIFT_NUM_SEGMENTS], lag[DRIFT_NUM_SEGMENTS], weight[DRIFT_NUM_SEGMENTS];
+    int n = 0;
+    for (int s = 0; s < DRIFT_NUM_SEGMENTS; s++) {
+        int first = sweep_first + s * length;
+        if (first < 0 || first + length > n_samples) {
+            continue;
+        }
+        double correlation = segment_lag(recording, reference, n_samples, first, length, coarse_delay, search, rec,
+                                         ref, nfft, cfg_fwd, cfg_inv, &lag[n], &weight[n]);
+        if (correlation >= DRIFT_MIN_CORRELATION) {
+            t[n++] = first + 0.5 * length;
+        }
+    }
+    free(rec);
+    free(ref);
+    kiss_fft_free(cfg_fwd);
+    kiss_fft_free(cfg_inv);
+    if (n < DRIFT_MIN_SEGMENTS) {
+        return -1;
+    }
+
+    /*
+     * Weighted least squares line lag = a + b t. A lag is as precise as its
+     * envelope is sharp: narrow-band (low) segments of an exponential
+     * sweep weigh little.
+     */
+    double sum_w = 0.0, mean_t = 0.0, mean_lag = 0.0;
+    for (int i = 0; i < n; i++) {
+        sum_w += weight[i];
+        mean_t += weight[i] * t[i];
+        mean_lag += weight[i] * lag[i];
+    }
+    mean_t /= sum_w;
+    mean_lag /= sum_w;
+    double stt = 0.0, stl = 0.0;
+    for (int i = 0; i < n; i++) {
+        stt += weight[i] * (t[i] - mean_t) * (t[i] - mean_t);
+        stl += weight[i] * (t[i] - mean_t) * (lag[i] - mean_lag);
+    }
+    double b = stl / stt;
+    double a = mean_lag - b * mean_t;
+    double misfit = 0.0;
+    for (int i = 0; i < n; i++) {
+        double e = lag[i] - (a + b * t[i]);
+        misfit += weight[i] * e * e;
+    }
+
+    clock_from_lags(drift, a, b, chirp, fs, sweep_first);
+    drift->residual = sqrt(misfit / sum_w);
+    drift->num_segments = n;
+    return 0;
+}
+
+double clock_drift_ppm(const ClockDrift *drift) {
+    return (drift->ratio - 1.0) * 1e6;
+}
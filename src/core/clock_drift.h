@@ -0,0 +1,64 @@
+#ifndef CLOCK_DRIFT_H
+#define CLOCK_DRIFT_H
+
+#include "config.h"
+
+#define DRIFT_NUM_SEGMENTS 8          /* Sweep segments whose lag is measured */
+#define DRIFT_MAX_PPM 1000.0          /* Largest clock mismatch searched for */
+#define DRIFT_SEARCH_MARGIN 64        /* Lag searched beyond DRIFT_MAX_PPM either side (samples) */
+#define DRIFT_MIN_CORRELATION 0.2     /* Least normalized correlation of a usable segment */
+#define DRIFT_MIN_SEGMENTS 4          /* Usable segments needed for a fit */
+#define DRIFT_CORRECTION_SAMPLES 0.2  /* Takes are resampled only if the drift over them exceeds this */
+
+/**
+ * Linear clock model of a take: reference sample t was recorded at
+ * position offset + ratio * t. offset is the constant delay
+ * estimate_delay() measures, down to a fraction of a sample; ratio is
+ * the input clock over the output clock.
+ */
+typedef struct {
+    double offset;
+    double ratio;
+    double residual;  /* RMS lag misfit of the segments (samples) */
+    int num_segments; /* Segments used in the fit */
+} ClockDrift;
+
+/**
+ * Measures the lag of the recording behind the reference at
+ * DRIFT_NUM_SEGMENTS points along the sweep and fits the linear clock
+ * model to them.
+ *
+ * Each sweep segment is cross-correlated with the recording around
+ * coarse_delay (by FFT, over DRIFT_MAX_PPM of the take plus
+ * DRIFT_SEARCH_MARGIN). The lag is taken at the peak of the correlation
+ * envelope, refined by a parabola through its neighbours, so it follows
+ * the system's group delay rather than the carrier phase; segments
+ * correlating less than DRIFT_MIN_CORRELATION (noise, dropouts) are left
+ * out, and the others are weighted by the sharpness of their peak. The
+ * envelope lines up frequencies, which the drift also scales, so the
+ * fitted line is mapped back to the clock through the sweep law. The
+ * system's group delay is assumed to be constant over the sweep: its
+ * spread across the band shows up in the residual.
+ *
+ * Parameters:
+ *   recording: Recorded take (n_samples)
+ *   reference: Sent signal (n_samples), the chirp of generate_chirp()
+ *   n_samples: Length of both
+ *   chirp: Sweep parameters
+ *   fs: Sampling rate of the reference (Hz)
+ *   sweep_first: First sample of the sweep in the reference (after the leading gap)
+ *   coarse_delay: Lag of the recording from estimate_delay() (samples)
+ *   drift: Output model
+ *
+ * Returns:
+ *   0 on success, -1 if too few segments were usable or on allocation failure
+ */
+int estimate_clock_drift(const float *recording, const float *reference, int n_samples, const ChirpParams *chirp,
+                         double fs, int sweep_first, int coarse_delay, ClockDrift *drift);
+
+/**
+ * Clock mismatch of a model in parts per million: (ratio - 1) * 1e6.
+ */
+double clock_drift_ppm(const ClockDrift *drift);
+
+#endif
@@ -1,9 +1,25 @@
+#ifndef COMPLEX_UTILS_H
+#define COMPLEX_UTILS_H
+
+#include <stddef.h>
 #include <complex.h>
 #include "kiss_fft.h"
 
+/*
+ * The processing core computes in kiss_fft_scalar: float by default,
+ * double when built with PRECISION=double (-Dkiss_fft_scalar=double).
+ * Files and the C API keep float32 (re, im) pairs in both builds.
+ */
+
+/* Complex bin as stored in FRF files and returned by the C API */
+typedef struct {
+    float r;
+    float i;
+} float_cpx;
+
 /**
  * Mapping: kiss_fft_cpx -> double complex
- * Converts the float-based KissFFT struct into a standard C99 complex type.
+ * Converts the KissFFT struct into a standard C99 complex type.
  */
 static inline double complex kiss_to_c99(kiss_fft_cpx k) {
     return (double)k.r + (double)k.i * I;
@@ -12,7 +28,7 @@ static inline double complex kiss_to_c99(kiss_fft_cpx k) {
 /**
  * Mapping: double complex -> kiss_fft_cpx
  * Converts a standard complex back to the struct.
- * Note: kiss_fft_scalar is typically float, so this will cast down.
+ * Note: casts down in float builds.
  */
 static inline kiss_fft_cpx c99_to_kiss(double complex c) {
     kiss_fft_cpx k;
@@ -25,7 +41,7 @@ static inline kiss_fft_cpx c99_to_kiss(double complex c) {
  * Calculates the squared magnitude of a complex number.
  * Used in the denominator of the transfer function ratio (cf. eq. II.18).
  */
-static inline float complex_squared_magnitude(kiss_fft_cpx z) {
+static inline kiss_fft_scalar complex_squared_magnitude(kiss_fft_cpx z) {
     return (z.r * z.r) + (z.i * z.i);
 }
 
@@ -40,22 +56,58 @@ static inline kiss_fft_cpx complex_conjugate(kiss_fft_cpx z) {
     return res;
 }
 
+/**
+ * Calculates the product a * b.
+ */
+static inline kiss_fft_cpx complex_multiply(kiss_fft_cpx a, kiss_fft_cpx b) {
+    kiss_fft_cpx res;
+    res.r = a.r * b.r - a.i * b.i;
+    res.i = a.r * b.i + a.i * b.r;
+    return res;
+}
+
 /**
  * Performs general complex division.
  * Uses the formula: (a.r + i*a.i) / (b.r + i*b.i)
  */
 static inline kiss_fft_cpx complex_division(kiss_fft_cpx a, kiss_fft_cpx b) {
-    float denom = complex_squared_magnitude(b);
+    kiss_fft_scalar denom = complex_squared_magnitude(b);
     kiss_fft_cpx res;
 
     // Check for division by zero
-    if (denom == 0.0f) {
-        res.r = 0.0f; // or some error value
-        res.i = 0.0f;
+    if (denom == 0) {
+        res.r = 0; // or some error value
+        res.i = 0;
         return res;
     }
 
     res.r = (a.r * b.r + a.i * b.i) / denom;
     res.i = (a.i * b.r - a.r * b.i) / denom;
     return res;
-}
\ No newline at end of file
+}
+
+/**
+ * Converts n bins to float32 pairs (a copy in float builds).
+ * dst may be src itself: the conversion runs forwards.
+ */
+static inline void complex_to_float32(float_cpx *dst, const kiss_fft_cpx *src, size_t n) {
+    for (size_t k = 0; k < n; k++) {
+        kiss_fft_cpx z = src[k];
+        dst[k].r = (float)z.r;
+        dst[k].i = (float)z.i;
+    }
+}
+
+/**
+ * Converts n float32 pairs to bins (a copy in float builds).
+ * dst may be src itself, if sized for n bins: the conversion runs backwards.
+ */
+static inline void complex_from_float32(kiss_fft_cpx *dst, const float_cpx *src, size_t n) {
+    for (size_t k = n; k-- > 0;) {
+        float_cpx z = src[k];
+        dst[k].r = z.r;
+        dst[k].i = z.i;
+    }
+}
+
+#endif
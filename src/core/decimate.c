@@ -0,0 +1,290 @@
+#include "decimate.h"
+#include "processing.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// --- Factor choice ---
+
+static int gcd(int a, int b) {
+    while (b != 0) {
+        int t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+int decimation_factor(double fs, double f_pass, int *up, int *down) {
+    double min_rate = 2.0 * DECIMATION_OVERSAMPLING * f_pass;
+    int integer_rate = fs == floor(fs);
+    double best_rate = fs;
+    *up = 1;
+    *down = 1;
+
+    for (int u = 1; u <= DECIMATION_MAX_UP; u++) {
+        for (int d = u + 1; d <= DECIMATION_MAX_DOWN; d++) {
+            double rate = fs * u / d;
+            if (rate < min_rate) {
+                break;
+            }
+            if (gcd(u, d) != 1 || (integer_rate && fmod(fs * u, d) != 0.0)) {
+                continue;
+            }
+            if (rate < best_rate) {
+                best_rate = rate;
+                *up = u;
+                *down = d;
+            }
+        }
+    }
+    return *down > *up;
+}
+
+// --- Filter design ---
+
+/* Modified Bessel function of the first kind, order 0 (power series) */
+static double bessel_i0(double x) {
+    double sum = 1.0, term = 1.0;
+    for (int k = 1; k < 100 && term > 1e-16 * sum; k++) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+/*
+ * Kaiser-windowed sinc of 2 * half * up + 1 taps at rate fs * up, cut at
+ * half the output rate, scaled to a DC gain of up (zero stuffing divides
+ * the level by up). Transition band: [f_pass, f_out - f_pass], which
+ * keeps everything that aliases onto [0, f_pass] below the attenuation.
+ */
+static int design_lowpass(Decimator *d, double fs, double f_pass) {
+    double f_out = fs * d->up / d->down;
+    double rate = fs * d->up;
+    double transition = 2.0 * M_PI * (f_out - 2.0 * f_pass) / rate;
+    double a = DECIMATION_ATTENUATION_DB;
+    double beta = 0.1102 * (a - 8.7);
+    int order = (int)ceil((a - 8.0) / (2.285 * transition));
+    int half = (order + 2 * d->up - 1) / (2 * d->up);
+    int length = 2 * half * d->up + 1;
+
+    d->center = half * d->up;
+    d->num_taps = 2 * half + 1;
+    d->coeffs = (float*)calloc((size_t)d->up * d->num_taps, sizeof(float));
+    double *h = (double*)malloc(sizeof(double) * length);
+    if (!d->coeffs || !h) {
+        fprintf(stderr, "Failed to allocate decimation filter (%d taps)\n", length);
+        free(h);
+        return -1;
+    }
+
+    double cutoff = f_out / 2.0 / rate; /* Cycles per sample */
+    double sum = 0.0;
+    for (int n = 0; n < length; n++) {
+        double x = n - d->center;
+        double sinc = x == 0.0 ? 2.0 * cutoff : sin(2.0 * M_PI * cutoff * x) / (M_PI * x);
+        double r = x / d->center;
+        h[n] = sinc * bessel_i0(beta * sqrt(1.0 - r * r)) / bessel_i0(beta);
+        sum += h[n];
+    }
+
+    /* Branch p holds taps p, p + up, p + 2 up, ... */
+    for (int n = 0; n < length; n++) {
+        d->coeffs[(n % d->up) * d->num_taps + n / d->up] = (float)(h[n] * d->up / sum);
+    }
+    free(h);
+    return 0;
+}
+
+int decimator_init(Decimator *d, int up, int down, double fs, double f_pass, SampleSource source, void *context,
+                   int64_t num_input) {
+    memset(d, 0, sizeof(*d));
+    if (up < 1 || down < up || up > DECIMATION_MAX_UP || down > DECIMATION_MAX_DOWN) {
+        fprintf(stderr, "Invalid decimation factor %d/%d (need 1 <= up <= down, up <= %d, down <= %d)\n",
+                up, down, DECIMATION_MAX_UP, DECIMATION_MAX_DOWN);
+        return -1;
+    }
+    double f_out = fs * up / down;
+    if (f_out < 2.0 * DECIMATION_MIN_OVERSAMPLING * f_pass) {
+        fprintf(stderr, "Decimation by %d/%d gives %.1f Hz, too low to keep %.1f Hz (need %.1f Hz)\n",
+                up, down, f_out, f_pass, 2.0 * DECIMATION_MIN_OVERSAMPLING * f_pass);
+        return -1;
+    }
+
+    d->up = up;
+    d->down = down;
+    d->source = source;
+    d->context = context;
+    d->num_input = num_input;
+    if (up == down) {
+        d->num_taps = 1;
+        d->coeffs = (float*)malloc(sizeof(float));
+        if (!d->coeffs) {
+            fprintf(stderr, "Failed to allocate decimation filter\n");
+            return -1;
+        }
+        d->coeffs[0] = 1.0f;
+        return 0;
+    }
+    if (design_lowpass(d, fs, f_pass) != 0) {
+        decimator_free(d);
+        return -1;
+    }
+    return 0;
+}
+
+void decimator_free(Decimator *d) {
+    free(d->coeffs);
+    free(d->scratch);
+    d->coeffs = NULL;
+    d->scratch = NULL;
+    d->scratch_size = 0;
+}
+
+int64_t decimator_output_length(const Decimator *d) {
+    return d->num_input * d->up / d->down;
+}
+
+// --- Filtering ---
+
+/* Input sample feeding output m's newest tap: floor((m * down + center) / up) */
+static int64_t newest_input(const Decimator *d, int64_t m) {
+    return (m * d->down + d->center) / d->up;
+}
+
+/*
+ * Reads inputs [in_first, in_first + span) into a scratch buffer grown as
+ * needed, with zeros outside [0, num_input)
+ */
+static int read_padded(SampleSource source, void *context, int64_t num_input, int64_t in_first, int span,
+                       float **scratch, int *scratch_size) {
+    if (span > *scratch_size) {
+        float *grown = (float*)realloc(*scratch, sizeof(float) * span);
+        if (!grown) {
+            fprintf(stderr, "Failed to allocate resampling buffer\n");
+            return -1;
+        }
+        *scratch = grown;
+        *scratch_size = span;
+    }
+
+    int64_t read_first = in_first > 0 ? in_first : 0;
+    int64_t read_end = in_first + span < num_input ? in_first + span : num_input;
+    memset(*scratch, 0, sizeof(float) * span);
+    if (read_end > read_first
+        && source(context, read_first, (int)(read_end - read_first), *scratch + (read_first - in_first)) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+int decimator_read(void *context, int64_t first, int count, float *dst) {
+    Decimator *d = (Decimator *)context;
+    if (count <= 0) {
+        return 0;
+    }
+
+    /* Input span of the whole read */
+    int64_t in_last = newest_input(d, first + count - 1);
+    int64_t in_first = newest_input(d, first) - (d->num_taps - 1);
+    if (read_padded(d->source, d->context, d->num_input, in_first, (int)(in_last - in_first + 1), &d->scratch,
+                    &d->scratch_size) != 0) {
+        return -1;
+    }
+
+    /* Only the kept outputs: y[m] = sum_t branch_p[t] x[newest - t], p = (m * down + center) mod up */
+    for (int k = 0; k < count; k++) {
+        int64_t j = (first + k) * d->down + d->center;
+        const float *branch = d->coeffs + (j % d->up) * d->num_taps;
+        const float *x = d->scratch + (j / d->up - in_first);
+        double acc = 0.0;
+        for (int t = 0; t < d->num_taps; t++) {
+            acc += (double)branch[t] * x[-t];
+        }
+        dst[k] = (float)acc;
+    }
+    return 0;
+}
+
+// --- Fractional resampling ---
+
+#define RESAMPLER_TAPS (2 * RESAMPLER_HALF_TAPS)
+
+int resampler_init(Resampler *r, double offset, double ratio, SampleSource source, void *context, int64_t num_input) {
+    memset(r, 0, sizeof(*r));
+    if (!(ratio >= 0.5 && ratio <= 2.0)) {
+        fprintf(stderr, "Invalid resampling ratio %g (need 0.5 to 2)\n", ratio);
+        return -1;
+    }
+    r->offset = offset;
+    r->ratio = ratio;
+    r->source = source;
+    r->context = context;
+    r->num_input = num_input;
+    r->table = (float*)malloc(sizeof(float) * (RESAMPLER_PHASES + 1) * RESAMPLER_TAPS);
+    if (!r->table) {
+        fprintf(stderr, "Failed to allocate resampling filter\n");
+        return -1;
+    }
+
+    /* Row p: taps at distances t - (HALF - 1) - p / PHASES from the read position, each row summing to 1 */
+    double cutoff = RESAMPLER_CUTOFF * (ratio > 1.0 ? 1.0 / ratio : 1.0);
+    double beta = 0.1102 * (DECIMATION_ATTENUATION_DB - 8.7);
+    for (int p = 0; p <= RESAMPLER_PHASES; p++) {
+        float *row = r->table + p * RESAMPLER_TAPS;
+        double h[RESAMPLER_TAPS], sum = 0.0;
+        for (int t = 0; t < RESAMPLER_TAPS; t++) {
+            double x = t - (RESAMPLER_HALF_TAPS - 1) - (double)p / RESAMPLER_PHASES;
+            double sinc = x == 0.0 ? 2.0 * cutoff : sin(2.0 * M_PI * cutoff * x) / (M_PI * x);
+            double q = x / RESAMPLER_HALF_TAPS;
+            h[t] = q * q < 1.0 ? sinc * bessel_i0(beta * sqrt(1.0 - q * q)) / bessel_i0(beta) : 0.0;
+            sum += h[t];
+        }
+        for (int t = 0; t < RESAMPLER_TAPS; t++) {
+            row[t] = (float)(h[t] / sum);
+        }
+    }
+    return 0;
+}
+
+void resampler_free(Resampler *r) {
+    free(r->table);
+    free(r->scratch);
+    r->table = NULL;
+    r->scratch = NULL;
+    r->scratch_size = 0;
+}
+
+int resampler_read(void *context, int64_t first, int count, float *dst) {
+    Resampler *r = (Resampler *)context;
+    if (count <= 0) {
+        return 0;
+    }
+
+    int64_t in_first = (int64_t)floor(r->offset + r->ratio * first) - (RESAMPLER_HALF_TAPS - 1);
+    int64_t in_last = (int64_t)floor(r->offset + r->ratio * (first + count - 1)) + RESAMPLER_HALF_TAPS;
+    if (read_padded(r->source, r->context, r->num_input, in_first, (int)(in_last - in_first + 1), &r->scratch,
+                    &r->scratch_size) != 0) {
+        return -1;
+    }
+
+    for (int k = 0; k < count; k++) {
+        double pos = r->offset + r->ratio * (first + k);
+        double base = floor(pos);
+        double phase = (pos - base) * RESAMPLER_PHASES;
+        int p = (int)phase;
+        if (p >= RESAMPLER_PHASES) p = RESAMPLER_PHASES - 1;
+        double w = phase - p;
+        const float *row0 = r->table + p * RESAMPLER_TAPS;
+        const float *row1 = row0 + RESAMPLER_TAPS;
+        const float *x = r->scratch + ((int64_t)base - (RESAMPLER_HALF_TAPS - 1) - in_first);
+        double acc0 = 0.0, acc1 = 0.0;
+        for (int t = 0; t < RESAMPLER_TAPS; t++) {
+            acc0 += (double)row0[t] * x[t];
+            acc1 += (double)row1[t] * x[t];
+        }
+        dst[k] = (float)(acc0 + w * (acc1 - acc0));
+    }
+    return 0;
+}
@@ -0,0 +1,137 @@
+#ifndef DECIMATE_H
+#define DECIMATE_H
+
+#include <stdint.h>
+#include "stream_deconv.h"
+
+#define DECIMATION_MAX_UP 4             /* Largest interpolation factor of a rational factor */
+#define DECIMATION_MAX_DOWN 256         /* Largest decimation factor */
+#define DECIMATION_OVERSAMPLING 1.25    /* Automatic factors: output rate over twice the highest kept frequency */
+#define DECIMATION_MIN_OVERSAMPLING 1.1 /* Least output rate over twice the highest kept frequency */
+#define DECIMATION_ATTENUATION_DB 100.0 /* Stopband attenuation of the anti-alias filter */
+#define RESAMPLER_HALF_TAPS 32          /* Input samples either side of a fractional read */
+#define RESAMPLER_PHASES 512            /* Filter phases per input sample, interpolated linearly */
+#define RESAMPLER_CUTOFF 0.45           /* Interpolation low-pass cutoff, as a fraction of the sample rate */
+
+/**
+ * Rational resampler by up / down (up <= down) in front of a sample
+ * source. A Kaiser-windowed sinc low-pass, split into up polyphase
+ * branches, passes [0, f_pass] and rejects everything that would alias
+ * into it. Only the kept output samples are computed. Its group delay is
+ * compensated: output m lines up with input m * down / up.
+ */
+typedef struct {
+    int up, down;
+    int num_taps;      /* Taps per branch */
+    int center;        /* Prototype filter center, in upsampled samples */
+    float *coeffs;     /* Branch p, tap t at coeffs[p * num_taps + t] */
+    float *scratch;    /* Input samples of one read */
+    int scratch_size;
+    SampleSource source;
+    void *context;
+    int64_t num_input; /* Input samples; reads beyond them see zeros */
+} Decimator;
+
+/**
+ * Fractional-ratio resampler in front of a sample source: output m is
+ * the input band-limited to RESAMPLER_CUTOFF and read at position
+ * offset + ratio * m. Meant for ratios close to 1 (clock drift), where
+ * up / down factors would be huge. A Kaiser-windowed sinc of
+ * 2 * RESAMPLER_HALF_TAPS taps is tabulated at RESAMPLER_PHASES
+ * fractional positions; positions in between interpolate two phases.
+ */
+typedef struct {
+    double offset;     /* Input position of output 0 */
+    double ratio;      /* Input samples per output sample */
+    float *table;      /* Phase p, tap t at table[p * 2 * RESAMPLER_HALF_TAPS + t], p = 0 .. RESAMPLER_PHASES */
+    float *scratch;    /* Input samples of one read */
+    int scratch_size;
+    SampleSource source;
+    void *context;
+    int64_t num_input; /* Input samples; reads beyond them see zeros */
+} Resampler;
+
+/**
+ * Picks the rate factor for a capture: the lowest output rate
+ * fs * up / down at least 2 * DECIMATION_OVERSAMPLING * f_pass, with up
+ * up to DECIMATION_MAX_UP and an integer output rate when fs is an
+ * integer. Ties go to the smaller up.
+ *
+ * Parameters:
+ *   fs: Capture sample rate (Hz)
+ *   f_pass: Highest frequency to keep (Hz)
+ *   up, down: Output factor; 1, 1 if no lower rate fits
+ *
+ * Returns:
+ *   1 if the rate is lowered, 0 otherwise
+ */
+int decimation_factor(double fs, double f_pass, int *up, int *down);
+
+/**
+ * Designs the filter and attaches the source.
+ *
+ * Parameters:
+ *   d: Decimator to set up
+ *   up, down: Rate factor (1 <= up <= down)
+ *   fs: Input sample rate (Hz)
+ *   f_pass: Highest frequency to keep (Hz); the output rate must be at
+ *           least 2 * DECIMATION_MIN_OVERSAMPLING * f_pass
+ *   source, context: Input samples
+ *   num_input: Number of input samples
+ *
+ * Returns:
+ *   0 on success, -1 on an invalid factor or allocation failure
+ */
+int decimator_init(Decimator *d, int up, int down, double fs, double f_pass, SampleSource source, void *context,
+                   int64_t num_input);
+
+/**
+ * Releases the filter and scratch buffer.
+ */
+void decimator_free(Decimator *d);
+
+/**
+ * Number of output samples: num_input * up / down, rounded down.
+ */
+int64_t decimator_output_length(const Decimator *d);
+
+/**
+ * Supplies output samples [first, first + count). A SampleSource with
+ * the Decimator as context, so the decimated capture can be read
+ * wherever a capture is.
+ *
+ * Returns:
+ *   0 on success, -1 on a read or allocation error
+ */
+int decimator_read(void *context, int64_t first, int count, float *dst);
+
+/**
+ * Tabulates the interpolation filter and attaches the source.
+ *
+ * Parameters:
+ *   r: Resampler to set up
+ *   offset: Input position of output sample 0 (may be fractional or negative)
+ *   ratio: Input samples per output sample (0.5 to 2)
+ *   source, context: Input samples
+ *   num_input: Number of input samples
+ *
+ * Returns:
+ *   0 on success, -1 on an invalid ratio or allocation failure
+ */
+int resampler_init(Resampler *r, double offset, double ratio, SampleSource source, void *context, int64_t num_input);
+
+/**
+ * Releases the filter table and scratch buffer.
+ */
+void resampler_free(Resampler *r);
+
+/**
+ * Supplies output samples [first, first + count), as a SampleSource
+ * with the Resampler as context.
+ *
+ * Returns:
+ *   0 on success, -1 on a read or allocation error
+ */
+int resampler_read(void *context, int64_t first, int count, float *dst);
+
+#endif
@@ -0,0 +1,119 @@
+#include "frf_grid.h"
+#include <math.h>
+
+double frf_grid_frequency(const FrfGrid *grid, int k) {
+    if (grid->num_points < 2) {
+        return grid->f_min;
+    }
+    double t = (double)k / (grid->num_points - 1);
+    if (grid->type == FRF_GRID_LOG) {
+        return grid->f_min * pow(grid->f_max / grid->f_min, t);
+    }
+    return grid->f_min + t * (grid->f_max - grid->f_min);
+}
+
+void frf_grid_slice(FrfGrid *slice, const FrfGrid *grid, int first, int count) {
+    slice->type = grid->type;
+    slice->f_min = frf_grid_frequency(grid, first);
+    slice->f_max = frf_grid_frequency(grid, first + count - 1);
+    slice->num_points = count;
+}
+
+int frf_grid_band_bins(FrfGrid *grid, double f_lo, double f_hi, double sample_rate, int nfft) {
+    double bin_hz = sample_rate / nfft;
+    int last_bin = nfft / 2 - 1;
+
+    int first = (int)floor(f_lo / bin_hz);
+    int last = (int)ceil(f_hi / bin_hz);
+    if (first < 0) first = 0;
+    if (last > last_bin) last = last_bin;
+    if (last < first) last = first;
+
+    grid->type = FRF_GRID_LINEAR;
+    grid->f_min = first * bin_hz;
+    grid->f_max = last * bin_hz;
+    grid->num_points = last - first + 1;
+    return first;
+}
+
+/* Local spacing of the grid around point k, in bins */
+static double grid_spacing_bins(const FrfGrid *grid, int k, double bin_hz) {
+    if (grid->num_points < 2) {
+        return 1.0;
+    }
+    if (grid->type == FRF_GRID_LOG) {
+        return frf_grid_frequency(grid, k) * log(grid->f_max / grid->f_min) / (grid->num_points - 1) / bin_hz;
+    }
+    return (grid->f_max - grid->f_min) / (grid->num_points - 1) / bin_hz;
+}
+
+static kiss_fft_cpx bin_at(const kiss_fft_cpx *bins, int num_bins, int i) {
+    if (i < 0) i = 0;
+    if (i >= num_bins) i = num_bins - 1;
+    return bins[i];
+}
+
+static float catmull_rom(float p0, float p1, float p2, float p3, float t) {
+    return 0.5f * ((2.0f * p1) + (p2 - p0) * t + (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * t * t
+                   + (3.0f * p1 - p0 - 3.0f * p2 + p3) * t * t * t);
+}
+
+void frf_resample(const kiss_fft_cpx *bins, int num_bins, double bin_hz, const FrfGrid *grid, kiss_fft_cpx *out) {
+    for (int k = 0; k < grid->num_points; k++) {
+        double x = frf_grid_frequency(grid, k) / bin_hz;
+        double spacing = grid_spacing_bins(grid, k, bin_hz);
+
+        if (spacing > 1.0) {
+            /* Coarser than the bins: mean of the linear interpolant over the cell */
+            double lo = x - 0.5 * spacing;
+            double hi = x + 0.5 * spacing;
+            double sum_r = 0.0, sum_i = 0.0;
+            for (int j = (int)floor(lo); j <= (int)floor(hi); j++) {
+                double u0 = (lo > j) ? lo : j;
+                double u1 = (hi < j + 1) ? hi : j + 1;
+                if (u1 <= u0) continue;
+                double t = 0.5 * (u0 + u1) - j;
+                kiss_fft_cpx a = bin_at(bins, num_bins, j);
+                kiss_fft_cpx b = bin_at(bins, num_bins, j + 1);
+                sum_r += (u1 - u0) * (a.r + t * (b.r - a.r));
+                sum_i += (u1 - u0) * (a.i + t * (b.i - a.i));
+            }
+            out[k].r = (float)(sum_r / spacing);
+            out[k].i = (float)(sum_i / spacing);
+        } else {
+            int i = (int)floor(x);
+            float t = (float)(x - i);
+            kiss_fft_cpx p0 = bin_at(bins, num_bins, i - 1);
+            kiss_fft_cpx p1 = bin_at(bins, num_bins, i);
+            kiss_fft_cpx p2 = bin_at(bins, num_bins, i + 1);
+            kiss_fft_cpx p3 = bin_at(bins, num_bins, i + 2);
+            out[k].r = catmull_rom(p0.r, p1.r, p2.r, p3.r, t);
+            out[k].i = catmull_rom(p0.i, p1.i, p2.i, p3.i, t);
+        }
+    }
+}
+
+int frf_resample_bins(const FrfGrid *grid, int num_bins, double bin_hz, int *count) {
+    int first = num_bins - 1;
+    int last = 0;
+    for (int k = 0; k < grid->num_points; k++) {
+        double x = frf_grid_frequency(grid, k) / bin_hz;
+        double spacing = grid_spacing_bins(grid, k, bin_hz);
+        int lo, hi;
+        if (spacing > 1.0) {
+            lo = (int)floor(x - 0.5 * spacing);
+            hi = (int)floor(x + 0.5 * spacing) + 1;
+        } else {
+            lo = (int)floor(x) - 1;
+            hi = (int)floor(x) + 2;
+        }
+        if (lo < first) first = lo;
+        if (hi > last) last = hi;
+    }
+    /* Reads outside the spectrum are clamped to its ends */
+    if (first < 0) first = 0;
+    if (last > num_bins - 1) last = num_bins - 1;
+    if (last < first) last = first;
+    *count = last - first + 1;
+    return first;
+}
@@ -0,0 +1,82 @@
+#ifndef FRF_GRID_H
+#define FRF_GRID_H
+
+#include "kiss_fft.h"
+
+/* Margin kept on each side of the sweep band when band-limiting (octaves) */
+#define FRF_BAND_MARGIN_OCTAVES (1.0 / 3.0)
+
+typedef enum {
+    FRF_GRID_LINEAR = 0, /* Uniform spacing between f_min and f_max */
+    FRF_GRID_LOG = 1     /* Uniform spacing of log(f) between f_min and f_max */
+} FrfGridType;
+
+/**
+ * Frequency axis of an FRF: num_points frequencies from f_min to f_max
+ * (both included). An FFT spectrum is the linear grid 0 .. (n-1)*fs/nfft.
+ */
+typedef struct {
+    FrfGridType type;
+    double f_min;
+    double f_max;
+    int num_points;
+} FrfGrid;
+
+/**
+ * Frequency of point k of a grid.
+ */
+double frf_grid_frequency(const FrfGrid *grid, int k);
+
+/**
+ * Points [first, first + count) of a grid, as a grid of the same type
+ * whose frequencies are those of the points.
+ */
+void frf_grid_slice(FrfGrid *slice, const FrfGrid *grid, int first, int count);
+
+/**
+ * Builds a bin-aligned linear grid covering [f_lo, f_hi], clamped to
+ * the first nfft / 2 bins. Resampling onto it copies the bins exactly.
+ *
+ * Parameters:
+ *   grid: Output grid
+ *   f_lo, f_hi: Band to keep (Hz)
+ *   sample_rate: Sampling rate (Hz)
+ *   nfft: FFT size of the spectrum
+ *
+ * Returns:
+ *   Index of the first kept bin
+ */
+int frf_grid_band_bins(FrfGrid *grid, double f_lo, double f_hi, double sample_rate, int nfft);
+
+/**
+ * Resamples a complex spectrum onto a frequency grid.
+ * Where the grid is coarser than the FFT bins, each point is the mean of
+ * the (linearly interpolated) spectrum over its cell, so narrow features
+ * are averaged rather than aliased; elsewhere the real and imaginary
+ * parts are interpolated with a Catmull-Rom cubic, which reproduces bin
+ * values exactly at bin frequencies.
+ *
+ * Parameters:
+ *   bins: Spectrum, bin k at k * bin_hz
+ *   num_bins: Number of usable bins
+ *   bin_hz: Bin spacing (sample_rate / nfft)
+ *   grid: Target grid
+ *   out: Output array of grid->num_points values
+ */
+void frf_resample(const kiss_fft_cpx *bins, int num_bins, double bin_hz, const FrfGrid *grid, kiss_fft_cpx *out);
+
+/**
+ * Bins that frf_resample() reads for a grid, so that a spectrum only
+ * needs computing over them.
+ *
+ * Parameters:
+ *   grid: Target grid
+ *   num_bins, bin_hz: As for frf_resample()
+ *   count: Output number of bins read
+ *
+ * Returns:
+ *   Index of the first bin read
+ */
+int frf_resample_bins(const FrfGrid *grid, int num_bins, double bin_hz, int *count);
+
+#endif
@@ -0,0 +1,232 @@
+#include "frf_peaks.h"
+#include "processing.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define POWER_FLOOR 1e-30   /* Power taken for 0 before converting to dB */
+#define HALF_POWER_DB 3.0103
+
+int frf_peaks_init(FrfPeakAnalyzer *an, const FrfGrid *grid, const FrfPeakOptions *options) {
+    memset(an, 0, sizeof(*an));
+    int n = grid->num_points;
+    if (n < 3 || options->smoothing_octaves < 0.0 || options->prominence_db < 0.0) {
+        fprintf(stderr, "Invalid peak analysis: %d points, %.3f octaves smoothing, %.1f dB prominence\n", n,
+                options->smoothing_octaves, options->prominence_db);
+        return -1;
+    }
+    an->grid = *grid;
+    an->options = *options;
+    an->freq = (double*)malloc(sizeof(double) * n);
+    an->lo = (int*)malloc(sizeof(int) * n);
+    an->hi = (int*)malloc(sizeof(int) * n);
+    an->weight = (double*)malloc(sizeof(double) * n);
+    an->prefix = (double*)malloc(sizeof(double) * (n + 1));
+    an->power = (float*)malloc(sizeof(float) * n);
+    an->smoothed = (float*)malloc(sizeof(float) * n);
+    an->extrema = (int*)malloc(sizeof(int) * n);
+    if (!an->freq || !an->lo || !an->hi || !an->weight || !an->prefix || !an->power || !an->smoothed
+        || !an->extrema) {
+        fprintf(stderr, "Failed to allocate peak analyzer\n");
+        frf_peaks_free(an);
+        return -1;
+    }
+    for (int k = 0; k < n; k++) {
+        an->freq[k] = frf_grid_frequency(grid, k);
+    }
+    /* Window of point k: the points within half the width on either side, in octaves */
+    double half = pow(2.0, options->smoothing_octaves / 2.0);
+    int lo = 0, hi = 0;
+    for (int k = 0; k < n; k++) {
+        while (lo < k && an->freq[lo] < an->freq[k] / half) lo++;
+        if (hi < k) hi = k;
+        while (hi + 1 < n && an->freq[hi + 1] <= an->freq[k] * half) hi++;
+        an->lo[k] = lo;
+        an->hi[k] = hi;
+        an->weight[k] = 1.0 / (hi - lo + 1);
+    }
+    return 0;
+}
+
+void frf_peaks_free(FrfPeakAnalyzer *an) {
+    free(an->freq);
+    free(an->lo);
+    free(an->hi);
+    free(an->weight);
+    free(an->prefix);
+    free(an->power);
+    free(an->smoothed);
+    free(an->extrema);
+    memset(an, 0, sizeof(*an));
+}
+
+void frf_peaks_set_spectrum(FrfPeakAnalyzer *an, const kiss_fft_cpx *h) {
+    for (int k = 0; k < an->grid.num_points; k++) {
+        an->power[k] = (float)(h[k].r * h[k].r + h[k].i * h[k].i);
+    }
+}
+
+void frf_peaks_set_float32(FrfPeakAnalyzer *an, const float_cpx *h) {
+    for (int k = 0; k < an->grid.num_points; k++) {
+        an->power[k] = h[k].r * h[k].r + h[k].i * h[k].i;
+    }
+}
+
+static double power_db(double p) {
+    return 10.0 * log10(p > POWER_FLOOR ? p : POWER_FLOOR);
+}
+
+/* Frequency at fractional position k + t, geometric between the points of a log grid */
+static double frequency_at(const FrfPeakAnalyzer *an, int k, double t) {
+    int n = an->grid.num_points;
+    int j = t >= 0.0 ? k + 1 : k - 1;
+    if (j < 0 || j >= n) {
+        return an->freq[k];
+    }
+    double a = fabs(t);
+    if (an->grid.type == FRF_GRID_LOG && an->freq[k] > 0.0) {
+        return an->freq[k] * pow(an->freq[j] / an->freq[k], a);
+    }
+    return an->freq[k] + a * (an->freq[j] - an->freq[k]);
+}
+
+/*
+ * Whether the smoothed extremum at k is prominent: walking from it on
+ * each side, the curve crosses the threshold (sign * s <= sign *
+ * threshold) before passing the extremum (on the left, reaching it) and
+ * before the end of the grid. The sides are walked in step, so the
+ * rounding-level wiggles of a smooth slope, which fail at once on their
+ * downhill side, cost a few points rather than a walk up the slope.
+ */
+static int prominent(const FrfPeakAnalyzer *an, int k, double sign, double threshold) {
+    const float *s = an->smoothed;
+    int n = an->grid.num_points;
+    double peak = sign * s[k], floor = sign * threshold;
+    int left = k - 1, right = k + 1;
+    int left_done = 0, right_done = 0;
+    while (!left_done || !right_done) {
+        if (!left_done) {
+            if (left < 0 || sign * s[left] >= peak) return 0;
+            left_done = sign * s[left--] <= floor;
+        }
+        if (!right_done) {
+            if (right >= n || sign * s[right] > peak) return 0;
+            right_done = sign * s[right++] <= floor;
+        }
+    }
+    return 1;
+}
+
+/*
+ * Position of the -3 dB (+3 dB) crossing of the unsmoothed curve walking
+ * from m in direction step, or -1 if the curve passes the extremum again
+ * or the grid ends first.
+ */
+static double edge_frequency(const FrfPeakAnalyzer *an, int m, int step, double sign, double target_db) {
+    const float *p = an->power;
+    double target = pow(10.0, target_db / 10.0);
+    for (int j = m + step; j >= 0 && j < an->grid.num_points; j += step) {
+        if (sign * p[j] > sign * p[m]) {
+            return -1.0;
+        }
+        if (sign * p[j] <= sign * target) {
+            /* Crossing interpolated in dB between the last two points */
+            double prev = power_db(p[j - step]), v = power_db(p[j]);
+            double t = prev != v ? (prev - target_db) / (prev - v) : 0.0;
+            return frequency_at(an, j - step, step * t);
+        }
+    }
+    return -1.0;
+}
+
+/* Refines the smoothed extremum at k on the unsmoothed curve; returns the raw extreme point */
+static int refine(const FrfPeakAnalyzer *an, int k, FrfPeakType type, FrfPeak *peak) {
+    const float *p = an->power;
+    double sign = type == FRF_PEAK_RESONANCE ? 1.0 : -1.0;
+    int m = an->lo[k];
+    for (int j = an->lo[k] + 1; j <= an->hi[k]; j++) {
+        if (sign * p[j] > sign * p[m]) m = j;
+    }
+
+    peak->type = type;
+    peak->frequency = an->freq[m];
+    peak->level_db = power_db(p[m]);
+    if (m > 0 && m < an->grid.num_points - 1) {
+        /* Vertex of the parabola through the three points in dB */
+        double a = power_db(p[m - 1]), b = peak->level_db, c = power_db(p[m + 1]);
+        double denom = a - 2.0 * b + c;
+        if (denom != 0.0) {
+            double d = 0.5 * (a - c) / denom;
+            if (d > 0.5) d = 0.5;
+            if (d < -0.5) d = -0.5;
+            peak->frequency = frequency_at(an, m, d);
+            peak->level_db = b - 0.25 * (a - c) * d;
+        }
+    }
+
+    double target = peak->level_db - sign * HALF_POWER_DB;
+    double f_lo = edge_frequency(an, m, -1, sign, target);
+    double f_hi = edge_frequency(an, m, 1, sign, target);
+    peak->bandwidth = f_lo >= 0.0 && f_hi >= 0.0 ? f_hi - f_lo : 0.0;
+    peak->q = peak->bandwidth > 0.0 ? peak->frequency / peak->bandwidth : 0.0;
+    return m;
+}
+
+int frf_peaks_find(FrfPeakAnalyzer *an, FrfPeak *peaks, int max_peaks) {
+    int n = an->grid.num_points;
+    const float *p = an->power;
+    float *s = an->smoothed;
+
+    an->prefix[0] = 0.0;
+    for (int k = 0; k < n; k++) {
+        an->prefix[k + 1] = an->prefix[k] + p[k];
+    }
+    for (int k = 0; k < n; k++) {
+        s[k] = (float)((an->prefix[an->hi[k] + 1] - an->prefix[an->lo[k]]) * an->weight[k]);
+    }
+    /* Extrema listed in one tight pass: rounding makes many on a smooth curve, and most fail at once below */
+    int num_extrema = 0;
+    for (int k = 1; k < n - 1; k++) {
+        an->extrema[num_extrema] = k;
+        num_extrema += (s[k] > s[k - 1] && s[k] >= s[k + 1]) | (s[k] < s[k - 1] && s[k] <= s[k + 1]);
+    }
+
+    double ratio = pow(10.0, an->options.prominence_db / 10.0);
+    int count = 0;
+    int last_raw[2] = { -1, -1 };
+    for (int e = 0; e < num_extrema && count < max_peaks; e++) {
+        int k = an->extrema[e];
+        FrfPeakType type;
+        double sign, threshold;
+        if (s[k] > s[k - 1] && s[k] >= s[k + 1]) {
+            type = FRF_PEAK_RESONANCE;
+            sign = 1.0;
+            threshold = s[k] / ratio;
+        } else {
+            type = FRF_PEAK_ANTI_RESONANCE;
+            sign = -1.0;
+            threshold = s[k] * ratio;
+        }
+        /* Of two equal extrema with nothing prominent between them, the left one is kept */
+        if (!prominent(an, k, sign, threshold)) {
+            continue;
+        }
+        int m = refine(an, k, type, &peaks[count]);
+        if (m == last_raw[type]) {
+            continue;   /* Two smoothed extrema on one raw extremum */
+        }
+        last_raw[type] = m;
+        count++;
+    }
+
+    /* Refinement can move a peak past a neighbour of the other type */
+    for (int i = 1; i < count; i++) {
+        FrfPeak peak = peaks[i];
+        int j = i;
+        for (; j > 0 && peaks[j - 1].frequency > peak.frequency; j--) {
+            peaks[j] = peaks[j - 1];
+        }
+        peaks[j] = peak;
+    }
+    return count;
+}
@@ -0,0 +1,90 @@
+#ifndef FRF_PEAKS_H
+#define FRF_PEAKS_H
+
+#include "kiss_fft.h"
+#include "complex_utils.h"
+#include "frf_grid.h"
+
+#define FRF_PEAKS_DEFAULT_SMOOTHING (1.0 / 24.0)  /* Octaves */
+#define FRF_PEAKS_DEFAULT_PROMINENCE 3.0          /* dB */
+#define FRF_PEAKS_MAX 64                          /* Peaks kept per FRF */
+
+/*
+ * Resonances (maxima of |H|) and anti-resonances (minima) of an FRF.
+ *
+ * Candidates are the local extrema of the power |H|^2 smoothed over a
+ * fractional-octave window, kept if the smoothed curve falls (rises, for
+ * an anti-resonance) by the prominence on both sides before passing the
+ * extremum again. Each candidate is then refined on the unsmoothed
+ * curve: the extreme point within its smoothing window, a parabola
+ * through that point and its neighbours in dB for the centre frequency
+ * and level, and the -3 dB (+3 dB) crossings on either side, linearly
+ * interpolated, for the bandwidth and Q = f / bandwidth.
+ *
+ * The analyzer holds the smoothing windows of one grid and its scratch,
+ * so FRFs sharing a grid are analysed without allocating, in a few
+ * linear passes over their points.
+ */
+
+typedef enum {
+    FRF_PEAK_RESONANCE = 0,
+    FRF_PEAK_ANTI_RESONANCE = 1
+} FrfPeakType;
+
+typedef struct {
+    FrfPeakType type;
+    double frequency;   /* Interpolated centre (Hz) */
+    double level_db;    /* Interpolated level of |H| (dB) */
+    double bandwidth;   /* Between the -3 dB (+3 dB) crossings (Hz), 0 if one is outside the grid */
+    double q;           /* frequency / bandwidth, 0 without a bandwidth */
+} FrfPeak;
+
+typedef struct {
+    double smoothing_octaves;  /* Width of the smoothing window, 0 for none */
+    double prominence_db;      /* Fall (rise) required on both sides of a candidate */
+} FrfPeakOptions;
+
+typedef struct {
+    FrfGrid grid;
+    FrfPeakOptions options;
+    double *freq;      /* Frequency of each point */
+    int *lo, *hi;      /* Smoothing window of each point, inclusive */
+    double *weight;    /* 1 / points in the window */
+    double *prefix;    /* Running sums of the power, num_points + 1 */
+    float *power;      /* Unsmoothed power, filled by the caller */
+    float *smoothed;
+    int *extrema;      /* Smoothed local extrema of the current spectrum */
+} FrfPeakAnalyzer;
+
+/**
+ * Prepares the analysis of FRFs on one grid.
+ *
+ * Returns:
+ *   0 on success, -1 on invalid options (fewer than 3 points, negative
+ *   widths) or allocation failure
+ */
+int frf_peaks_init(FrfPeakAnalyzer *an, const FrfGrid *grid, const FrfPeakOptions *options);
+
+void frf_peaks_free(FrfPeakAnalyzer *an);
+
+/**
+ * Fills an->power from a spectrum on the analyzer's grid, either in the
+ * processing precision or as the float32 pairs of files and the FRF
+ * database.
+ */
+void frf_peaks_set_spectrum(FrfPeakAnalyzer *an, const kiss_fft_cpx *h);
+void frf_peaks_set_float32(FrfPeakAnalyzer *an, const float_cpx *h);
+
+/**
+ * Finds the resonances and anti-resonances of the spectrum set last, in
+ * increasing frequency.
+ *
+ * Parameters:
+ *   peaks: Output, up to max_peaks entries
+ *
+ * Returns:
+ *   Number of peaks written
+ */
+int frf_peaks_find(FrfPeakAnalyzer *an, FrfPeak *peaks, int max_peaks);
+
+#endif
@@ -0,0 +1,165 @@
+#include "live_frf.h"
+#include "processing.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int live_default_period(double fs) {
+    int period = LIVE_MIN_PERIOD;
+    while (period < LIVE_MAX_PERIOD && 2.0 * period <= LIVE_DEFAULT_PERIOD_S * fs) {
+        period *= 2;
+    }
+    return period;
+}
+
+/* Phase of excited bin j of num_bins */
+static double excitation_phase(LiveExcitation type, int j, int num_bins, unsigned *state) {
+    if (type == LIVE_EXCITATION_MULTISINE) {
+        *state = *state * 1664525u + 1013904223u;
+        return 2.0 * M_PI * (double)(*state >> 8) / (double)(1u << 24);
+    }
+    return -M_PI * (double)j * j / num_bins;
+}
+
+int live_estimator_init(LiveEstimator *est, float *excitation, int period, double fs, float start_freq,
+                        float end_freq, float amplitude, LiveExcitation type, double smoothing_s) {
+    memset(est, 0, sizeof(*est));
+    if (period < LIVE_MIN_PERIOD || period > LIVE_MAX_PERIOD || (period & (period - 1)) != 0) {
+        fprintf(stderr, "Invalid excitation period %d (a power of two from %d to %d)\n", period, LIVE_MIN_PERIOD,
+                LIVE_MAX_PERIOD);
+        return -1;
+    }
+    int first = (int)ceil(start_freq * (double)period / fs);
+    int last = (int)floor(end_freq * (double)period / fs);
+    if (first < 1) first = 1;
+    if (last > period / 2 - 1) last = period / 2 - 1;
+    if (last < first) {
+        fprintf(stderr, "No FFT bin of a %d-sample period lies in %.0f-%.0f Hz\n", period, start_freq, end_freq);
+        return -1;
+    }
+    est->period = period;
+    est->fs = fs;
+    est->first_bin = first;
+    est->num_bins = last - first + 1;
+    est->smoothing = smoothing_s > 0.0 ? 1.0 - exp(-(double)period / (fs * smoothing_s)) : 1.0;
+
+    est->cfg_fwd = kiss_fft_alloc(period, 0, NULL, NULL);
+    est->cfg_inv = kiss_fft_alloc(period, 1, NULL, NULL);
+    est->work = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * period);
+    est->excitation = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * est->num_bins);
+    est->open = (kiss_fft_cpx*)calloc(est->num_bins, sizeof(kiss_fft_cpx));
+    est->closed = (kiss_fft_cpx*)calloc(est->num_bins, sizeof(kiss_fft_cpx));
+    est->epsilon = (kiss_fft_scalar*)malloc(sizeof(kiss_fft_scalar) * (first + est->num_bins));
+    if (!est->cfg_fwd || !est->cfg_inv || !est->work || !est->excitation || !est->open || !est->closed
+        || !est->epsilon) {
+        fprintf(stderr, "Failed to allocate live estimator\n");
+        live_estimator_free(est);
+        return -1;
+    }
+    generate_epsilon_bins(est->epsilon, start_freq, end_freq, (float)fs, period, EPSILON_TRANSITION_HZ, first,
+                          est->num_bins);
+
+    /* Unit magnitude on the excited bins and their mirrors, back to the time domain */
+    unsigned state = LIVE_MULTISINE_SEED;
+    memset(est->work, 0, sizeof(kiss_fft_cpx) * period);
+    for (int j = 0; j < est->num_bins; j++) {
+        double phase = excitation_phase(type, j, est->num_bins, &state);
+        est->work[first + j].r = (kiss_fft_scalar)cos(phase);
+        est->work[first + j].i = (kiss_fft_scalar)sin(phase);
+        est->work[period - first - j] = complex_conjugate(est->work[first + j]);
+    }
+    kiss_fft(est->cfg_inv, est->work, est->work);
+    double peak = 0.0;
+    for (int i = 0; i < period; i++) {
+        if (fabs(est->work[i].r) > peak) peak = fabs(est->work[i].r);
+    }
+    for (int i = 0; i < period; i++) {
+        excitation[i] = (float)(amplitude * est->work[i].r / peak);
+    }
+
+    /* X of the samples actually played */
+    for (int i = 0; i < period; i++) {
+        est->work[i].r = excitation[i];
+        est->work[i].i = 0.0f;
+    }
+    kiss_fft(est->cfg_fwd, est->work, est->work);
+    memcpy(est->excitation, est->work + first, sizeof(kiss_fft_cpx) * est->num_bins);
+    return 0;
+}
+
+void live_estimator_free(LiveEstimator *est) {
+    kiss_fft_free(est->cfg_fwd);
+    kiss_fft_free(est->cfg_inv);
+    free(est->work);
+    free(est->excitation);
+    free(est->open);
+    free(est->closed);
+    free(est->epsilon);
+    memset(est, 0, sizeof(*est));
+}
+
+void live_estimator_set_calibration(LiveEstimator *est, const kiss_fft_cpx *ir, int ir_len, int nimp_pre,
+                                    double scale) {
+    int period = est->period;
+    memset(est->work, 0, sizeof(kiss_fft_cpx) * period);
+    for (int i = 0; i < ir_len; i++) {
+        int k = ((i - nimp_pre) % period + period) % period;
+        est->work[k].r += (kiss_fft_scalar)(scale * ir[i].r);
+    }
+    kiss_fft(est->cfg_fwd, est->work, est->work);
+    memcpy(est->closed, est->work + est->first_bin, sizeof(kiss_fft_cpx) * est->num_bins);
+}
+
+/* FFT of one recorded period into est->work */
+static void transform_period(LiveEstimator *est, const float *recorded) {
+    for (int i = 0; i < est->period; i++) {
+        est->work[i].r = recorded[i];
+        est->work[i].i = 0.0f;
+    }
+    kiss_fft(est->cfg_fwd, est->work, est->work);
+}
+
+int live_estimator_delay(LiveEstimator *est, const float *recorded) {
+    transform_period(est, recorded);
+
+    /* One-sided cross-spectrum: the inverse FFT is the correlation's envelope */
+    for (int k = 0; k < est->period; k++) {
+        int j = k - est->first_bin;
+        if (j >= 0 && j < est->num_bins) {
+            est->work[k] = complex_multiply(est->work[k], complex_conjugate(est->excitation[j]));
+        } else {
+            est->work[k].r = 0.0f;
+            est->work[k].i = 0.0f;
+        }
+    }
+    kiss_fft(est->cfg_inv, est->work, est->work);
+    int delay = 0;
+    kiss_fft_scalar peak = 0;
+    for (int i = 0; i < est->period; i++) {
+        kiss_fft_scalar m = complex_squared_magnitude(est->work[i]);
+        if (m > peak) {
+            peak = m;
+            delay = i;
+        }
+    }
+    return delay;
+}
+
+void live_estimator_add_period(LiveEstimator *est, const float *recorded) {
+    transform_period(est, recorded);
+    double weight = est->periods == 0 ? 1.0 : est->smoothing;
+    for (int j = 0; j < est->num_bins; j++) {
+        kiss_fft_cpx x = est->excitation[j];
+        kiss_fft_cpx y = est->work[est->first_bin + j];
+        double norm = (double)x.r * x.r + (double)x.i * x.i;
+        double hr = ((double)y.r * x.r + (double)y.i * x.i) / norm;
+        double hi = ((double)y.i * x.r - (double)y.r * x.i) / norm;
+        est->open[j].r = (kiss_fft_scalar)(est->open[j].r + weight * (hr - est->open[j].r));
+        est->open[j].i = (kiss_fft_scalar)(est->open[j].i + weight * (hi - est->open[j].i));
+    }
+    est->periods++;
+}
+
+void live_estimator_h_lips(const LiveEstimator *est, kiss_fft_cpx *h_lips) {
+    compute_h_lips(h_lips, est->open, est->closed, est->epsilon + est->first_bin, est->num_bins);
+}
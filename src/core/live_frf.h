@@ -0,0 +1,115 @@
+#ifndef LIVE_FRF_H
+#define LIVE_FRF_H
+
+#include "kiss_fft.h"
+
+#define LIVE_MIN_PERIOD 1024         /* Shortest excitation period (samples) */
+#define LIVE_MAX_PERIOD 262144       /* Longest excitation period (samples) */
+#define LIVE_DEFAULT_PERIOD_S 0.1    /* Default period: the longest power of two within this (s) */
+#define LIVE_MULTISINE_SEED 12345u   /* Phases of the multisine, fixed so runs repeat */
+
+/* Periodic excitation played in a loop by live mode */
+typedef enum {
+    LIVE_EXCITATION_CHIRP = 0,     /* Quadratic (Schroeder) phases: a linear sweep over each period */
+    LIVE_EXCITATION_MULTISINE = 1  /* Pseudo-random phases */
+} LiveExcitation;
+
+/*
+ * Periodic FRF estimation. The excitation is one period of a signal with
+ * flat magnitude on the FFT bins of the band and nothing elsewhere, so
+ * in the steady state one FFT of a recorded period gives the response on
+ * every excited bin: H(k) = Y(k) / X(k), with no deconvolution and no
+ * leakage. The response is only resolved to the period: an IR longer
+ * than a period wraps around onto its start.
+ */
+typedef struct {
+    int period;              /* FFT size and excitation length (power of two) */
+    double fs;
+    int first_bin;           /* Excited bins [first_bin, first_bin + num_bins) */
+    int num_bins;
+    double smoothing;        /* Weight of each new period in the running estimate (1: none) */
+    int periods;             /* Periods averaged so far */
+    kiss_fft_cfg cfg_fwd;
+    kiss_fft_cfg cfg_inv;
+    kiss_fft_cpx *work;      /* period */
+    kiss_fft_cpx *excitation;/* X on the excited bins */
+    kiss_fft_cpx *open;      /* Running estimate of Y / X on the excited bins */
+    kiss_fft_cpx *closed;    /* Calibration on the excited bins */
+    kiss_fft_scalar *epsilon;/* Regularization on the excited bins */
+} LiveEstimator;
+
+/**
+ * Default excitation period at a sample rate: the longest power of two
+ * within LIVE_DEFAULT_PERIOD_S, clamped to the allowed periods.
+ */
+int live_default_period(double fs);
+
+/**
+ * Creates an estimator and designs its excitation: flat magnitude on the
+ * bins from start_freq to end_freq (rounded inwards), with the phases of
+ * type, scaled to a peak of amplitude.
+ *
+ * Parameters:
+ *   est: Output estimator (release with live_estimator_free())
+ *   excitation: Output period of the excitation (period samples)
+ *   period: Period in samples, a power of two from LIVE_MIN_PERIOD to LIVE_MAX_PERIOD
+ *   fs: Sampling rate (Hz)
+ *   start_freq, end_freq: Excited band (Hz)
+ *   amplitude: Peak of the excitation
+ *   type: Phases of the excitation
+ *   smoothing_s: Time constant of the running average (s), 0 for none
+ *
+ * Returns:
+ *   0 on success, -1 (with a message) on invalid parameters or allocation failure
+ */
+int live_estimator_init(LiveEstimator *est, float *excitation, int period, double fs, float start_freq,
+                        float end_freq, float amplitude, LiveExcitation type, double smoothing_s);
+
+/**
+ * Releases the estimator's buffers.
+ */
+void live_estimator_free(LiveEstimator *est);
+
+/**
+ * Sets the calibration from a windowed linear IR, such as the work
+ * buffer of window_linear_ir(): the IR is folded onto one period, which
+ * samples its spectrum exactly on the excited bins.
+ *
+ * Parameters:
+ *   ir: Windowed IR (ir_len samples); sample 0 is nimp_pre before the linear IR
+ *   ir_len: Samples of ir
+ *   nimp_pre: Samples of ir before the linear IR
+ *   scale: Factor applied to the IR (1 / nfft for an unscaled inverse FFT)
+ */
+void live_estimator_set_calibration(LiveEstimator *est, const kiss_fft_cpx *ir, int ir_len, int nimp_pre,
+                                    double scale);
+
+/**
+ * Circular delay of a recorded period behind the excitation, from the
+ * peak of their cross-correlation over the excited bins.
+ *
+ * Parameters:
+ *   recorded: One period of the steady-state response (period samples)
+ *
+ * Returns:
+ *   Delay in samples, 0 to period - 1
+ */
+int live_estimator_delay(LiveEstimator *est, const float *recorded);
+
+/**
+ * Adds one recorded period, aligned to the excitation, to the running
+ * estimate: the first period sets it, later ones are averaged in with
+ * weight est->smoothing.
+ */
+void live_estimator_add_period(LiveEstimator *est, const float *recorded);
+
+/**
+ * H_lips of the running estimate against the calibration
+ * (compute_h_lips()), on the excited bins.
+ *
+ * Parameters:
+ *   h_lips: Output, num_bins values
+ */
+void live_estimator_h_lips(const LiveEstimator *est, kiss_fft_cpx *h_lips);
+
+#endif
@@ -0,0 +1,296 @@
+#include "mls.h"
+#include "processing.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MLS_MAX_TAPS 4
+
+/* Feedback taps of a maximal Fibonacci LFSR per order: a[n] = XOR of a[n - tap] */
+static const int MLS_TAPS[MLS_MAX_ORDER - MLS_MIN_ORDER + 1][MLS_MAX_TAPS] = {
+    { 8, 6, 5, 4 },     /* 8 */
+    { 9, 5, 0, 0 },
+    { 10, 7, 0, 0 },
+    { 11, 9, 0, 0 },
+    { 12, 11, 10, 4 },
+    { 13, 12, 11, 8 },
+    { 14, 13, 12, 2 },
+    { 15, 14, 0, 0 },
+    { 16, 15, 13, 4 },
+    { 17, 14, 0, 0 },
+    { 18, 11, 0, 0 },
+    { 19, 18, 17, 14 },
+    { 20, 17, 0, 0 },   /* 20 */
+};
+
+int mls_length(int order) {
+    return (1 << order) - 1;
+}
+
+/* The sequence bits a[0 .. count), count >= order, from an all-ones start */
+static unsigned char *mls_bits(int order, int count) {
+    unsigned char *bits = (unsigned char*)malloc(count);
+    if (!bits) {
+        return NULL;
+    }
+    const int *taps = MLS_TAPS[order - MLS_MIN_ORDER];
+    for (int n = 0; n < order; n++) {
+        bits[n] = 1;
+    }
+    for (int n = order; n < count; n++) {
+        unsigned char b = 0;
+        for (int t = 0; t < MLS_MAX_TAPS && taps[t] > 0; t++) {
+            b ^= bits[n - taps[t]];
+        }
+        bits[n] = b;
+    }
+    return bits;
+}
+
+int mls_check(ChirpParams *chirp, double fs) {
+    if (chirp->type != MLS_CHIRP_TYPE) {
+        chirp->mls_order = 0;
+        chirp->mls_periods = 0;
+        return 0;
+    }
+    if (chirp->amplitude <= 0.0f) {
+        fprintf(stderr, "MLS takes need a positive amplitude\n");
+        return -1;
+    }
+    if (chirp->mls_order == 0) {
+        if (chirp->duration <= 0.0f) {
+            fprintf(stderr, "MLS takes need an order or a period duration to cover\n");
+            return -1;
+        }
+        int order = MLS_MIN_ORDER;
+        while (order < MLS_MAX_ORDER && mls_length(order) < chirp->duration * fs) {
+            order++;
+        }
+        if (mls_length(order) < chirp->duration * fs) {
+            fprintf(stderr, "A %.2f s MLS period needs more than order %d\n", chirp->duration, MLS_MAX_ORDER);
+            return -1;
+        }
+        chirp->mls_order = order;
+    }
+    if (chirp->mls_order < MLS_MIN_ORDER || chirp->mls_order > MLS_MAX_ORDER) {
+        fprintf(stderr, "Invalid MLS order %d (%d to %d)\n", chirp->mls_order, MLS_MIN_ORDER, MLS_MAX_ORDER);
+        return -1;
+    }
+    if (chirp->mls_periods == 0) {
+        chirp->mls_periods = MLS_DEFAULT_PERIODS;
+    }
+    if (chirp->mls_periods < 1 || chirp->mls_periods > MLS_MAX_PERIODS) {
+        fprintf(stderr, "Invalid number of MLS periods %d (1 to %d)\n", chirp->mls_periods, MLS_MAX_PERIODS);
+        return -1;
+    }
+    chirp->duration = (float)(mls_excitation_samples(chirp) / fs);
+    return 0;
+}
+
+int mls_excitation_samples(const ChirpParams *chirp) {
+    return (chirp->mls_periods + 1) * mls_length(chirp->mls_order);
+}
+
+int mls_first_sample(const ChirpParams *chirp, double fs) {
+    return (int)((chirp->Tgap / 2) * fs) + mls_length(chirp->mls_order);
+}
+
+int generate_mls(float *buffer, const ChirpParams *chirp, float fs) {
+    int length = mls_length(chirp->mls_order);
+    int n_gap_half = (int)((chirp->Tgap / 2) * fs);
+    int n_total = 2 * n_gap_half + mls_excitation_samples(chirp);
+    unsigned char *bits = mls_bits(chirp->mls_order, length);
+    if (!bits) {
+        fprintf(stderr, "Failed to allocate MLS buffer\n");
+        return -1;
+    }
+
+    memset(buffer, 0, sizeof(float) * n_total);
+    float *period = buffer + n_gap_half;
+    for (int i = 0; i < length; i++) {
+        period[i] = bits[i] ? -chirp->amplitude : chirp->amplitude;
+    }
+    for (int p = 1; p <= chirp->mls_periods; p++) {
+        memcpy(period + (size_t)p * length, period, sizeof(float) * length);
+    }
+
+    /* Only the lead-in is faded: the averaged periods must stay periodic */
+    int n_fade = (int)(chirp->Tfade * fs);
+    if (n_fade > length / 2) {
+        n_fade = length / 2;
+    }
+    for (int i = 0; i < n_fade; i++) {
+        period[i] *= 0.5f * (1.0f - cosf((float)M_PI * i / n_fade));
+    }
+    free(bits);
+    return 0;
+}
+
+void mls_ir_window(const ChirpParams *chirp, double fs, int *nimp_pre, int *nimp_post) {
+    int length = mls_length(chirp->mls_order);
+    int npre = (int)(MLS_PRE_WINDOW_S * fs);
+    int npost = (int)(0.2 * fs);
+    if (npre > length / 8) {
+        npre = length / 8;
+    }
+    if (npost > length - npre) {
+        npost = length - npre;
+    }
+    *nimp_pre = npre;
+    *nimp_post = npost;
+}
+
+void fast_hadamard_transform(kiss_fft_scalar *data, int order) {
+    int n = 1 << order;
+    for (int half = 1; half < n; half <<= 1) {
+        for (int i = 0; i < n; i += 2 * half) {
+            kiss_fft_scalar *a = data + i;
+            kiss_fft_scalar *b = data + i + half;
+            for (int j = 0; j < half; j++) {
+                kiss_fft_scalar sum = a[j] + b[j];
+                b[j] = a[j] - b[j];
+                a[j] = sum;
+            }
+        }
+    }
+}
+
+void mls_decoder_free(MlsDecoder *dec) {
+    free(dec->in_index);
+    free(dec->out_index);
+    free(dec->sums);
+    memset(dec, 0, sizeof(*dec));
+}
+
+/*
+ * With the sequence written a[i + j] = r_i . q_j over GF(2), where q_j is
+ * the window a[j .. j + order) and r_i the combination of that window
+ * giving a[i + j], the correlation sum over n of y[n] (-1)^a[n - k] is
+ * the Hadamard transform of y scattered to indices q_n, read at index
+ * r_(-k mod length).
+ */
+int mls_decoder_init(MlsDecoder *dec, int order) {
+    memset(dec, 0, sizeof(*dec));
+    if (order < MLS_MIN_ORDER || order > MLS_MAX_ORDER) {
+        fprintf(stderr, "Invalid MLS order %d (%d to %d)\n", order, MLS_MIN_ORDER, MLS_MAX_ORDER);
+        return -1;
+    }
+    int length = mls_length(order);
+    dec->order = order;
+    dec->length = length;
+    dec->in_index = (uint32_t*)malloc(sizeof(uint32_t) * length);
+    dec->out_index = (uint32_t*)malloc(sizeof(uint32_t) * length);
+    dec->sums = (kiss_fft_scalar*)calloc((size_t)length + 1, sizeof(kiss_fft_scalar));
+    unsigned char *bits = mls_bits(order, length + order);
+    if (!dec->in_index || !dec->out_index || !dec->sums || !bits) {
+        fprintf(stderr, "Failed to allocate MLS decoder\n");
+        free(bits);
+        mls_decoder_free(dec);
+        return -1;
+    }
+
+    /* Windows: every non-zero index exactly once for a maximal sequence */
+    uint32_t q = 0;
+    for (int i = 0; i < order; i++) {
+        q |= (uint32_t)bits[i] << i;
+    }
+    for (int n = 0; n < length; n++) {
+        dec->in_index[n] = q;
+        q = (q >> 1) | ((uint32_t)bits[n + order] << (order - 1));
+    }
+    free(bits);
+
+    /* Rows follow the feedback: r_i = XOR of r_(i - tap); built in out_index, then reordered by lag */
+    uint32_t *rows = dec->out_index;
+    const int *taps = MLS_TAPS[order - MLS_MIN_ORDER];
+    for (int i = 0; i < length; i++) {
+        if (i < order) {
+            rows[i] = 1u << i;
+            continue;
+        }
+        uint32_t r = 0;
+        for (int t = 0; t < MLS_MAX_TAPS && taps[t] > 0; t++) {
+            r ^= rows[i - taps[t]];
+        }
+        rows[i] = r;
+    }
+    /* out_index[k] = r_((length - k) % length): reverse lags 1 .. length - 1 in place */
+    for (int i = 1, j = length - 1; i < j; i++, j--) {
+        uint32_t t = rows[i];
+        rows[i] = rows[j];
+        rows[j] = t;
+    }
+    return 0;
+}
+
+void mls_decoder_reset(MlsDecoder *dec) {
+    memset(dec->sums, 0, sizeof(kiss_fft_scalar) * ((size_t)dec->length + 1));
+    dec->added = 0;
+}
+
+void mls_decoder_add(MlsDecoder *dec, const float *samples, int count) {
+    int pos = (int)(dec->added % dec->length);
+    for (int i = 0; i < count; i++) {
+        dec->sums[dec->in_index[pos]] += samples[i];
+        if (++pos == dec->length) {
+            pos = 0;
+        }
+    }
+    dec->added += count;
+}
+
+void mls_decoder_ir(MlsDecoder *dec, double amplitude, kiss_fft_scalar *ir) {
+    fast_hadamard_transform(dec->sums, dec->order);
+    int64_t periods = dec->added / dec->length;
+    double scale = 1.0 / (amplitude * (dec->length + 1.0) * (double)(periods > 0 ? periods : 1));
+    for (int k = 0; k < dec->length; k++) {
+        ir[k] = (kiss_fft_scalar)(dec->sums[dec->out_index[k]] * scale);
+    }
+}
+
+int mls_linear_ir(kiss_fft_cpx *spectrum, MlsDecoder *dec, SampleSource source, void *context, int chunk,
+                  const ChirpParams *chirp, double fs, int nimp_pre, int nimp_post, kiss_fft_cfg cfg_fft) {
+    int length = dec->length;
+    int nfft = length + 1;
+    int n_samples = chirp->mls_periods * length;
+    int64_t first = mls_first_sample(chirp, fs);
+
+    float *block = (float*)malloc(sizeof(float) * chunk);
+    kiss_fft_scalar *ir = (kiss_fft_scalar*)malloc(sizeof(kiss_fft_scalar) * length);
+    kiss_fft_cpx *time_signal = (kiss_fft_cpx*)calloc(nfft, sizeof(kiss_fft_cpx));
+    kiss_fft_cpx *work = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * nfft);
+    int ret = -1;
+    if (!block || !ir || !time_signal || !work) {
+        fprintf(stderr, "Failed to allocate MLS buffers\n");
+        goto done;
+    }
+
+    mls_decoder_reset(dec);
+    for (int start = 0; start < n_samples; start += chunk) {
+        int count = n_samples - start < chunk ? n_samples - start : chunk;
+        if (source(context, first + start, count, block) != 0) {
+            fprintf(stderr, "Failed to read capture samples\n");
+            goto done;
+        }
+        mls_decoder_add(dec, block, count);
+    }
+    mls_decoder_ir(dec, chirp->amplitude, ir);
+
+    /* Lags before 0 wrap to the end of the period; window_linear_ir() reads them from the end of nfft */
+    for (int i = 0; i < nimp_post; i++) {
+        time_signal[i].r = (kiss_fft_scalar)(ir[i] * nfft);
+    }
+    for (int i = 0; i < nimp_pre; i++) {
+        time_signal[nfft - nimp_pre + i].r = (kiss_fft_scalar)(ir[length - nimp_pre + i] * nfft);
+    }
+    window_linear_ir(time_signal, work, spectrum, cfg_fft, nfft, nimp_pre, nimp_post, LINEAR_IR_FADE, fs, 0,
+                     nfft / 2 + 1);
+    ret = 0;
+
+done:
+    free(block);
+    free(ir);
+    free(time_signal);
+    free(work);
+    return ret;
+}
@@ -0,0 +1,166 @@
+#ifndef MLS_H
+#define MLS_H
+
+#include <stdint.h>
+#include "config.h"
+#include "kiss_fft.h"
+#include "stream_deconv.h"
+
+#define MLS_CHIRP_TYPE 2        /* ChirpParams.type of maximum-length sequence takes */
+#define MLS_MIN_ORDER 8
+#define MLS_MAX_ORDER 20        /* 2^20 - 1 samples: 22 s at 48 kHz */
+#define MLS_DEFAULT_PERIODS 4
+#define MLS_MAX_PERIODS 256
+#define MLS_PRE_WINDOW_S 0.02   /* IR window before the linear IR (s); MLS takes have no harmonic IRs to skip */
+
+/*
+ * Maximum-length sequence takes: Tgap / 2 of silence, one lead-in period
+ * of a binary MLS of order N (period L = 2^N - 1 samples, levels +/-A),
+ * mls_periods periods that are averaged, and the trailing Tgap / 2. The
+ * lead-in lets the response become periodic; the averaged period is the
+ * circular convolution of the IR with the sequence.
+ *
+ * The circular cross-correlation with the sequence is a Hadamard matrix
+ * with its rows and columns permuted (Borish & Angus): the samples of the
+ * period are scattered to Hadamard indices, transformed with N L
+ * additions and no multiplications, and gathered back as IR lags. An IR
+ * longer than the period wraps round, so the period has to cover it.
+ * Nonlinear distortion does not form harmonic IRs ahead of the linear
+ * one, as with exponential sweeps, but spreads over every lag.
+ *
+ * mls_order, mls_periods and Tgap are fields of ChirpParams; start_freq
+ * and end_freq give the band that is regularized and exported, as for
+ * sweeps. The sequence itself is white up to Nyquist.
+ */
+
+/**
+ * Period of an MLS of the given order: 2^order - 1 samples.
+ */
+int mls_length(int order);
+
+/**
+ * Validates the MLS fields of chirp. A zero order becomes the lowest that
+ * makes the period at least chirp->duration, zero periods
+ * MLS_DEFAULT_PERIODS, and duration is then set to the length of the
+ * sequence part of the take (lead-in included). The MLS fields of other
+ * chirps are cleared.
+ *
+ * Parameters:
+ *   chirp: Excitation parameters, updated
+ *   fs: Sampling rate (Hz)
+ *
+ * Returns:
+ *   0 on success, -1 (with a message) on invalid parameters
+ */
+int mls_check(ChirpParams *chirp, double fs);
+
+/**
+ * Samples of the sequence part of a take: (mls_periods + 1) periods.
+ */
+int mls_excitation_samples(const ChirpParams *chirp);
+
+/**
+ * First sample of the averaged periods in a take: Tgap / 2 plus the
+ * lead-in period.
+ */
+int mls_first_sample(const ChirpParams *chirp, double fs);
+
+/**
+ * Generates the take's excitation. Tfade fades the lead-in period in (at
+ * most half of it); the averaged periods are not faded.
+ *
+ * Parameters:
+ *   buffer: Output, 2 (int)(Tgap / 2 * fs) + mls_excitation_samples() samples
+ *   chirp: MLS parameters
+ *   fs: Sampling rate (Hz)
+ *
+ * Returns:
+ *   0 on success, -1 on allocation failure
+ */
+int generate_mls(float *buffer, const ChirpParams *chirp, float fs);
+
+/**
+ * IR window of MLS takes: MLS_PRE_WINDOW_S before the linear IR and the
+ * 200 ms of linear_ir_window() after it, shortened so both fit in one
+ * period.
+ */
+void mls_ir_window(const ChirpParams *chirp, double fs, int *nimp_pre, int *nimp_post);
+
+/**
+ * Fast Hadamard transform in place, natural (Sylvester) order, without
+ * normalization: n = 2^order butterflies of one addition and one
+ * subtraction per stage.
+ */
+void fast_hadamard_transform(kiss_fft_scalar *data, int order);
+
+/* Period averaging and Hadamard deconvolution of one MLS order */
+typedef struct {
+    int order;
+    int length;              /* mls_length(order) */
+    uint32_t *in_index;      /* Hadamard index of each sample of the period */
+    uint32_t *out_index;     /* Hadamard index of each IR lag */
+    kiss_fft_scalar *sums;   /* Hadamard-ordered period sums, 2^order */
+    int64_t added;           /* Samples added since the last reset */
+} MlsDecoder;
+
+/**
+ * Builds the permutations of an order. Memory is 2^order times two
+ * indices and one kiss_fft_scalar, whatever the take length.
+ *
+ * Returns:
+ *   0 on success, -1 on an invalid order or allocation failure
+ */
+int mls_decoder_init(MlsDecoder *dec, int order);
+
+void mls_decoder_free(MlsDecoder *dec);
+
+/**
+ * Clears the period sums.
+ */
+void mls_decoder_reset(MlsDecoder *dec);
+
+/**
+ * Adds recorded samples to the period sums. Consecutive calls continue
+ * the period where the last one stopped; the first sample after a reset
+ * is the first of a period.
+ */
+void mls_decoder_add(MlsDecoder *dec, const float *samples, int count);
+
+/**
+ * Deconvolves the average of the whole periods added: the IR at lags
+ * 0 to length - 1, circularly, for an excitation of levels +/-amplitude.
+ * Lags are exact up to an offset of -sum(h) / 2^order common to all of
+ * them; a DC offset c of the recording adds -c / (amplitude 2^order) to
+ * that offset. The sums are transformed in place, so reset before adding
+ * again.
+ *
+ * Parameters:
+ *   ir: Output, length samples
+ *   amplitude: Level of the sequence
+ */
+void mls_decoder_ir(MlsDecoder *dec, double amplitude, kiss_fft_scalar *ir);
+
+/**
+ * Linear IR spectrum of an MLS take: averages its periods, deconvolves
+ * them (mls_decoder_ir()), windows the IR with window_linear_ir() and
+ * transforms it. The spectrum is scaled by nfft, as the unnormalized
+ * transforms of the sweep path leave it.
+ *
+ * Parameters:
+ *   spectrum: Output, nfft = 2^order bins; the non-negative frequencies
+ *             are computed, the others set to zero
+ *   dec: Decoder of the take's order, reset here
+ *   source, context: Capture samples, aligned with the excitation
+ *   chunk: Samples per read
+ *   chirp: MLS parameters of the take
+ *   fs: Sampling rate (Hz)
+ *   nimp_pre, nimp_post: IR window before/after the linear IR (mls_ir_window())
+ *   cfg_fft: Forward FFT config (nfft)
+ *
+ * Returns:
+ *   0 on success, -1 on failure
+ */
+int mls_linear_ir(kiss_fft_cpx *spectrum, MlsDecoder *dec, SampleSource source, void *context, int chunk,
+                  const ChirpParams *chirp, double fs, int nimp_pre, int nimp_post, kiss_fft_cfg cfg_fft);
+
+#endif
@@ -0,0 +1,113 @@
+#include "multi_sweep.h"
+#include "processing.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Rate of the exponential sweep of generate_chirp() (s) */
+static double sweep_rate(const ChirpParams *chirp) {
+    double f0 = chirp->start_freq, f1 = chirp->end_freq;
+    return (1 / f0) * ceil(f0 * chirp->duration / log(f1 / f0));
+}
+
+int multi_sweep_count(const ChirpParams *chirp) {
+    return chirp->num_sweeps > 1 ? chirp->num_sweeps : 1;
+}
+
+double multi_sweep_min_stagger(const ChirpParams *chirp, double fs) {
+    int npre, npost;
+    linear_ir_window(chirp->start_freq, chirp->end_freq, chirp->duration, fs, &npre, &npost);
+    return (double)npost / fs + sweep_rate(chirp) * log((double)MULTI_SWEEP_HARMONICS);
+}
+
+int multi_sweep_check(ChirpParams *chirp, double fs) {
+    if (chirp->num_sweeps < 0 || chirp->num_sweeps > MULTI_SWEEP_MAX) {
+        fprintf(stderr, "Invalid number of sweeps %d (1 to %d)\n", chirp->num_sweeps, MULTI_SWEEP_MAX);
+        return -1;
+    }
+    if (multi_sweep_count(chirp) == 1) {
+        return 0;
+    }
+    if (chirp->type != 1) {
+        fprintf(stderr, "Staggered sweeps need an exponential chirp\n");
+        return -1;
+    }
+    if (chirp->sweep_level_step < 0.0f) {
+        fprintf(stderr, "Invalid sweep level step\n");
+        return -1;
+    }
+    double min_stagger = multi_sweep_min_stagger(chirp, fs);
+    if (chirp->sweep_stagger == 0.0f) {
+        chirp->sweep_stagger = (float)ceil(min_stagger * 1000.0) / 1000.0f;
+    } else if (chirp->sweep_stagger < min_stagger) {
+        fprintf(stderr, "Sweep stagger of %.3f s is below the %.3f s that separates the IRs\n",
+                chirp->sweep_stagger, min_stagger);
+        return -1;
+    }
+    return 0;
+}
+
+double multi_sweep_duration(const ChirpParams *chirp) {
+    return chirp->duration + (multi_sweep_count(chirp) - 1) * (double)chirp->sweep_stagger;
+}
+
+int multi_sweep_offset(const ChirpParams *chirp, double fs, int k) {
+    return (int)lround(k * (double)chirp->sweep_stagger * fs);
+}
+
+double multi_sweep_gain(const ChirpParams *chirp, int k) {
+    return pow(10.0, -k * (double)chirp->sweep_level_step / 20.0);
+}
+
+int generate_multi_sweep(float *buffer, const ChirpParams *chirp, float fs) {
+    int num_sweeps = multi_sweep_count(chirp);
+    if (num_sweeps == 1) {
+        generate_chirp(buffer, chirp->amplitude, chirp->start_freq, chirp->end_freq, chirp->duration, fs, chirp->type,
+                       chirp->Tgap, chirp->Tfade);
+        return 0;
+    }
+
+    /* One sweep with its padding, added in at each offset */
+    int n_total = (int)((multi_sweep_duration(chirp) + chirp->Tgap) * fs);
+    int n_single = (int)((chirp->duration + chirp->Tgap) * fs);
+    float *single = (float*)malloc(sizeof(float) * n_single);
+    if (!single) {
+        fprintf(stderr, "Failed to allocate sweep buffer\n");
+        return -1;
+    }
+    generate_chirp(single, chirp->amplitude, chirp->start_freq, chirp->end_freq, chirp->duration, fs, chirp->type,
+                   chirp->Tgap, chirp->Tfade);
+
+    memset(buffer, 0, sizeof(float) * n_total);
+    for (int k = 0; k < num_sweeps; k++) {
+        int offset = multi_sweep_offset(chirp, fs, k);
+        float gain = (float)multi_sweep_gain(chirp, k);
+        for (int i = 0; i < n_single && offset + i < n_total; i++) {
+            buffer[offset + i] += gain * single[i];
+        }
+    }
+    free(single);
+    return 0;
+}
+
+void separate_sweep_ir(const kiss_fft_cpx *time_signal, kiss_fft_cpx *rotated, kiss_fft_cpx *work,
+                       kiss_fft_cpx *spectrum, kiss_fft_cfg cfg_fft, int nfft, double offset, double gain,
+                       int nimp_pre, int nimp_post, double fs, int first_bin, int num_bins) {
+    /* Bring the whole samples of the offset to 0 and window there */
+    int shift = (int)floor(offset);
+    double frac = offset - shift;
+    shift %= nfft;
+    memcpy(rotated, time_signal + shift, sizeof(kiss_fft_cpx) * (nfft - shift));
+    memcpy(rotated + nfft - shift, time_signal, sizeof(kiss_fft_cpx) * shift);
+    window_linear_ir(rotated, work, spectrum, cfg_fft, nfft, nimp_pre, nimp_post, LINEAR_IR_FADE, fs, first_bin,
+                     num_bins);
+
+    /* Advance by the rest of a sample and undo the sweep's level */
+    for (int k = first_bin; k < first_bin + num_bins; k++) {
+        double phase = 2.0 * M_PI * k * frac / nfft;
+        double c = cos(phase) / gain, s = sin(phase) / gain;
+        double re = spectrum[k].r, im = spectrum[k].i;
+        spectrum[k].r = (kiss_fft_scalar)(re * c - im * s);
+        spectrum[k].i = (kiss_fft_scalar)(re * s + im * c);
+    }
+}
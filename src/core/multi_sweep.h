@@ -0,0 +1,104 @@
+#ifndef MULTI_SWEEP_H
+#define MULTI_SWEEP_H
+
+#include "config.h"
+#include "kiss_fft.h"
+
+#define MULTI_SWEEP_MAX 16       /* Most sweeps in one take */
+#define MULTI_SWEEP_HARMONICS 5  /* Harmonic orders of the next sweep kept clear of each IR window */
+
+/*
+ * Multiple exponential sweep takes: num_sweeps copies of the exponential
+ * sweep of a ChirpParams, sweep k starting k * sweep_stagger after the
+ * first and sweep_level_step * k dB below it. The sweeps overlap in time;
+ * deconvolving the take once with the single-sweep inverse filter puts
+ * the linear IR of sweep k at its start offset, with its harmonic IRs
+ * L ln(n) ahead of it. As long as the stagger leaves room for the IR
+ * window plus the harmonics of the next sweep, every IR is windowed out
+ * cleanly. num_sweeps of 0 or 1 is a single sweep.
+ */
+
+/**
+ * Sweeps in a take (at least 1).
+ */
+int multi_sweep_count(const ChirpParams *chirp);
+
+/**
+ * Shortest stagger that keeps harmonic orders up to MULTI_SWEEP_HARMONICS
+ * of each sweep out of the IR window of the one before it: the
+ * post-IR window of linear_ir_window() plus L ln(MULTI_SWEEP_HARMONICS).
+ *
+ * Parameters:
+ *   chirp: Sweep parameters
+ *   fs: Sampling rate (Hz)
+ *
+ * Returns:
+ *   Stagger in seconds
+ */
+double multi_sweep_min_stagger(const ChirpParams *chirp, double fs);
+
+/**
+ * Validates the multiple-sweep fields of chirp and fills in the default
+ * stagger (multi_sweep_min_stagger()) when it is 0. Single sweeps pass
+ * unchanged.
+ *
+ * Parameters:
+ *   chirp: Sweep parameters, updated
+ *   fs: Sampling rate (Hz)
+ *
+ * Returns:
+ *   0 on success, -1 (with a message) if the sweeps cannot be separated
+ */
+int multi_sweep_check(ChirpParams *chirp, double fs);
+
+/**
+ * Length of all sweeps from the start of the first to the end of the
+ * last, without the silence padding (s).
+ */
+double multi_sweep_duration(const ChirpParams *chirp);
+
+/**
+ * Start of sweep k after the first, rounded to the sample at rate fs.
+ */
+int multi_sweep_offset(const ChirpParams *chirp, double fs, int k);
+
+/**
+ * Amplitude of sweep k relative to the first: 10^(-k sweep_level_step / 20).
+ */
+double multi_sweep_gain(const ChirpParams *chirp, int k);
+
+/**
+ * Generates the take's excitation: the sweeps of generate_chirp(), each
+ * scaled and delayed, summed after the leading Tgap / 2 of silence.
+ *
+ * Parameters:
+ *   buffer: Output, (multi_sweep_duration() + Tgap) * fs samples
+ *   chirp: Sweep parameters
+ *   fs: Sampling rate (Hz)
+ *
+ * Returns:
+ *   0 on success, -1 on allocation failure
+ */
+int generate_multi_sweep(float *buffer, const ChirpParams *chirp, float fs);
+
+/**
+ * Windows the linear IR of one sweep out of a take deconvolved with the
+ * single-sweep inverse filter, and returns its spectrum at the level of
+ * the first sweep.
+ *
+ * Parameters:
+ *   time_signal: Deconvolved take (nfft samples), not modified
+ *   rotated, work: Scratch buffers (nfft)
+ *   spectrum: Output linear IR spectrum (nfft bins)
+ *   cfg_fft: Forward FFT config (nfft)
+ *   offset: Start of the sweep after the first (samples at fs, fractional)
+ *   gain: Level of the sweep (multi_sweep_gain())
+ *   nimp_pre, nimp_post: IR window before/after the linear IR (samples)
+ *   fs: Sampling rate (Hz)
+ *   first_bin, num_bins: Bins of spectrum to compute; the others are set to zero
+ */
+void separate_sweep_ir(const kiss_fft_cpx *time_signal, kiss_fft_cpx *rotated, kiss_fft_cpx *work,
+                       kiss_fft_cpx *spectrum, kiss_fft_cfg cfg_fft, int nfft, double offset, double gain,
+                       int nimp_pre, int nimp_post, double fs, int first_bin, int num_bins);
+
+#endif
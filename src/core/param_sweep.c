@@ -0,0 +1,356 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "param_sweep.h"
+#include "processing.h"
+#include "frf_grid.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#define DB_FLOOR 1e-20 /* Power floor before taking dB */
+
+// --- Grid ---
+
+static float axis_value(const ParamSweepAxis *axis, int i, float fallback) {
+    return axis->count > 0 ? axis->values[i] : fallback;
+}
+
+static int axis_count(const ParamSweepAxis *axis) {
+    return axis->count > 0 ? axis->count : 1;
+}
+
+int param_sweep_expand(const ParamSweepGrid *grid, const ParamSetting *defaults, double fs, ParamSetting *settings) {
+    int n = 0;
+    for (int a = 0; a < axis_count(&grid->pre_s); a++) {
+        for (int b = 0; b < axis_count(&grid->post_s); b++) {
+            for (int c = 0; c < axis_count(&grid->fade); c++) {
+                for (int d = 0; d < axis_count(&grid->epsilon_hz); d++, n++) {
+                    if (!settings) continue;
+                    ParamSetting *s = &settings[n];
+                    s->npre = grid->pre_s.count > 0 ? (int)(grid->pre_s.values[a] * fs) : defaults->npre;
+                    s->npost = grid->post_s.count > 0 ? (int)(grid->post_s.values[b] * fs) : defaults->npost;
+                    s->fade = axis_value(&grid->fade, c, defaults->fade);
+                    s->epsilon_hz = axis_value(&grid->epsilon_hz, d, defaults->epsilon_hz);
+                }
+            }
+        }
+    }
+    return n;
+}
+
+// --- Metrics ---
+
+static double bin_db(kiss_fft_cpx z) {
+    return 10.0 * log10((double)z.r * z.r + (double)z.i * z.i + DB_FLOOR);
+}
+
+void param_sweep_metrics(const kiss_fft_cpx *h, int first_bin, int num_bins, const float *reference_db,
+                         double bin_hz, ParamMetrics *metrics) {
+    memset(metrics, 0, sizeof(*metrics));
+    metrics->peak_db = -INFINITY;
+
+    double prev = 0.0, prev2 = 0.0;
+    double ripple = 0.0, delta = 0.0;
+    for (int k = 0; k < num_bins; k++) {
+        double db = bin_db(h[first_bin + k]);
+        if (db > metrics->peak_db) {
+            metrics->peak_db = db;
+            metrics->peak_hz = (first_bin + k) * bin_hz;
+        }
+        metrics->mean_db += db;
+        if (k >= 2) {
+            double d2 = db - 2.0 * prev + prev2;
+            ripple += d2 * d2;
+        }
+        if (reference_db) {
+            delta += (db - reference_db[k]) * (db - reference_db[k]);
+        }
+        prev2 = prev;
+        prev = db;
+    }
+    if (num_bins > 0) {
+        metrics->mean_db /= num_bins;
+        metrics->delta_db = sqrt(delta / num_bins);
+    }
+    if (num_bins > 2) {
+        metrics->ripple_db = sqrt(ripple / (num_bins - 2));
+    }
+}
+
+// --- Evaluation ---
+
+/* Buffers of one worker */
+typedef struct {
+    kiss_fft_cpx *work;
+    kiss_fft_cpx *open;
+    kiss_fft_cpx *closed;
+    kiss_fft_cpx *h;
+    kiss_fft_scalar *window;
+} SweepBuffers;
+
+typedef struct {
+    /* Shared, read only */
+    const kiss_fft_cpx *open_time, *closed_time; /* Raw deconvolved time signals */
+    int nfft;
+    int fft_size; /* Window FFT size: every window fits, bins are every nfft / fft_size-th FFT bin */
+    double fs;
+    float f0, f1;
+    kiss_fft_cfg cfg;
+    const ParamSetting *settings;
+    const int *group_start; /* First setting of each window group, plus num_settings */
+    int num_groups;
+    int first_bin, num_bins;
+    const kiss_fft_scalar *epsilon; /* Tables of epsilon over the band, one per distinct transition width */
+    const int *epsilon_table;       /* Table of each setting */
+    const float *reference_db;
+
+    /* Per worker */
+    int index, stride;
+    ParamMetrics *metrics;
+    int threaded; /* Runs on its own thread (joined at the end) */
+    int failed;
+} SweepWorker;
+
+int param_sweep_fft_size(const ParamSetting *settings, int num_settings, const ParamSetting *reference, int nfft) {
+    int widest = reference->npre + reference->npost;
+    for (int i = 0; i < num_settings; i++) {
+        if (settings[i].npre + settings[i].npost > widest) widest = settings[i].npre + settings[i].npost;
+    }
+    int size = calculate_next_power_of_two(widest);
+    return size < nfft ? size : nfft;
+}
+
+size_t param_sweep_thread_memory(int fft_size) {
+    return (size_t)fft_size * (4 * sizeof(kiss_fft_cpx) + sizeof(kiss_fft_scalar));
+}
+
+int param_sweep_cpu_count(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
+
+static int buffers_alloc(SweepBuffers *b, int size) {
+    b->work = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * size);
+    b->open = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * size);
+    b->closed = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * size);
+    b->h = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * size);
+    b->window = (kiss_fft_scalar*)malloc(sizeof(kiss_fft_scalar) * size);
+    return (b->work && b->open && b->closed && b->h && b->window) ? 0 : -1;
+}
+
+static void buffers_free(SweepBuffers *b) {
+    free(b->work);
+    free(b->open);
+    free(b->closed);
+    free(b->h);
+    free(b->window);
+}
+
+/*
+ * Windows both captures with a setting's IR window, leaving their spectra
+ * over the band in b: the spectra of window_linear_ir(), from one FFT.
+ * The IRs are real, so the pair is transformed as one complex signal and
+ * split using the symmetry of real spectra. The window is applied where
+ * the samples are, npre before time 0 wrapping to the end, which is the
+ * advance by npre that window_linear_ir() applies as a phase.
+ *
+ * The windowed IR is shorter than fft_size, so its fft_size-point FFT
+ * holds the nfft-point spectrum of processing mode exactly at every
+ * (nfft / fft_size)-th bin: X_nfft[q nfft / fft_size] = X_fft_size[q].
+ */
+static void window_pair(const SweepWorker *w, SweepBuffers *b, const ParamSetting *s) {
+    int size = w->fft_size;
+    int len_window = calculate_next_power_of_two(s->npre + s->npost);
+    memset(b->window, 0, sizeof(kiss_fft_scalar) * len_window);
+    generate_tukey_window(b->window, (int)(s->fade * (double)s->npre), (int)(s->fade * (double)s->npost), len_window);
+
+    memset(b->work, 0, sizeof(kiss_fft_cpx) * size);
+    for (int i = 0; i < s->npre + s->npost; i++) {
+        int j = i < s->npre ? size - s->npre + i : i - s->npre;
+        int src = i < s->npre ? w->nfft - s->npre + i : i - s->npre;
+        b->work[j].r = w->open_time[src].r * b->window[i];
+        b->work[j].i = w->closed_time[src].r * b->window[i];
+    }
+    kiss_fft(w->cfg, b->work, b->work);
+
+    /* Open = (Z[k] + conj(Z[-k])) / 2, closed = (Z[k] - conj(Z[-k])) / 2j */
+    for (int k = w->first_bin; k < w->first_bin + w->num_bins; k++) {
+        kiss_fft_cpx z = b->work[k];
+        kiss_fft_cpx m = b->work[(size - k) % size];
+        b->open[k].r = (z.r + m.r) * 0.5f;
+        b->open[k].i = (z.i - m.i) * 0.5f;
+        b->closed[k].r = (z.i + m.i) * 0.5f;
+        b->closed[k].i = (m.r - z.r) * 0.5f;
+    }
+}
+
+/* H_lips over the band for setting i (num_settings: the reference), from the spectra in b */
+static void band_h_lips(const SweepWorker *w, SweepBuffers *b, int i) {
+    const kiss_fft_scalar *epsilon = w->epsilon + (size_t)w->epsilon_table[i] * w->num_bins;
+    compute_h_lips(b->h + w->first_bin, b->open + w->first_bin, b->closed + w->first_bin, epsilon, w->num_bins);
+}
+
+/*
+ * Tabulates epsilon over the band once per distinct transition width of
+ * the settings and the reference (the last entry of table). Returns the
+ * tables, num_bins values each, or NULL when out of memory.
+ */
+static kiss_fft_scalar *epsilon_tables(const SweepWorker *w, const ParamSetting *settings, int num_settings,
+                                       const ParamSetting *reference, int *table) {
+    float *widths = (float*)malloc(sizeof(float) * (num_settings + 1));
+    if (!widths) {
+        return NULL;
+    }
+    int num_tables = 0;
+    for (int i = 0; i <= num_settings; i++) {
+        float hz = i < num_settings ? settings[i].epsilon_hz : reference->epsilon_hz;
+        int t = 0;
+        while (t < num_tables && widths[t] != hz) t++;
+        if (t == num_tables) widths[num_tables++] = hz;
+        table[i] = t;
+    }
+
+    /* generate_epsilon_bins() indexes by bin; each table is the band part of it */
+    kiss_fft_scalar *bins = (kiss_fft_scalar*)malloc(sizeof(kiss_fft_scalar) * (w->first_bin + w->num_bins));
+    kiss_fft_scalar *tables = (kiss_fft_scalar*)malloc(sizeof(kiss_fft_scalar) * ((size_t)num_tables * w->num_bins + 1));
+    if (bins && tables) {
+        for (int t = 0; t < num_tables; t++) {
+            generate_epsilon_bins(bins, w->f0, w->f1, (float)w->fs, w->fft_size, widths[t], w->first_bin, w->num_bins);
+            memcpy(tables + (size_t)t * w->num_bins, bins + w->first_bin, sizeof(kiss_fft_scalar) * w->num_bins);
+        }
+    } else {
+        free(tables);
+        tables = NULL;
+    }
+    free(bins);
+    free(widths);
+    return tables;
+}
+
+static void *sweep_worker(void *arg) {
+    SweepWorker *w = (SweepWorker *)arg;
+    SweepBuffers b;
+    if (buffers_alloc(&b, w->fft_size) != 0) {
+        buffers_free(&b);
+        w->failed = 1;
+        return NULL;
+    }
+
+    double bin_hz = w->fs / w->fft_size;
+    for (int g = w->index; g < w->num_groups; g += w->stride) {
+        window_pair(w, &b, &w->settings[w->group_start[g]]);
+        for (int i = w->group_start[g]; i < w->group_start[g + 1]; i++) {
+            band_h_lips(w, &b, i);
+            param_sweep_metrics(b.h, w->first_bin, w->num_bins, w->reference_db, bin_hz, &w->metrics[i]);
+        }
+    }
+    buffers_free(&b);
+    return NULL;
+}
+
+static int same_window(const ParamSetting *a, const ParamSetting *b) {
+    return a->npre == b->npre && a->npost == b->npost && a->fade == b->fade;
+}
+
+int param_sweep_run(const kiss_fft_cpx *open_time, const kiss_fft_cpx *closed_time, int nfft, double fs,
+                    float f0, float f1, const ParamSetting *settings, int num_settings,
+                    const ParamSetting *reference, int num_threads, ParamMetrics *metrics) {
+    SweepWorker shared;
+    memset(&shared, 0, sizeof(shared));
+    shared.fft_size = param_sweep_fft_size(settings, num_settings, reference, nfft);
+    shared.fs = fs;
+    shared.f0 = f0;
+    shared.f1 = f1;
+    shared.settings = settings;
+    int size = shared.fft_size;
+
+    /* Same band as the band-limited FRF output, on the bins of the window FFT */
+    FrfGrid band;
+    double margin = pow(2.0, FRF_BAND_MARGIN_OCTAVES);
+    shared.first_bin = frf_grid_band_bins(&band, f0 / margin, f1 * margin, fs, size);
+    shared.num_bins = band.num_points;
+
+    int *group_start = (int*)malloc(sizeof(int) * (num_settings + 1));
+    int *epsilon_table = (int*)malloc(sizeof(int) * (num_settings + 1));
+    float *reference_db = (float*)malloc(sizeof(float) * (shared.num_bins > 0 ? shared.num_bins : 1));
+    kiss_fft_scalar *epsilon = epsilon_table ? epsilon_tables(&shared, settings, num_settings, reference, epsilon_table)
+                                             : NULL;
+    shared.cfg = kiss_fft_alloc(size, 0, NULL, NULL);
+    SweepBuffers b;
+    int ret = -1;
+    if (!group_start || !epsilon_table || !epsilon || !reference_db || !shared.cfg
+        || buffers_alloc(&b, size) != 0) {
+        fprintf(stderr, "Failed to allocate parameter sweep buffers\n");
+        if (group_start && epsilon_table && epsilon && reference_db && shared.cfg) buffers_free(&b);
+        free(group_start);
+        free(epsilon_table);
+        free(epsilon);
+        free(reference_db);
+        kiss_fft_free(shared.cfg);
+        return -1;
+    }
+    shared.epsilon = epsilon;
+    shared.epsilon_table = epsilon_table;
+    shared.open_time = open_time;
+    shared.closed_time = closed_time;
+    shared.nfft = nfft;
+
+    /* Settings sharing an IR window, adjacent after param_sweep_expand(), form one work unit */
+    for (int i = 0; i < num_settings; i++) {
+        if (i == 0 || !same_window(&settings[i], &settings[i - 1])) {
+            group_start[shared.num_groups++] = i;
+        }
+    }
+    group_start[shared.num_groups] = num_settings;
+    shared.group_start = group_start;
+
+    /* Reference |H_lips| that every setting is compared with */
+    window_pair(&shared, &b, reference);
+    band_h_lips(&shared, &b, num_settings);
+    for (int k = 0; k < shared.num_bins; k++) {
+        reference_db[k] = (float)bin_db(b.h[shared.first_bin + k]);
+    }
+    buffers_free(&b);
+    shared.reference_db = reference_db;
+
+    if (num_threads > shared.num_groups) num_threads = shared.num_groups;
+    if (num_threads < 1) num_threads = 1;
+    SweepWorker *workers = (SweepWorker*)malloc(sizeof(SweepWorker) * num_threads);
+    pthread_t *threads = (pthread_t*)malloc(sizeof(pthread_t) * num_threads);
+    if (workers && threads) {
+        for (int t = 0; t < num_threads; t++) {
+            workers[t] = shared;
+            workers[t].index = t;
+            workers[t].stride = num_threads;
+            workers[t].metrics = metrics;
+        }
+        /* The calling thread is worker 0, and runs any worker whose thread fails to start */
+        for (int t = 1; t < num_threads; t++) {
+            workers[t].threaded = pthread_create(&threads[t], NULL, sweep_worker, &workers[t]) == 0;
+        }
+        for (int t = 0; t < num_threads; t++) {
+            if (!workers[t].threaded) sweep_worker(&workers[t]);
+        }
+        ret = 0;
+        for (int t = 0; t < num_threads; t++) {
+            if (workers[t].threaded) pthread_join(threads[t], NULL);
+            if (workers[t].failed) ret = -1;
+        }
+        if (ret != 0) {
+            fprintf(stderr, "Failed to allocate parameter sweep buffers\n");
+        }
+    } else {
+        fprintf(stderr, "Failed to allocate parameter sweep workers\n");
+    }
+
+    free(workers);
+    free(threads);
+    free(group_start);
+    free(epsilon_table);
+    free(epsilon);
+    free(reference_db);
+    kiss_fft_free(shared.cfg);
+    return ret;
+}
@@ -0,0 +1,127 @@
+#ifndef PARAM_SWEEP_H
+#define PARAM_SWEEP_H
+
+#include <stddef.h>
+#include "kiss_fft.h"
+
+#define PARAM_SWEEP_MAX_VALUES 16 /* Values per grid axis */
+
+/* Values of one grid axis; an empty axis stands for the processing default */
+typedef struct {
+    int count;
+    float values[PARAM_SWEEP_MAX_VALUES];
+} ParamSweepAxis;
+
+/**
+ * Grid of processing settings: every combination of the axis values.
+ */
+typedef struct {
+    ParamSweepAxis pre_s;      /* IR window before the linear IR (s); default from linear_ir_window() */
+    ParamSweepAxis post_s;     /* IR window after the linear IR (s); default 0.2 s */
+    ParamSweepAxis fade;       /* Taper of each window side (fraction, 0 to 0.5); default LINEAR_IR_FADE */
+    ParamSweepAxis epsilon_hz; /* Regularization transition width (Hz); default EPSILON_TRANSITION_HZ */
+} ParamSweepGrid;
+
+/* One grid point, in samples where processing works in samples */
+typedef struct {
+    int npre, npost;
+    float fade;
+    float epsilon_hz;
+} ParamSetting;
+
+/* H_lips figures of one setting over the band */
+typedef struct {
+    double peak_db;   /* Largest |H_lips| (dB) */
+    double peak_hz;   /* Its frequency */
+    double mean_db;   /* Mean |H_lips| (dB) */
+    double ripple_db; /* RMS second difference of |H_lips| (dB) between bins; lower is smoother */
+    double delta_db;  /* RMS difference from the reference setting (dB) */
+} ParamMetrics;
+
+/**
+ * Expands a grid into its settings, epsilon varying fastest so that
+ * settings sharing an IR window are adjacent.
+ *
+ * Parameters:
+ *   grid: Axes (empty axes take the defaults)
+ *   defaults: Setting used for empty axes (e.g. from linear_ir_window())
+ *   fs: Sampling rate (Hz), to convert window lengths to samples
+ *   settings: Output, NULL to only count
+ *
+ * Returns:
+ *   Number of settings
+ */
+int param_sweep_expand(const ParamSweepGrid *grid, const ParamSetting *defaults, double fs, ParamSetting *settings);
+
+/**
+ * Computes the H_lips figures of one spectrum over bins
+ * [first_bin, first_bin + num_bins).
+ *
+ * Parameters:
+ *   h: H_lips spectrum (FFT bins)
+ *   reference_db: |H_lips| (dB) of the reference setting over the same bins, or NULL (delta_db = 0)
+ *   bin_hz: Bin spacing (Hz)
+ *   metrics: Output
+ */
+void param_sweep_metrics(const kiss_fft_cpx *h, int first_bin, int num_bins, const float *reference_db,
+                         double bin_hz, ParamMetrics *metrics);
+
+/**
+ * Evaluates settings from the raw deconvolved time signals of the two
+ * captures (the inverse FFT of capture spectrum times inverse filter,
+ * before any windowing), which are computed once by the caller. Each
+ * distinct IR window is applied once and both windowed IRs go through
+ * one FFT; settings that only differ in epsilon reuse their spectra, and
+ * epsilon is tabulated once per distinct transition width. H_lips and
+ * the metrics are only computed over the band bins.
+ * The windows are transformed at param_sweep_fft_size(), the shortest
+ * FFT holding the widest window, instead of nfft. Its bins are every
+ * (nfft / size)-th bin of the processing spectrum, and exactly equal to
+ * them, so the metrics match processing mode on that coarser grid.
+ * Windows are spread over worker threads, each with its own buffers;
+ * the FFT plan and epsilon tables are shared.
+ *
+ * Parameters:
+ *   open_time, closed_time: Raw deconvolved time signals (nfft samples), read only
+ *   nfft: FFT size
+ *   fs: Sampling rate (Hz)
+ *   f0, f1: Chirp freq. range (Hz)
+ *   settings, num_settings: Settings to evaluate
+ *   reference: Setting the delta_db figures are measured against
+ *   num_threads: Worker threads (at least 1)
+ *   metrics: Output, one per setting
+ *
+ * Returns:
+ *   0 on success, -1 on allocation failure
+ */
+int param_sweep_run(const kiss_fft_cpx *open_time, const kiss_fft_cpx *closed_time, int nfft, double fs,
+                    float f0, float f1, const ParamSetting *settings, int num_settings,
+                    const ParamSetting *reference, int num_threads, ParamMetrics *metrics);
+
+/**
+ * FFT size param_sweep_run() transforms the windows at: the next power of
+ * two holding the widest window (npre + npost), at most nfft.
+ *
+ * Parameters:
+ *   settings, num_settings, reference: As passed to param_sweep_run()
+ *   nfft: FFT size of the raw deconvolved time signals
+ *
+ * Returns:
+ *   FFT size, a power of two dividing nfft
+ */
+int param_sweep_fft_size(const ParamSetting *settings, int num_settings, const ParamSetting *reference, int nfft);
+
+/**
+ * Working memory of one worker thread of param_sweep_run() in bytes.
+ *
+ * Parameters:
+ *   fft_size: From param_sweep_fft_size()
+ */
+size_t param_sweep_thread_memory(int fft_size);
+
+/**
+ * Number of online CPUs, the default worker count (1 if unknown).
+ */
+int param_sweep_cpu_count(void);
+
+#endif
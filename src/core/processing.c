@@ -5,9 +5,9 @@
 // --- Constants ---
 #define EPSILON_DIVISION_BY_ZERO 1e-15
 #define EPSILON_MAGNITUDE_THRESHOLD 1e-12
-#define EPSILON_TRANSITION_HZ 50.0
 #define DEFAULT_IR_LENGTH 8192
 #define DEFAULT_FADE_LENGTH 16
+#define DEBUG_CONVERT_CHUNK 4096    /* Scalars converted per write when dumping debug buffers */
 
 int calculate_next_power_of_two(int n) {
     int nfft = 1;
@@ -255,13 +255,18 @@ double transition_function(double f, double fa, double fb) {
     return 0.5 * (1.0 + tanh(term1 + term2));
 }
 
-void generate_epsilon(float *epsilon, float f0, float f1, float fs, int nfft) {
+void generate_epsilon(kiss_fft_scalar *epsilon, float f0, float f1, float fs, int nfft) {
+    generate_epsilon_bins(epsilon, f0, f1, fs, nfft, EPSILON_TRANSITION_HZ, 0, nfft);
+}
+
+void generate_epsilon_bins(kiss_fft_scalar *epsilon, float f0, float f1, float fs, int nfft, double transition_hz,
+                           int first_bin, int num_bins) {
     double fa0 = f0;
-    double fb0 = f0 - EPSILON_TRANSITION_HZ;
+    double fb0 = f0 - transition_hz;
     double fa1 = f1;
-    double fb1 = f1 + EPSILON_TRANSITION_HZ;
+    double fb1 = f1 + transition_hz;
 
-    for (int k = 0; k < nfft; k++) {
+    for (int k = first_bin; k < first_bin + num_bins; k++) {
         double f = (double)k * fs / nfft;
         double weight = 0.0;
 
@@ -271,118 +276,197 @@ void generate_epsilon(float *epsilon, float f0, float f1, float fs, int nfft) {
             weight = transition_function(f, fa1, fb1);
         }
 
-        // epsilon[k] = (float)(weight * We);
-        epsilon[k] = (float)(weight);
+        // epsilon[k] = (kiss_fft_scalar)(weight * We);
+        epsilon[k] = (kiss_fft_scalar)(weight);
     }
 }
 
+int sweep_band_bins(float f0, float f1, double fs, int nfft, int *num_bins) {
+    double bin_hz = fs / nfft;
+    int first = (int)floor(f0 / bin_hz);
+    int last = (int)ceil(f1 / bin_hz);
+    if (first < 0) first = 0;
+    if (last > nfft / 2) last = nfft / 2;
+    *num_bins = last >= first ? last - first + 1 : 0;
+    return first;
+}
+
 void perform_deconvolution(kiss_fft_cpx *spectrum, const kiss_fft_cpx *inverse_filter, int nfft) {
     for (int k = 0; k < nfft; k++) {
-        double complex z = kiss_to_c99(spectrum[k]);
-        double complex x_inv = kiss_to_c99(inverse_filter[k]);
-        spectrum[k] = c99_to_kiss(z * x_inv);
+        spectrum[k] = complex_multiply(spectrum[k], inverse_filter[k]);
+    }
+}
+
+void perform_deconvolution_bins(kiss_fft_cpx *spectrum, const kiss_fft_cpx *inverse_filter, int nfft,
+                                int first_bin, int num_bins) {
+    int lo = first_bin;
+    int hi = first_bin + num_bins;
+
+    // Negative frequencies: bin nfft - k mirrors bin k, so [lo, hi) maps to [nfft - hi + 1, nfft - lo + 1)
+    int mirror_lo = nfft - hi + 1;
+    int mirror_hi = nfft - lo + 1;
+    if (mirror_hi > nfft) mirror_hi = nfft; // DC has no mirror
+    if (mirror_lo < hi) mirror_lo = hi;     // nor has nfft / 2
+    if (mirror_lo > mirror_hi) mirror_lo = mirror_hi;
+
+    memset(spectrum, 0, sizeof(kiss_fft_cpx) * lo);
+    for (int k = lo; k < hi; k++) {
+        spectrum[k] = complex_multiply(spectrum[k], inverse_filter[k]);
     }
+    memset(spectrum + hi, 0, sizeof(kiss_fft_cpx) * (mirror_lo - hi));
+    for (int k = mirror_lo; k < mirror_hi; k++) {
+        spectrum[k] = complex_multiply(spectrum[k], inverse_filter[k]);
+    }
+    memset(spectrum + mirror_hi, 0, sizeof(kiss_fft_cpx) * (nfft - mirror_hi));
 }
 
-void compute_h_lips(kiss_fft_cpx *h_out, const kiss_fft_cpx *p_open, const kiss_fft_cpx *p_closed, const float *epsilon, int nfft) {
+void compute_h_lips(kiss_fft_cpx *h_out, const kiss_fft_cpx *p_open, const kiss_fft_cpx *p_closed,
+                    const kiss_fft_scalar *epsilon, int nfft) {
     for (int k = 0; k < nfft; k++) {
-        double complex top = kiss_to_c99(p_open[k]);
-        double complex bot = kiss_to_c99(p_closed[k]);
-        double complex numerator = top * conj(bot);
-        
-        double mag_sq = bot * conj(bot);
-        double denominator = mag_sq + epsilon[k];
-        
-        if (denominator < EPSILON_MAGNITUDE_THRESHOLD) {
-            denominator = EPSILON_MAGNITUDE_THRESHOLD;
+        kiss_fft_cpx numerator = complex_multiply(p_open[k], complex_conjugate(p_closed[k]));
+
+        kiss_fft_scalar denominator = complex_squared_magnitude(p_closed[k]) + epsilon[k];
+
+        if (denominator < (kiss_fft_scalar)EPSILON_MAGNITUDE_THRESHOLD) {
+            denominator = (kiss_fft_scalar)EPSILON_MAGNITUDE_THRESHOLD;
         }
-        
-        h_out[k] = c99_to_kiss(numerator / denominator);
+
+        h_out[k].r = numerator.r / denominator;
+        h_out[k].i = numerator.i / denominator;
     }
 }
 
-void generate_tukey_window(float *window, int nfade_pre, int nfade_post, int len_window) {
+void linear_ir_window(float f0, float f1, float T, double fs, int *nimp_pre, int *nimp_post) {
+    // The second harmonic IR arrives L * ln(2) before the linear one
+    double L = (1.0 / f0) * floor(f0 * T / log((double)f1 / f0));
+    double delay_harm2 = L * log(2.0);
+    *nimp_pre = (int)(delay_harm2 * fs);
+    *nimp_post = (int)(0.2 * fs);
+}
+
+void generate_tukey_window(kiss_fft_scalar *window, int nfade_pre, int nfade_post, int len_window) {
     // between nfade_pre and 2*nfade_pre, 0.5 * (1 - np.cos(np.linspace(0, np.pi, nfade_pre)))
     for (int i = 0; i < nfade_pre; i++) {
-        window[i] = 0.5f * (1.0f - cosf((float)M_PI * i / (float)nfade_pre));
+        window[i] = (kiss_fft_scalar)(0.5 * (1.0 - cos(M_PI * i / nfade_pre)));
     }
 
     // after impulse (after end-nfade_post), 0.5 * (1 + np.cos(np.linspace(0, np.pi, nfade_post)))
     for (int i = 0; i < nfade_post; i++) {
-        window[len_window - nfade_post + i] = 0.5f * (1.0f + cosf((float)M_PI * i / (float)nfade_post));
+        window[len_window - nfade_post + i] = (kiss_fft_scalar)(0.5 * (1.0 + cos(M_PI * i / nfade_post)));
     }
     // in the middle, constant 1.0 (between 2*nfade_pre and nimp_pre + nfade_post)
     for (int i = 2*nfade_pre; i < len_window - nfade_post; i++) {
-        window[i] = 1.0f;
+        window[i] = 1;
     }
 }
 
-void extract_linear_ir(kiss_fft_cpx *spectrum, kiss_fft_cfg cfg_inv, kiss_fft_cfg cfg_fft, int nfft, int n_samples_chirp, int nimp_pre, int nimp_post, double fs) {
-    kiss_fft_cpx *time_buf = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * nfft);
-    if (!time_buf) return;
-
-    kiss_fft(cfg_inv, spectrum, time_buf);
-
-    kiss_fft_cpx *circ_buf = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * calculate_next_power_of_two(nimp_pre + nimp_post));
-    if (!circ_buf) return;
-
-    // Save intermediate results for debugging
-    FILE *time_calib_file = fopen("output/time_domain_calibration_response.raw", "wb");
-    if (time_calib_file) {
-        fwrite(time_buf, sizeof(float), n_samples_chirp, time_calib_file);
-        fclose(time_calib_file);
-        printf("Time-domain calibration response saved for debugging.\n");
-    } else {
-        fprintf(stderr, "Failed to save time-domain calibration response for debugging\n");
+void advance_spectrum_bins(kiss_fft_cpx *spectrum, int nfft, int delay, double fs, int first_bin, int num_bins) {
+    memset(spectrum, 0, sizeof(kiss_fft_cpx) * first_bin);
+    for (int k = first_bin; k < first_bin + num_bins; k++) {
+        double f = (double)k * fs / nfft;
+        double phase_correction = 2.0 * M_PI * f * delay / fs;
+        double cos_phase = cos(phase_correction);
+        double sin_phase = sin(phase_correction);
+        double real_part = spectrum[k].r * cos_phase - spectrum[k].i * sin_phase;
+        double imag_part = spectrum[k].r * sin_phase + spectrum[k].i * cos_phase;
+        spectrum[k].r = real_part;
+        spectrum[k].i = imag_part;
     }
+    memset(spectrum + first_bin + num_bins, 0, sizeof(kiss_fft_cpx) * (nfft - first_bin - num_bins));
+}
 
-    // Put into circ_buf the nimp_pre last samples of time_buf followed by the nimp_post first samples
+void window_linear_ir(const kiss_fft_cpx *time_signal, kiss_fft_cpx *work, kiss_fft_cpx *spectrum, kiss_fft_cfg cfg_fft,
+                      int nfft, int nimp_pre, int nimp_post, float fade, double fs, int first_bin, int num_bins) {
+    // Put into work the nimp_pre last samples of time_signal followed by the nimp_post first samples,
+    // zero-padded to nfft: the forward FFT below reads nfft bins, whatever the rate
+    memset(work, 0, sizeof(kiss_fft_cpx) * nfft);
     for (int i = 0; i < nimp_pre; i++) {
-        circ_buf[i] = time_buf[n_samples_chirp - nimp_pre + i];
+        work[i] = time_signal[nfft - nimp_pre + i];
     }
     for (int i = 0; i < nimp_post; i++) {
-        circ_buf[nimp_pre + i] = time_buf[i];
+        work[nimp_pre + i] = time_signal[i];
     }
 
     // Design the window with fade-in/out at boundaries
-    int nfade_pre = (int)nimp_pre / 2;
-    int nfade_post = (int)nimp_post / 2;
+    int nfade_pre = (int)(fade * (double)nimp_pre);
+    int nfade_post = (int)(fade * (double)nimp_post);
+    int len_window = calculate_next_power_of_two(nimp_pre + nimp_post);
+
+    kiss_fft_scalar *window = (kiss_fft_scalar*)calloc(len_window, sizeof(kiss_fft_scalar));
+    if (window) {
+        generate_tukey_window(window, nfade_pre, nfade_post, len_window);
+
+        // apply window to work
+        for (int i = 0; i < nimp_pre + nimp_post; i++) {
+            work[i].r *= window[i];
+            work[i].i *= window[i];
+        }
+        free(window);
+    }
 
-    float *window = (float*)calloc(calculate_next_power_of_two(nimp_pre + nimp_post), sizeof(float));
+    kiss_fft(cfg_fft, work, spectrum);
 
-    generate_tukey_window(window, nfade_pre, nfade_post, calculate_next_power_of_two(nimp_pre + nimp_post));
+    // Apply phase correction * exp(2j pi f nimp_pre / fs) on the requested bins only
+    advance_spectrum_bins(spectrum, nfft, nimp_pre, fs, first_bin, num_bins);
+}
 
-    // apply window to circ_buf
-    for (int i = 0; i < nimp_pre + nimp_post; i++) {
-        circ_buf[i].r *= window[i];
-        circ_buf[i].i *= window[i];
+/* Writes the first n_scalars of an interleaved (re, im) buffer as float32, whatever the build precision */
+static int write_debug_float32(const char *filename, const kiss_fft_cpx *buf, size_t n_scalars) {
+    FILE *file = fopen(filename, "wb");
+    if (!file) {
+        return -1;
+    }
+    const kiss_fft_scalar *src = (const kiss_fft_scalar *)buf;
+    float chunk[DEBUG_CONVERT_CHUNK];
+    int result = 0;
+    for (size_t done = 0; done < n_scalars && result == 0; done += DEBUG_CONVERT_CHUNK) {
+        size_t count = n_scalars - done < DEBUG_CONVERT_CHUNK ? n_scalars - done : DEBUG_CONVERT_CHUNK;
+        for (size_t i = 0; i < count; i++) {
+            chunk[i] = (float)src[done + i];
+        }
+        if (fwrite(chunk, sizeof(float), count, file) != count) {
+            result = -1;
+        }
+    }
+    if (fclose(file) != 0) {
+        result = -1;
     }
+    return result;
+}
 
-    // Save windowed result for debugging
-    FILE *windowed_calib_file = fopen("output/windowed_calibration_response.raw", "wb");
-    if (windowed_calib_file) {
-        fwrite(circ_buf, sizeof(kiss_fft_cpx), calculate_next_power_of_two(nimp_pre + nimp_post), windowed_calib_file);
-        fclose(windowed_calib_file);
-        printf("Windowed calibration response saved for debugging.\n");
-    } else {
-        fprintf(stderr, "Failed to save windowed calibration response for debugging\n");
+void extract_linear_ir(kiss_fft_cpx *spectrum, kiss_fft_cfg cfg_inv, kiss_fft_cfg cfg_fft, int nfft, int n_samples_chirp, int nimp_pre, int nimp_post, double fs, int save_debug) {
+    kiss_fft_cpx *time_buf = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * nfft);
+    if (!time_buf) return;
+
+    kiss_fft(cfg_inv, spectrum, time_buf);
+
+    kiss_fft_cpx *circ_buf = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * nfft);
+    if (!circ_buf) {
+        free(time_buf);
+        return;
     }
 
-    kiss_fft(cfg_fft, circ_buf, spectrum);
+    // Save intermediate results for debugging
+    if (save_debug) {
+        if (write_debug_float32("output/time_domain_calibration_response.raw", time_buf, n_samples_chirp) == 0) {
+            printf("Time-domain calibration response saved for debugging.\n");
+        } else {
+            fprintf(stderr, "Failed to save time-domain calibration response for debugging\n");
+        }
+    }
 
-    // Apply phase correction * exp(2j pi f nimp_pre / fs)
-    for (int k = 0; k < nfft; k++) {
-        double f = (double)k * fs / nfft;
-        double phase_correction = 2.0 * M_PI * f * nimp_pre / fs;
-        double cos_phase = cos(phase_correction);
-        double sin_phase = sin(phase_correction);
-        double real_part = spectrum[k].r * cos_phase - spectrum[k].i * sin_phase;
-        double imag_part = spectrum[k].r * sin_phase + spectrum[k].i * cos_phase;
-        spectrum[k].r = real_part;
-        spectrum[k].i = imag_part;
+    window_linear_ir(time_buf, circ_buf, spectrum, cfg_fft, nfft, nimp_pre, nimp_post, LINEAR_IR_FADE, fs, 0, nfft / 2 + 1);
+
+    // Save windowed result for debugging (circ_buf still holds the windowed IR)
+    if (save_debug) {
+        size_t n_windowed = 2 * (size_t)calculate_next_power_of_two(nimp_pre + nimp_post);
+        if (write_debug_float32("output/windowed_calibration_response.raw", circ_buf, n_windowed) == 0) {
+            printf("Windowed calibration response saved for debugging.\n");
+        } else {
+            fprintf(stderr, "Failed to save windowed calibration response for debugging\n");
+        }
     }
 
-    free(window);
     free(time_buf);
     free(circ_buf);
-}
\ No newline at end of file
+}
@@ -5,6 +5,9 @@
 #include <complex.h>
 #include "complex_utils.h"
 
+#define EPSILON_TRANSITION_HZ 50.0 /* Default width of the regularization transitions outside the sweep */
+#define LINEAR_IR_FADE 0.5f        /* Default taper of each IR window side, as a fraction of that side */
+
 int calculate_next_power_of_two(int n);
 
 /**
@@ -83,23 +86,55 @@ double transition_function(double f, double fa, double fb);
  * - fs: Sampling rate (Hz)
  * - nfft: FFT size
  */
-void generate_epsilon(float *epsilon, float f0, float f1, float fs, int nfft);
+void generate_epsilon(kiss_fft_scalar *epsilon, float f0, float f1, float fs, int nfft);
+
+/**
+ * Same as generate_epsilon() with a given transition width, for bins
+ * [first_bin, first_bin + num_bins) only: epsilon rises from 0 at f0
+ * (f1) to 1 at f0 - transition_hz (f1 + transition_hz).
+ */
+void generate_epsilon_bins(kiss_fft_scalar *epsilon, float f0, float f1, float fs, int nfft, double transition_hz,
+                           int first_bin, int num_bins);
+
+/**
+ * Bins of the sweep band [f0, f1], which the inverse filters are
+ * non-zero on, clamped to the non-negative frequencies [0, nfft / 2].
+ * The range is rounded outwards, so it covers every non-zero bin.
+ * Parameters:
+ * - f0, f1: Chirp freq. range (Hz)
+ * - fs: Sampling rate (Hz)
+ * - nfft: FFT size
+ * - num_bins: Output number of bins
+ * Returns:
+ * - Index of the first bin
+ */
+int sweep_band_bins(float f0, float f1, double fs, int nfft, int *num_bins);
 
 /**
- * Performs frequency domain deconvolution.
+ * Performs frequency domain deconvolution, in kiss_fft_scalar.
  * Z_out(w) = Z_in(w) * X_inverse(w)
  */
 void perform_deconvolution(kiss_fft_cpx *spectrum, const kiss_fft_cpx *inverse_filter, int nfft);
 
 /**
- * Computes the final transfer function H_lips
+ * Same as perform_deconvolution() for an inverse filter that is zero
+ * outside bins [first_bin, first_bin + num_bins) (from sweep_band_bins())
+ * and their negative-frequency mirrors nfft - k: only those bins are
+ * multiplied, all others are set to zero.
+ */
+void perform_deconvolution_bins(kiss_fft_cpx *spectrum, const kiss_fft_cpx *inverse_filter, int nfft,
+                                int first_bin, int num_bins);
+
+/**
+ * Computes the final transfer function H_lips, in kiss_fft_scalar
  * Parameters:
  * - h_out: Output buffer for H_lips
  * - p_open: Deconvolved Open Mouth spectrum (G1 * P_open)
  * - p_closed: Deconvolved Closed Mouth spectrum (G1 * P_closed)
  * - epsilon: Regularisation vector
  */
-void compute_h_lips(kiss_fft_cpx *h_out, const kiss_fft_cpx *p_open, const kiss_fft_cpx *p_closed, const float *epsilon, int nfft);
+void compute_h_lips(kiss_fft_cpx *h_out, const kiss_fft_cpx *p_open, const kiss_fft_cpx *p_closed,
+                    const kiss_fft_scalar *epsilon, int nfft);
 
 /**
  * Applies a one-sided Tukey window to the time domain signal.
@@ -121,20 +156,61 @@ void apply_tukey_window(kiss_fft_cpx *time_signal, int nfft, int ir_len, int fad
  * - nfade_post: Number of samples for fade-out at the end
  * - len_window: Total length of the window buffer
  */
-void generate_tukey_window(float *window, int nfade_pre, int nfade_post, int len_window);
+void generate_tukey_window(kiss_fft_scalar *window, int nfade_pre, int nfade_post, int len_window);
+
+/**
+ * Lengths of the IR window kept around the linear IR: up to the second
+ * harmonic IR before it (exponential sweep delay L * ln 2), 200 ms after.
+ * Parameters:
+ * - f0, f1: Chirp freq. range (Hz)
+ * - T: Chirp duration (s)
+ * - fs: Sampling rate (Hz)
+ * - nimp_pre, nimp_post: Output window lengths (samples)
+ */
+void linear_ir_window(float f0, float f1, float T, double fs, int *nimp_pre, int *nimp_post);
+
+/**
+ * Advances a spectrum by delay samples: multiplies bins
+ * [first_bin, first_bin + num_bins) by exp(2j pi f delay / fs) and sets
+ * all other bins to zero.
+ * Parameters:
+ * - spectrum: I/O buffer (nfft bins)
+ * - delay: Advance (samples)
+ * - fs: Sampling rate (Hz)
+ * - first_bin, num_bins: Bins to keep
+ */
+void advance_spectrum_bins(kiss_fft_cpx *spectrum, int nfft, int delay, double fs, int first_bin, int num_bins);
+
+/**
+ * Windows the linear IR out of a deconvolved time signal and transforms
+ * it back (steps 2-3 of extract_linear_ir()), with a given taper.
+ * Parameters:
+ * - time_signal: Deconvolved time signal (nfft samples, linear IR at 0), not modified
+ * - work: Scratch buffer (nfft); holds the windowed IR on return
+ * - spectrum: Output linear IR spectrum (nfft bins)
+ * - cfg_fft: Config for FFT (kissfft, inverse_fft = 0)
+ * - nimp_pre, nimp_post: IR window before/after the linear IR (samples)
+ * - fade: Taper of each window side as a fraction of that side (0 to 0.5, LINEAR_IR_FADE by default)
+ * - first_bin, num_bins: Bins of spectrum to compute; the others are set to zero
+ */
+void window_linear_ir(const kiss_fft_cpx *time_signal, kiss_fft_cpx *work, kiss_fft_cpx *spectrum, kiss_fft_cfg cfg_fft,
+                      int nfft, int nimp_pre, int nimp_post, float fade, double fs, int first_bin, int num_bins);
 
 /**
  * Coordinates the extraction of the linear part (F -> T -> Window -> F)
  * 1. IFFT of the raw deconvolved spectrum.
  * 2. Windowing in time domain -> no non-linearities.
  * 3. FFT to get the clean freq. Response Function.
+ * The IR is real, so only the non-negative frequencies, bins 0 to
+ * nfft / 2, are computed; the negative ones are set to zero.
  * Parameters:
  * - spectrum: I/O buffer
  * - cfg_inv: Config for IFFT (kissfft, inverse_fft = 1)
  * - cfg_fft: Config for FFT (kissfft, inverse_fft = 0)
  * - nfft: FFT size
  * - ir_len, fade_len: Windowing params
+ * - save_debug: Non-zero to dump the time-domain and windowed IRs as raw files in output/
  */
-void extract_linear_ir(kiss_fft_cpx *spectrum, kiss_fft_cfg cfg_inv, kiss_fft_cfg cfg_fft, int nfft, int n_samples_chirp, int nimp_pre, int nimp_post, double fs);
+void extract_linear_ir(kiss_fft_cpx *spectrum, kiss_fft_cfg cfg_inv, kiss_fft_cfg cfg_fft, int nfft, int n_samples_chirp, int nimp_pre, int nimp_post, double fs, int save_debug);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,98 @@
+#include "sample_format.h"
+#include <stdint.h>
+#include <string.h>
+
+static const char *format_names[NUM_SAMPLE_FORMATS] = { "float32", "int16", "int24", "int32" };
+
+int sample_format_bytes(SampleFormat format) {
+    switch (format) {
+        case SAMPLE_FORMAT_INT16: return 2;
+        case SAMPLE_FORMAT_INT24: return 3;
+        case SAMPLE_FORMAT_INT32: return 4;
+        case SAMPLE_FORMAT_FLOAT32:
+        default: return 4;
+    }
+}
+
+const char *sample_format_name(SampleFormat format) {
+    if ((int)format < 0 || (int)format >= NUM_SAMPLE_FORMATS) {
+        return "unknown";
+    }
+    return format_names[format];
+}
+
+int sample_format_from_name(const char *name, SampleFormat *format) {
+    for (int i = 0; i < NUM_SAMPLE_FORMATS; i++) {
+        if (strcmp(name, format_names[i]) == 0) {
+            *format = (SampleFormat)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+double sample_format_scale(SampleFormat format) {
+    switch (format) {
+        case SAMPLE_FORMAT_INT16: return 1.0 / 32768.0;
+        case SAMPLE_FORMAT_INT24: return 1.0 / 8388608.0;
+        case SAMPLE_FORMAT_INT32: return 1.0 / 2147483648.0;
+        case SAMPLE_FORMAT_FLOAT32:
+        default: return 1.0;
+    }
+}
+
+/* Loads go through memcpy so blocks may start at any byte offset (e.g. inside a mapped file) */
+static void int16_block_to_float(const uint8_t *src, float *dst, int n, float scale) {
+    for (int i = 0; i < n; i++) {
+        int16_t v;
+        memcpy(&v, src + 2 * i, sizeof(v));
+        dst[i] = (float)v * scale;
+    }
+}
+
+static void int24_block_to_float(const uint8_t *src, float *dst, int n, float scale) {
+    for (int i = 0; i < n; i++) {
+        // Assemble the packed little-endian triplet, then sign-extend bit 23
+        int32_t v = (int32_t)src[3 * i] | ((int32_t)src[3 * i + 1] << 8) | ((int32_t)src[3 * i + 2] << 16);
+        v = (v ^ 0x800000) - 0x800000;
+        dst[i] = (float)v * scale;
+    }
+}
+
+static void int32_block_to_float(const uint8_t *src, float *dst, int n, float scale) {
+    for (int i = 0; i < n; i++) {
+        int32_t v;
+        memcpy(&v, src + 4 * i, sizeof(v));
+        dst[i] = (float)v * scale;
+    }
+}
+
+void sample_format_to_float(const void *src, SampleFormat format, float *dst, int n_samples) {
+    const uint8_t *bytes = (const uint8_t *)src;
+    int sample_bytes = sample_format_bytes(format);
+    float scale = (float)sample_format_scale(format);
+
+    if (format == SAMPLE_FORMAT_FLOAT32) {
+        memcpy(dst, src, sizeof(float) * n_samples);
+        return;
+    }
+
+    for (int start = 0; start < n_samples; start += SAMPLE_CONVERT_BLOCK) {
+        int n = n_samples - start < SAMPLE_CONVERT_BLOCK ? n_samples - start : SAMPLE_CONVERT_BLOCK;
+        const uint8_t *block = bytes + (size_t)start * sample_bytes;
+
+        switch (format) {
+            case SAMPLE_FORMAT_INT16:
+                int16_block_to_float(block, dst + start, n, scale);
+                break;
+            case SAMPLE_FORMAT_INT24:
+                int24_block_to_float(block, dst + start, n, scale);
+                break;
+            case SAMPLE_FORMAT_INT32:
+                int32_block_to_float(block, dst + start, n, scale);
+                break;
+            default:
+                break;
+        }
+    }
+}
@@ -0,0 +1,53 @@
+#ifndef SAMPLE_FORMAT_H
+#define SAMPLE_FORMAT_H
+
+/* Native capture sample formats (mirror paFloat32/paInt16/paInt24/paInt32) */
+typedef enum {
+    SAMPLE_FORMAT_FLOAT32 = 0,
+    SAMPLE_FORMAT_INT16 = 1,
+    SAMPLE_FORMAT_INT24 = 2, /* Packed, 3 bytes per sample, little-endian */
+    SAMPLE_FORMAT_INT32 = 3
+} SampleFormat;
+
+#define NUM_SAMPLE_FORMATS 4
+#define SAMPLE_CONVERT_BLOCK 256 /* Samples converted per block by sample_format_to_float() */
+
+/**
+ * Size of one sample in bytes.
+ */
+int sample_format_bytes(SampleFormat format);
+
+/**
+ * Short name used in parameter files ("float32", "int16", "int24", "int32").
+ */
+const char *sample_format_name(SampleFormat format);
+
+/**
+ * Parses a name written by sample_format_name().
+ * 
+ * Returns:
+ *   0 on success, -1 if the name is unknown
+ */
+int sample_format_from_name(const char *name, SampleFormat *format);
+
+/**
+ * Factor mapping native integer full scale to [-1, 1) in float.
+ * 1.0 for float32, 2^-(bits-1) for integer formats.
+ */
+double sample_format_scale(SampleFormat format);
+
+/**
+ * Converts native samples to float, applying the format scale factor.
+ * Works in blocks of SAMPLE_CONVERT_BLOCK with branch-free inner loops
+ * so the compiler can vectorise them; call it on the range being read
+ * rather than converting whole captures up front.
+ * 
+ * Parameters:
+ *   src: Native samples (byte layout given by format)
+ *   format: Format of src
+ *   dst: Output floats (n_samples)
+ *   n_samples: Number of samples to convert
+ */
+void sample_format_to_float(const void *src, SampleFormat format, float *dst, int n_samples);
+
+#endif
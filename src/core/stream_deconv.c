@@ -0,0 +1,167 @@
+#include "stream_deconv.h"
+#include "processing.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// --- Inverse filter taps ---
+
+/* Sweep rate constant of generate_chirp()'s exponential chirp */
+static double exponential_rate(const ChirpParams *chirp) {
+    return (1 / chirp->start_freq) * ceil(chirp->start_freq * chirp->duration / log(chirp->end_freq / chirp->start_freq));
+}
+
+/* Sample n of the chirp as generate_chirp() produces it (no gap, no fade) */
+static double chirp_sample(const ChirpParams *chirp, double L, double fs, int64_t n) {
+    double t = (double)n / fs;
+    double f0 = chirp->start_freq;
+    double f1 = chirp->end_freq;
+    if (chirp->type == 0) {
+        return chirp->amplitude * (float)sin(M_PI * (2 * f0 * t + (f1 - f0) * t * t / chirp->duration));
+    }
+    return chirp->amplitude * (float)sin(2 * M_PI * f0 * L * exp(t / L));
+}
+
+/*
+ * Weight that flattens the sweep's spectrum: an exponential sweep spends
+ * time proportional to 1/f at each frequency, so its inverse is boosted
+ * in proportion to the instantaneous frequency. Linear sweeps are flat.
+ */
+static double chirp_weight(const ChirpParams *chirp, double L, double fs, int64_t n) {
+    if (chirp->type == 0) {
+        return 1.0;
+    }
+    return chirp->start_freq * exp((double)n / fs / L);
+}
+
+// --- Segmented deconvolution ---
+
+int segmented_ir_nfft(int nimp_pre, int nimp_post, int nfft_full) {
+    int nfft_out = 2 * calculate_next_power_of_two(nimp_pre + nimp_post);
+    return nfft_out < nfft_full ? nfft_out : nfft_full;
+}
+
+size_t segmented_ir_memory(int nimp_pre, int nimp_post) {
+    size_t window = (size_t)(nimp_pre + nimp_post);
+    size_t m = 2 * (size_t)calculate_next_power_of_two(nimp_pre + nimp_post);
+    /* Segment and filter spectra, two FFT plans, sample block, window, accumulated lags */
+    return m * (4 * sizeof(kiss_fft_cpx) + sizeof(float)) + m / 2 * sizeof(kiss_fft_scalar) + window * sizeof(double);
+}
+
+int segmented_linear_ir(kiss_fft_cpx *spectrum, int nfft_out, SampleSource source, void *context,
+                        const ChirpParams *chirp, double fs, int n_samples_chirp,
+                        int nimp_pre, int nimp_post, int nfft_full) {
+    int n = n_samples_chirp;
+    int window_len = nimp_pre + nimp_post;
+    int window_alloc = calculate_next_power_of_two(window_len);
+    int m = 2 * window_alloc;          /* Segment FFT size */
+    int block = m - window_len + 1;    /* Filter taps per segment; leaves window_len valid outputs */
+    double L = chirp->type == 0 ? 0.0 : exponential_rate(chirp);
+
+    kiss_fft_cfg cfg_fwd = kiss_fft_alloc(m, 0, NULL, NULL);
+    kiss_fft_cfg cfg_inv = kiss_fft_alloc(m, 1, NULL, NULL);
+    kiss_fft_cfg cfg_out = nfft_out == m ? cfg_fwd : kiss_fft_alloc(nfft_out, 0, NULL, NULL);
+    kiss_fft_cpx *seg = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * m);
+    kiss_fft_cpx *taps = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * m);
+    float *samples = (float*)malloc(sizeof(float) * m);
+    kiss_fft_scalar *window = (kiss_fft_scalar*)calloc(window_alloc, sizeof(kiss_fft_scalar));
+    double *lags = (double*)calloc(window_len, sizeof(double));
+
+    if (!cfg_fwd || !cfg_inv || !cfg_out || !seg || !taps || !samples || !window || !lags) {
+        fprintf(stderr, "Failed to allocate segmented deconvolution buffers\n");
+        if (cfg_out != cfg_fwd) free(cfg_out);
+        free(cfg_fwd);
+        free(cfg_inv);
+        free(seg);
+        free(taps);
+        free(samples);
+        free(window);
+        free(lags);
+        return -1;
+    }
+
+    /*
+     * Normalize to the in-memory path: there the deconvolved chirp is an
+     * ideal band-pass whose peak, through an unnormalized inverse FFT of
+     * size nfft_full, is the number of bins it passes.
+     */
+    int band_bins = 0;
+    for (int k = 0; k <= nfft_full / 2; k++) {
+        double f = (double)k * fs / nfft_full;
+        if (f >= chirp->start_freq && f <= chirp->end_freq) band_bins++;
+    }
+    double energy = 0.0;
+    for (int64_t i = 0; i < n; i++) {
+        double x = chirp_sample(chirp, L, fs, i);
+        energy += x * x * chirp_weight(chirp, L, fs, i);
+    }
+    double gain = energy > 0.0 ? 2.0 * band_bins / energy / m : 0.0; /* 1/m undoes the segment IFFT */
+
+    /*
+     * Lag t of the deconvolution is output N - 1 + t of the convolution
+     * of the capture with taps[j] = x[N - 1 - j] * w[N - 1 - j]. Segment
+     * s convolves filter taps [s * block, s * block + block) with the
+     * m capture samples ending at the last wanted output.
+     */
+    int64_t first_out = (int64_t)n - 1 - nimp_pre;
+    int ret = 0;
+    for (int64_t tap0 = 0; tap0 < n && ret == 0; tap0 += block) {
+        int n_taps = n - tap0 < block ? (int)(n - tap0) : block;
+        for (int j = 0; j < m; j++) {
+            taps[j].r = 0.0f;
+            taps[j].i = 0.0f;
+        }
+        for (int j = 0; j < n_taps; j++) {
+            int64_t i = n - 1 - (tap0 + j);
+            taps[j].r = (kiss_fft_scalar)(gain * chirp_sample(chirp, L, fs, i) * chirp_weight(chirp, L, fs, i));
+        }
+        kiss_fft(cfg_fwd, taps, taps);
+
+        /* Capture samples [start, start + m), zero outside [0, n) */
+        int64_t start = first_out - tap0 - (block - 1);
+        int64_t lo = start < 0 ? 0 : start;
+        int64_t hi = start + m < n ? start + m : n;
+        memset(samples, 0, sizeof(float) * m);
+        if (hi > lo && source(context, lo, (int)(hi - lo), samples + (lo - start)) != 0) {
+            ret = -1;
+            break;
+        }
+        for (int j = 0; j < m; j++) {
+            seg[j].r = samples[j];
+            seg[j].i = 0.0f;
+        }
+        kiss_fft(cfg_fwd, seg, seg);
+        for (int j = 0; j < m; j++) {
+            kiss_fft_cpx a = seg[j];
+            seg[j].r = a.r * taps[j].r - a.i * taps[j].i;
+            seg[j].i = a.r * taps[j].i + a.i * taps[j].r;
+        }
+        kiss_fft(cfg_inv, seg, seg);
+
+        /* Outputs before block - 1 wrapped around; the rest are exact */
+        for (int j = 0; j < window_len; j++) {
+            lags[j] += seg[block - 1 + j].r;
+        }
+    }
+
+    if (ret == 0) {
+        /* Same window, transform and delay compensation as extract_linear_ir() */
+        generate_tukey_window(window, nimp_pre / 2, nimp_post / 2, window_alloc);
+        for (int j = 0; j < nfft_out; j++) {
+            seg[j].r = j < window_len ? (kiss_fft_scalar)(lags[j] * window[j]) : 0;
+            seg[j].i = 0;
+        }
+        kiss_fft(cfg_out, seg, spectrum);
+        advance_spectrum_bins(spectrum, nfft_out, nimp_pre, fs, 0, nfft_out / 2 + 1);
+    }
+
+    if (cfg_out != cfg_fwd) free(cfg_out);
+    free(cfg_fwd);
+    free(cfg_inv);
+    free(seg);
+    free(taps);
+    free(samples);
+    free(window);
+    free(lags);
+    return ret;
+}
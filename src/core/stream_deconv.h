@@ -0,0 +1,65 @@
+#ifndef STREAM_DECONV_H
+#define STREAM_DECONV_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "config.h"
+#include "kiss_fft.h"
+
+/**
+ * Supplies samples [first, first + count) of a capture as float. The
+ * range always lies within the capture.
+ *
+ * Returns:
+ *   0 on success, -1 on a read error
+ */
+typedef int (*SampleSource)(void *context, int64_t first, int count, float *dst);
+
+/**
+ * Size of the spectrum produced by segmented_linear_ir(): twice the
+ * window length rounded up to a power of two, at most nfft_full.
+ *
+ * Parameters:
+ *   nimp_pre, nimp_post: IR window before/after the linear IR (samples)
+ *   nfft_full: FFT size of the full-length (in-memory) deconvolution
+ */
+int segmented_ir_nfft(int nimp_pre, int nimp_post, int nfft_full);
+
+/**
+ * Approximate peak working memory of segmented_linear_ir() in bytes,
+ * excluding the output spectrum. It depends on the IR window only, not
+ * on the capture length.
+ */
+size_t segmented_ir_memory(int nimp_pre, int nimp_post);
+
+/**
+ * Extracts the windowed linear IR spectrum of a capture by segmented
+ * (overlap-save) deconvolution, reading the capture in blocks.
+ *
+ * The inverse filter is the time-reversed chirp weighted by its
+ * instantaneous frequency (exponential sweeps) and normalized to unit
+ * gain over [f0, f1]; its taps are generated block by block, so neither
+ * the capture nor the filter is ever held at full length. Only the IR
+ * lags [-nimp_pre, nimp_post) are computed. They are windowed and
+ * transformed exactly as extract_linear_ir() does, and scaled like the
+ * unnormalized transforms of the in-memory path of size nfft_full, so
+ * both paths give comparable spectra.
+ *
+ * Parameters:
+ *   spectrum: Output, nfft_out bins
+ *   nfft_out: segmented_ir_nfft(nimp_pre, nimp_post, nfft_full)
+ *   source, context: Capture samples
+ *   chirp: Chirp that excited the capture
+ *   fs: Sample rate (Hz)
+ *   n_samples_chirp: Samples of the capture to deconvolve
+ *   nimp_pre, nimp_post: IR window before/after the linear IR (samples)
+ *   nfft_full: FFT size of the equivalent in-memory deconvolution
+ *
+ * Returns:
+ *   0 on success, -1 on failure
+ */
+int segmented_linear_ir(kiss_fft_cpx *spectrum, int nfft_out, SampleSource source, void *context,
+                        const ChirpParams *chirp, double fs, int n_samples_chirp,
+                        int nimp_pre, int nimp_post, int nfft_full);
+
+#endif
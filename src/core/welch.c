@@ -0,0 +1,166 @@
+#include "welch.h"
+#include "processing.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int welch_init(WelchEstimator *est, int segment, double overlap) {
+    memset(est, 0, sizeof(*est));
+    if (segment < WELCH_MIN_SEGMENT || segment > WELCH_MAX_SEGMENT || (segment & (segment - 1)) != 0) {
+        fprintf(stderr, "Invalid Welch segment %d (a power of two, %d to %d)\n", segment, WELCH_MIN_SEGMENT,
+                WELCH_MAX_SEGMENT);
+        return -1;
+    }
+    if (overlap < 0.0 || overlap > 0.9) {
+        fprintf(stderr, "Invalid Welch overlap %.2f (0 to 0.9)\n", overlap);
+        return -1;
+    }
+    est->segment = segment;
+    est->hop = (int)lround(segment * (1.0 - overlap));
+    if (est->hop < 1) {
+        est->hop = 1;
+    }
+    est->num_bins = segment / 2 + 1;
+    est->cfg = kiss_fft_alloc(segment, 0, NULL, NULL);
+    est->window = (kiss_fft_scalar*)malloc(sizeof(kiss_fft_scalar) * segment);
+    est->x_buf = (float*)malloc(sizeof(float) * segment);
+    est->y_buf = (float*)malloc(sizeof(float) * segment);
+    est->fx = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * segment);
+    est->fy = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * segment);
+    est->sxx = (double*)calloc(est->num_bins, sizeof(double));
+    est->syy = (double*)calloc(est->num_bins, sizeof(double));
+    est->sxy_r = (double*)calloc(est->num_bins, sizeof(double));
+    est->sxy_i = (double*)calloc(est->num_bins, sizeof(double));
+    if (!est->cfg || !est->window || !est->x_buf || !est->y_buf || !est->fx || !est->fy || !est->sxx || !est->syy
+        || !est->sxy_r || !est->sxy_i) {
+        fprintf(stderr, "Failed to allocate Welch estimator\n");
+        welch_free(est);
+        return -1;
+    }
+    /* Periodic Hann: overlapping windows at 50% sum to a constant */
+    for (int i = 0; i < segment; i++) {
+        est->window[i] = (kiss_fft_scalar)(0.5 - 0.5 * cos(2.0 * M_PI * i / segment));
+    }
+    return 0;
+}
+
+void welch_free(WelchEstimator *est) {
+    kiss_fft_free(est->cfg);
+    free(est->window);
+    free(est->x_buf);
+    free(est->y_buf);
+    free(est->fx);
+    free(est->fy);
+    free(est->sxx);
+    free(est->syy);
+    free(est->sxy_r);
+    free(est->sxy_i);
+    memset(est, 0, sizeof(*est));
+}
+
+void welch_reset(WelchEstimator *est) {
+    memset(est->sxx, 0, sizeof(double) * est->num_bins);
+    memset(est->syy, 0, sizeof(double) * est->num_bins);
+    memset(est->sxy_r, 0, sizeof(double) * est->num_bins);
+    memset(est->sxy_i, 0, sizeof(double) * est->num_bins);
+    est->buffered = 0;
+    est->segments = 0;
+}
+
+/* Transforms the full segment in x_buf / y_buf and adds it to the sums */
+static void add_segment(WelchEstimator *est) {
+    for (int i = 0; i < est->segment; i++) {
+        est->fx[i].r = est->x_buf[i] * est->window[i];
+        est->fx[i].i = 0.0f;
+        est->fy[i].r = est->y_buf[i] * est->window[i];
+        est->fy[i].i = 0.0f;
+    }
+    kiss_fft(est->cfg, est->fx, est->fx);
+    kiss_fft(est->cfg, est->fy, est->fy);
+    for (int k = 0; k < est->num_bins; k++) {
+        double xr = est->fx[k].r, xi = est->fx[k].i;
+        double yr = est->fy[k].r, yi = est->fy[k].i;
+        est->sxx[k] += xr * xr + xi * xi;
+        est->syy[k] += yr * yr + yi * yi;
+        est->sxy_r[k] += xr * yr + xi * yi;
+        est->sxy_i[k] += xr * yi - xi * yr;
+    }
+    est->segments++;
+}
+
+void welch_add(WelchEstimator *est, const float *x, const float *y, int count) {
+    while (count > 0) {
+        int n = est->segment - est->buffered < count ? est->segment - est->buffered : count;
+        memcpy(est->x_buf + est->buffered, x, sizeof(float) * n);
+        memcpy(est->y_buf + est->buffered, y, sizeof(float) * n);
+        est->buffered += n;
+        x += n;
+        y += n;
+        count -= n;
+        if (est->buffered < est->segment) {
+            break;
+        }
+        add_segment(est);
+        /* The next segment starts hop samples on; with no overlap nothing is kept */
+        int keep = est->segment - est->hop;
+        if (keep > 0) {
+            memmove(est->x_buf, est->x_buf + est->hop, sizeof(float) * keep);
+            memmove(est->y_buf, est->y_buf + est->hop, sizeof(float) * keep);
+            est->buffered = keep;
+        } else {
+            est->buffered = 0;
+        }
+    }
+}
+
+int welch_add_sources(WelchEstimator *est, SampleSource x, void *x_context, SampleSource y, void *y_context,
+                      int64_t first, int64_t count, int chunk) {
+    float *x_block = (float*)malloc(sizeof(float) * chunk);
+    float *y_block = (float*)malloc(sizeof(float) * chunk);
+    if (!x_block || !y_block) {
+        fprintf(stderr, "Failed to allocate read buffers\n");
+        free(x_block);
+        free(y_block);
+        return -1;
+    }
+    int ret = 0;
+    for (int64_t start = 0; start < count && ret == 0; start += chunk) {
+        int n = count - start < chunk ? (int)(count - start) : chunk;
+        if (x(x_context, first + start, n, x_block) != 0 || y(y_context, first + start, n, y_block) != 0) {
+            fprintf(stderr, "Failed to read capture samples\n");
+            ret = -1;
+            break;
+        }
+        welch_add(est, x_block, y_block, n);
+    }
+    free(x_block);
+    free(y_block);
+    return ret;
+}
+
+int welch_result(const WelchEstimator *est, int first_bin, int num_bins, kiss_fft_cpx *h1, kiss_fft_cpx *h2,
+                 kiss_fft_scalar *coherence) {
+    if (est->segments == 0) {
+        return -1;
+    }
+    for (int j = 0; j < num_bins; j++) {
+        int k = first_bin + j;
+        double sxx = est->sxx[k], syy = est->syy[k];
+        double cr = est->sxy_r[k], ci = est->sxy_i[k];
+        double cross = cr * cr + ci * ci;
+        int valid = sxx > 0.0 && syy > 0.0 && cross > 0.0;
+        if (h1) {
+            h1[j].r = valid ? (kiss_fft_scalar)(cr / sxx) : 0.0f;
+            h1[j].i = valid ? (kiss_fft_scalar)(ci / sxx) : 0.0f;
+        }
+        if (h2) {
+            /* Syy / conj(Sxy) = Syy Sxy / |Sxy|^2 */
+            h2[j].r = valid ? (kiss_fft_scalar)(syy * cr / cross) : 0.0f;
+            h2[j].i = valid ? (kiss_fft_scalar)(syy * ci / cross) : 0.0f;
+        }
+        if (coherence) {
+            coherence[j] = valid ? (kiss_fft_scalar)(cross / (sxx * syy)) : 0.0f;
+        }
+    }
+    return 0;
+}
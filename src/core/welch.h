@@ -0,0 +1,89 @@
+#ifndef WELCH_H
+#define WELCH_H
+
+#include <stdint.h>
+#include "kiss_fft.h"
+#include "stream_deconv.h"
+
+#define WELCH_MIN_SEGMENT 64
+#define WELCH_MAX_SEGMENT 1048576
+#define WELCH_DEFAULT_OVERLAP 0.5   /* Fraction of a segment shared with the next */
+
+/*
+ * Welch-averaged transfer function of two aligned signals, input x and
+ * output y. Both are cut into Hann-windowed segments of one FFT size,
+ * each starting hop samples after the one before, and the auto-spectra
+ * Sxx, Syy and the cross-spectrum Sxy = sum conj(X) Y are summed over the
+ * segments as the samples arrive. Per bin:
+ *
+ *   H1 = Sxy / Sxx          noise on y averages out; noise on x biases it low
+ *   H2 = Syy / conj(Sxy)    noise on x averages out; noise on y biases it high
+ *   coherence = |Sxy|^2 / (Sxx Syy) = H1 / H2, from 0 to 1
+ *
+ * Coherence below 1 means y is not a linear function of x on that bin:
+ * noise, distortion, or a response longer than a segment. Memory is a
+ * few segments' worth, whatever the length of the signals.
+ */
+typedef struct {
+    int segment;             /* Samples per segment and FFT size (power of two) */
+    int hop;                 /* Samples from one segment start to the next */
+    int num_bins;            /* segment / 2 + 1 */
+    int buffered;            /* Samples of the next segment held in x_buf and y_buf */
+    int64_t segments;        /* Segments summed since the last reset */
+    kiss_fft_cfg cfg;
+    kiss_fft_scalar *window; /* Periodic Hann, segment */
+    float *x_buf, *y_buf;    /* Pending samples, segment */
+    kiss_fft_cpx *fx, *fy;   /* FFT work, segment */
+    double *sxx, *syy;       /* Spectral sums, num_bins; in double so long signals keep their precision */
+    double *sxy_r, *sxy_i;
+} WelchEstimator;
+
+/**
+ * Creates an estimator.
+ *
+ * Parameters:
+ *   est: Output estimator (release with welch_free())
+ *   segment: FFT size, a power of two from WELCH_MIN_SEGMENT to WELCH_MAX_SEGMENT
+ *   overlap: Fraction of each segment shared with the next, 0 to 0.9
+ *
+ * Returns:
+ *   0 on success, -1 (with a message) on invalid parameters or allocation failure
+ */
+int welch_init(WelchEstimator *est, int segment, double overlap);
+
+void welch_free(WelchEstimator *est);
+
+/**
+ * Clears the sums and any pending samples.
+ */
+void welch_reset(WelchEstimator *est);
+
+/**
+ * Adds count aligned samples of both signals. Every segment they
+ * complete is transformed and summed; the rest is kept for the next
+ * call, so the signals may arrive in blocks of any size.
+ */
+void welch_add(WelchEstimator *est, const float *x, const float *y, int count);
+
+/**
+ * Streams samples [first, first + count) of two sample sources through
+ * welch_add(), chunk samples at a time.
+ *
+ * Returns:
+ *   0 on success, -1 if a read fails or on allocation failure
+ */
+int welch_add_sources(WelchEstimator *est, SampleSource x, void *x_context, SampleSource y, void *y_context,
+                      int64_t first, int64_t count, int chunk);
+
+/**
+ * H1, H2 and coherence on bins [first_bin, first_bin + num_bins) of the
+ * segments summed so far. Bins where x or y has no energy get H1 = H2 = 0
+ * and coherence 0. Any output may be NULL.
+ *
+ * Returns:
+ *   0 on success, -1 if no segment has been summed
+ */
+int welch_result(const WelchEstimator *est, int first_bin, int num_bins, kiss_fft_cpx *h1, kiss_fft_cpx *h2,
+                 kiss_fft_scalar *coherence);
+
+#endif
@@ -0,0 +1,518 @@
+#include "command_line.h"
+#include "mls.h"
+#include "welch.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CONFIG_LINE_MAX 256
+#define OPTION_NAME_MAX 64
+
+typedef struct {
+    const char *name;
+    const char *alias; /* Legacy config key, or NULL */
+    RunOption option;
+    int is_flag;       /* Takes no value on the command line */
+    const char *help;
+} OptionSpec;
+
+static const OptionSpec OPTION_SPECS[] = {
+    { "mode", NULL, RUN_OPT_MODE, 0, "calibration | measurement | processing | daemon | param_sweep | live | peaks" },
+    { "batch", "non_interactive", RUN_OPT_BATCH, 1, "never prompt or pause (missing required values are errors)" },
+    { "input_device", "input_device_index", RUN_OPT_INPUT_DEVICE, 0, "input device index" },
+    { "output_device", "output_device_index", RUN_OPT_OUTPUT_DEVICE, 0, "output device index" },
+    { "sample_rate", NULL, RUN_OPT_SAMPLE_RATE, 0, "sample rate in Hz (default 44100)" },
+    { "capture_format", NULL, RUN_OPT_CAPTURE_FORMAT, 0, "float32 | int16 | int24 | int32 (default float32)" },
+    { "chirp_duration", "duration", RUN_OPT_CHIRP_DURATION, 0, "chirp duration in seconds" },
+    { "start_freq", NULL, RUN_OPT_START_FREQ, 0, "chirp start frequency in Hz" },
+    { "end_freq", NULL, RUN_OPT_END_FREQ, 0, "chirp end frequency in Hz" },
+    { "chirp_type", NULL, RUN_OPT_CHIRP_TYPE, 0, "linear | exponential | mls (default exponential)" },
+    { "amplitude", NULL, RUN_OPT_AMPLITUDE, 0, "chirp amplitude (default 0.5)" },
+    { "tgap", NULL, RUN_OPT_TGAP, 0, "silence padding in seconds (default 0)" },
+    { "tfade", NULL, RUN_OPT_TFADE, 0, "fade-in/fade-out in seconds (default 0)" },
+    { "sweeps", NULL, RUN_OPT_SWEEPS, 0, "staggered exponential sweeps per take, 1-16 (default 1)" },
+    { "sweep_stagger", NULL, RUN_OPT_SWEEP_STAGGER, 0, "start-to-start spacing of the sweeps in seconds (default: shortest that separates them)" },
+    { "sweep_level_step", NULL, RUN_OPT_SWEEP_LEVEL_STEP, 0, "level of each sweep below the one before in dB (default 0)" },
+    { "mls_order", NULL, RUN_OPT_MLS_ORDER, 0, "mls: period 2^N - 1 samples, 8-20 (default: shortest covering --chirp-duration)" },
+    { "mls_periods", NULL, RUN_OPT_MLS_PERIODS, 0, "mls: periods averaged after one lead-in period, 1-256 (default 4)" },
+    { "recording_duration", NULL, RUN_OPT_RECORDING_DURATION, 0, "recording length in seconds (default chirp + padding + 1 s)" },
+    { "tuner", NULL, RUN_OPT_TUNER, 0, "ask | skip | run, when no saved stream tuning exists" },
+    { "clock_drift", NULL, RUN_OPT_CLOCK_DRIFT, 0, "auto | on | off: fit and resample out clock drift (default auto: split devices)" },
+    { "frf_band", NULL, RUN_OPT_FRF_BAND, 0, "sweep | full (default sweep)" },
+    { "frf_grid", NULL, RUN_OPT_FRF_GRID, 0, "bins | log | linear (default bins)" },
+    { "frf_points", NULL, RUN_OPT_FRF_POINTS, 0, "number of points of a log/linear FRF grid (default 500)" },
+    { "export_csv", "csv", RUN_OPT_EXPORT_CSV, 1, "also write the FRF as CSV" },
+    { "subject", NULL, RUN_OPT_SUBJECT, 0, "subject label of the FRF database entry" },
+    { "session", NULL, RUN_OPT_SESSION, 0, "session label of the FRF database entry" },
+    { "memory_mb", NULL, RUN_OPT_MEMORY_MB, 0, "MiB for full-length deconvolution, else segmented (default 256, 0: no limit)" },
+    { "decimate", NULL, RUN_OPT_DECIMATE, 0, "off | auto | M | L/M: lower the capture rate before processing (default off)" },
+    { "welch_segment", NULL, RUN_OPT_WELCH_SEGMENT, 0, "processing: Welch H1/H2 and coherence segment in samples, a power of two (default 0: off)" },
+    { "welch_overlap", NULL, RUN_OPT_WELCH_OVERLAP, 0, "processing: fraction of each Welch segment shared with the next, 0-0.9 (default 0.5)" },
+    { "peak_smoothing", NULL, RUN_OPT_PEAK_SMOOTHING, 0, "processing, peaks: resonance search smoothing in octaves, 0 for none (default 0.042: 1/24 octave)" },
+    { "peak_prominence", NULL, RUN_OPT_PEAK_PROMINENCE, 0, "processing, peaks: dB a resonance must stand out on both sides (default 3)" },
+    { "socket", NULL, RUN_OPT_SOCKET, 0, "Unix socket of daemon mode (default " DEFAULT_DAEMON_SOCKET ")" },
+    { "param_pre", NULL, RUN_OPT_PARAM_PRE, 0, "param_sweep: IR window before the linear IR in s (list)" },
+    { "param_post", NULL, RUN_OPT_PARAM_POST, 0, "param_sweep: IR window after the linear IR in s (list)" },
+    { "param_fade", NULL, RUN_OPT_PARAM_FADE, 0, "param_sweep: taper fraction of each window side, 0-0.5 (list)" },
+    { "param_epsilon", NULL, RUN_OPT_PARAM_EPSILON, 0, "param_sweep: epsilon transition width in Hz (list)" },
+    { "live_period", NULL, RUN_OPT_LIVE_PERIOD, 0, "live: excitation period in samples, a power of two (default ~0.1 s)" },
+    { "live_excitation", NULL, RUN_OPT_LIVE_EXCITATION, 0, "live: chirp | multisine (default chirp)" },
+    { "live_rate", NULL, RUN_OPT_LIVE_RATE, 0, "live: frames published per second (default 15)" },
+    { "live_smoothing", NULL, RUN_OPT_LIVE_SMOOTHING, 0, "live: averaging time constant in s, 0 for none (default 0.2)" },
+    { "live_duration", NULL, RUN_OPT_LIVE_DURATION, 0, "live: stop after this many seconds (default: Enter or Ctrl-C)" },
+    { "live_file", NULL, RUN_OPT_LIVE_FILE, 0, "live: frame file (default " DEFAULT_LIVE_FRAME_FILE ")" },
+};
+
+#define NUM_OPTION_SPECS ((int)(sizeof(OPTION_SPECS) / sizeof(OPTION_SPECS[0])))
+
+/* Lowercases name and maps '-' to '_' so "--start-freq" matches "start_freq" */
+static void normalize_name(char *dst, const char *src, size_t size) {
+    size_t i = 0;
+    for (; src[i] && i + 1 < size; i++) {
+        char c = src[i];
+        if (c == '-') c = '_';
+        if (c >= 'A' && c <= 'Z') c = (char)(c - 'A' + 'a');
+        dst[i] = c;
+    }
+    dst[i] = '\0';
+}
+
+static const OptionSpec *find_option(const char *name) {
+    char key[OPTION_NAME_MAX];
+    normalize_name(key, name, sizeof(key));
+    for (int i = 0; i < NUM_OPTION_SPECS; i++) {
+        if (strcmp(key, OPTION_SPECS[i].name) == 0
+            || (OPTION_SPECS[i].alias && strcmp(key, OPTION_SPECS[i].alias) == 0)) {
+            return &OPTION_SPECS[i];
+        }
+    }
+    return NULL;
+}
+
+static int parse_number(const char *value, double *out) {
+    char *end;
+    *out = strtod(value, &end);
+    return (end != value && *end == '\0') ? 0 : -1;
+}
+
+/*
+ * Parses a parameter sweep axis: comma-separated values, each a number
+ * or a "first:step:last" range, e.g. "0.05,0.1:0.1:0.4".
+ */
+static int parse_axis(const char *value, ParamSweepAxis *axis) {
+    axis->count = 0;
+    const char *p = value;
+    while (*p) {
+        char *end;
+        double first = strtod(p, &end);
+        if (end == p) return -1;
+        double step = 0.0, last = first;
+        if (*end == ':') {
+            p = end + 1;
+            step = strtod(p, &end);
+            if (end == p || *end != ':' || step <= 0.0) return -1;
+            p = end + 1;
+            last = strtod(p, &end);
+            if (end == p || last < first) return -1;
+        }
+        /* Half a step of slack so "0.1:0.1:0.4" reaches 0.4 */
+        for (double v = first; v <= last + 0.5 * step; v = step > 0.0 ? v + step : last + 1.0) {
+            if (axis->count == PARAM_SWEEP_MAX_VALUES) return -1;
+            axis->values[axis->count++] = (float)v;
+        }
+        if (*end != ',' && *end != '\0') return -1;
+        p = *end == ',' ? end + 1 : end;
+    }
+    return axis->count > 0 ? 0 : -1;
+}
+
+/* Parses a decimation setting: "off", "auto", "M" (by M) or "L/M" (by the rational factor L/M) */
+static int parse_decimation(const char *value, ProcessingOptions *processing) {
+    if (strcmp(value, "off") == 0) {
+        processing->decimate = DECIMATE_OFF;
+        return 0;
+    }
+    if (strcmp(value, "auto") == 0) {
+        processing->decimate = DECIMATE_AUTO;
+        return 0;
+    }
+    char *end;
+    long up = 1, down = strtol(value, &end, 10);
+    if (end != value && *end == '/') {
+        up = down;
+        const char *p = end + 1;
+        down = strtol(p, &end, 10);
+        if (end == p) return -1;
+    }
+    if (end == value || *end != '\0' || up < 1 || up > DECIMATION_MAX_UP || down < up || down > DECIMATION_MAX_DOWN) {
+        return -1;
+    }
+    processing->decimate = down > up ? DECIMATE_FIXED : DECIMATE_OFF;
+    processing->decimate_up = (int)up;
+    processing->decimate_down = (int)down;
+    return 0;
+}
+
+static int parse_flag(const char *value, int *out) {
+    if (strcmp(value, "1") == 0 || strcmp(value, "true") == 0 || strcmp(value, "yes") == 0) {
+        *out = 1;
+    } else if (strcmp(value, "0") == 0 || strcmp(value, "false") == 0 || strcmp(value, "no") == 0) {
+        *out = 0;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+/* Applies one key/value pair; source is used in error messages */
+static int set_option(RunConfig *run, const OptionSpec *spec, const char *value, const char *source) {
+    double number = 0.0;
+    int ok = 0;
+
+    switch (spec->option) {
+        case RUN_OPT_MODE:
+            if (strcmp(value, "calibration") == 0 || strcmp(value, "1") == 0) {
+                run->mode = MODE_CALIBRATION;
+            } else if (strcmp(value, "measurement") == 0 || strcmp(value, "2") == 0) {
+                run->mode = MODE_MEASUREMENT;
+            } else if (strcmp(value, "processing") == 0 || strcmp(value, "3") == 0) {
+                run->mode = MODE_PROCESSING;
+            } else if (strcmp(value, "daemon") == 0 || strcmp(value, "4") == 0) {
+                run->mode = MODE_DAEMON;
+            } else if (strcmp(value, "param_sweep") == 0 || strcmp(value, "param-sweep") == 0
+                       || strcmp(value, "5") == 0) {
+                run->mode = MODE_PARAM_SWEEP;
+            } else if (strcmp(value, "live") == 0 || strcmp(value, "6") == 0) {
+                run->mode = MODE_LIVE;
+            } else if (strcmp(value, "peaks") == 0 || strcmp(value, "7") == 0) {
+                run->mode = MODE_PEAKS;
+            } else {
+                ok = -1;
+            }
+            break;
+        case RUN_OPT_BATCH:
+            ok = parse_flag(value, &run->batch);
+            break;
+        case RUN_OPT_EXPORT_CSV:
+            ok = parse_flag(value, &run->processing.export.export_csv);
+            break;
+        case RUN_OPT_SUBJECT:
+        case RUN_OPT_SESSION:
+            if (strlen(value) >= FRF_DB_NAME_SIZE) {
+                ok = -1;
+            } else {
+                strcpy(spec->option == RUN_OPT_SUBJECT ? run->processing.subject : run->processing.session, value);
+            }
+            break;
+        case RUN_OPT_SOCKET:
+            if (strlen(value) >= DAEMON_SOCKET_PATH_MAX) {
+                ok = -1;
+            } else {
+                strcpy(run->socket_path, value);
+            }
+            break;
+        case RUN_OPT_LIVE_FILE:
+            if (strlen(value) >= LIVE_PATH_MAX) {
+                ok = -1;
+            } else {
+                strcpy(run->live.frame_file, value);
+            }
+            break;
+        case RUN_OPT_LIVE_EXCITATION:
+            if (strcmp(value, "chirp") == 0) {
+                run->live.excitation = LIVE_EXCITATION_CHIRP;
+            } else if (strcmp(value, "multisine") == 0) {
+                run->live.excitation = LIVE_EXCITATION_MULTISINE;
+            } else {
+                ok = -1;
+            }
+            break;
+        case RUN_OPT_PARAM_PRE:
+            ok = parse_axis(value, &run->param_grid.pre_s);
+            break;
+        case RUN_OPT_PARAM_POST:
+            ok = parse_axis(value, &run->param_grid.post_s);
+            break;
+        case RUN_OPT_PARAM_FADE:
+            ok = parse_axis(value, &run->param_grid.fade);
+            break;
+        case RUN_OPT_PARAM_EPSILON:
+            ok = parse_axis(value, &run->param_grid.epsilon_hz);
+            break;
+        case RUN_OPT_CAPTURE_FORMAT:
+            ok = sample_format_from_name(value, &run->capture_format);
+            break;
+        case RUN_OPT_CHIRP_TYPE:
+            if (strcmp(value, "linear") == 0 || strcmp(value, "l") == 0) {
+                run->chirp.type = 0;
+            } else if (strcmp(value, "exponential") == 0 || strcmp(value, "e") == 0) {
+                run->chirp.type = 1;
+            } else if (strcmp(value, "mls") == 0 || strcmp(value, "m") == 0) {
+                run->chirp.type = MLS_CHIRP_TYPE;
+            } else {
+                ok = -1;
+            }
+            break;
+        case RUN_OPT_TUNER:
+            if (strcmp(value, "ask") == 0) {
+                run->tuner = TUNER_ASK;
+            } else if (strcmp(value, "skip") == 0) {
+                run->tuner = TUNER_SKIP;
+            } else if (strcmp(value, "run") == 0) {
+                run->tuner = TUNER_RUN;
+            } else {
+                ok = -1;
+            }
+            break;
+        case RUN_OPT_CLOCK_DRIFT:
+            if (strcmp(value, "auto") == 0) {
+                run->clock_drift = DRIFT_AUTO;
+            } else if (strcmp(value, "on") == 0) {
+                run->clock_drift = DRIFT_ON;
+            } else if (strcmp(value, "off") == 0) {
+                run->clock_drift = DRIFT_OFF;
+            } else {
+                ok = -1;
+            }
+            break;
+        case RUN_OPT_DECIMATE:
+            ok = parse_decimation(value, &run->processing);
+            break;
+        case RUN_OPT_FRF_BAND:
+            if (strcmp(value, "sweep") == 0) {
+                run->processing.export.band_limited = 1;
+            } else if (strcmp(value, "full") == 0) {
+                run->processing.export.band_limited = 0;
+            } else {
+                ok = -1;
+            }
+            break;
+        case RUN_OPT_FRF_GRID:
+            if (strcmp(value, "bins") == 0) {
+                run->processing.export.num_points = 0;
+            } else if (strcmp(value, "log") == 0) {
+                run->processing.export.grid_type = FRF_GRID_LOG;
+                if (run->processing.export.num_points == 0) run->processing.export.num_points = DEFAULT_FRF_GRID_POINTS;
+            } else if (strcmp(value, "linear") == 0) {
+                run->processing.export.grid_type = FRF_GRID_LINEAR;
+                if (run->processing.export.num_points == 0) run->processing.export.num_points = DEFAULT_FRF_GRID_POINTS;
+            } else {
+                ok = -1;
+            }
+            break;
+        default:
+            /* Numeric settings */
+            ok = parse_number(value, &number);
+            if (ok != 0) break;
+            switch (spec->option) {
+                case RUN_OPT_INPUT_DEVICE: run->input_device = (PaDeviceIndex)number; break;
+                case RUN_OPT_OUTPUT_DEVICE: run->output_device = (PaDeviceIndex)number; break;
+                case RUN_OPT_SAMPLE_RATE: run->sample_rate = number; ok = number > 0 ? 0 : -1; break;
+                case RUN_OPT_CHIRP_DURATION: run->chirp.duration = (float)number; break;
+                case RUN_OPT_START_FREQ: run->chirp.start_freq = (float)number; break;
+                case RUN_OPT_END_FREQ: run->chirp.end_freq = (float)number; break;
+                case RUN_OPT_AMPLITUDE: run->chirp.amplitude = (float)number; break;
+                case RUN_OPT_TGAP: run->chirp.Tgap = (float)number; break;
+                case RUN_OPT_TFADE: run->chirp.Tfade = (float)number; break;
+                case RUN_OPT_SWEEPS: run->chirp.num_sweeps = (int)number; ok = number >= 1 && number == (int)number ? 0 : -1; break;
+                case RUN_OPT_SWEEP_STAGGER: run->chirp.sweep_stagger = (float)number; ok = number > 0 ? 0 : -1; break;
+                case RUN_OPT_SWEEP_LEVEL_STEP: run->chirp.sweep_level_step = (float)number; ok = number >= 0 ? 0 : -1; break;
+                case RUN_OPT_MLS_ORDER:
+                    run->chirp.mls_order = (int)number;
+                    ok = number >= MLS_MIN_ORDER && number <= MLS_MAX_ORDER && number == (int)number ? 0 : -1;
+                    break;
+                case RUN_OPT_MLS_PERIODS:
+                    run->chirp.mls_periods = (int)number;
+                    ok = number >= 1 && number <= MLS_MAX_PERIODS && number == (int)number ? 0 : -1;
+                    break;
+                case RUN_OPT_RECORDING_DURATION: run->recording_duration = (float)number; break;
+                case RUN_OPT_MEMORY_MB: run->processing.memory_budget = (size_t)(number * 1048576.0); ok = number >= 0 ? 0 : -1; break;
+                case RUN_OPT_WELCH_SEGMENT:
+                    run->processing.welch_segment = (int)number;
+                    ok = number == 0 || (number >= WELCH_MIN_SEGMENT && number <= WELCH_MAX_SEGMENT
+                                         && number == (int)number && ((int)number & ((int)number - 1)) == 0) ? 0 : -1;
+                    break;
+                case RUN_OPT_WELCH_OVERLAP: run->processing.welch_overlap = number; ok = number >= 0 && number <= 0.9 ? 0 : -1; break;
+                case RUN_OPT_PEAK_SMOOTHING: run->processing.peaks.smoothing_octaves = number; ok = number >= 0 ? 0 : -1; break;
+                case RUN_OPT_PEAK_PROMINENCE: run->processing.peaks.prominence_db = number; ok = number >= 0 ? 0 : -1; break;
+                case RUN_OPT_FRF_POINTS: run->processing.export.num_points = (int)number; ok = number >= 2 ? 0 : -1; break;
+                case RUN_OPT_LIVE_PERIOD:
+                    run->live.period = (int)number;
+                    ok = number >= LIVE_MIN_PERIOD && number <= LIVE_MAX_PERIOD && number == (int)number
+                         && ((int)number & ((int)number - 1)) == 0 ? 0 : -1;
+                    break;
+                case RUN_OPT_LIVE_RATE: run->live.frame_rate = number; ok = number > 0 ? 0 : -1; break;
+                case RUN_OPT_LIVE_SMOOTHING: run->live.smoothing_s = number; ok = number >= 0 ? 0 : -1; break;
+                case RUN_OPT_LIVE_DURATION: run->live.duration_s = number; ok = number >= 0 ? 0 : -1; break;
+                default: ok = -1; break;
+            }
+            break;
+    }
+
+    if (ok != 0) {
+        fprintf(stderr, "%s: invalid value '%s' for '%s'\n", source, value, spec->name);
+        return -1;
+    }
+    run->set |= 1ULL << spec->option;
+    return 0;
+}
+
+/* Reads key=value lines; a missing file is only an error if it was named explicitly */
+static int load_config_file(RunConfig *run, const char *filename, int required) {
+    FILE *file = fopen(filename, "r");
+    if (!file) {
+        if (required) {
+            fprintf(stderr, "Failed to open config file '%s'\n", filename);
+            return -1;
+        }
+        return 0;
+    }
+
+    char line[CONFIG_LINE_MAX];
+    int line_number = 0;
+    int ret = 0;
+    while (ret == 0 && fgets(line, sizeof(line), file)) {
+        line_number++;
+        line[strcspn(line, "\r\n#")] = '\0';
+
+        char *key = line;
+        while (*key == ' ' || *key == '\t') key++;
+        if (*key == '\0') continue;
+
+        char *eq = strchr(key, '=');
+        if (!eq) {
+            fprintf(stderr, "%s:%d: expected key=value\n", filename, line_number);
+            ret = -1;
+            break;
+        }
+        *eq = '\0';
+        char *value = eq + 1;
+        while (*value == ' ' || *value == '\t') value++;
+        for (char *p = eq - 1; p >= key && (*p == ' ' || *p == '\t'); p--) *p = '\0';
+        for (char *p = value + strlen(value) - 1; p >= value && (*p == ' ' || *p == '\t'); p--) *p = '\0';
+
+        const OptionSpec *spec = find_option(key);
+        if (!spec) {
+            fprintf(stderr, "%s:%d: unknown key '%s'\n", filename, line_number, key);
+            ret = -1;
+            break;
+        }
+
+        char source[CONFIG_LINE_MAX];
+        snprintf(source, sizeof(source), "%s:%d", filename, line_number);
+        ret = set_option(run, spec, value, source);
+    }
+    fclose(file);
+
+    if (ret == 0) {
+        printf("Loaded configuration from '%s'\n", filename);
+    }
+    return ret;
+}
+
+static void run_config_defaults(RunConfig *run) {
+    memset(run, 0, sizeof(*run));
+    run->input_device = paNoDevice;
+    run->output_device = paNoDevice;
+    run->sample_rate = DEFAULT_SAMPLE_RATE;
+    run->capture_format = SAMPLE_FORMAT_FLOAT32;
+    run->chirp.type = 1;
+    run->chirp.amplitude = 0.5f;
+    run->tuner = TUNER_ASK;
+    run->clock_drift = DRIFT_AUTO;
+    run->processing.export.band_limited = 1;
+    run->processing.export.grid_type = FRF_GRID_LOG;
+    run->processing.memory_budget = (size_t)DEFAULT_PROCESSING_MEMORY_MB << 20;
+    run->processing.welch_overlap = WELCH_DEFAULT_OVERLAP;
+    run->processing.peaks.smoothing_octaves = FRF_PEAKS_DEFAULT_SMOOTHING;
+    run->processing.peaks.prominence_db = FRF_PEAKS_DEFAULT_PROMINENCE;
+    snprintf(run->socket_path, sizeof(run->socket_path), "%s", DEFAULT_DAEMON_SOCKET);
+    run->live.excitation = LIVE_EXCITATION_CHIRP;
+    run->live.frame_rate = LIVE_DEFAULT_FRAME_RATE;
+    run->live.smoothing_s = LIVE_DEFAULT_SMOOTHING_S;
+    snprintf(run->live.frame_file, sizeof(run->live.frame_file), "%s", DEFAULT_LIVE_FRAME_FILE);
+}
+
+int run_config_load(RunConfig *run, int argc, char **argv) {
+    run_config_defaults(run);
+
+    /* The config file comes first so the command line can override it */
+    const char *config_file = DEFAULT_CONFIG_FILE;
+    int config_required = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0) {
+            run_config_print_usage(argv[0]);
+            return 1;
+        }
+        if (strcmp(argv[i], "--config") == 0 && i + 1 < argc) {
+            config_file = argv[++i];
+            config_required = 1;
+        } else if (strncmp(argv[i], "--config=", 9) == 0) {
+            config_file = argv[i] + 9;
+            config_required = 1;
+        }
+    }
+    if (load_config_file(run, config_file, config_required) != 0) {
+        return -1;
+    }
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        if (strncmp(arg, "--", 2) != 0) {
+            fprintf(stderr, "Unexpected argument '%s' (see --help)\n", arg);
+            return -1;
+        }
+        if (strcmp(arg, "--config") == 0) {
+            i++;
+            continue;
+        }
+        if (strncmp(arg, "--config=", 9) == 0) {
+            continue;
+        }
+
+        char name[OPTION_NAME_MAX];
+        const char *value = NULL;
+        const char *eq = strchr(arg, '=');
+        size_t name_len = eq ? (size_t)(eq - arg - 2) : strlen(arg + 2);
+        if (name_len >= sizeof(name)) name_len = sizeof(name) - 1;
+        memcpy(name, arg + 2, name_len);
+        name[name_len] = '\0';
+
+        const OptionSpec *spec = find_option(name);
+        if (!spec) {
+            fprintf(stderr, "Unknown option '%s' (see --help)\n", arg);
+            return -1;
+        }
+
+        if (eq) {
+            value = eq + 1;
+        } else if (spec->is_flag) {
+            value = "1";
+        } else if (i + 1 < argc) {
+            value = argv[++i];
+        } else {
+            fprintf(stderr, "Option '%s' needs a value\n", arg);
+            return -1;
+        }
+
+        if (set_option(run, spec, value, "command line") != 0) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int run_config_has(const RunConfig *run, RunOption option) {
+    return (run->set & (1ULL << option)) != 0;
+}
+
+void run_config_print_usage(const char *program) {
+    printf("Usage: %s [--config FILE] [--key value | --key=value]...\n\n", program);
+    printf("Settings are read from %s (or --config FILE) as key=value lines,\n", DEFAULT_CONFIG_FILE);
+    printf("then overridden by command-line options. Anything not given is prompted for,\n");
+    printf("unless --batch is set.\n\n");
+    for (int i = 0; i < NUM_OPTION_SPECS; i++) {
+        printf("  --%-20s %s\n", OPTION_SPECS[i].name, OPTION_SPECS[i].help);
+    }
+}
@@ -0,0 +1,112 @@
+#ifndef COMMAND_LINE_H
+#define COMMAND_LINE_H
+
+#include "config.h"
+#include "pipeline.h"
+#include "daemon.h"
+#include "live.h"
+
+#define DEFAULT_CONFIG_FILE "src/config/audio_config.txt"
+#define DEFAULT_RECORD_MARGIN_S 1.0 /* Batch recording length beyond the chirp and its padding */
+#define DEFAULT_FRF_GRID_POINTS 500 /* Points of a log/linear FRF grid when --frf-points is not given */
+
+/* Settings that can come from the command line or the config file */
+typedef enum {
+    RUN_OPT_MODE,
+    RUN_OPT_BATCH,
+    RUN_OPT_INPUT_DEVICE,
+    RUN_OPT_OUTPUT_DEVICE,
+    RUN_OPT_SAMPLE_RATE,
+    RUN_OPT_CAPTURE_FORMAT,
+    RUN_OPT_CHIRP_DURATION,
+    RUN_OPT_START_FREQ,
+    RUN_OPT_END_FREQ,
+    RUN_OPT_CHIRP_TYPE,
+    RUN_OPT_AMPLITUDE,
+    RUN_OPT_TGAP,
+    RUN_OPT_TFADE,
+    RUN_OPT_SWEEPS,
+    RUN_OPT_SWEEP_STAGGER,
+    RUN_OPT_SWEEP_LEVEL_STEP,
+    RUN_OPT_MLS_ORDER,
+    RUN_OPT_MLS_PERIODS,
+    RUN_OPT_RECORDING_DURATION,
+    RUN_OPT_TUNER,
+    RUN_OPT_CLOCK_DRIFT,
+    RUN_OPT_FRF_BAND,
+    RUN_OPT_FRF_GRID,
+    RUN_OPT_FRF_POINTS,
+    RUN_OPT_EXPORT_CSV,
+    RUN_OPT_SUBJECT,
+    RUN_OPT_SESSION,
+    RUN_OPT_MEMORY_MB,
+    RUN_OPT_DECIMATE,
+    RUN_OPT_WELCH_SEGMENT,
+    RUN_OPT_WELCH_OVERLAP,
+    RUN_OPT_PEAK_SMOOTHING,
+    RUN_OPT_PEAK_PROMINENCE,
+    RUN_OPT_SOCKET,
+    RUN_OPT_PARAM_PRE,
+    RUN_OPT_PARAM_POST,
+    RUN_OPT_PARAM_FADE,
+    RUN_OPT_PARAM_EPSILON,
+    RUN_OPT_LIVE_PERIOD,
+    RUN_OPT_LIVE_EXCITATION,
+    RUN_OPT_LIVE_RATE,
+    RUN_OPT_LIVE_SMOOTHING,
+    RUN_OPT_LIVE_DURATION,
+    RUN_OPT_LIVE_FILE,
+    NUM_RUN_OPTS
+} RunOption;
+
+/**
+ * Everything a run needs. Values not given on the command line or in
+ * the config file are prompted for in interactive runs; batch runs use
+ * defaults where one exists and fail otherwise.
+ */
+typedef struct {
+    unsigned long long set;   /* Bit (1 << RunOption) for every value given */
+    int batch;                /* 1: never prompt or pause */
+    int mode;                 /* ProcessingMode */
+    PaDeviceIndex input_device;
+    PaDeviceIndex output_device;
+    double sample_rate;
+    SampleFormat capture_format;
+    ChirpParams chirp;
+    float recording_duration;
+    TunerPolicy tuner;
+    DriftPolicy clock_drift;
+    ProcessingOptions processing;
+    char socket_path[DAEMON_SOCKET_PATH_MAX]; /* Daemon mode */
+    ParamSweepGrid param_grid;                /* Parameter sweep mode */
+    LiveOptions live;                         /* Live mode */
+} RunConfig;
+
+/**
+ * Fills a RunConfig from the config file and the command line.
+ * The config file (DEFAULT_CONFIG_FILE, or --config FILE) is read
+ * first; command-line options override it. Both use the same keys:
+ * "key=value" lines in the file (blank lines and '#' comments ignored),
+ * "--key value" or "--key=value" on the command line, with '-' and '_'
+ * interchangeable.
+ *
+ * Parameters:
+ *   run: Output configuration
+ *   argc, argv: Program arguments
+ *
+ * Returns:
+ *   0 to proceed, 1 if --help was printed, -1 on invalid input
+ */
+int run_config_load(RunConfig *run, int argc, char **argv);
+
+/**
+ * Tells whether a setting was given on the command line or in the file.
+ */
+int run_config_has(const RunConfig *run, RunOption option);
+
+/**
+ * Prints the supported options and config keys.
+ */
+void run_config_print_usage(const char *program);
+
+#endif
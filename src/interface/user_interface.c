@@ -1,73 +1,209 @@
 #include "user_interface.h"
 #include "audio_io.h"
+#include "mls.h"
 #include <stdio.h>
 #include <stdlib.h>
 
+static int validate_input_device(PaDeviceIndex device, int num_devices) {
+    if (device < 0 || device >= num_devices) {
+        fprintf(stderr, "Invalid input device index\n");
+        return -1;
+    }
+
+    const PaDeviceInfo *input_info = audio_get_device_info(device);
+    if (!input_info || input_info->maxInputChannels < NUM_CHANNELS) {
+        fprintf(stderr, "Selected input device does not support %d channel(s)\n", NUM_CHANNELS);
+        return -1;
+    }
+    return 0;
+}
+
+static int validate_output_device(PaDeviceIndex device, int num_devices) {
+    if (device < 0 || device >= num_devices) {
+        fprintf(stderr, "Invalid output device index\n");
+        return -1;
+    }
+
+    const PaDeviceInfo *output_info = audio_get_device_info(device);
+    if (!output_info || output_info->maxOutputChannels < NUM_CHANNELS) {
+        fprintf(stderr, "Selected output device does not support %d channel(s)\n", NUM_CHANNELS);
+        return -1;
+    }
+    return 0;
+}
+
 int select_audio_devices(AudioConfig *audio_cfg, int num_devices) {
     printf("\n--- Audio Device Selection ---\n");
     
     printf("Enter input device index: ");
     scanf("%d", &audio_cfg->input_device);
+    if (validate_input_device(audio_cfg->input_device, num_devices) != 0) {
+        return -1;
+    }
     
-    if (audio_cfg->input_device < 0 || audio_cfg->input_device >= num_devices) {
-        fprintf(stderr, "Invalid input device index\n");
+    printf("Enter output device index: ");
+    scanf("%d", &audio_cfg->output_device);
+    if (validate_output_device(audio_cfg->output_device, num_devices) != 0) {
         return -1;
     }
+    
+    return 0;
+}
 
-    const PaDeviceInfo *input_info = audio_get_device_info(audio_cfg->input_device);
-    if (!input_info || input_info->maxInputChannels < NUM_CHANNELS) {
-        fprintf(stderr, "Selected input device does not support %d channel(s)\n", NUM_CHANNELS);
+int validate_audio_config(const AudioConfig *audio_cfg, int num_devices) {
+    if (validate_input_device(audio_cfg->input_device, num_devices) != 0
+        || validate_output_device(audio_cfg->output_device, num_devices) != 0) {
         return -1;
     }
     
-    printf("Enter output device index: ");
-    scanf("%d", &audio_cfg->output_device);
+    if (!audio_is_sample_rate_supported(audio_cfg->input_device, audio_cfg->output_device,
+                                        audio_cfg->sample_rate, NUM_CHANNELS)) {
+        fprintf(stderr, "Selected devices do not support %.0f Hz\n", audio_cfg->sample_rate);
+        return -1;
+    }
     
-    if (audio_cfg->output_device < 0 || audio_cfg->output_device >= num_devices) {
-        fprintf(stderr, "Invalid output device index\n");
+    if (!audio_is_capture_format_supported(audio_cfg->input_device, audio_cfg->sample_rate,
+                                           audio_cfg->capture_format, NUM_CHANNELS)) {
+        fprintf(stderr, "Input device does not support %s capture at %.0f Hz\n",
+                sample_format_name(audio_cfg->capture_format), audio_cfg->sample_rate);
         return -1;
     }
+    
+    return 0;
+}
 
-    const PaDeviceInfo *output_info = audio_get_device_info(audio_cfg->output_device);
-    if (!output_info || output_info->maxOutputChannels < NUM_CHANNELS) {
-        fprintf(stderr, "Selected output device does not support %d channel(s)\n", NUM_CHANNELS);
+int select_sample_rate(AudioConfig *audio_cfg) {
+    const double rates[NUM_STANDARD_SAMPLE_RATES] = STANDARD_SAMPLE_RATES;
+    int supported[NUM_STANDARD_SAMPLE_RATES];
+    int num_supported = 0;
+
+    printf("\n--- Sample Rate Selection ---\n");
+    for (int i = 0; i < NUM_STANDARD_SAMPLE_RATES; i++) {
+        supported[i] = audio_is_sample_rate_supported(audio_cfg->input_device, audio_cfg->output_device,
+                                                      rates[i], NUM_CHANNELS);
+        if (supported[i]) {
+            printf("%d. %.0f Hz\n", i + 1, rates[i]);
+            num_supported++;
+        }
+    }
+
+    if (num_supported == 0) {
+        fprintf(stderr, "Selected devices share no standard sample rate\n");
+        return -1;
+    }
+
+    printf("Enter choice: ");
+    int choice;
+    scanf("%d", &choice);
+
+    if (choice < 1 || choice > NUM_STANDARD_SAMPLE_RATES || !supported[choice - 1]) {
+        fprintf(stderr, "Invalid or unsupported sample rate choice\n");
+        return -1;
+    }
+
+    audio_cfg->sample_rate = rates[choice - 1];
+    return 0;
+}
+
+int select_capture_format(AudioConfig *audio_cfg) {
+    int supported[NUM_SAMPLE_FORMATS];
+    int num_supported = 0;
+
+    printf("\n--- Capture Format Selection ---\n");
+    for (int i = 0; i < NUM_SAMPLE_FORMATS; i++) {
+        supported[i] = audio_is_capture_format_supported(audio_cfg->input_device, audio_cfg->sample_rate,
+                                                         (SampleFormat)i, NUM_CHANNELS);
+        if (supported[i]) {
+            printf("%d. %s (%d bytes/sample)\n", i + 1, sample_format_name((SampleFormat)i),
+                   sample_format_bytes((SampleFormat)i));
+            num_supported++;
+        }
+    }
+
+    if (num_supported == 0) {
+        fprintf(stderr, "Input device supports no capture format at %.0f Hz\n", audio_cfg->sample_rate);
+        return -1;
+    }
+
+    printf("Enter choice: ");
+    int choice;
+    scanf("%d", &choice);
+
+    if (choice < 1 || choice > NUM_SAMPLE_FORMATS || !supported[choice - 1]) {
+        fprintf(stderr, "Invalid or unsupported capture format choice\n");
+        return -1;
+    }
+
+    audio_cfg->capture_format = (SampleFormat)(choice - 1);
+    return 0;
+}
+
+int prompt_run_tuner(void) {
+    printf("\nNo saved stream tuning for this device pair and sample rate.\n");
+    printf("Run the buffer/latency tuner now (about 10 s of silent takes)? (y/n): ");
+    char choice;
+    scanf(" %c", &choice);
+    
+    return choice == 'y' || choice == 'Y';
+}
+
+int select_frf_export(FrfExportOptions *export) {
+    printf("\n--- FRF Output ---\n");
+    printf("1. Sweep band only, FFT bins (default)\n");
+    printf("2. Sweep band, resampled onto a log grid\n");
+    printf("3. Sweep band, resampled onto a linear grid\n");
+    printf("4. Full spectrum, FFT bins\n");
+    printf("Enter choice (1-4): ");
+    
+    int choice;
+    scanf("%d", &choice);
+    if (choice < 1 || choice > 4) {
+        fprintf(stderr, "Invalid FRF output choice\n");
         return -1;
     }
     
+    export->band_limited = choice != 4;
+    export->grid_type = (choice == 2) ? FRF_GRID_LOG : FRF_GRID_LINEAR;
+    export->num_points = 0;
+    
+    if (choice == 2 || choice == 3) {
+        printf("Enter number of grid points: ");
+        scanf("%d", &export->num_points);
+        if (export->num_points < 2) {
+            fprintf(stderr, "Invalid number of grid points\n");
+            return -1;
+        }
+    }
+    
+    printf("Also export the FRF as CSV? (y/n): ");
+    char csv;
+    scanf(" %c", &csv);
+    export->export_csv = csv == 'y' || csv == 'Y';
+    
     return 0;
 }
 
-int get_chirp_parameters(ChirpParams *chirp_params) {
+int get_chirp_parameters(ChirpParams *chirp_params, double sample_rate) {
     printf("\n--- Chirp Parameters ---\n");
     
     printf("Enter chirp duration in seconds: ");
     scanf("%f", &chirp_params->duration);
-    if (chirp_params->duration <= 0) {
-        fprintf(stderr, "Invalid chirp duration\n");
-        return -1;
-    }
     
     printf("Enter chirp start frequency (Hz): ");
     scanf("%f", &chirp_params->start_freq);
-    if (chirp_params->start_freq <= 0 || chirp_params->start_freq >= SAMPLE_RATE / 2) {
-        fprintf(stderr, "Invalid chirp start frequency\n");
-        return -1;
-    }
     
     printf("Enter chirp end frequency (Hz): ");
     scanf("%f", &chirp_params->end_freq);
-    if (chirp_params->end_freq <= 0 || chirp_params->end_freq >= SAMPLE_RATE / 2) {
-        fprintf(stderr, "Invalid chirp end frequency\n");
-        return -1;
-    }
     
-    printf("Enter chirp type (linear: l, exponential: e): ");
+    printf("Enter chirp type (linear: l, exponential: e, maximum-length sequence: m): ");
     char chirp_type;
     scanf(" %c", &chirp_type);
     if (chirp_type == 'e') {
         chirp_params->type = 1;
     } else if (chirp_type == 'l') {
         chirp_params->type = 0;
+    } else if (chirp_type == 'm') {
+        chirp_params->type = MLS_CHIRP_TYPE; /* The duration is the shortest period; see mls_check() */
     } else {
         fprintf(stderr, "Invalid chirp type\n");
         return -1;
@@ -75,20 +211,39 @@ int get_chirp_parameters(ChirpParams *chirp_params) {
     
     printf("Enter chirp amplitude: ");
     scanf("%f", &chirp_params->amplitude);
+    
+    printf("Enter silence padding duration in seconds (Tgap): ");
+    scanf("%f", &chirp_params->Tgap);
+    
+    printf("Enter fade-in/fade-out duration in seconds (Tfade): ");
+    scanf("%f", &chirp_params->Tfade);
+    
+    return validate_chirp_parameters(chirp_params, sample_rate);
+}
+
+int validate_chirp_parameters(const ChirpParams *chirp_params, double sample_rate) {
+    /* An MLS order gives the period, so the duration may be left out */
+    int has_order = chirp_params->type == MLS_CHIRP_TYPE && chirp_params->mls_order > 0;
+    if (chirp_params->duration <= 0 && !has_order) {
+        fprintf(stderr, "Invalid chirp duration\n");
+        return -1;
+    }
+    if (chirp_params->start_freq <= 0 || chirp_params->start_freq >= sample_rate / 2) {
+        fprintf(stderr, "Invalid chirp start frequency\n");
+        return -1;
+    }
+    if (chirp_params->end_freq <= 0 || chirp_params->end_freq >= sample_rate / 2) {
+        fprintf(stderr, "Invalid chirp end frequency\n");
+        return -1;
+    }
     if (chirp_params->amplitude < 0.0f) {
         fprintf(stderr, "Invalid chirp amplitude\n");
         return -1;
     }
-    
-    printf("Enter silence padding duration in seconds (Tgap): ");
-    scanf("%f", &chirp_params->Tgap);
     if (chirp_params->Tgap < 0.0f) {
         fprintf(stderr, "Invalid silence padding duration\n");
         return -1;
     }
-    
-    printf("Enter fade-in/fade-out duration in seconds (Tfade): ");
-    scanf("%f", &chirp_params->Tfade);
     if (chirp_params->Tfade < 0.0f) {
         fprintf(stderr, "Invalid fade duration\n");
         return -1;
@@ -97,13 +252,13 @@ int get_chirp_parameters(ChirpParams *chirp_params) {
     return 0;
 }
 
-int confirm_and_preview(PaDeviceIndex output_device, const float *chirp_buffer, int n_samples) {
+int confirm_and_preview(PaDeviceIndex output_device, double sample_rate, const float *chirp_buffer, int n_samples) {
     printf("Chirp preview? (y/n): ");
     char preview_choice;
     scanf(" %c", &preview_choice);
     
     if (preview_choice == 'y' || preview_choice == 'Y') {
-        if (audio_play(output_device, SAMPLE_RATE, chirp_buffer, n_samples, NUM_CHANNELS) != 0) {
+        if (audio_play(output_device, sample_rate, chirp_buffer, n_samples, NUM_CHANNELS) != 0) {
             fprintf(stderr, "Failed to play chirp preview\n");
             return -1;
         }
@@ -2,6 +2,7 @@
 #define USER_INTERFACE_H
 
 #include "config.h"
+#include "frf_io.h"
 
 /**
  * Prompts user to select input and output devices.
@@ -16,29 +17,104 @@
 int select_audio_devices(AudioConfig *audio_cfg, int num_devices);
 
 /**
- * Prompts user for all chirp parameters.
- * Validates all inputs before storing.
+ * Checks settings given without prompting (command line or config file):
+ * both device indices, the sample rate on both devices and the capture
+ * format on the input device.
+ * 
+ * Parameters:
+ *   audio_cfg: Devices, sample rate and capture format to check
+ *   num_devices: Number of available devices
+ * 
+ * Returns:
+ *   0 if usable, -1 otherwise (reason printed to stderr)
+ */
+int validate_audio_config(const AudioConfig *audio_cfg, int num_devices);
+
+/**
+ * Prompts user to select the sample rate among the standard rates
+ * supported by both selected devices.
+ * 
+ * Parameters:
+ *   audio_cfg: Config with selected devices; sample_rate is written on success
+ * 
+ * Returns:
+ *   0 on success, -1 on invalid or unsupported selection
+ */
+int select_sample_rate(AudioConfig *audio_cfg);
+
+/**
+ * Prompts user to select the native capture format (float32, int16,
+ * int24, int32) among those the input device supports at the selected
+ * sample rate. Integer captures are stored as-is with a scale factor.
+ * 
+ * Parameters:
+ *   audio_cfg: Config with selected devices and sample rate;
+ *              capture_format is written on success
+ * 
+ * Returns:
+ *   0 on success, -1 on invalid or unsupported selection
+ */
+int select_capture_format(AudioConfig *audio_cfg);
+
+/**
+ * Asks whether to run the stream buffer/latency tuner for a device pair
+ * that has no saved tuning.
+ * 
+ * Returns:
+ *   1 if the user wants to tune now, 0 otherwise
+ */
+int prompt_run_tuner(void);
+
+/**
+ * Prompts for the FRF output: full spectrum or sweep band, optional
+ * resampling onto a linear or log grid, and CSV export.
+ * 
+ * Parameters:
+ *   export: Output options to fill
+ * 
+ * Returns:
+ *   0 on success, -1 on invalid input
+ */
+int select_frf_export(FrfExportOptions *export);
+
+/**
+ * Prompts user for all chirp parameters, then validates them.
  * 
  * Parameters:
  *   chirp_params: Output struct to store parameters
+ *   sample_rate: Sampling rate in Hz (frequencies must stay below Nyquist)
  * 
  * Returns:
  *   0 on success, -1 on invalid input
  */
-int get_chirp_parameters(ChirpParams *chirp_params);
+int get_chirp_parameters(ChirpParams *chirp_params, double sample_rate);
+
+/**
+ * Validates chirp parameters: positive duration, frequencies between 0
+ * and Nyquist, non-negative amplitude, padding and fade.
+ * 
+ * Parameters:
+ *   chirp_params: Parameters to check
+ *   sample_rate: Sampling rate in Hz
+ * 
+ * Returns:
+ *   0 if valid, -1 otherwise (reason printed to stderr)
+ */
+int validate_chirp_parameters(const ChirpParams *chirp_params, double sample_rate);
 
 /**
  * Offers preview of the generated chirp.
  * 
  * Parameters:
  *   output_device: Device index for playback
+ *   sample_rate: Sampling rate in Hz
  *   chirp_buffer: Audio buffer to preview
  *   n_samples: Number of samples
  * 
  * Returns:
  *   0 on success, -1 on failure
  */
-int confirm_and_preview(PaDeviceIndex output_device, const float *chirp_buffer, int n_samples);
+int confirm_and_preview(PaDeviceIndex output_device, double sample_rate, const float *chirp_buffer, int n_samples);
 
 /**
  * Prompts user to confirm readiness and waits for Enter.
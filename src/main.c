@@ -1,19 +1,25 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "audio_io.h"
 #include "config.h"
 #include "user_interface.h"
+#include "command_line.h"
 #include "pipeline.h"
+#include "daemon.h"
+#include "multi_sweep.h"
+#include "mls.h"
 
-int main() {
+/* Initializes audio and picks the devices; on failure audio is terminated again */
+static int open_audio_devices(const RunConfig *run, AudioConfig *audio_cfg, int *num_devices_out) {
     /* Initialize audio system */
     if (audio_init() != 0) {
         fprintf(stderr, "Failed to initialize audio system\n");
         return -1;
     }
     printf("Audio system initialized successfully.\n");
-    
+
     /* List and select devices */
     int num_devices = audio_list_devices();
     if (num_devices <= 0) {
@@ -21,62 +27,203 @@ int main() {
         audio_terminate();
         return -1;
     }
-    
+
+    memset(audio_cfg, 0, sizeof(*audio_cfg));
+    audio_cfg->interactive = !run->batch;
+    audio_cfg->clock_drift = run->clock_drift;
+
+    int has_devices = run_config_has(run, RUN_OPT_INPUT_DEVICE) && run_config_has(run, RUN_OPT_OUTPUT_DEVICE);
+    if (has_devices) {
+        audio_cfg->input_device = run->input_device;
+        audio_cfg->output_device = run->output_device;
+    } else if (run->batch) {
+        fprintf(stderr, "Batch runs need --input-device and --output-device (or config file entries)\n");
+        audio_terminate();
+        return -1;
+    } else if (select_audio_devices(audio_cfg, num_devices) != 0) {
+        audio_terminate();
+        return -1;
+    }
+    *num_devices_out = num_devices;
+    return 0;
+}
+
+/* Calibration and measurement: devices, capture settings, chirp, then the take */
+static int run_capture(const RunConfig *run, int mode) {
     AudioConfig audio_cfg;
-    if (select_audio_devices(&audio_cfg, num_devices) != 0) {
+    int num_devices;
+    if (open_audio_devices(run, &audio_cfg, &num_devices) != 0) {
+        return -1;
+    }
+
+    /* Sample rate and capture format: given or defaulted in batch runs, prompted otherwise */
+    audio_cfg.sample_rate = run->sample_rate;
+    audio_cfg.capture_format = run->capture_format;
+    if (!run->batch && !run_config_has(run, RUN_OPT_SAMPLE_RATE) && select_sample_rate(&audio_cfg) != 0) {
+        audio_terminate();
+        return -1;
+    }
+    if (!run->batch && !run_config_has(run, RUN_OPT_CAPTURE_FORMAT) && select_capture_format(&audio_cfg) != 0) {
+        audio_terminate();
+        return -1;
+    }
+    if (validate_audio_config(&audio_cfg, num_devices) != 0) {
         audio_terminate();
         return -1;
     }
-    
+
     /* Get chirp parameters */
-    ChirpParams chirp_params;
-    if (get_chirp_parameters(&chirp_params) != 0) {
+    ChirpParams chirp_params = run->chirp;
+    int has_chirp = run_config_has(run, RUN_OPT_CHIRP_DURATION) || run_config_has(run, RUN_OPT_START_FREQ)
+                    || run_config_has(run, RUN_OPT_END_FREQ);
+    if (has_chirp || run->batch) {
+        int has_duration = run_config_has(run, RUN_OPT_CHIRP_DURATION)
+                           || (chirp_params.type == MLS_CHIRP_TYPE && run_config_has(run, RUN_OPT_MLS_ORDER));
+        if (!has_duration || !run_config_has(run, RUN_OPT_START_FREQ) || !run_config_has(run, RUN_OPT_END_FREQ)) {
+            fprintf(stderr, "Chirp needs --chirp-duration (or --mls-order), --start-freq and --end-freq\n");
+            audio_terminate();
+            return -1;
+        }
+        if (validate_chirp_parameters(&chirp_params, audio_cfg.sample_rate) != 0) {
+            audio_terminate();
+            return -1;
+        }
+    } else if (get_chirp_parameters(&chirp_params, audio_cfg.sample_rate) != 0) {
         audio_terminate();
         return -1;
     }
-    
-    /* Prompt for recording duration */
-    printf("\nEnter recording duration in seconds: ");
-    float recording_duration;
-    scanf("%f", &recording_duration);
+    if (multi_sweep_check(&chirp_params, audio_cfg.sample_rate) != 0
+        || mls_check(&chirp_params, audio_cfg.sample_rate) != 0) {
+        audio_terminate();
+        return -1;
+    }
+    float take_duration = (float)multi_sweep_duration(&chirp_params) + chirp_params.Tgap;
+
+    /* Recording duration */
+    float recording_duration = run->recording_duration;
+    if (!run_config_has(run, RUN_OPT_RECORDING_DURATION)) {
+        if (run->batch) {
+            recording_duration = take_duration + (float)DEFAULT_RECORD_MARGIN_S;
+        } else {
+            printf("\nEnter recording duration in seconds: ");
+            scanf("%f", &recording_duration);
+        }
+    }
     if (recording_duration <= 0) {
         fprintf(stderr, "Invalid recording duration\n");
         audio_terminate();
         return -1;
     }
-    
-    if (recording_duration < chirp_params.duration) {
-        printf("Warning: recording duration is shorter than chirp duration.\n");
-    }
-    
-    /* Select processing mode */
-    int mode = prompt_mode_selection();
-    if (mode < 0) {
+
+    if (recording_duration < take_duration) {
+        fprintf(stderr, "Recording duration (%.2f s) is shorter than the chirp and its padding (%.2f s)\n",
+                recording_duration, take_duration);
         audio_terminate();
         return -1;
     }
-    
-    int ret = 0;
-    
+
+    /* Capture modes start with the tuned (or default) stream settings */
+    TunerPolicy tuner = (run->batch && run->tuner == TUNER_ASK) ? TUNER_SKIP : run->tuner;
+    configure_stream_tuning(&audio_cfg, tuner);
+
+    int ret;
+    if (mode == MODE_CALIBRATION) {
+        ret = run_calibration_mode(&audio_cfg, &chirp_params, recording_duration);
+    } else {
+        ret = run_measurement_mode(&audio_cfg, &chirp_params, recording_duration);
+    }
+
+    /* Cleanup */
+    audio_terminate();
+
+    return ret;
+}
+
+/* The captures carry their own chirp and rate; explicit values are fallbacks */
+static double stored_capture_fallbacks(const RunConfig *run, ChirpParams *chirp_params) {
+    *chirp_params = run->chirp;
+    if (!run_config_has(run, RUN_OPT_CHIRP_DURATION)) {
+        chirp_params->duration = 0.0f;
+    }
+    return run_config_has(run, RUN_OPT_SAMPLE_RATE) ? run->sample_rate : 0.0;
+}
+
+/* Processing works from the stored captures only; no audio device is opened */
+static int run_processing(const RunConfig *run) {
+    ProcessingOptions options = run->processing;
+    int has_export = run_config_has(run, RUN_OPT_FRF_BAND) || run_config_has(run, RUN_OPT_FRF_GRID)
+                     || run_config_has(run, RUN_OPT_FRF_POINTS) || run_config_has(run, RUN_OPT_EXPORT_CSV);
+    if (!has_export && !run->batch && select_frf_export(&options.export) != 0) {
+        return -1;
+    }
+
+    ChirpParams chirp_params;
+    double sample_rate = stored_capture_fallbacks(run, &chirp_params);
+    return run_processing_mode(&chirp_params, sample_rate, &options);
+}
+
+static int run_param_sweep(const RunConfig *run) {
+    ChirpParams chirp_params;
+    double sample_rate = stored_capture_fallbacks(run, &chirp_params);
+    return run_param_sweep_mode(&chirp_params, sample_rate, &run->processing, &run->param_grid);
+}
+
+/* Live monitoring: devices, then the periodic excitation; rate and band come from the calibration */
+static int run_live(const RunConfig *run) {
+    AudioConfig audio_cfg;
+    int num_devices;
+    if (open_audio_devices(run, &audio_cfg, &num_devices) != 0) {
+        return -1;
+    }
+
+    LiveOptions live = run->live;
+    if (run_config_has(run, RUN_OPT_AMPLITUDE)) {
+        live.amplitude = run->chirp.amplitude;
+    }
+    TunerPolicy tuner = (run->batch && run->tuner == TUNER_ASK) ? TUNER_SKIP : run->tuner;
+    int ret = run_live_mode(&audio_cfg, tuner, &live);
+
+    audio_terminate();
+    return ret;
+}
+
+int main(int argc, char **argv) {
+    RunConfig run;
+    int loaded = run_config_load(&run, argc, argv);
+    if (loaded != 0) {
+        return loaded > 0 ? 0 : -1;
+    }
+
+    /* Select processing mode */
+    int mode = run.mode;
+    if (!run_config_has(&run, RUN_OPT_MODE)) {
+        if (run.batch) {
+            fprintf(stderr, "Batch runs need --mode\n");
+            return -1;
+        }
+        mode = prompt_mode_selection();
+        if (mode < 0) {
+            return -1;
+        }
+    }
+
     /* Execute selected mode */
     switch (mode) {
         case MODE_CALIBRATION:
-            ret = run_calibration_mode(&audio_cfg, &chirp_params, recording_duration);
-            break;
         case MODE_MEASUREMENT:
-            ret = run_measurement_mode(&audio_cfg, &chirp_params, recording_duration);
-            break;
+            return run_capture(&run, mode);
         case MODE_PROCESSING:
-            ret = run_processing_mode(&chirp_params);
-            break;
+            return run_processing(&run);
+        case MODE_DAEMON:
+            return run_daemon_mode(run.socket_path);
+        case MODE_PARAM_SWEEP:
+            return run_param_sweep(&run);
+        case MODE_LIVE:
+            return run_live(&run);
+        case MODE_PEAKS:
+            return run_peaks_mode(&run.processing);
         default:
             fprintf(stderr, "Invalid mode\n");
-            ret = -1;
-            break;
+            return -1;
     }
-    
-    /* Cleanup */
-    audio_terminate();
-    
-    return ret;
-}
\ No newline at end of file
+}
@@ -0,0 +1,546 @@
+#define _POSIX_C_SOURCE 200809L
+#include "daemon.h"
+#include "config.h"
+#include "wav_io.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#define DAEMON_TAG_MAX 1024 /* Calibration identity: kind, path, inode, size and mtime in ns */
+
+/* Sweep fields a raw job must give (bit per field) */
+#define JOB_SAMPLE_RATE 1
+#define JOB_START_FREQ 2
+#define JOB_END_FREQ 4
+#define JOB_DURATION 8
+#define JOB_SWEEP_COMPLETE 15
+#define JOB_AMPLITUDE 16
+#define JOB_TYPE 32
+
+/* One warm sweep: its context and the calibration it holds */
+typedef struct {
+    VtContext *ctx;
+    VtSweep sweep;
+    char calibration[DAEMON_TAG_MAX]; /* Tag of the calibration capture it holds; empty if none */
+    unsigned long last_used;
+} WarmContext;
+
+typedef struct {
+    WarmContext contexts[DAEMON_MAX_CONTEXTS];
+    unsigned long jobs;
+    float *samples;         /* Capture workspace, reused across jobs */
+    int64_t samples_capacity;
+    unsigned char *reply;   /* Reply payload workspace */
+    size_t reply_capacity;
+} DaemonState;
+
+typedef struct {
+    const char *calibration;
+    const char *measurement;
+    int calibration_raw;    /* Given as calibration_raw= rather than calibration= */
+    int measurement_raw;
+    int raw;                /* Both captures raw, set once the kinds are checked */
+    VtSweep sweep;
+    int sweep_set;          /* JOB_* bits */
+    int band_limited;
+    VtOutputGrid grid;
+    int points;
+} Job;
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void handle_stop_signal(int sig) {
+    (void)sig;
+    stop_requested = 1;
+}
+
+// --- Replies ---
+
+static int write_all(int fd, const void *data, size_t size) {
+    const char *p = (const char *)data;
+    while (size > 0) {
+        ssize_t n = write(fd, p, size);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        p += n;
+        size -= (size_t)n;
+    }
+    return 0;
+}
+
+static int reply_line(int fd, const char *format, ...) {
+    char line[DAEMON_REQUEST_MAX];
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(line, sizeof(line) - 1, format, args);
+    va_end(args);
+    if (len < 0) return -1;
+    if (len > (int)sizeof(line) - 2) len = (int)sizeof(line) - 2;
+    line[len++] = '\n';
+    return write_all(fd, line, (size_t)len);
+}
+
+// --- Workspaces ---
+
+static float *samples_workspace(DaemonState *state, int64_t n) {
+    if (n > state->samples_capacity) {
+        float *grown = (float*)realloc(state->samples, sizeof(float) * (size_t)n);
+        if (!grown) return NULL;
+        state->samples = grown;
+        state->samples_capacity = n;
+    }
+    return state->samples;
+}
+
+static unsigned char *reply_workspace(DaemonState *state, size_t size) {
+    if (size > state->reply_capacity) {
+        unsigned char *grown = (unsigned char*)realloc(state->reply, size);
+        if (!grown) return NULL;
+        state->reply = grown;
+        state->reply_capacity = size;
+    }
+    return state->reply;
+}
+
+static int same_sweep(const VtSweep *a, const VtSweep *b) {
+    return a->sample_rate == b->sample_rate && a->start_freq == b->start_freq && a->end_freq == b->end_freq
+           && a->duration == b->duration && a->amplitude == b->amplitude && a->type == b->type;
+}
+
+/* Context for a sweep, reusing a warm one or replacing the least recently used */
+static WarmContext *warm_context(DaemonState *state, const VtSweep *sweep, int *warm) {
+    WarmContext *slot = &state->contexts[0];
+    for (int i = 0; i < DAEMON_MAX_CONTEXTS; i++) {
+        WarmContext *c = &state->contexts[i];
+        if (c->ctx && same_sweep(&c->sweep, sweep)) {
+            c->last_used = state->jobs;
+            *warm = 1;
+            return c;
+        }
+        if (!c->ctx || (slot->ctx && c->last_used < slot->last_used)) {
+            slot = c;
+        }
+    }
+
+    *warm = 0;
+    vt_context_destroy(slot->ctx);
+    memset(slot, 0, sizeof(*slot));
+    slot->ctx = vt_context_create(sweep);
+    if (!slot->ctx) {
+        return NULL;
+    }
+    slot->sweep = *sweep;
+    slot->last_used = state->jobs;
+    return slot;
+}
+
+// --- Captures ---
+
+/*
+ * Identity of a calibration capture: a cached calibration IR is reused
+ * while the file keeps its kind, path, inode, size and modification time
+ * (to the nanosecond).
+ */
+static void capture_tag(char *tag, size_t size, const char *kind, const char *path, const struct stat *st) {
+    snprintf(tag, size, "%s:%s:%llu:%lld:%lld.%09ld", kind, path, (unsigned long long)st->st_ino,
+             (long long)st->st_size, (long long)st->st_mtim.tv_sec, (long)st->st_mtim.tv_nsec);
+}
+
+/* Maps a raw mono float32 file and fills st; the caller unmaps map_size bytes at *map */
+static int map_raw_capture(const char *path, const float **samples, int64_t *num_samples, void **map, size_t *map_size,
+                           struct stat *st_out) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(float)) {
+        close(fd);
+        return -1;
+    }
+    void *p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        return -1;
+    }
+    *samples = (const float *)p;
+    *num_samples = (int64_t)st.st_size / (int64_t)sizeof(float);
+    *map = p;
+    *map_size = (size_t)st.st_size;
+    *st_out = st;
+    return 0;
+}
+
+/* Reads the first n frames of a mono WAV capture into the workspace */
+static const float *read_wav_capture(DaemonState *state, WavReader *reader, int64_t n) {
+    float *samples = samples_workspace(state, n);
+    if (!samples || reader->info.num_frames < n || wav_reader_read(reader, 0, (int)n, samples) != 0) {
+        return NULL;
+    }
+    return samples;
+}
+
+// --- Jobs ---
+
+static int parse_job(char *args, Job *job, char *error, size_t error_size) {
+    memset(job, 0, sizeof(*job));
+    job->sweep.type = 1;
+    job->sweep.amplitude = 0.5f;
+    job->band_limited = 1;
+    job->grid = VT_OUTPUT_BINS;
+
+    char *save = NULL;
+    for (char *token = strtok_r(args, " \t", &save); token; token = strtok_r(NULL, " \t", &save)) {
+        char *value = strchr(token, '=');
+        if (!value) {
+            snprintf(error, error_size, "expected key=value, got '%s'", token);
+            return -1;
+        }
+        *value++ = '\0';
+        char *end = value;
+        double number = strtod(value, &end);
+        int numeric = end != value && *end == '\0';
+
+        if (strcmp(token, "calibration") == 0 || strcmp(token, "calibration_raw") == 0) {
+            job->calibration = value;
+            job->calibration_raw = strcmp(token, "calibration_raw") == 0;
+        } else if (strcmp(token, "measurement") == 0 || strcmp(token, "measurement_raw") == 0) {
+            job->measurement = value;
+            job->measurement_raw = strcmp(token, "measurement_raw") == 0;
+        } else if (strcmp(token, "sample_rate") == 0 && numeric && number > 0) {
+            job->sweep.sample_rate = number;
+            job->sweep_set |= JOB_SAMPLE_RATE;
+        } else if (strcmp(token, "start_freq") == 0 && numeric) {
+            job->sweep.start_freq = (float)number;
+            job->sweep_set |= JOB_START_FREQ;
+        } else if (strcmp(token, "end_freq") == 0 && numeric) {
+            job->sweep.end_freq = (float)number;
+            job->sweep_set |= JOB_END_FREQ;
+        } else if (strcmp(token, "duration") == 0 && numeric) {
+            job->sweep.duration = (float)number;
+            job->sweep_set |= JOB_DURATION;
+        } else if (strcmp(token, "amplitude") == 0 && numeric) {
+            job->sweep.amplitude = (float)number;
+            job->sweep_set |= JOB_AMPLITUDE;
+        } else if (strcmp(token, "chirp_type") == 0 && (strcmp(value, "linear") == 0 || strcmp(value, "exponential") == 0)) {
+            job->sweep.type = strcmp(value, "exponential") == 0;
+            job->sweep_set |= JOB_TYPE;
+        } else if (strcmp(token, "band") == 0 && (strcmp(value, "sweep") == 0 || strcmp(value, "full") == 0)) {
+            job->band_limited = strcmp(value, "sweep") == 0;
+        } else if (strcmp(token, "grid") == 0 && strcmp(value, "bins") == 0) {
+            job->grid = VT_OUTPUT_BINS;
+        } else if (strcmp(token, "grid") == 0 && strcmp(value, "log") == 0) {
+            job->grid = VT_OUTPUT_LOG;
+        } else if (strcmp(token, "grid") == 0 && strcmp(value, "linear") == 0) {
+            job->grid = VT_OUTPUT_LINEAR;
+        } else if (strcmp(token, "points") == 0 && numeric && number >= 2) {
+            job->points = (int)number;
+        } else {
+            snprintf(error, error_size, "invalid argument '%s=%s'", token, value);
+            return -1;
+        }
+    }
+
+    if (!job->calibration || !job->measurement) {
+        snprintf(error, error_size, "process needs a calibration and a measurement");
+        return -1;
+    }
+    if (job->calibration_raw != job->measurement_raw) {
+        snprintf(error, error_size, "calibration and measurement must both be raw or both WAV");
+        return -1;
+    }
+    job->raw = job->calibration_raw;
+    if (job->raw && (job->sweep_set & JOB_SWEEP_COMPLETE) != JOB_SWEEP_COMPLETE) {
+        snprintf(error, error_size, "raw captures need sample_rate, start_freq, end_freq and duration");
+        return -1;
+    }
+    if (job->grid != VT_OUTPUT_BINS && job->points == 0) {
+        job->points = 500;
+    }
+    return 0;
+}
+
+/* Sends H_lips, open and closed on the job's grid after the header line */
+static int send_result(DaemonState *state, int fd, VtContext *ctx, const float *measurement, int64_t n,
+                       int warm, int calibration_cached, const struct timespec *start) {
+    int points = vt_output_points(ctx);
+    size_t freq_bytes = sizeof(double) * (size_t)points;
+    size_t spectrum_bytes = 2 * sizeof(float) * (size_t)points;
+    unsigned char *payload = reply_workspace(state, freq_bytes + 3 * spectrum_bytes);
+    if (!payload) {
+        return reply_line(fd, "error out of memory");
+    }
+    float *spectra = (float *)(payload + freq_bytes);
+    vt_output_frequencies(ctx, (double *)payload);
+    if (vt_process(ctx, measurement, n, spectra, spectra + 2 * points, spectra + 4 * points) != 0) {
+        return reply_line(fd, "error measurement rejected");
+    }
+
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double ms = (end.tv_sec - start->tv_sec) * 1e3 + (end.tv_nsec - start->tv_nsec) / 1e6;
+    printf("Job %lu: %d points, %s context, calibration %s, %.2f ms\n", state->jobs, points,
+           warm ? "warm" : "new", calibration_cached ? "cached" : "deconvolved", ms);
+    fflush(stdout);
+
+    if (reply_line(fd, "ok points=%d nfft=%d warm=%d calibration_cached=%d ms=%.3f", points,
+                   vt_fft_size(ctx), warm, calibration_cached, ms) != 0) {
+        return -1;
+    }
+    return write_all(fd, payload, freq_bytes + 3 * spectrum_bytes);
+}
+
+/* Raw job: both captures mapped and read in place; the calibration IR is reused while the file is unchanged */
+static int process_raw_job(DaemonState *state, int fd, const Job *job, const struct timespec *start) {
+    const float *calib = NULL, *meas = NULL;
+    int64_t n_calib = 0, n_meas = 0;
+    void *calib_map = NULL, *meas_map = NULL;
+    size_t calib_size = 0, meas_size = 0;
+    struct stat calib_st, meas_st;
+    int ret;
+
+    if (map_raw_capture(job->calibration, &calib, &n_calib, &calib_map, &calib_size, &calib_st) != 0) {
+        return reply_line(fd, "error cannot map '%s'", job->calibration);
+    }
+    if (map_raw_capture(job->measurement, &meas, &n_meas, &meas_map, &meas_size, &meas_st) != 0) {
+        munmap(calib_map, calib_size);
+        return reply_line(fd, "error cannot map '%s'", job->measurement);
+    }
+    char tag[DAEMON_TAG_MAX];
+    capture_tag(tag, sizeof(tag), "raw", job->calibration, &calib_st);
+
+    int warm = 0;
+    WarmContext *wc = warm_context(state, &job->sweep, &warm);
+    int cached = wc && strcmp(wc->calibration, tag) == 0;
+    if (!wc) {
+        ret = reply_line(fd, "error invalid sweep");
+    } else if (vt_set_output(wc->ctx, job->band_limited, job->grid, job->points) != 0) {
+        ret = reply_line(fd, "error invalid output grid");
+    } else if (!cached && vt_set_calibration(wc->ctx, calib, n_calib) != 0) {
+        wc->calibration[0] = '\0';
+        ret = reply_line(fd, "error calibration has %lld samples, the sweep needs %lld",
+                         (long long)n_calib, (long long)vt_capture_length(wc->ctx));
+    } else {
+        snprintf(wc->calibration, sizeof(wc->calibration), "%s", tag);
+        ret = send_result(state, fd, wc->ctx, meas, n_meas, warm, cached, start);
+    }
+
+    munmap(calib_map, calib_size);
+    munmap(meas_map, meas_size);
+    return ret;
+}
+
+/* Whether the sweep fields given with a WAV job agree with the chirp stored in the capture */
+static int chirp_matches_job(const ChirpParams *chirp, const Job *job) {
+    return (!(job->sweep_set & JOB_START_FREQ) || job->sweep.start_freq == chirp->start_freq)
+           && (!(job->sweep_set & JOB_END_FREQ) || job->sweep.end_freq == chirp->end_freq)
+           && (!(job->sweep_set & JOB_DURATION) || job->sweep.duration == chirp->duration)
+           && (!(job->sweep_set & JOB_AMPLITUDE) || job->sweep.amplitude == chirp->amplitude)
+           && (!(job->sweep_set & JOB_TYPE) || job->sweep.type == chirp->type);
+}
+
+/* Whether two captures were taken with the same sweep (the level may differ) */
+static int same_chirp(const ChirpParams *a, const ChirpParams *b) {
+    return a->start_freq == b->start_freq && a->end_freq == b->end_freq && a->duration == b->duration
+           && a->type == b->type;
+}
+
+/* WAV job: the calibration's header gives the sweep; its IR is reused while the file is unchanged */
+static int process_wav_job(DaemonState *state, int fd, const Job *job, const struct timespec *start) {
+    WavReader calib, meas;
+    if (wav_reader_open(job->calibration, 0, &calib) != 0) {
+        return reply_line(fd, "error cannot read '%s'", job->calibration);
+    }
+    if (wav_reader_open(job->measurement, 0, &meas) != 0) {
+        wav_reader_close(&calib);
+        return reply_line(fd, "error cannot read '%s'", job->measurement);
+    }
+
+    VtSweep sweep = job->sweep;
+    sweep.sample_rate = calib.info.sample_rate;
+    if (calib.info.has_chirp) {
+        sweep.start_freq = calib.info.chirp.start_freq;
+        sweep.end_freq = calib.info.chirp.end_freq;
+        sweep.duration = calib.info.chirp.duration;
+        sweep.amplitude = calib.info.chirp.amplitude;
+        sweep.type = calib.info.chirp.type;
+    }
+
+    int ret;
+    int warm = 0;
+    WarmContext *wc = NULL;
+    struct stat st;
+    char tag[DAEMON_TAG_MAX];
+    if (fstat(calib.fd, &st) != 0) {
+        memset(&st, 0, sizeof(st));
+    }
+    capture_tag(tag, sizeof(tag), "wav", job->calibration, &st);
+
+    if (calib.info.num_channels != NUM_CHANNELS || meas.info.num_channels != NUM_CHANNELS) {
+        ret = reply_line(fd, "error captures must have %d channel(s)", NUM_CHANNELS);
+    } else if (meas.info.sample_rate != calib.info.sample_rate) {
+        ret = reply_line(fd, "error calibration and measurement sample rates differ");
+    } else if (calib.info.has_chirp && calib.info.chirp.num_sweeps > 1) {
+        ret = reply_line(fd, "error staggered-sweep takes are only handled by processing mode");
+    } else if (calib.info.has_chirp && calib.info.chirp.mls_order > 0) {
+        ret = reply_line(fd, "error MLS takes are only handled by processing mode");
+    } else if ((job->sweep_set & JOB_SAMPLE_RATE) && job->sweep.sample_rate != calib.info.sample_rate) {
+        ret = reply_line(fd, "error calibration sample rate differs from the job's");
+    } else if (calib.info.has_chirp && !chirp_matches_job(&calib.info.chirp, job)) {
+        ret = reply_line(fd, "error calibration chirp differs from the job's sweep parameters");
+    } else if (calib.info.has_chirp && meas.info.has_chirp && !same_chirp(&calib.info.chirp, &meas.info.chirp)) {
+        ret = reply_line(fd, "error calibration and measurement chirps differ");
+    } else if (!calib.info.has_chirp && (job->sweep_set & (JOB_START_FREQ | JOB_END_FREQ | JOB_DURATION))
+                                            != (JOB_START_FREQ | JOB_END_FREQ | JOB_DURATION)) {
+        ret = reply_line(fd, "error calibration carries no chirp; give start_freq, end_freq and duration");
+    } else if (!(wc = warm_context(state, &sweep, &warm))) {
+        ret = reply_line(fd, "error invalid sweep");
+    } else if (vt_set_output(wc->ctx, job->band_limited, job->grid, job->points) != 0) {
+        ret = reply_line(fd, "error invalid output grid");
+    } else {
+        int64_t n = vt_capture_length(wc->ctx);
+        int cached = strcmp(wc->calibration, tag) == 0;
+        const float *samples = cached ? NULL : read_wav_capture(state, &calib, n);
+        if (!cached && (!samples || vt_set_calibration(wc->ctx, samples, n) != 0)) {
+            wc->calibration[0] = '\0';
+            ret = reply_line(fd, "error calibration shorter than the %lld-sample sweep or unreadable", (long long)n);
+        } else {
+            snprintf(wc->calibration, sizeof(wc->calibration), "%s", tag);
+            samples = read_wav_capture(state, &meas, n);
+            ret = samples ? send_result(state, fd, wc->ctx, samples, n, warm, cached, start)
+                          : reply_line(fd, "error measurement shorter than the %lld-sample sweep or unreadable",
+                                       (long long)n);
+        }
+    }
+
+    wav_reader_close(&calib);
+    wav_reader_close(&meas);
+    return ret;
+}
+
+/* Handles one request line; returns 1 on shutdown, -1 if the connection failed */
+static int handle_request(DaemonState *state, int fd, char *request) {
+    size_t len = strlen(request);
+    if (len > 0 && request[len - 1] == '\r') request[--len] = '\0';
+
+    if (strcmp(request, "ping") == 0) {
+        return reply_line(fd, "ok pong");
+    }
+    if (strcmp(request, "shutdown") == 0) {
+        reply_line(fd, "ok shutdown");
+        return 1;
+    }
+    if (strncmp(request, "process", 7) != 0 || (request[7] != ' ' && request[7] != '\0')) {
+        return reply_line(fd, "error unknown request");
+    }
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    state->jobs++;
+
+    Job job;
+    char error[256];
+    if (parse_job(request + 7, &job, error, sizeof(error)) != 0) {
+        return reply_line(fd, "error %s", error);
+    }
+    return job.raw ? process_raw_job(state, fd, &job, &start) : process_wav_job(state, fd, &job, &start);
+}
+
+/* Serves one client until it disconnects; returns 1 on shutdown */
+static int serve_connection(DaemonState *state, int fd) {
+    char buffer[DAEMON_REQUEST_MAX];
+    size_t used = 0;
+
+    while (!stop_requested) {
+        ssize_t n = read(fd, buffer + used, sizeof(buffer) - 1 - used);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return 0;
+        used += (size_t)n;
+        buffer[used] = '\0';
+
+        char *line = buffer;
+        char *newline;
+        while ((newline = strchr(line, '\n')) != NULL) {
+            *newline = '\0';
+            int ret = handle_request(state, fd, line);
+            if (ret != 0) return ret > 0 ? 1 : 0;
+            line = newline + 1;
+        }
+        used -= (size_t)(line - buffer);
+        memmove(buffer, line, used);
+        if (used == sizeof(buffer) - 1) {
+            reply_line(fd, "error request longer than %d bytes", DAEMON_REQUEST_MAX - 1);
+            return 0;
+        }
+    }
+    return 0;
+}
+
+int run_daemon_mode(const char *socket_path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Socket path '%s' is too long\n", socket_path);
+        return -1;
+    }
+    memcpy(addr.sun_path, socket_path, strlen(socket_path) + 1);
+
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    unlink(socket_path);
+    if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(listen_fd, 4) != 0) {
+        fprintf(stderr, "Failed to listen on '%s': %s\n", socket_path, strerror(errno));
+        close(listen_fd);
+        return -1;
+    }
+
+    /* No SA_RESTART: a stop signal interrupts accept() and read() */
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = handle_stop_signal;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    printf("DAEMON MODE: listening on '%s' (ping, process, shutdown)\n", socket_path);
+    fflush(stdout);
+
+    DaemonState state;
+    memset(&state, 0, sizeof(state));
+    int stop = 0;
+    while (!stop_requested && !stop) {
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            perror("accept");
+            break;
+        }
+        stop = serve_connection(&state, fd);
+        close(fd);
+    }
+
+    close(listen_fd);
+    unlink(socket_path);
+    for (int i = 0; i < DAEMON_MAX_CONTEXTS; i++) {
+        vt_context_destroy(state.contexts[i].ctx);
+    }
+    free(state.samples);
+    free(state.reply);
+    printf("Daemon stopped after %lu job(s).\n", state.jobs);
+    return 0;
+}
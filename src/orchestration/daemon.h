@@ -0,0 +1,55 @@
+#ifndef DAEMON_H
+#define DAEMON_H
+
+#include "vtimpedance.h"
+
+#define DEFAULT_DAEMON_SOCKET "output/vtimpedance.sock"
+#define DAEMON_SOCKET_PATH_MAX 108 /* sun_path size on Linux */
+#define DAEMON_MAX_CONTEXTS 4      /* Sweeps kept warm; the least recently used is dropped */
+#define DAEMON_REQUEST_MAX 4096    /* Longest request line */
+
+/**
+ * Runs the processing daemon: listens on a Unix domain socket and serves
+ * processing jobs until a "shutdown" request, SIGINT or SIGTERM.
+ *
+ * Each connection sends newline-terminated requests and reads one reply
+ * per request, so a client can keep its connection open across jobs:
+ *
+ *   ping
+ *   shutdown
+ *   process calibration=PATH measurement=PATH [band=sweep|full]
+ *           [grid=bins|log|linear] [points=N]
+ *   process calibration_raw=PATH measurement_raw=PATH sample_rate=HZ
+ *           start_freq=HZ end_freq=HZ duration=S [chirp_type=linear|exponential]
+ *           [amplitude=A] [band=...] [grid=...] [points=N]
+ *
+ * WAV captures carry their own rate and chirp (as in processing mode);
+ * sweep keys given with a WAV job must agree with the calibration's chirp,
+ * and the measurement's chirp must span the same sweep, or the job fails.
+ * Raw captures are mono float32 files, typically in /dev/shm, mapped and
+ * read in place. Both captures of a job are of the same kind. Replies are
+ * "ok ..." or "error MESSAGE" lines; a successful process reply is
+ *
+ *   ok points=N nfft=NFFT warm=0|1 calibration_cached=0|1 ms=T
+ *
+ * followed by N float64 frequencies and three arrays of N complex float32
+ * (H_lips, open and closed linear IR spectra), in host byte order.
+ *
+ * FFT plans, inverse filters and regularization stay warm for the last
+ * DAEMON_MAX_CONTEXTS sweeps (see vtimpedance.h), together with the
+ * calibration IR of each sweep, which is reused while the calibration
+ * file (WAV or raw) keeps its path, inode, size and modification time
+ * (to the nanosecond). A process rewriting a raw capture through a
+ * shared mapping should msync() it so the modification time moves.
+ * Capture and output buffers are reused across
+ * jobs. Jobs do not go through the session store or the FRF database.
+ *
+ * Parameters:
+ *   socket_path: Socket to create (replaced if it exists)
+ *
+ * Returns:
+ *   0 after a clean shutdown, -1 if the socket could not be set up
+ */
+int run_daemon_mode(const char *socket_path);
+
+#endif
@@ -0,0 +1,375 @@
+#define _POSIX_C_SOURCE 200809L
+#include "live.h"
+#include "pipeline.h"
+#include "audio_io.h"
+#include "wav_io.h"
+#include "processing.h"
+#include "multi_sweep.h"
+#include "mls.h"
+#include <math.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/select.h>
+
+#define LIVE_CALIBRATION_FILE "output/calibration_response.wav"
+
+/* State shared by the worker thread and the thread that started it */
+typedef struct {
+    AudioDuplexHandle *stream;
+    LiveEstimator *est;
+    LiveFrames *frames;
+    const float *ring;
+    int ring_frames;
+    int frame_periods;      /* Periods per published frame */
+    int stop;               /* Set by the main thread (atomic) */
+    int finished;           /* Set by the worker when it returns (atomic) */
+    int failed;
+    /* Results, read after the join */
+    int delay;
+    unsigned long long periods;
+    unsigned long long dropped;
+    unsigned long long published;
+    double total_ms;
+    double max_ms;
+} LiveWorker;
+
+static volatile sig_atomic_t stop_requested = 0;
+
+static void handle_stop_signal(int sig) {
+    (void)sig;
+    stop_requested = 1;
+}
+
+static double elapsed_ms(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1e3 + (now.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+static void sleep_ms(double ms) {
+    struct timespec ts;
+    ts.tv_sec = (time_t)(ms / 1000.0);
+    ts.tv_nsec = (long)((ms - ts.tv_sec * 1000.0) * 1e6);
+    nanosleep(&ts, NULL);
+}
+
+/*
+ * Deconvolves the stored calibration capture, windows its linear IR as
+ * processing mode does and folds it onto the estimator's period. The
+ * first sweep of a staggered take is used.
+ */
+static int set_calibration(LiveEstimator *est, WavReader *calib, const ChirpParams *chirp, double fs) {
+    int n_samples = (int)(fs * multi_sweep_duration(chirp));
+    int nfft = calculate_next_power_of_two(n_samples);
+    int npre, npost;
+    linear_ir_window(chirp->start_freq, chirp->end_freq, chirp->duration, fs, &npre, &npost);
+
+    kiss_fft_cfg cfg_fwd = kiss_fft_alloc(nfft, 0, NULL, NULL);
+    kiss_fft_cfg cfg_inv = kiss_fft_alloc(nfft, 1, NULL, NULL);
+    kiss_fft_cpx *inv_filter = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * nfft);
+    kiss_fft_cpx *buf = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * nfft);
+    kiss_fft_cpx *work = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * nfft);
+    float *samples = (float*)malloc(sizeof(float) * n_samples);
+    int ret = -1;
+    if (!cfg_fwd || !cfg_inv || !inv_filter || !buf || !work || !samples) {
+        fprintf(stderr, "Failed to allocate calibration buffers\n");
+    } else if (wav_reader_read(calib, 0, n_samples, samples) == 0) {
+        for (int i = 0; i < nfft; i++) {
+            buf[i].r = i < n_samples ? samples[i] : 0.0f;
+            buf[i].i = 0.0f;
+        }
+        generate_inverse_filter(inv_filter, chirp->amplitude, chirp->start_freq, chirp->end_freq, chirp->duration,
+                                (float)fs, nfft, chirp->type);
+        kiss_fft(cfg_fwd, buf, buf);
+        int band_bins;
+        int band_first = sweep_band_bins(chirp->start_freq, chirp->end_freq, fs, nfft, &band_bins);
+        perform_deconvolution_bins(buf, inv_filter, nfft, band_first, band_bins);
+        kiss_fft(cfg_inv, buf, buf);
+
+        /* The windowed IR is left in work; inv_filter takes the unused spectrum */
+        window_linear_ir(buf, work, inv_filter, cfg_fwd, nfft, npre, npost, LINEAR_IR_FADE, fs, 0, 0);
+        live_estimator_set_calibration(est, work, npre + npost, npre, 1.0 / nfft);
+        printf("Calibration: %.0f-%.0f Hz sweep at %.0f Hz, IR window %.0f ms folded onto the period\n",
+               chirp->start_freq, chirp->end_freq, fs, (npre + npost) * 1000.0 / fs);
+        ret = 0;
+    }
+    kiss_fft_free(cfg_fwd);
+    kiss_fft_free(cfg_inv);
+    free(inv_filter);
+    free(buf);
+    free(work);
+    free(samples);
+    return ret;
+}
+
+/* Waits until the stream has recorded target frames; -1 if stopped or stalled */
+static int wait_for_frames(LiveWorker *w, long long target) {
+    double period_ms = 1000.0 * w->est->period / w->est->fs;
+    double poll_ms = period_ms / 4.0 > 1.0 ? period_ms / 4.0 : 1.0;
+    long long last = audio_duplex_frames_recorded(w->stream);
+    double idle_ms = 0.0;
+    while (last < target) {
+        if (__atomic_load_n(&w->stop, __ATOMIC_ACQUIRE)) {
+            return -1;
+        }
+        sleep_ms(poll_ms);
+        long long now = audio_duplex_frames_recorded(w->stream);
+        idle_ms = now == last ? idle_ms + poll_ms : 0.0;
+        if (idle_ms > LIVE_STALL_S * 1000.0) {
+            fprintf(stderr, "Audio stream stalled; stopping live monitoring\n");
+            w->failed = 1;
+            return -1;
+        }
+        last = now;
+    }
+    return 0;
+}
+
+/* Copies frames [start, start + period) out of the ring; -1 if the stream overwrote them first */
+static int read_period(LiveWorker *w, long long start, float *block) {
+    int period = w->est->period;
+    if (audio_duplex_frames_recorded(w->stream) - w->ring_frames > start) {
+        return -1;
+    }
+    for (int i = 0; i < period; i++) {
+        block[i] = w->ring[(start + i) % w->ring_frames];
+    }
+    return audio_duplex_frames_recorded(w->stream) - w->ring_frames > start ? -1 : 0;
+}
+
+static void *live_worker(void *arg) {
+    LiveWorker *w = (LiveWorker *)arg;
+    LiveEstimator *est = w->est;
+    int period = est->period;
+    float *block = (float*)malloc(sizeof(float) * period);
+    kiss_fft_cpx *h_lips = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * est->num_bins);
+    if (!block || !h_lips) {
+        fprintf(stderr, "Failed to allocate live worker buffers\n");
+        w->failed = 1;
+        goto done;
+    }
+
+    /* Loop latency, once the response has settled */
+    long long start = (long long)LIVE_SETTLE_PERIODS * period;
+    if (wait_for_frames(w, start + period) != 0) goto done;
+    if (read_period(w, start, block) != 0) {
+        fprintf(stderr, "Live worker fell behind before the first period\n");
+        w->failed = 1;
+        goto done;
+    }
+    /* Periods start at the correlation peak, as calibration and measurement takes are aligned */
+    w->delay = live_estimator_delay(est, block);
+    printf("Loop latency: %d samples modulo the period (%.1f ms)\n", w->delay, 1000.0 * w->delay / est->fs);
+    start += w->delay;
+
+    int in_frame = 0;
+    double frame_ms = 0.0;
+    double status_s = 0.0;
+    while (wait_for_frames(w, start + period) == 0) {
+        struct timespec t0;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        if (read_period(w, start, block) != 0) {
+            /* Skip to the newest whole period still in the ring */
+            long long behind = (audio_duplex_frames_recorded(w->stream) - start) / period - 1;
+            w->dropped += (unsigned long long)behind;
+            start += behind * period;
+            continue;
+        }
+        live_estimator_add_period(est, block);
+        start += period;
+        w->periods++;
+        frame_ms += elapsed_ms(&t0);
+        if (++in_frame < w->frame_periods) {
+            continue;
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        live_estimator_h_lips(est, h_lips);
+        LiveFrameInfo info;
+        info.frame = w->published;
+        info.time = (double)start / est->fs;
+        info.periods = (uint32_t)est->periods;
+        info.process_ms = (float)(frame_ms + elapsed_ms(&t0));
+        live_frames_publish(w->frames, &info, h_lips, est->open, est->closed);
+        frame_ms += elapsed_ms(&t0);
+        w->published++;
+        w->total_ms += frame_ms;
+        if (frame_ms > w->max_ms) w->max_ms = frame_ms;
+
+        if (info.time >= status_s) {
+            int peak = 0;
+            for (int j = 1; j < est->num_bins; j++) {
+                if (complex_squared_magnitude(h_lips[j]) > complex_squared_magnitude(h_lips[peak])) peak = j;
+            }
+            printf("Frame %llu at %.1f s: H_lips peak %.1f dB at %.0f Hz, %.2f ms\n", (unsigned long long)info.frame,
+                   info.time, 10.0 * log10(complex_squared_magnitude(h_lips[peak]) + 1e-30),
+                   (est->first_bin + peak) * est->fs / period, frame_ms);
+            fflush(stdout);
+            status_s = info.time + LIVE_STATUS_INTERVAL_S;
+        }
+        in_frame = 0;
+        frame_ms = 0.0;
+    }
+
+done:
+    free(block);
+    free(h_lips);
+    __atomic_store_n(&w->finished, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+/* Blocks until Enter (interactive), a stop signal, the duration or the end of the worker */
+static void wait_for_stop(const AudioConfig *audio_cfg, const LiveOptions *options, LiveWorker *worker) {
+    if (audio_cfg->interactive) {
+        printf("Press Enter to stop.\n");
+        fflush(stdout);
+    }
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while (!stop_requested && !__atomic_load_n(&worker->finished, __ATOMIC_ACQUIRE)) {
+        if (options->duration_s > 0.0 && elapsed_ms(&start) >= options->duration_s * 1000.0) {
+            break;
+        }
+        if (audio_cfg->interactive) {
+            fd_set fds;
+            FD_ZERO(&fds);
+            FD_SET(STDIN_FILENO, &fds);
+            struct timeval tv = { 0, 100000 };
+            if (select(STDIN_FILENO + 1, &fds, NULL, NULL, &tv) > 0) {
+                int c;
+                while ((c = getchar()) != '\n' && c != EOF) {}
+                break;
+            }
+        } else {
+            sleep_ms(100.0);
+        }
+    }
+}
+
+int run_live_mode(const AudioConfig *audio_cfg, TunerPolicy tuner, const LiveOptions *options) {
+    printf("LIVE MODE: Initializing periodic monitoring...\n");
+
+    WavReader calib;
+    if (wav_reader_open(LIVE_CALIBRATION_FILE, 0, &calib) != 0) {
+        return -1;
+    }
+    if (!calib.info.has_chirp) {
+        fprintf(stderr, "'%s' carries no chirp parameters\n", LIVE_CALIBRATION_FILE);
+        wav_reader_close(&calib);
+        return -1;
+    }
+    ChirpParams chirp = calib.info.chirp;
+    double fs = calib.info.sample_rate;
+    if (chirp.type == MLS_CHIRP_TYPE) {
+        fprintf(stderr, "Live mode needs a swept calibration ('%s' is an MLS take)\n", LIVE_CALIBRATION_FILE);
+        wav_reader_close(&calib);
+        return -1;
+    }
+    if (calib.info.num_frames < (int64_t)(fs * multi_sweep_duration(&chirp))) {
+        fprintf(stderr, "Calibration capture is shorter than its chirp\n");
+        wav_reader_close(&calib);
+        return -1;
+    }
+
+    int period = options->period > 0 ? options->period : live_default_period(fs);
+    float amplitude = options->amplitude > 0.0f ? options->amplitude : chirp.amplitude;
+    LiveEstimator est;
+    float *excitation = (float*)malloc(sizeof(float) * period);
+    if (!excitation) {
+        fprintf(stderr, "Failed to allocate excitation buffer\n");
+        wav_reader_close(&calib);
+        return -1;
+    }
+    if (live_estimator_init(&est, excitation, period, fs, chirp.start_freq, chirp.end_freq, amplitude,
+                            options->excitation, options->smoothing_s) != 0) {
+        free(excitation);
+        wav_reader_close(&calib);
+        return -1;
+    }
+    int ret = set_calibration(&est, &calib, &chirp, fs);
+    wav_reader_close(&calib);
+    if (ret != 0) {
+        live_estimator_free(&est);
+        free(excitation);
+        return -1;
+    }
+
+    /* The stream runs at the calibration's rate */
+    AudioConfig cfg = *audio_cfg;
+    cfg.sample_rate = fs;
+    if (!audio_is_sample_rate_supported(cfg.input_device, cfg.output_device, fs, NUM_CHANNELS)) {
+        fprintf(stderr, "The devices do not support the calibration's %.0f Hz\n", fs);
+        live_estimator_free(&est);
+        free(excitation);
+        return -1;
+    }
+    configure_stream_tuning(&cfg, tuner);
+
+    double periods_per_s = fs / period;
+    int frame_periods = (int)lround(periods_per_s / options->frame_rate);
+    if (frame_periods < 1) frame_periods = 1;
+
+    LiveFrames frames;
+    float *ring = (float*)calloc((size_t)LIVE_RING_PERIODS * period, sizeof(float));
+    if (!ring || live_frames_create(&frames, options->frame_file, est.num_bins, fs, period, est.first_bin) != 0) {
+        if (!ring) fprintf(stderr, "Failed to allocate input ring\n");
+        free(ring);
+        live_estimator_free(&est);
+        free(excitation);
+        return -1;
+    }
+
+    printf("Excitation: %d-sample periodic %s, %d bins from %.1f to %.1f Hz (%.2f Hz apart), peak %.2f\n", period,
+           options->excitation == LIVE_EXCITATION_MULTISINE ? "multisine" : "chirp", est.num_bins,
+           est.first_bin * fs / period, (est.first_bin + est.num_bins - 1) * fs / period, fs / period, amplitude);
+    printf("Frames every %d period(s) (%.1f per second) to '%s'\n", frame_periods, periods_per_s / frame_periods,
+           options->frame_file);
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = handle_stop_signal;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    LiveWorker worker;
+    memset(&worker, 0, sizeof(worker));
+    worker.est = &est;
+    worker.frames = &frames;
+    worker.ring = ring;
+    worker.ring_frames = LIVE_RING_PERIODS * period;
+    worker.frame_periods = frame_periods;
+    worker.stream = audio_duplex_start_loop(cfg.output_device, cfg.input_device, (float)fs, excitation, period, ring,
+                                            worker.ring_frames, NUM_CHANNELS, &cfg.tuning);
+    ret = -1;
+    pthread_t thread;
+    if (worker.stream && pthread_create(&thread, NULL, live_worker, &worker) == 0) {
+        wait_for_stop(&cfg, options, &worker);
+        __atomic_store_n(&worker.stop, 1, __ATOMIC_RELEASE);
+        pthread_join(thread, NULL);
+        ret = worker.failed ? -1 : 0;
+    } else if (worker.stream) {
+        fprintf(stderr, "Failed to start live worker thread\n");
+    }
+    if (worker.stream && audio_duplex_close(worker.stream) != 0) {
+        ret = -1;
+    }
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+
+    if (worker.published > 0) {
+        printf("%llu frames from %llu periods, %llu periods dropped; %.2f ms mean, %.2f ms max per frame "
+               "(%.1f ms of audio each)\n", worker.published, worker.periods, worker.dropped,
+               worker.total_ms / worker.published, worker.max_ms, 1000.0 * frame_periods * period / fs);
+    }
+    live_frames_close(&frames);
+    free(ring);
+    live_estimator_free(&est);
+    free(excitation);
+    return ret;
+}
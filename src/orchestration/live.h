@@ -0,0 +1,60 @@
+#ifndef LIVE_H
+#define LIVE_H
+
+#include "config.h"
+#include "audio_tuning.h"
+#include "live_frf.h"
+#include "live_frames.h"
+
+#define LIVE_PATH_MAX 256
+#define LIVE_RING_PERIODS 16          /* Periods the input ring holds */
+#define LIVE_SETTLE_PERIODS 2         /* Periods played before the response counts as steady */
+#define LIVE_DEFAULT_FRAME_RATE 15.0  /* Frames per second */
+#define LIVE_DEFAULT_SMOOTHING_S 0.2  /* Time constant of the running average (s) */
+#define LIVE_STATUS_INTERVAL_S 1.0    /* Spacing of the status lines (s) */
+#define LIVE_STALL_S 1.0              /* Stream considered dead after this long without input (s) */
+
+/**
+ * Options of run_live_mode().
+ */
+typedef struct {
+    int period;                  /* Excitation period (samples, power of two), 0: live_default_period() */
+    LiveExcitation excitation;
+    double frame_rate;           /* Frames published per second, at most one per period */
+    double smoothing_s;          /* Time constant of the running average, 0 for none */
+    double duration_s;           /* Stops after this long, 0: when stopped */
+    float amplitude;             /* Excitation peak, 0: that of the calibration chirp */
+    char frame_file[LIVE_PATH_MAX];
+} LiveOptions;
+
+/**
+ * Runs live monitoring: plays a periodic excitation through the duplex
+ * stream without pause and publishes a smoothed H_lips several times a
+ * second, until Enter is pressed (interactive runs), SIGINT/SIGTERM, or
+ * options->duration_s has passed.
+ *
+ * The calibration comes from the stored calibration capture: its linear
+ * IR is windowed as in processing mode and folded onto the excitation
+ * period, and its sample rate and sweep band become those of the stream
+ * and the excitation. After LIVE_SETTLE_PERIODS, the loop latency is
+ * taken from one recorded period (live_estimator_delay()); from then on
+ * a worker thread reads each period, aligned to that latency as capture
+ * takes are aligned to theirs, from the input ring and adds it to the
+ * running estimate (see live_frf.h). Every
+ * fs / (period * frame_rate) periods, rounded and at least one, it
+ * publishes H_lips with the open and closed responses to
+ * options->frame_file (see live_frames.h), together with the time the
+ * frame took to compute. A summary of the frame times and of any
+ * periods the worker fell too far behind to read is printed at the end.
+ *
+ * Parameters:
+ *   audio_cfg: Devices and interactivity; the sample rate and tuning are set here
+ *   tuner: Whether to ask, skip or run the stream tuner when nothing is saved
+ *   options: Excitation, frame rate, smoothing, duration and output file
+ *
+ * Returns:
+ *   0 on success, -1 on failure
+ */
+int run_live_mode(const AudioConfig *audio_cfg, TunerPolicy tuner, const LiveOptions *options);
+
+#endif
@@ -0,0 +1,115 @@
+#include "processing_stages.h"
+#include "processing.h"
+#include "multi_sweep.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+/* Key of one sweep's FRF in a multiple-sweep take */
+static StoreKey sweep_frf_key(StoreKey frf, int sweep) {
+    StoreHasher hasher;
+    store_hash_init(&hasher);
+    store_hash_bytes(&hasher, "sweep", 5);
+    store_hash_int(&hasher, (int64_t)frf);
+    store_hash_int(&hasher, sweep);
+    return store_hash_final(&hasher);
+}
+
+int process_multi_sweep(WavReader *calib, WavReader *meas, Decimator dec[2], const CaptureInput inputs[2],
+                        const ChirpParams *chirp_params, double fs, const ProcessingOptions *options) {
+    int num_sweeps = multi_sweep_count(chirp_params);
+    double capture_fs = calib->info.sample_rate;
+    int n_samples_take = (int)(fs * multi_sweep_duration(chirp_params));
+    int nfft = calculate_next_power_of_two(n_samples_take);
+    printf("Using FFT size of %d for %d staggered sweeps (%.3f s apart)\n", nfft, num_sweeps,
+           chirp_params->sweep_stagger);
+    if (options->memory_budget > 0 && full_processing_memory(nfft) > options->memory_budget) {
+        printf("Staggered sweeps are deconvolved at full length: %.1f MiB (budget %.1f MiB)\n",
+               full_processing_memory(nfft) / 1048576.0, options->memory_budget / 1048576.0);
+    }
+    
+    int npre, npost;
+    linear_ir_window(chirp_params->start_freq, chirp_params->end_freq, chirp_params->duration, fs, &npre, &npost);
+    
+    /* The stages are not stored, but each sweep's FRF is keyed for the database */
+    WavReader *captures[2] = { calib, meas };
+    TakeKeys keys;
+    if (take_keys(captures, dec, chirp_params, fs, nfft, npre, npost, 0, &options->export, &keys) != 0) {
+        close_capture_inputs(calib, meas, dec);
+        return -1;
+    }
+    
+    FrfInfo frf_info;
+    memset(&frf_info, 0, sizeof(frf_info));
+    frf_info.sample_rate = fs;
+    frf_info.nfft = nfft;
+    frf_info.chirp = *chirp_params;
+    int first_active, num_active;
+    int first_bin = frf_output_axis(&frf_info, &options->export, &first_active, &num_active);
+    
+    /* After the deconvolution the inverse filter holds the rotated take, and h_result is window scratch */
+    kiss_fft_cfg cfg_fwd = kiss_fft_alloc(nfft, 0, NULL, NULL);
+    kiss_fft_cfg cfg_inv = kiss_fft_alloc(nfft, 1, NULL, NULL);
+    kiss_fft_cpx *inv_filter = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * nfft);
+    kiss_fft_cpx *closed_time = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * nfft);
+    kiss_fft_cpx *open_time = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * nfft);
+    kiss_fft_cpx *buf_closed = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * nfft);
+    kiss_fft_cpx *buf_open = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * nfft);
+    kiss_fft_cpx *h_result = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * nfft);
+    kiss_fft_scalar *epsilon = (kiss_fft_scalar*)malloc(sizeof(kiss_fft_scalar) * (first_active + num_active));
+    
+    int ret = -1;
+    if (!cfg_fwd || !cfg_inv || !inv_filter || !closed_time || !open_time || !buf_closed || !buf_open || !h_result
+        || !epsilon) {
+        fprintf(stderr, "Failed to allocate FFT buffers\n");
+    } else {
+        ret = deconvolve_take(inputs, chirp_params, fs, nfft, n_samples_take, inv_filter, cfg_fwd, cfg_inv,
+                              closed_time, open_time);
+    }
+    close_capture_inputs(calib, meas, dec);
+    
+    if (ret == 0) {
+        generate_epsilon_bins(epsilon, chirp_params->start_freq, chirp_params->end_freq, fs, nfft,
+                              EPSILON_TRANSITION_HZ, first_active, num_active);
+    }
+    for (int k = 0; ret == 0 && k < num_sweeps; k++) {
+        /* Offsets are whole samples at the capture rate, fractional after decimation */
+        double offset = multi_sweep_offset(chirp_params, capture_fs, k) * fs / capture_fs;
+        double gain = multi_sweep_gain(chirp_params, k);
+        separate_sweep_ir(closed_time, inv_filter, h_result, buf_closed, cfg_fwd, nfft, offset, gain, npre, npost, fs,
+                          first_active, num_active);
+        separate_sweep_ir(open_time, inv_filter, h_result, buf_open, cfg_fwd, nfft, offset, gain, npre, npost, fs,
+                          first_active, num_active);
+        compute_h_lips(h_result + first_active, buf_open + first_active, buf_closed + first_active,
+                       epsilon + first_active, num_active);
+        
+        printf("Sweep %d of %d: %.1f dB, %.3f s after the first\n", k + 1, num_sweeps, 20.0 * log10(gain),
+               offset / fs);
+        char frf_path[STORE_PATH_MAX], csv_path[STORE_PATH_MAX];
+        snprintf(frf_path, sizeof(frf_path), DEFAULT_SWEEP_FRF_FILE, k + 1);
+        snprintf(csv_path, sizeof(csv_path), DEFAULT_SWEEP_FRF_CSV_FILE, k + 1);
+        frf_info.chirp.amplitude = (float)(chirp_params->amplitude * gain);
+        ret = write_frf_outputs(&frf_info, &options->export, first_bin, h_result, buf_open, buf_closed, frf_path,
+                                csv_path);
+        if (ret == 0) {
+            add_to_frf_database(sweep_frf_key(keys.frf, k), frf_path, options->subject, options->session);
+        }
+    }
+    
+    free(inv_filter);
+    free(closed_time);
+    free(open_time);
+    free(buf_closed);
+    free(buf_open);
+    free(h_result);
+    free(epsilon);
+    kiss_fft_free(cfg_fwd);
+    kiss_fft_free(cfg_inv);
+    
+    if (ret != 0) {
+        return -1;
+    }
+    printf("Processing completed successfully.\n");
+    return 0;
+}
@@ -0,0 +1,164 @@
+#define _POSIX_C_SOURCE 200809L
+#include "processing_stages.h"
+#include "processing.h"
+#include "multi_sweep.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static double elapsed_ms(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1e3 + (now.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+/* Prints the table and writes it as CSV */
+static int write_param_sweep_table(const ParamSetting *settings, const ParamMetrics *metrics, int n, double fs) {
+    FILE *csv = fopen(DEFAULT_PARAM_SWEEP_FILE, "w");
+    if (!csv) {
+        fprintf(stderr, "Failed to create '%s'\n", DEFAULT_PARAM_SWEEP_FILE);
+        return -1;
+    }
+    fprintf(csv, "pre_ms,post_ms,fade,epsilon_hz,peak_db,peak_hz,mean_db,ripple_db,delta_db\n");
+    printf("\n%8s %8s %5s %7s %8s %9s %8s %9s %8s\n", "pre_ms", "post_ms", "fade", "eps_hz",
+           "peak_db", "peak_hz", "mean_db", "ripple_db", "delta_db");
+    
+    int smoothest = 0;
+    for (int i = 0; i < n; i++) {
+        const ParamSetting *s = &settings[i];
+        const ParamMetrics *m = &metrics[i];
+        fprintf(csv, "%.3f,%.3f,%.3f,%.3f,%.4f,%.3f,%.4f,%.5f,%.5f\n", 1e3 * s->npre / fs, 1e3 * s->npost / fs,
+                s->fade, s->epsilon_hz, m->peak_db, m->peak_hz, m->mean_db, m->ripple_db, m->delta_db);
+        printf("%8.2f %8.2f %5.2f %7.1f %8.2f %9.1f %8.2f %9.4f %8.4f\n", 1e3 * s->npre / fs, 1e3 * s->npost / fs,
+               s->fade, s->epsilon_hz, m->peak_db, m->peak_hz, m->mean_db, m->ripple_db, m->delta_db);
+        if (m->ripple_db < metrics[smoothest].ripple_db) {
+            smoothest = i;
+        }
+    }
+    fclose(csv);
+    
+    printf("\nSmoothest H_lips: pre %.2f ms, post %.2f ms, fade %.2f, epsilon transition %.1f Hz\n",
+           1e3 * settings[smoothest].npre / fs, 1e3 * settings[smoothest].npost / fs, settings[smoothest].fade,
+           settings[smoothest].epsilon_hz);
+    printf("Table saved to '%s'\n", DEFAULT_PARAM_SWEEP_FILE);
+    return 0;
+}
+
+int run_param_sweep_mode(const ChirpParams *chirp_params, double sample_rate, const ProcessingOptions *options,
+                         const ParamSweepGrid *grid) {
+    printf("PARAMETER SWEEP MODE: Evaluating processing settings on the stored captures...\n");
+    
+    WavReader calib, meas;
+    ChirpParams stored_params;
+    if (open_capture_pair(&calib, &meas, chirp_params, sample_rate, &stored_params) != 0) {
+        return -1;
+    }
+    chirp_params = &stored_params;
+    if (multi_sweep_count(chirp_params) > 1) {
+        fprintf(stderr, "Parameter sweeps need single-sweep captures (these hold %d staggered sweeps)\n",
+                multi_sweep_count(chirp_params));
+        wav_reader_close(&calib);
+        wav_reader_close(&meas);
+        return -1;
+    }
+    if (chirp_params->type == MLS_CHIRP_TYPE) {
+        fprintf(stderr, "Parameter sweeps need swept captures (these are MLS takes)\n");
+        wav_reader_close(&calib);
+        wav_reader_close(&meas);
+        return -1;
+    }
+    WavReader *captures[2] = { &calib, &meas };
+    Decimator dec[2];
+    CaptureInput inputs[2];
+    double fs = open_capture_inputs(captures, chirp_params, options, dec, inputs);
+    if (fs < 0.0) {
+        wav_reader_close(&calib);
+        wav_reader_close(&meas);
+        return -1;
+    }
+    int n_samples_chirp = (int)(fs * chirp_params->duration);
+    int nfft = calculate_next_power_of_two(n_samples_chirp);
+    
+    /* Empty axes keep what processing mode uses */
+    ParamSetting defaults;
+    linear_ir_window(chirp_params->start_freq, chirp_params->end_freq, chirp_params->duration, fs,
+                     &defaults.npre, &defaults.npost);
+    defaults.fade = LINEAR_IR_FADE;
+    defaults.epsilon_hz = (float)EPSILON_TRANSITION_HZ;
+    
+    int num_settings = param_sweep_expand(grid, &defaults, fs, NULL);
+    ParamSetting *settings = (ParamSetting*)malloc(sizeof(ParamSetting) * num_settings);
+    ParamMetrics *metrics = (ParamMetrics*)malloc(sizeof(ParamMetrics) * num_settings);
+    if (!settings || !metrics) {
+        fprintf(stderr, "Failed to allocate %d parameter settings\n", num_settings);
+        free(settings);
+        free(metrics);
+        close_capture_inputs(&calib, &meas, dec);
+        return -1;
+    }
+    param_sweep_expand(grid, &defaults, fs, settings);
+    
+    for (int i = 0; i < num_settings; i++) {
+        const ParamSetting *s = &settings[i];
+        if (s->npre < 0 || s->npost <= 0 || s->npre + s->npost > nfft || s->fade < 0.0f || s->fade > 0.5f
+            || s->epsilon_hz <= 0.0f) {
+            fprintf(stderr, "Invalid setting: pre %d, post %d samples (FFT size %d), fade %.3f, epsilon %.1f Hz\n",
+                    s->npre, s->npost, nfft, s->fade, s->epsilon_hz);
+            free(settings);
+            free(metrics);
+            close_capture_inputs(&calib, &meas, dec);
+            return -1;
+        }
+    }
+    
+    /* The expensive part, done once: both captures deconvolved at full length */
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    kiss_fft_cfg cfg_fwd = kiss_fft_alloc(nfft, 0, NULL, NULL);
+    kiss_fft_cfg cfg_inv = kiss_fft_alloc(nfft, 1, NULL, NULL);
+    kiss_fft_cpx *inv_filter = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * nfft);
+    kiss_fft_cpx *open_time = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * nfft);
+    kiss_fft_cpx *closed_time = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * nfft);
+    
+    int ret = -1;
+    if (!cfg_fwd || !cfg_inv || !inv_filter || !open_time || !closed_time) {
+        fprintf(stderr, "Failed to allocate FFT buffers\n");
+    } else {
+        ret = deconvolve_take(inputs, chirp_params, fs, nfft, n_samples_chirp, inv_filter, cfg_fwd, cfg_inv,
+                              closed_time, open_time);
+    }
+    close_capture_inputs(&calib, &meas, dec);
+    free(inv_filter);
+    kiss_fft_free(cfg_fwd);
+    kiss_fft_free(cfg_inv);
+    double deconv_ms = elapsed_ms(&start);
+    
+    if (ret == 0) {
+        /* One worker per CPU, within what the budget leaves after the two time signals */
+        int num_threads = param_sweep_cpu_count();
+        int window_nfft = param_sweep_fft_size(settings, num_settings, &defaults, nfft);
+        size_t shared_bytes = 2 * sizeof(kiss_fft_cpx) * (size_t)nfft;
+        size_t thread_bytes = param_sweep_thread_memory(window_nfft);
+        if (options->memory_budget > 0) {
+            size_t fit = options->memory_budget > shared_bytes ? (options->memory_budget - shared_bytes) / thread_bytes : 0;
+            if (fit < (size_t)num_threads) num_threads = fit > 0 ? (int)fit : 1;
+        }
+        printf("Deconvolved both captures once (FFT size %d) in %.1f ms; evaluating %d settings at FFT size %d on %d thread(s)\n",
+               nfft, deconv_ms, num_settings, window_nfft, num_threads);
+        
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        ret = param_sweep_run(open_time, closed_time, nfft, fs, chirp_params->start_freq, chirp_params->end_freq,
+                              settings, num_settings, &defaults, num_threads, metrics);
+        if (ret == 0) {
+            printf("Evaluated %d settings in %.1f ms\n", num_settings, elapsed_ms(&start));
+            ret = write_param_sweep_table(settings, metrics, num_settings, fs);
+        }
+    }
+    
+    free(open_time);
+    free(closed_time);
+    free(settings);
+    free(metrics);
+    return ret;
+}
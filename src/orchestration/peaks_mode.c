@@ -0,0 +1,99 @@
+#define _POSIX_C_SOURCE 200809L
+#include "processing_stages.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static double elapsed_ms(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1e3 + (now.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+int run_peaks_mode(const ProcessingOptions *options) {
+    printf("PEAKS MODE: Resonances and anti-resonances of the FRF database\n");
+    
+    FrfDb db;
+    if (frf_db_open(&db, DEFAULT_FRF_DB_DIR) != 0) {
+        return -1;
+    }
+    FrfDbQuery query;
+    memset(&query, 0, sizeof(query));
+    query.subject = options->subject[0] ? options->subject : NULL;
+    query.session = options->session[0] ? options->session : NULL;
+    const FrfDbEntry **results = (const FrfDbEntry**)malloc(sizeof(*results) * (db.num_entries + 1));
+    FrfPeakAnalyzer an;
+    memset(&an, 0, sizeof(an));
+    FILE *file = NULL;
+    int ret = -1;
+    if (!results) {
+        fprintf(stderr, "Failed to allocate query results\n");
+        goto done;
+    }
+    size_t num_results = frf_db_query(&db, &query, results, db.num_entries);
+    
+    file = fopen(DEFAULT_DB_PEAKS_CSV_FILE, "w");
+    if (!file) {
+        fprintf(stderr, "Failed to create '%s'\n", DEFAULT_DB_PEAKS_CSV_FILE);
+        goto done;
+    }
+    fprintf(file, "Key,Subject,Session,Timestamp,Type,Frequency_Hz,Level_dB,Bandwidth_Hz,Q\n");
+    
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    size_t analysed = 0, skipped = 0, num_peaks = 0;
+    double bytes = 0.0;
+    FrfPeak peaks[FRF_PEAKS_MAX];
+    for (size_t i = 0; i < num_results; i++) {
+        const FrfDbEntry *entry = results[i];
+        int first;
+        int count = frf_db_point_range(entry, entry->info.chirp.start_freq, entry->info.chirp.end_freq, &first);
+        if (count < 3) {
+            skipped++;
+            continue;
+        }
+        /* Entries on the grid of the one before reuse its smoothing windows */
+        FrfGrid grid;
+        frf_grid_slice(&grid, &entry->info.grid, first, count);
+        if (!an.freq || grid.type != an.grid.type || grid.f_min != an.grid.f_min || grid.f_max != an.grid.f_max
+            || grid.num_points != an.grid.num_points) {
+            frf_peaks_free(&an);
+            if (frf_peaks_init(&an, &grid, &options->peaks) != 0) {
+                goto done;
+            }
+        }
+        frf_peaks_set_float32(&an, frf_db_array(&db, entry, FRF_ARRAY_H_LIPS) + first);
+        int n = frf_peaks_find(&an, peaks, FRF_PEAKS_MAX);
+        
+        char prefix[2 * FRF_DB_NAME_SIZE + 48];
+        snprintf(prefix, sizeof(prefix), "%016llx,%s,%s,%lld,", (unsigned long long)entry->key, entry->subject,
+                 entry->session, (long long)entry->timestamp);
+        write_peak_rows(file, prefix, peaks, n);
+        analysed++;
+        num_peaks += (size_t)n;
+        bytes += (double)count * sizeof(float_cpx);
+    }
+    double ms = elapsed_ms(&start);
+    if (fclose(file) != 0) {
+        file = NULL;
+        fprintf(stderr, "Failed to write '%s'\n", DEFAULT_DB_PEAKS_CSV_FILE);
+        goto done;
+    }
+    file = NULL;
+    
+    printf("%zu of %zu entries matched; %zu analysed, %zu without a sweep band on their grid\n", num_results,
+           db.num_entries, analysed, skipped);
+    printf("%zu peaks in %.1f ms (%.0f MB/s of H_lips)\n", num_peaks, ms, ms > 0.0 ? bytes / 1e3 / ms : 0.0);
+    printf("Peaks saved to '%s'\n", DEFAULT_DB_PEAKS_CSV_FILE);
+    ret = 0;
+    
+done:
+    if (file) {
+        fclose(file);
+    }
+    frf_peaks_free(&an);
+    free(results);
+    frf_db_close(&db);
+    return ret;
+}
@@ -1,88 +1,364 @@
+#define _POSIX_C_SOURCE 200809L
 #include "pipeline.h"
 #include "audio_io.h"
+#include "audio_tuning.h"
+#include "wav_io.h"
 #include "processing.h"
+#include "clock_drift.h"
+#include "multi_sweep.h"
+#include "mls.h"
 #include "user_interface.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
 
-int save_response_files(const float *response_buffer, const float *chirp_buffer, 
-                       int n_samples, int is_calibration) {
-    const char *response_filename = is_calibration ? "output/calibration_response.raw" : "output/measurement_response.raw";
-    const char *chirp_filename = is_calibration ? "output/calibration_chirp.raw" : "output/measurement_chirp.raw";
-    
-    FILE *response_file = fopen(response_filename, "wb");
-    if (!response_file) {
-        fprintf(stderr, "Failed to open file for writing response\n");
+#define DUPLEX_TIMEOUT_MARGIN_S 5.0 /* Extra wait beyond the take length before giving up */
+#define DRIFT_RESAMPLE_BLOCK 65536   /* Samples per read when resampling a drifting take */
+#define PAD_BLOCK_BYTES 16384        /* Bytes of silence per write when zero-padding a capture */
+
+/* Writes a view in its native format followed by zero padding up to n_samples */
+static int write_view_padded(FILE *file, AudioView view, int n_samples) {
+    size_t sample_bytes = (size_t)sample_format_bytes(view.format);
+    int n_view = view.length < n_samples ? view.length : n_samples;
+    if (fwrite(audio_view_ptr(view), sample_bytes, n_view * NUM_CHANNELS, file) != (size_t)(n_view * NUM_CHANNELS)) {
+        return -1;
+    }
+    
+    /* All-zero bytes are silence in every supported format */
+    static const unsigned char zero[PAD_BLOCK_BYTES];
+    size_t remaining = (size_t)(n_samples - n_view) * NUM_CHANNELS * sample_bytes;
+    while (remaining > 0) {
+        size_t chunk = remaining < sizeof(zero) ? remaining : sizeof(zero);
+        if (fwrite(zero, 1, chunk, file) != chunk) {
+            return -1;
+        }
+        remaining -= chunk;
+    }
+    return 0;
+}
+
+/* Writes a capture view as a WAV file carrying its rate, format and chirp metadata */
+static int write_view_wav(const char *filename, AudioView view, int n_samples, const ChirpParams *chirp_params) {
+    WavInfo info;
+    info.sample_rate = view.sample_rate;
+    info.num_channels = NUM_CHANNELS;
+    info.format = view.format;
+    info.num_frames = n_samples;
+    info.has_chirp = 1;
+    info.chirp = *chirp_params;
+    
+    FILE *file = wav_write_begin(filename, &info);
+    if (!file) {
+        return -1;
+    }
+    if (write_view_padded(file, view, n_samples) != 0) {
+        fclose(file);
+        return -1;
+    }
+    return wav_write_end(file, &info);
+}
+
+int save_response_files(AudioView response, AudioView chirp, int n_samples,
+                        const ChirpParams *chirp_params, int is_calibration) {
+    const char *response_filename = is_calibration ? "output/calibration_response.wav" : "output/measurement_response.wav";
+    const char *chirp_filename = is_calibration ? "output/calibration_chirp.wav" : "output/measurement_chirp.wav";
+    
+    if (response.length < n_samples) {
+        printf("Warning: only %d of %d aligned response samples recorded, zero-padding\n", response.length, n_samples);
+    }
+    
+    if (write_view_wav(response_filename, response, n_samples, chirp_params) != 0) {
+        fprintf(stderr, "Failed to write response to '%s'\n", response_filename);
         return -1;
     }
-    fwrite(response_buffer, sizeof(float), n_samples * NUM_CHANNELS, response_file);
-    fclose(response_file);
     printf("%s response saved to '%s'\n", is_calibration ? "Calibration" : "Measurement", response_filename);
     
-    FILE *chirp_file = fopen(chirp_filename, "wb");
-    if (!chirp_file) {
-        fprintf(stderr, "Failed to open file for writing chirp\n");
+    if (write_view_wav(chirp_filename, chirp, n_samples, chirp_params) != 0) {
+        fprintf(stderr, "Failed to write chirp to '%s'\n", chirp_filename);
         return -1;
     }
-    fwrite(chirp_buffer, sizeof(float), n_samples * NUM_CHANNELS, chirp_file);
-    fclose(chirp_file);
     printf("%s chirp saved to '%s'\n", is_calibration ? "Calibration" : "Measurement", chirp_filename);
     
     return 0;
 }
 
-int save_calibration_parameters(const ChirpParams *chirp_params) {
-    FILE *param_file = fopen("output/calibration_parameters.txt", "w");
+static int write_parameters_file(const char *filename, const ChirpParams *chirp_params, const AudioConfig *audio_cfg) {
+    FILE *param_file = fopen(filename, "w");
     if (!param_file) {
-        fprintf(stderr, "Failed to open file for writing calibration parameters\n");
+        fprintf(stderr, "Failed to open '%s' for writing parameters\n", filename);
         return -1;
     }
     
     fprintf(param_file, "Chirp Duration: %.2f seconds\n", chirp_params->duration);
     fprintf(param_file, "Chirp Start Frequency: %.2f Hz\n", chirp_params->start_freq);
     fprintf(param_file, "Chirp End Frequency: %.2f Hz\n", chirp_params->end_freq);
-    fprintf(param_file, "Chirp Type: %s\n", (chirp_params->type == 0) ? "Linear" : "Exponential");
+    fprintf(param_file, "Chirp Type: %s\n", (chirp_params->type == 0) ? "Linear"
+                                          : chirp_params->type == MLS_CHIRP_TYPE ? "MLS" : "Exponential");
     fprintf(param_file, "Chirp Amplitude: %.2f\n", chirp_params->amplitude);
     fprintf(param_file, "Chirp Gap Duration: %.2f seconds\n", chirp_params->Tgap);
     fprintf(param_file, "Chirp Fade Duration: %.2f seconds\n", chirp_params->Tfade);
+    if (multi_sweep_count(chirp_params) > 1) {
+        fprintf(param_file, "Staggered Sweeps: %d\n", chirp_params->num_sweeps);
+        fprintf(param_file, "Sweep Stagger: %.3f seconds\n", chirp_params->sweep_stagger);
+        fprintf(param_file, "Sweep Level Step: %.2f dB\n", chirp_params->sweep_level_step);
+    }
+    if (chirp_params->type == MLS_CHIRP_TYPE) {
+        fprintf(param_file, "MLS Order: %d (%d samples per period)\n", chirp_params->mls_order,
+                mls_length(chirp_params->mls_order));
+        fprintf(param_file, "MLS Periods: %d averaged after one lead-in\n", chirp_params->mls_periods);
+    }
+    fprintf(param_file, "Sample Rate: %.0f Hz\n", audio_cfg->sample_rate);
+    fprintf(param_file, "Capture Format: %s\n", sample_format_name(audio_cfg->capture_format));
+    fprintf(param_file, "Capture Scale: %.10g\n", sample_format_scale(audio_cfg->capture_format));
     fclose(param_file);
+    
+    return 0;
+}
+
+int save_calibration_parameters(const ChirpParams *chirp_params, const AudioConfig *audio_cfg) {
+    if (write_parameters_file("output/calibration_parameters.txt", chirp_params, audio_cfg) != 0) {
+        return -1;
+    }
     printf("Calibration parameters saved to 'output/calibration_parameters.txt'\n");
+    return 0;
+}
+
+int save_measurement_parameters(const ChirpParams *chirp_params, const AudioConfig *audio_cfg) {
+    if (write_parameters_file("output/measurement_parameters.txt", chirp_params, audio_cfg) != 0) {
+        return -1;
+    }
+    printf("Measurement parameters saved to 'output/measurement_parameters.txt'\n");
+    return 0;
+}
+
+int configure_stream_tuning(AudioConfig *audio_cfg, TunerPolicy policy) {
+    memset(&audio_cfg->tuning, 0, sizeof(audio_cfg->tuning));
+    
+    if (audio_tuning_load(DEFAULT_TUNING_FILE, audio_cfg->output_device, audio_cfg->input_device,
+                          audio_cfg->sample_rate, &audio_cfg->tuning) == 0) {
+        printf("Using saved stream tuning: %lu frames per buffer, latency in %.1f ms / out %.1f ms\n",
+               audio_cfg->tuning.frames_per_buffer, audio_cfg->tuning.input_latency * 1000,
+               audio_cfg->tuning.output_latency * 1000);
+        return 0;
+    }
+    
+    int run_tuner = (policy == TUNER_RUN) || (policy == TUNER_ASK && prompt_run_tuner());
+    if (!run_tuner) {
+        printf("Using default stream settings.\n");
+        return 0;
+    }
     
+    AudioStreamTuning tuned;
+    if (audio_tune_duplex(audio_cfg->output_device, audio_cfg->input_device, audio_cfg->sample_rate,
+                          NUM_CHANNELS, &tuned) != 0) {
+        printf("Using default stream settings.\n");
+        return 0;
+    }
+    
+    audio_cfg->tuning = tuned;
+    audio_tuning_save(DEFAULT_TUNING_FILE, audio_cfg->output_device, audio_cfg->input_device,
+                      audio_cfg->sample_rate, &tuned);
+    return 0;
+}
+
+/* Sample source over a float array */
+static int read_float_samples(void *context, int64_t first, int count, float *dst) {
+    memcpy(dst, (const float *)context + first, sizeof(float) * count);
+    return 0;
+}
+
+/*
+ * Fits the clock model of a take (see clock_drift.h) and, when the drift
+ * adds up to DRIFT_CORRECTION_SAMPLES over the take, returns the
+ * recording resampled onto the output clock with the delay removed:
+ * n_samples floats, aligned with the chirp. NULL when no correction
+ * applies or it fails; the take is then aligned by the constant delay.
+ */
+static float *correct_clock_drift(const float *record, const float *chirp_buffer, int n_samples,
+                                  const ChirpParams *chirp_params, double fs, int delay_samples) {
+    ClockDrift drift;
+    int sweep_first = (int)((chirp_params->Tgap / 2) * fs);
+    
+    /* Of staggered sweeps, the first alone is the reference: the fit follows one sweep law */
+    float *first_sweep = NULL;
+    if (multi_sweep_count(chirp_params) > 1) {
+        first_sweep = (float*)calloc(n_samples, sizeof(float));
+        if (!first_sweep) {
+            fprintf(stderr, "Failed to allocate clock drift reference; aligning by the constant delay.\n");
+            return NULL;
+        }
+        generate_chirp(first_sweep, chirp_params->amplitude, chirp_params->start_freq, chirp_params->end_freq,
+                       chirp_params->duration, (float)fs, chirp_params->type, chirp_params->Tgap,
+                       chirp_params->Tfade);
+        chirp_buffer = first_sweep;
+    }
+    int ret = estimate_clock_drift(record, chirp_buffer, n_samples, chirp_params, fs, sweep_first, delay_samples,
+                                   &drift);
+    free(first_sweep);
+    if (ret != 0) {
+        printf("Clock drift could not be measured; aligning by the constant delay.\n");
+        return NULL;
+    }
+    double drift_samples = (drift.ratio - 1.0) * n_samples;
+    printf("Clock drift: %+.2f ppm (%+.2f samples over the take, fit residual %.3f samples over %d segments)\n",
+           clock_drift_ppm(&drift), drift_samples, drift.residual, drift.num_segments);
+    if (fabs(drift_samples) < DRIFT_CORRECTION_SAMPLES) {
+        return NULL;
+    }
+
+    Resampler resampler;
+    float *corrected = (float*)malloc(sizeof(float) * n_samples);
+    if (!corrected || resampler_init(&resampler, drift.offset, drift.ratio, read_float_samples, (void *)record,
+                                     n_samples) != 0) {
+        fprintf(stderr, "Failed to set up clock drift correction; aligning by the constant delay.\n");
+        free(corrected);
+        return NULL;
+    }
+    for (int first = 0; first < n_samples; first += DRIFT_RESAMPLE_BLOCK) {
+        int count = n_samples - first < DRIFT_RESAMPLE_BLOCK ? n_samples - first : DRIFT_RESAMPLE_BLOCK;
+        if (resampler_read(&resampler, first, count, corrected + first) != 0) {
+            fprintf(stderr, "Clock drift correction failed; aligning by the constant delay.\n");
+            free(corrected);
+            corrected = NULL;
+            break;
+        }
+    }
+    resampler_free(&resampler);
+    if (corrected) {
+        printf("Resampled the recording onto the output clock (delay %.2f samples).\n", drift.offset);
+    }
+    return corrected;
+}
+
+/* Samples of a take's excitation with its silence padding */
+static int take_samples(const ChirpParams *chirp_params, double fs) {
+    if (chirp_params->type == MLS_CHIRP_TYPE) {
+        return 2 * (int)((chirp_params->Tgap / 2) * fs) + mls_excitation_samples(chirp_params);
+    }
+    return (int)(fs * (multi_sweep_duration(chirp_params) + chirp_params->Tgap));
+}
+
+/*
+ * Fills the chirp buffer of a take: the chirp, the MLS periods of an MLS
+ * take, or the staggered sweeps of a multiple-sweep take, which must not
+ * add up to clipping.
+ */
+static int generate_take_excitation(float *chirp_buffer, const ChirpParams *chirp_params, double fs,
+                                    int n_samples_chirp) {
+    if (chirp_params->type == MLS_CHIRP_TYPE) {
+        if (generate_mls(chirp_buffer, chirp_params, (float)fs) != 0) {
+            return -1;
+        }
+        printf("MLS of order %d: %d periods of %d samples (%.3f s) after one lead-in (%.2f s take)\n",
+               chirp_params->mls_order, chirp_params->mls_periods, mls_length(chirp_params->mls_order),
+               mls_length(chirp_params->mls_order) / fs, n_samples_chirp / fs);
+        return 0;
+    }
+    if (generate_multi_sweep(chirp_buffer, chirp_params, (float)fs) != 0) {
+        return -1;
+    }
+    int num_sweeps = multi_sweep_count(chirp_params);
+    if (num_sweeps > 1) {
+        float peak = find_peak_amplitude(chirp_buffer, n_samples_chirp);
+        if (peak > 1.0f) {
+            fprintf(stderr, "The %d staggered sweeps peak at %.2f of full scale; lower the amplitude\n",
+                    num_sweeps, peak);
+            return -1;
+        }
+        printf("%d staggered sweeps, %.3f s apart, %.1f dB steps (%.2f s take, peak %.2f)\n", num_sweeps,
+               chirp_params->sweep_stagger, chirp_params->sweep_level_step, n_samples_chirp / fs, peak);
+    }
     return 0;
 }
 
-static int perform_duplex_and_align(const AudioConfig *audio_cfg, const float *chirp_buffer, 
-                                   float *record_buffer, int n_samples_record) {
+static int perform_duplex_and_align(const AudioConfig *audio_cfg, const ChirpParams *chirp_params,
+                                   const float *chirp_buffer, void *record_buffer, int n_samples_record,
+                                   AudioView *record_view, AudioView *chirp_view, float **corrected) {
     printf("Starting full-duplex audio (play chirp and record response)...\n");
-    if (audio_duplex_callback(audio_cfg->output_device, audio_cfg->input_device, SAMPLE_RATE, 
-                             chirp_buffer, record_buffer, n_samples_record, NUM_CHANNELS) != 0) {
+    AudioDuplexHandle *take = audio_duplex_start_native(audio_cfg->output_device, audio_cfg->input_device, 
+                                                        audio_cfg->sample_rate, chirp_buffer, 
+                                                        record_buffer, audio_cfg->capture_format,
+                                                        n_samples_record, NUM_CHANNELS, &audio_cfg->tuning);
+    if (!take) {
+        fprintf(stderr, "Failed to perform full-duplex audio\n");
+        return -1;
+    }
+    
+    /* Capture runs on the audio thread; bound the wait by the take length plus a margin */
+    double timeout = (double)n_samples_record / audio_cfg->sample_rate + DUPLEX_TIMEOUT_MARGIN_S;
+    if (audio_duplex_wait(take, timeout) != 0) {
+        fprintf(stderr, "Full-duplex audio did not complete within %.1f seconds\n", timeout);
+        audio_duplex_close(take);
+        return -1;
+    }
+    if (audio_duplex_close(take) != 0) {
         fprintf(stderr, "Failed to perform full-duplex audio\n");
         return -1;
     }
     printf("Full-duplex audio completed successfully.\n");
     
     printf("Estimating delay and aligning recorded response with chirp...\n");
-    int delay_samples = -estimate_delay(record_buffer, chirp_buffer, n_samples_record);
+    const float *record = (const float *)record_buffer;
+    float *record_float = NULL;
+    if (audio_cfg->capture_format != SAMPLE_FORMAT_FLOAT32) {
+        /* Cross-correlation needs float; the converted copy is dropped after alignment */
+        record_float = (float*)malloc(sizeof(float) * n_samples_record);
+        if (!record_float) {
+            fprintf(stderr, "Failed to allocate delay estimation buffer\n");
+            return -1;
+        }
+        sample_format_to_float(record_buffer, audio_cfg->capture_format, record_float, n_samples_record);
+        record = record_float;
+    }
+    int delay_samples = -estimate_delay(record, chirp_buffer, n_samples_record);
     printf("Estimated delay: %d samples\n", delay_samples);
     
-    for (int i = 0; i < n_samples_record - delay_samples; i++) {
-        record_buffer[i] = record_buffer[i + delay_samples];
+    /* Split devices run on separate clocks; a drifting take is resampled (stored as float32 from then on) */
+    *corrected = NULL;
+    int split_devices = audio_cfg->input_device != audio_cfg->output_device;
+    int fit_drift = audio_cfg->clock_drift == DRIFT_ON || (audio_cfg->clock_drift == DRIFT_AUTO && split_devices);
+    if (fit_drift && chirp_params->type == MLS_CHIRP_TYPE) {
+        printf("Clock drift is fitted on sweeps; aligning the MLS take by the constant delay.\n");
+    } else if (fit_drift) {
+        *corrected = correct_clock_drift(record, chirp_buffer, n_samples_record, chirp_params,
+                                         audio_cfg->sample_rate, delay_samples);
+    }
+    free(record_float);
+    if (*corrected) {
+        *record_view = audio_view_make(*corrected, SAMPLE_FORMAT_FLOAT32, n_samples_record, audio_cfg->sample_rate);
+        *chirp_view = audio_view_make(chirp_buffer, SAMPLE_FORMAT_FLOAT32, n_samples_record, audio_cfg->sample_rate);
+        printf("Aligned recorded response with chirp.\n");
+        return 0;
+    }
+    
+    /* Align by advancing whichever signal leads; no samples are moved */
+    *record_view = audio_view_make(record_buffer, audio_cfg->capture_format, n_samples_record, audio_cfg->sample_rate);
+    *chirp_view = audio_view_make(chirp_buffer, SAMPLE_FORMAT_FLOAT32, n_samples_record, audio_cfg->sample_rate);
+    if (delay_samples >= 0) {
+        *record_view = audio_view_advance(*record_view, delay_samples);
+    } else {
+        *chirp_view = audio_view_advance(*chirp_view, -delay_samples);
     }
-    printf("Shifted recorded response to align with chirp.\n");
+    printf("Aligned recorded response with chirp.\n");
     
     return 0;
 }
 
 int run_calibration_mode(const AudioConfig *audio_cfg, const ChirpParams *chirp_params, 
                         float recording_duration) {
-    int n_samples_chirp = (int)(SAMPLE_RATE * (chirp_params->duration + chirp_params->Tgap));
-    int n_samples_record = (int)(SAMPLE_RATE * recording_duration);
+    double fs = audio_cfg->sample_rate;
+    int n_samples_chirp = take_samples(chirp_params, fs);
+    int n_samples_record = (int)(fs * recording_duration);
+    if (n_samples_record < n_samples_chirp) {
+        fprintf(stderr, "Recording of %d samples is shorter than the %d-sample take\n", n_samples_record,
+                n_samples_chirp);
+        return -1;
+    }
     
     /* Allocate buffers */
     float *chirp_buffer = (float*)malloc(sizeof(float) * n_samples_record);
-    float *record_buffer = (float*)malloc(sizeof(float) * n_samples_record * NUM_CHANNELS);
+    void *record_buffer = malloc((size_t)sample_format_bytes(audio_cfg->capture_format) * n_samples_record * NUM_CHANNELS);
     
     if (!chirp_buffer || !record_buffer) {
         fprintf(stderr, "Failed to allocate buffers\n");
@@ -91,61 +367,54 @@ int run_calibration_mode(const AudioConfig *audio_cfg, const ChirpParams *chirp_
         return -1;
     }
     
-    /* Generate chirp */
-    generate_chirp(chirp_buffer, chirp_params->amplitude, chirp_params->start_freq, 
-                   chirp_params->end_freq, chirp_params->duration, SAMPLE_RATE, chirp_params->type,
-                   chirp_params->Tgap, chirp_params->Tfade);
+    /* Generate chirp (or the staggered sweeps) */
+    if (generate_take_excitation(chirp_buffer, chirp_params, fs, n_samples_chirp) != 0) {
+        free(chirp_buffer);
+        free(record_buffer);
+        return -1;
+    }
     
     for (int i = n_samples_chirp; i < n_samples_record; i++) {
         chirp_buffer[i] = 0.0f;
     }
     
-    /* Preview */
-    if (confirm_and_preview(audio_cfg->output_device, chirp_buffer, n_samples_chirp) != 0) {
-        free(chirp_buffer);
-        free(record_buffer);
-        return -1;
+    /* Preview and user confirmation */
+    if (audio_cfg->interactive) {
+        if (confirm_and_preview(audio_cfg->output_device, fs, chirp_buffer, n_samples_chirp) != 0) {
+            free(chirp_buffer);
+            free(record_buffer);
+            return -1;
+        }
+        prompt_ready("CALIBRATION");
+    } else {
+        printf("\nCALIBRATION MODE: batch run, starting take\n");
     }
     
-    /* User confirmation */
-    prompt_ready("CALIBRATION");
-    
     /* Perform duplex and align */
-    if (perform_duplex_and_align(audio_cfg, chirp_buffer, record_buffer, n_samples_record) != 0) {
+    AudioView record_view, chirp_view;
+    float *corrected = NULL;
+    if (perform_duplex_and_align(audio_cfg, chirp_params, chirp_buffer, record_buffer, n_samples_record,
+                                 &record_view, &chirp_view, &corrected) != 0) {
         free(chirp_buffer);
         free(record_buffer);
         return -1;
     }
     
     /* Trim and save */
-    float *record_buffer_final = (float*)malloc(sizeof(float) * n_samples_chirp * NUM_CHANNELS);
-    float *chirp_buffer_final = (float*)malloc(sizeof(float) * n_samples_chirp * NUM_CHANNELS);
+    record_view = audio_view_trim(record_view, n_samples_chirp);
+    chirp_view = audio_view_trim(chirp_view, n_samples_chirp);
     
-    if (!record_buffer_final || !chirp_buffer_final) {
-        fprintf(stderr, "Failed to allocate final buffers\n");
+    if (save_response_files(record_view, chirp_view, n_samples_chirp, chirp_params, 1) != 0) {
         free(chirp_buffer);
         free(record_buffer);
-        free(record_buffer_final);
-        free(chirp_buffer_final);
+        free(corrected);
         return -1;
     }
     
-    memcpy(record_buffer_final, record_buffer, sizeof(float) * n_samples_chirp * NUM_CHANNELS);
-    memcpy(chirp_buffer_final, chirp_buffer, sizeof(float) * n_samples_chirp * NUM_CHANNELS);
-    
-    if (save_response_files(record_buffer_final, chirp_buffer_final, n_samples_chirp, 1) != 0) {
-        free(chirp_buffer);
-        free(record_buffer);
-        free(record_buffer_final);
-        free(chirp_buffer_final);
-        return -1;
-    }
-    
-    if (save_calibration_parameters(chirp_params) != 0) {
+    if (save_calibration_parameters(chirp_params, audio_cfg) != 0) {
         free(chirp_buffer);
         free(record_buffer);
-        free(record_buffer_final);
-        free(chirp_buffer_final);
+        free(corrected);
         return -1;
     }
     
@@ -153,20 +422,25 @@ int run_calibration_mode(const AudioConfig *audio_cfg, const ChirpParams *chirp_
 
     free(chirp_buffer);
     free(record_buffer);
-    free(record_buffer_final);
-    free(chirp_buffer_final);
+    free(corrected);
     
     return 0;
 }
 
 int run_measurement_mode(const AudioConfig *audio_cfg, const ChirpParams *chirp_params, 
                         float recording_duration) {
-    int n_samples_chirp = (int)(SAMPLE_RATE * (chirp_params->duration + chirp_params->Tgap));
-    int n_samples_record = (int)(SAMPLE_RATE * recording_duration);
+    double fs = audio_cfg->sample_rate;
+    int n_samples_chirp = take_samples(chirp_params, fs);
+    int n_samples_record = (int)(fs * recording_duration);
+    if (n_samples_record < n_samples_chirp) {
+        fprintf(stderr, "Recording of %d samples is shorter than the %d-sample take\n", n_samples_record,
+                n_samples_chirp);
+        return -1;
+    }
     
     /* Allocate buffers */
     float *chirp_buffer = (float*)malloc(sizeof(float) * n_samples_record);
-    float *record_buffer = (float*)malloc(sizeof(float) * n_samples_record * NUM_CHANNELS);
+    void *record_buffer = malloc((size_t)sample_format_bytes(audio_cfg->capture_format) * n_samples_record * NUM_CHANNELS);
     
     if (!chirp_buffer || !record_buffer) {
         fprintf(stderr, "Failed to allocate buffers\n");
@@ -175,53 +449,54 @@ int run_measurement_mode(const AudioConfig *audio_cfg, const ChirpParams *chirp_
         return -1;
     }
     
-    /* Generate chirp */
-    generate_chirp(chirp_buffer, chirp_params->amplitude, chirp_params->start_freq, 
-                   chirp_params->end_freq, chirp_params->duration, SAMPLE_RATE, chirp_params->type,
-                   chirp_params->Tgap, chirp_params->Tfade);
+    /* Generate chirp (or the staggered sweeps) */
+    if (generate_take_excitation(chirp_buffer, chirp_params, fs, n_samples_chirp) != 0) {
+        free(chirp_buffer);
+        free(record_buffer);
+        return -1;
+    }
     
     for (int i = n_samples_chirp; i < n_samples_record; i++) {
         chirp_buffer[i] = 0.0f;
     }
     
-    /* Preview */
-    if (confirm_and_preview(audio_cfg->output_device, chirp_buffer, n_samples_chirp) != 0) {
-        free(chirp_buffer);
-        free(record_buffer);
-        return -1;
+    /* Preview and user confirmation */
+    if (audio_cfg->interactive) {
+        if (confirm_and_preview(audio_cfg->output_device, fs, chirp_buffer, n_samples_chirp) != 0) {
+            free(chirp_buffer);
+            free(record_buffer);
+            return -1;
+        }
+        prompt_ready("MEASUREMENT");
+    } else {
+        printf("\nMEASUREMENT MODE: batch run, starting take\n");
     }
     
-    /* User confirmation */
-    prompt_ready("MEASUREMENT");
-    
     /* Perform duplex and align */
-    if (perform_duplex_and_align(audio_cfg, chirp_buffer, record_buffer, n_samples_record) != 0) {
+    AudioView record_view, chirp_view;
+    float *corrected = NULL;
+    if (perform_duplex_and_align(audio_cfg, chirp_params, chirp_buffer, record_buffer, n_samples_record,
+                                 &record_view, &chirp_view, &corrected) != 0) {
         free(chirp_buffer);
         free(record_buffer);
         return -1;
     }
     
     /* Trim and save */
-    float *record_buffer_final = (float*)malloc(sizeof(float) * n_samples_chirp * NUM_CHANNELS);
-    float *chirp_buffer_final = (float*)malloc(sizeof(float) * n_samples_chirp * NUM_CHANNELS);
+    record_view = audio_view_trim(record_view, n_samples_chirp);
+    chirp_view = audio_view_trim(chirp_view, n_samples_chirp);
     
-    if (!record_buffer_final || !chirp_buffer_final) {
-        fprintf(stderr, "Failed to allocate final buffers\n");
+    if (save_response_files(record_view, chirp_view, n_samples_chirp, chirp_params, 0) != 0) {
         free(chirp_buffer);
         free(record_buffer);
-        free(record_buffer_final);
-        free(chirp_buffer_final);
+        free(corrected);
         return -1;
     }
     
-    memcpy(record_buffer_final, record_buffer, sizeof(float) * n_samples_chirp * NUM_CHANNELS);
-    memcpy(chirp_buffer_final, chirp_buffer, sizeof(float) * n_samples_chirp * NUM_CHANNELS);
-    
-    if (save_response_files(record_buffer_final, chirp_buffer_final, n_samples_chirp, 0) != 0) {
+    if (save_measurement_parameters(chirp_params, audio_cfg) != 0) {
         free(chirp_buffer);
         free(record_buffer);
-        free(record_buffer_final);
-        free(chirp_buffer_final);
+        free(corrected);
         return -1;
     }
     
@@ -229,156 +504,7 @@ int run_measurement_mode(const AudioConfig *audio_cfg, const ChirpParams *chirp_
     
     free(chirp_buffer);
     free(record_buffer);
-    free(record_buffer_final);
-    free(chirp_buffer_final);
-    
-    return 0;
-}
-
-int run_processing_mode(const ChirpParams *chirp_params) {
-    printf("PROCESSING MODE: Initializing processing pipeline...\n");
-    
-    int n_samples_chirp = (int)(SAMPLE_RATE * chirp_params->duration);
-    int nfft = calculate_next_power_of_two(n_samples_chirp);
-    printf("Using FFT size of %d for processing\n", nfft);
-    
-    /* Load calibration and measurement responses */
-    float *calibration_response = (float*)malloc(sizeof(float) * n_samples_chirp * NUM_CHANNELS);
-    float *measurement_response = (float*)malloc(sizeof(float) * n_samples_chirp * NUM_CHANNELS);
-    
-    if (!calibration_response || !measurement_response) {
-        fprintf(stderr, "Failed to allocate buffers for processing\n");
-        free(calibration_response);
-        free(measurement_response);
-        return -1;
-    }
-    
-    FILE *calib_file = fopen("output/calibration_response.raw", "rb");
-    if (!calib_file) {
-        fprintf(stderr, "Failed to open calibration response file\n");
-        free(calibration_response);
-        free(measurement_response);
-        return -1;
-    }
-    
-    FILE *meas_file = fopen("output/measurement_response.raw", "rb");
-    if (!meas_file) {
-        fprintf(stderr, "Failed to open measurement response file\n");
-        free(calibration_response);
-        free(measurement_response);
-        fclose(calib_file);
-        return -1;
-    }
-    
-    fread(calibration_response, sizeof(float), n_samples_chirp * NUM_CHANNELS, calib_file);
-    fread(measurement_response, sizeof(float), n_samples_chirp * NUM_CHANNELS, meas_file);
-    fclose(calib_file);
-    fclose(meas_file);
-    printf("Successfully loaded calibration and measurement responses.\n");
-    
-    /* Allocate FFT buffers */
-    kiss_fft_cfg cfg_fwd = kiss_fft_alloc(nfft, 0, NULL, NULL);
-    kiss_fft_cfg cfg_inv = kiss_fft_alloc(nfft, 1, NULL, NULL);
-    
-    kiss_fft_cpx *buf_closed = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * nfft);
-    kiss_fft_cpx *buf_open = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * nfft);
-    kiss_fft_cpx *inv_filter = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * nfft);
-    kiss_fft_cpx *h_result = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * nfft);
-    float *epsilon = (float*)malloc(sizeof(float) * nfft);
-    
-    if (!buf_closed || !buf_open || !inv_filter || !h_result || !epsilon) {
-        fprintf(stderr, "Failed to allocate FFT buffers\n");
-        free(buf_closed);
-        free(buf_open);
-        free(inv_filter);
-        free(h_result);
-        free(epsilon);
-        free(calibration_response);
-        free(measurement_response);
-        return -1;
-    }
-    
-    /* Convert to complex format */
-    for (int i = 0; i < nfft; i++) {
-        buf_closed[i].r = (i < n_samples_chirp) ? calibration_response[i] : 0.0f;
-        buf_closed[i].i = 0.0f;
-        buf_open[i].r = (i < n_samples_chirp) ? measurement_response[i] : 0.0f;
-        buf_open[i].i = 0.0f;
-    }
-    
-    free(calibration_response);
-    free(measurement_response);
-    
-    /* Generate inverse filter and compute FFT */
-    generate_inverse_filter(inv_filter, chirp_params->amplitude, chirp_params->start_freq, chirp_params->end_freq, 
-                           chirp_params->duration, SAMPLE_RATE, nfft, chirp_params->type);
-    
-    kiss_fft(cfg_fwd, buf_closed, buf_closed);
-    kiss_fft(cfg_fwd, buf_open, buf_open);
-    
-    /* Perform deconvolution */
-    perform_deconvolution(buf_closed, inv_filter, nfft);
-    perform_deconvolution(buf_open, inv_filter, nfft);
-    
-    /* Estimate regularization parameter We */
-    double We = 0.0;
-    for (int i = 0; i < nfft / 2; i++) {
-        double mag = sqrt(complex_squared_magnitude(buf_open[i]));
-        We += mag * mag;
-    }
-    printf("Estimated We: %.6f\n", We);
-    
-    /* Generate regularization epsilon */
-    generate_epsilon(epsilon, chirp_params->start_freq, chirp_params->end_freq, SAMPLE_RATE, nfft);
-
-    float L = (1.0 / chirp_params->start_freq) * floor(chirp_params->start_freq * chirp_params->duration / logf(chirp_params->end_freq / chirp_params->start_freq));
-    float delay_harm2 = L * log(2.0f);
-
-    int npre = (int)(delay_harm2 * SAMPLE_RATE);
-    int npost = (int)(0.2 * SAMPLE_RATE);
-    
-    /* Extract linear impulse response */
-    extract_linear_ir(buf_closed, cfg_inv, cfg_fwd, nfft, n_samples_chirp, npre, npost, SAMPLE_RATE);
-    extract_linear_ir(buf_open, cfg_inv, cfg_fwd, nfft, n_samples_chirp, npre, npost, SAMPLE_RATE);
-    
-    /* Compute final transfer function */
-    compute_h_lips(h_result, buf_open, buf_closed, epsilon, nfft);
-    
-    /* Save results */
-    FILE *fp = fopen("output/real_tract_frf.csv", "w");
-    if (!fp) {
-        fprintf(stderr, "Failed to open output CSV file\n");
-        free(buf_closed);
-        free(buf_open);
-        free(inv_filter);
-        free(h_result);
-        free(epsilon);
-        return -1;
-    }
+    free(corrected);
     
-    fprintf(fp, "Frequency_Hz,Magnitude_dB,Resistance_dB,Reactance_dB,Phase_Rad\n");
-    for (int i = 0; i < nfft / 2; i++) {
-        double f = (double)i * SAMPLE_RATE / nfft;
-        double mag = sqrt(complex_squared_magnitude(h_result[i]));
-        
-        if (mag < 1e-9) mag = 1e-9;
-        double db = 20.0 * log10(mag);
-        double phase = atan2(h_result[i].i, h_result[i].r);
-        
-        fprintf(fp, "%.2f,%.4f,%.4f,%.4f,%.4f\n", f, db, h_result[i].r, h_result[i].i, phase);
-    }
-    fclose(fp);
-    printf("Results saved to 'output/real_tract_frf.csv'\n");
-    
-    /* Cleanup */
-    free(buf_closed);
-    free(buf_open);
-    free(inv_filter);
-    free(h_result);
-    free(epsilon);
-    kiss_fft_free(cfg_fwd);
-    kiss_fft_free(cfg_inv);
-    
-    printf("Processing completed successfully.\n");
     return 0;
 }
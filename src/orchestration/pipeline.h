@@ -2,6 +2,45 @@
 #define PIPELINE_H
 
 #include "config.h"
+#include "audio_view.h"
+#include "frf_io.h"
+#include "frf_db.h"
+#include "audio_tuning.h"
+#include "param_sweep.h"
+#include "decimate.h"
+#include "frf_peaks.h"
+
+#define DEFAULT_PROCESSING_MEMORY_MB 256
+#define DEFAULT_PARAM_SWEEP_FILE "output/param_sweep.csv"
+#define DEFAULT_SWEEP_FRF_FILE "output/real_tract_frf_sweep%d.frf"     /* FRF of sweep %d of a multiple-sweep take */
+#define DEFAULT_SWEEP_FRF_CSV_FILE "output/real_tract_frf_sweep%d.csv"
+#define DEFAULT_WELCH_CSV_FILE "output/real_tract_welch.csv"          /* Welch H1, H2 and coherence */
+#define WELCH_LOW_COHERENCE 0.9                                        /* Bins below this are counted in the summary */
+#define DEFAULT_PEAKS_CSV_FILE "output/real_tract_peaks.csv"          /* Resonances of the processed FRF */
+#define DEFAULT_DB_PEAKS_CSV_FILE "output/frf_peaks.csv"               /* Resonances of the FRF database entries */
+
+/* Rate reduction of the captures before processing */
+typedef enum {
+    DECIMATE_OFF,   /* Process at the capture rate */
+    DECIMATE_AUTO,  /* Lowest rate that keeps the output band (decimation_factor()) */
+    DECIMATE_FIXED  /* By decimate_up / decimate_down */
+} DecimateMode;
+
+/**
+ * Options of run_processing_mode().
+ */
+typedef struct {
+    FrfExportOptions export;
+    char subject[FRF_DB_NAME_SIZE];   /* FRF database labels */
+    char session[FRF_DB_NAME_SIZE];
+    size_t memory_budget;             /* Bytes allowed for the full-length deconvolution; captures
+                                         needing more are deconvolved in segments (0: no limit) */
+    int decimate;                     /* DecimateMode */
+    int decimate_up, decimate_down;   /* Factor of DECIMATE_FIXED */
+    int welch_segment;                /* Welch H1/H2 segment (samples, power of two), 0: no Welch estimate */
+    double welch_overlap;             /* Fraction of each Welch segment shared with the next */
+    FrfPeakOptions peaks;             /* Resonance and anti-resonance extraction */
+} ProcessingOptions;
 
 /**
  * Calculates the next power of 2 greater than or equal to n.
@@ -15,30 +54,64 @@
 int calculate_next_power_of_two(int n);
 
 /**
- * Saves recorded response and chirp to binary files.
+ * Saves recorded response and chirp as WAV (RF64 above 4 GiB) files.
+ * Each file carries its sample rate, channel count, native sample format
+ * and the chirp parameters. This is the only place aligned samples are
+ * copied; views shorter than n_samples are zero-padded so both files
+ * always hold n_samples.
  * 
  * Parameters:
- *   response_buffer: Recorded audio data
- *   chirp_buffer: Sent chirp data
- *   n_samples: Number of samples
+ *   response: Aligned view of the recorded audio
+ *   chirp: Aligned view of the sent chirp
+ *   n_samples: Number of samples to write
+ *   chirp_params: Chirp parameters stored in the files
  *   is_calibration: 1 for calibration mode, 0 for measurement
  * 
  * Returns:
  *   0 on success, -1 on failure
  */
-int save_response_files(const float *response_buffer, const float *chirp_buffer, 
-                       int n_samples, int is_calibration);
+int save_response_files(AudioView response, AudioView chirp, int n_samples,
+                        const ChirpParams *chirp_params, int is_calibration);
 
 /**
  * Saves calibration parameters to text file.
  * 
  * Parameters:
  *   chirp_params: Chirp parameters to save
+ *   audio_cfg: Capture settings (sample rate, native format and scale)
  * 
  * Returns:
  *   0 on success, -1 on failure
  */
-int save_calibration_parameters(const ChirpParams *chirp_params);
+int save_calibration_parameters(const ChirpParams *chirp_params, const AudioConfig *audio_cfg);
+
+/**
+ * Saves measurement parameters to text file.
+ * Same format as the calibration parameters file.
+ * 
+ * Parameters:
+ *   chirp_params: Chirp parameters to save
+ *   audio_cfg: Capture settings (sample rate, native format and scale)
+ * 
+ * Returns:
+ *   0 on success, -1 on failure
+ */
+int save_measurement_parameters(const ChirpParams *chirp_params, const AudioConfig *audio_cfg);
+
+/**
+ * Selects the stream buffer size and latencies for duplex takes.
+ * Uses the saved tuning for the device pair and sample rate if any;
+ * otherwise runs the tuner (asking first under TUNER_ASK) and saves its
+ * result. Falls back to default settings when tuning is skipped or fails.
+ * 
+ * Parameters:
+ *   audio_cfg: Config with devices and sample rate; tuning is written
+ *   policy: Whether to ask, skip or run the tuner when nothing is saved
+ * 
+ * Returns:
+ *   0 (defaults are always a valid fallback)
+ */
+int configure_stream_tuning(AudioConfig *audio_cfg, TunerPolicy policy);
 
 /**
  * Runs the calibration workflow.
@@ -72,14 +145,95 @@ int run_measurement_mode(const AudioConfig *audio_cfg, const ChirpParams *chirp_
 
 /**
  * Runs the processing workflow.
- * Loads calibration and measurement data, performs analysis.
+ * Opens the calibration and measurement WAV files and performs the
+ * analysis on their samples. The sample rate and chirp
+ * parameters stored in the files take precedence over the ones passed
+ * in; captures with mismatched rates or shorter than the chirp are
+ * rejected. The FRF is written as a binary container (see frf_io.h),
+ * with an optional CSV export of H_lips, either for every FFT bin or
+ * restricted to the sweep band and optionally resampled onto a linear
+ * or log grid. The FRF is also appended to the FRF database
+ * (DEFAULT_FRF_DB_DIR, see frf_db.h) under the given subject and session.
+ * 
+ * Captures are read in fixed-size chunks. When the full-length FFT
+ * deconvolution would need more than options->memory_budget, each
+ * linear IR is extracted by segmented (overlap-save) deconvolution
+ * instead (see stream_deconv.h), whose memory depends on the IR window
+ * and not on the recording length.
+ * 
+ * With options->decimate, the captures are first brought to a lower
+ * rate that still holds the sweep band plus FRF_BAND_MARGIN_OCTAVES
+ * (see decimate.h). The inverse filter, IR extraction and FRF are then
+ * computed at that rate, with FFT sizes and memory shrunk to match; a
+ * full-band FRF ends at half the reduced rate.
+ * 
+ * Captures holding staggered sweeps (chirp_params->num_sweeps > 1, see
+ * multi_sweep.h) are deconvolved once at full length whatever the
+ * budget; each sweep's IR is windowed out at its offset and gives one
+ * FRF, DEFAULT_SWEEP_FRF_FILE numbered from 1, each added to the
+ * database.
+ * 
+ * With options->welch_segment, the measurement capture is also compared
+ * with the calibration capture segment by segment (see welch.h): H1, H2
+ * and their coherence over the output band are written to
+ * DEFAULT_WELCH_CSV_FILE, whatever the session store holds, and the
+ * band's mean coherence is printed as a confidence measure of H_lips.
+ * 
+ * The resonances and anti-resonances of H_lips over the sweep band (see
+ * frf_peaks.h) are printed as a table and written to
+ * DEFAULT_PEAKS_CSV_FILE, from the FFT bins before any resampling, and
+ * kept in the session store with the FRF. Staggered sweeps get no table.
  * 
  * Parameters:
- *   chirp_params: Chirp parameters (for inverse filter generation)
+ *   chirp_params: Chirp parameters (used if the files carry none)
+ *   sample_rate: Requested sampling rate (Hz), reported if it differs;
+ *                0 if none was requested
+ *   options: Output band, grid, CSV export, database labels, memory budget, decimation, Welch segment,
+ *            peak options
  * 
  * Returns:
  *   0 on success, -1 on failure
  */
-int run_processing_mode(const ChirpParams *chirp_params);
+int run_processing_mode(const ChirpParams *chirp_params, double sample_rate, const ProcessingOptions *options);
+
+/**
+ * Evaluates a grid of processing settings (IR window lengths and taper,
+ * epsilon transition width) on the stored captures.
+ *
+ * Both captures are deconvolved once at full length; every setting is
+ * then windowed and regularized from those time signals on worker
+ * threads (one per CPU, as many as the memory budget allows). Each
+ * setting's H_lips figures over the band (peak, mean level, ripple and
+ * deviation from the default setting) are printed as a table and
+ * written to DEFAULT_PARAM_SWEEP_FILE. Nothing goes to the session
+ * store or the FRF database.
+ *
+ * Parameters:
+ *   chirp_params: Chirp parameters (used if the files carry none)
+ *   sample_rate: Requested sampling rate (Hz), reported if it differs; 0 if none
+ *   options: Memory budget and decimation (the other fields are not used)
+ *   grid: Values of each setting to try
+ *
+ * Returns:
+ *   0 on success, -1 on failure
+ */
+int run_param_sweep_mode(const ChirpParams *chirp_params, double sample_rate, const ProcessingOptions *options,
+                         const ParamSweepGrid *grid);
+
+/**
+ * Extracts the resonances and anti-resonances of every FRF database
+ * entry matching the subject and session labels (all entries if none
+ * are set), over each entry's sweep band. The spectra are read in place
+ * from the mapped database; one analyzer serves all entries on the same
+ * grid. The peaks are written to DEFAULT_DB_PEAKS_CSV_FILE, one row per
+ * peak, with the entry's key, labels and timestamp.
+ *
+ * Parameters:
+ *   options: Database labels and peak options (the other fields are not used)
+ *
+ * Returns:
+ *   0 on success, -1 if the database cannot be opened or the table written
+ */
+int run_peaks_mode(const ProcessingOptions *options);
 
 #endif
@@ -0,0 +1,250 @@
+#define _POSIX_C_SOURCE 200809L
+#include "processing_stages.h"
+#include "processing.h"
+#include "stream_deconv.h"
+#include "multi_sweep.h"
+#include "welch.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+/*
+ * Welch-averaged H1 / H2 of the measurement (output) against the
+ * calibration (input) capture: both takes play the same excitation from
+ * sample 0, so each pair of segments sees the same part of it and their
+ * ratio is H_lips. Writes the sweep band plus the FRF band margin, at
+ * the segment's resolution, to DEFAULT_WELCH_CSV_FILE and prints the
+ * band's coherence.
+ */
+static int run_welch_estimate(WavReader *captures[2], const Decimator dec[2], const CaptureInput inputs[2],
+                              const ChirpParams *chirp_params, double fs, const ProcessingOptions *options) {
+    WelchEstimator est;
+    if (welch_init(&est, options->welch_segment, options->welch_overlap) != 0) {
+        return -1;
+    }
+    int64_t n_closed = capture_input_length(captures[0], &dec[0]);
+    int64_t n_open = capture_input_length(captures[1], &dec[1]);
+    int64_t count = n_closed < n_open ? n_closed : n_open;
+    int chunk = inputs[0].chunk < inputs[1].chunk ? inputs[0].chunk : inputs[1].chunk;
+    if (welch_add_sources(&est, inputs[0].read, inputs[0].context, inputs[1].read, inputs[1].context, 0, count,
+                          chunk) != 0) {
+        welch_free(&est);
+        return -1;
+    }
+    if (est.segments == 0) {
+        fprintf(stderr, "Captures of %lld samples are shorter than one Welch segment (%d)\n", (long long)count,
+                est.segment);
+        welch_free(&est);
+        return -1;
+    }
+    
+    double bin_hz = fs / est.segment;
+    double margin = pow(2.0, FRF_BAND_MARGIN_OCTAVES);
+    int first_bin = (int)ceil(chirp_params->start_freq / margin / bin_hz);
+    int last_bin = (int)floor(chirp_params->end_freq * margin / bin_hz);
+    if (first_bin < 1) first_bin = 1;
+    if (last_bin > est.num_bins - 1) last_bin = est.num_bins - 1;
+    int num_bins = last_bin - first_bin + 1;
+    
+    kiss_fft_cpx *h1 = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * num_bins);
+    kiss_fft_cpx *h2 = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * num_bins);
+    kiss_fft_scalar *coherence = (kiss_fft_scalar*)malloc(sizeof(kiss_fft_scalar) * num_bins);
+    FILE *file = NULL;
+    int ret = -1;
+    if (num_bins < 1 || !h1 || !h2 || !coherence) {
+        fprintf(stderr, "No Welch bins in the sweep band, or allocation failed\n");
+        goto done;
+    }
+    welch_result(&est, first_bin, num_bins, h1, h2, coherence);
+    
+    file = fopen(DEFAULT_WELCH_CSV_FILE, "w");
+    if (!file) {
+        fprintf(stderr, "Failed to create '%s'\n", DEFAULT_WELCH_CSV_FILE);
+        goto done;
+    }
+    fprintf(file, "Frequency_Hz,H1_dB,H1_Phase_Rad,H2_dB,H2_Phase_Rad,Coherence\n");
+    double sum = 0.0;
+    int in_band = 0, low = 0;
+    for (int j = 0; j < num_bins; j++) {
+        double f = (first_bin + j) * bin_hz;
+        fprintf(file, "%.2f,%.4f,%.4f,%.4f,%.4f,%.4f\n", f, 20.0 * log10(hypot(h1[j].r, h1[j].i) + 1e-20),
+                atan2(h1[j].i, h1[j].r), 20.0 * log10(hypot(h2[j].r, h2[j].i) + 1e-20), atan2(h2[j].i, h2[j].r),
+                coherence[j]);
+        if (f >= chirp_params->start_freq && f <= chirp_params->end_freq) {
+            sum += coherence[j];
+            in_band++;
+            low += coherence[j] < WELCH_LOW_COHERENCE;
+        }
+    }
+    if (fclose(file) != 0) {
+        fprintf(stderr, "Failed to write '%s'\n", DEFAULT_WELCH_CSV_FILE);
+        goto done;
+    }
+    printf("Welch H1/H2: %lld segments of %d samples (%.1f Hz bins, hop %d)\n", (long long)est.segments,
+           est.segment, bin_hz, est.hop);
+    if (in_band > 0) {
+        printf("  coherence over %.0f-%.0f Hz: mean %.3f, %d of %d bins below %.2f\n", chirp_params->start_freq,
+               chirp_params->end_freq, sum / in_band, low, in_band, WELCH_LOW_COHERENCE);
+    }
+    printf("  H1, H2 and coherence saved to '%s'\n", DEFAULT_WELCH_CSV_FILE);
+    ret = 0;
+    
+done:
+    free(h1);
+    free(h2);
+    free(coherence);
+    welch_free(&est);
+    return ret;
+}
+
+int run_processing_mode(const ChirpParams *chirp_params, double sample_rate, const ProcessingOptions *options) {
+    printf("PROCESSING MODE: Initializing processing pipeline...\n");
+    
+    WavReader calib, meas;
+    ChirpParams stored_params;
+    if (open_capture_pair(&calib, &meas, chirp_params, sample_rate, &stored_params) != 0) {
+        return -1;
+    }
+    chirp_params = &stored_params;
+    
+    /* Everything after the captures runs at the processing rate */
+    WavReader *captures[2] = { &calib, &meas };
+    Decimator dec[2];
+    CaptureInput inputs[2];
+    double fs = open_capture_inputs(captures, chirp_params, options, dec, inputs);
+    if (fs < 0.0) {
+        wav_reader_close(&calib);
+        wav_reader_close(&meas);
+        return -1;
+    }
+    if (options->welch_segment > 0 && run_welch_estimate(captures, dec, inputs, chirp_params, fs, options) != 0) {
+        close_capture_inputs(&calib, &meas, dec);
+        return -1;
+    }
+    if (multi_sweep_count(chirp_params) > 1) {
+        return process_multi_sweep(&calib, &meas, dec, inputs, chirp_params, fs, options);
+    }
+    int is_mls = chirp_params->type == MLS_CHIRP_TYPE;
+    int n_samples_chirp = (int)(fs * chirp_params->duration);
+    
+    /* MLS takes give one period of IR, transformed at the next power of two */
+    int nfft = is_mls ? mls_length(chirp_params->mls_order) + 1 : calculate_next_power_of_two(n_samples_chirp);
+    printf("Using FFT size of %d for processing\n", nfft);
+    printf("Successfully opened calibration (%s) and measurement (%s) responses.\n",
+           sample_format_name(calib.info.format), sample_format_name(meas.info.format));
+    
+    int npre, npost;
+    if (is_mls) {
+        mls_ir_window(chirp_params, fs, &npre, &npost);
+        printf("MLS take: %d periods of order %d, deconvolved by fast Hadamard transform\n",
+               chirp_params->mls_periods, chirp_params->mls_order);
+    } else {
+        linear_ir_window(chirp_params->start_freq, chirp_params->end_freq, chirp_params->duration, fs, &npre,
+                         &npost);
+    }
+    
+    /*
+     * Deconvolve at full length if it fits the memory budget, else segment
+     * by segment. Segmenting only saves memory when the IR window is
+     * short against the capture. MLS takes only ever hold one period.
+     */
+    size_t full_bytes = full_processing_memory(nfft);
+    int segmented_nfft = segmented_ir_nfft(npre, npost, nfft);
+    size_t segmented_bytes = segmented_ir_memory(npre, npost) + 4 * sizeof(kiss_fft_cpx) * (size_t)segmented_nfft;
+    int segmented = 0;
+    if (!is_mls && options->memory_budget > 0 && full_bytes > options->memory_budget) {
+        segmented = segmented_bytes < full_bytes;
+        printf("Full-length deconvolution needs %.1f MiB (budget %.1f MiB); %s (%.1f MiB)\n",
+               full_bytes / 1048576.0, options->memory_budget / 1048576.0,
+               segmented ? "using segmented deconvolution" : "segmented deconvolution would not need less",
+               segmented_bytes / 1048576.0);
+    }
+    int work_nfft = segmented ? segmented_nfft : nfft;
+    
+    /* Key every stage by its inputs; unchanged stages come from the store */
+    TakeKeys keys;
+    if (take_keys(captures, dec, chirp_params, fs, nfft, npre, npost, segmented, &options->export, &keys) != 0) {
+        close_capture_inputs(&calib, &meas, dec);
+        return -1;
+    }
+    
+    if (export_cached_frf(keys.frf, &options->export) == 0) {
+        restore_frf_peaks(keys.frf, &options->peaks);
+        add_to_frf_database(keys.frf, DEFAULT_FRF_FILE, options->subject, options->session);
+        close_capture_inputs(&calib, &meas, dec);
+        printf("Processing completed successfully.\n");
+        return 0;
+    }
+    
+    /* Output axis first: H_lips and epsilon are only needed on the bins it reads */
+    FrfInfo frf_info;
+    memset(&frf_info, 0, sizeof(frf_info));
+    frf_info.sample_rate = fs;
+    frf_info.nfft = work_nfft;
+    frf_info.chirp = *chirp_params;
+    int first_active, num_active;
+    int first_bin = frf_output_axis(&frf_info, &options->export, &first_active, &num_active);
+    
+    /* Allocate FFT buffers and the deconvolution's plans */
+    LinearIrStage stage;
+    int stage_ret = linear_ir_stage_init(&stage, chirp_params, fs, nfft, work_nfft, n_samples_chirp, npre, npost,
+                                         segmented);
+    kiss_fft_cpx *buf_closed = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * work_nfft);
+    kiss_fft_cpx *buf_open = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * work_nfft);
+    kiss_fft_cpx *h_result = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * work_nfft);
+    kiss_fft_scalar *epsilon = (kiss_fft_scalar*)malloc(sizeof(kiss_fft_scalar) * (first_active + num_active));
+    
+    if (!buf_closed || !buf_open || !h_result || !epsilon || stage_ret != 0) {
+        fprintf(stderr, "Failed to allocate FFT buffers\n");
+        free(buf_closed);
+        free(buf_open);
+        free(h_result);
+        free(epsilon);
+        linear_ir_stage_free(&stage);
+        close_capture_inputs(&calib, &meas, dec);
+        return -1;
+    }
+    
+    int ret = linear_ir_get(&stage, buf_closed, &inputs[0], keys.capture[0], keys.ir[0], "Calibration", 0);
+    if (ret == 0) {
+        ret = linear_ir_get(&stage, buf_open, &inputs[1], keys.capture[1], keys.ir[1], "Measurement", 1);
+    }
+    close_capture_inputs(&calib, &meas, dec);
+    linear_ir_stage_free(&stage);
+    
+    if (ret == 0) {
+        /* Generate regularization epsilon */
+        generate_epsilon_bins(epsilon, chirp_params->start_freq, chirp_params->end_freq, fs, work_nfft,
+                              EPSILON_TRANSITION_HZ, first_active, num_active);
+        
+        /* Compute final transfer function */
+        compute_h_lips(h_result + first_active, buf_open + first_active, buf_closed + first_active,
+                       epsilon + first_active, num_active);
+        
+        /* Save results */
+        ret = write_frf_outputs(&frf_info, &options->export, first_bin, h_result, buf_open, buf_closed,
+                                DEFAULT_FRF_FILE, DEFAULT_FRF_CSV_FILE);
+        if (ret == 0) {
+            char description[STORE_PATH_MAX];
+            snprintf(description, sizeof(description), "FRF of IRs %016llx (open) / %016llx (closed), %d points",
+                     (unsigned long long)keys.ir[1], (unsigned long long)keys.ir[0], frf_info.grid.num_points);
+            store_import_file(DEFAULT_STORE_DIR, keys.frf, "frf", DEFAULT_FRF_FILE, description);
+            frf_bin_peaks(keys.frf, h_result, first_active, num_active, fs / work_nfft, chirp_params,
+                          &options->peaks);
+            add_to_frf_database(keys.frf, DEFAULT_FRF_FILE, options->subject, options->session);
+        }
+    }
+    
+    /* Cleanup */
+    free(buf_closed);
+    free(buf_open);
+    free(h_result);
+    free(epsilon);
+    
+    if (ret != 0) {
+        return -1;
+    }
+    printf("Processing completed successfully.\n");
+    return 0;
+}
@@ -0,0 +1,730 @@
+#define _POSIX_C_SOURCE 200809L
+#include "processing_stages.h"
+#include "frf_io.h"
+#include "frf_db.h"
+#include "processing.h"
+#include "stream_deconv.h"
+#include "multi_sweep.h"
+#include "frf_peaks.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <sys/stat.h>
+
+// --- Captures ---
+
+/* Sample source of a capture reader */
+static int read_capture_samples(void *context, int64_t first, int count, float *dst) {
+    return wav_reader_read((WavReader *)context, first, count, dst);
+}
+
+/* Reads the first n_samples of a capture, chunk by chunk, into the real part of a zero-padded FFT buffer */
+static int read_capture_to_complex(kiss_fft_cpx *dst, int nfft, const CaptureInput *capture, int n_samples) {
+    float *block = (float*)malloc(sizeof(float) * capture->chunk);
+    if (!block) {
+        fprintf(stderr, "Failed to allocate read buffer\n");
+        return -1;
+    }
+    
+    for (int start = 0; start < n_samples && start < nfft; start += capture->chunk) {
+        int n = n_samples - start < capture->chunk ? n_samples - start : capture->chunk;
+        if (n > nfft - start) n = nfft - start;
+        if (capture->read(capture->context, start, n, block) != 0) {
+            free(block);
+            return -1;
+        }
+        for (int i = 0; i < n; i++) {
+            dst[start + i].r = block[i];
+            dst[start + i].i = 0.0f;
+        }
+    }
+    for (int i = n_samples; i < nfft; i++) {
+        dst[i].r = 0.0f;
+        dst[i].i = 0.0f;
+    }
+    free(block);
+    return 0;
+}
+
+int open_capture_pair(WavReader *calib, WavReader *meas, const ChirpParams *chirp_params, double sample_rate,
+                      ChirpParams *chirp_out) {
+    /* Samples are read in fixed-size chunks, never whole */
+    if (wav_reader_open("output/calibration_response.wav", 0, calib) != 0) {
+        fprintf(stderr, "Failed to load calibration response file\n");
+        return -1;
+    }
+    if (wav_reader_open("output/measurement_response.wav", 0, meas) != 0) {
+        fprintf(stderr, "Failed to load measurement response file\n");
+        wav_reader_close(calib);
+        return -1;
+    }
+    
+    if (calib->info.sample_rate != meas->info.sample_rate) {
+        fprintf(stderr, "Calibration (%.0f Hz) and measurement (%.0f Hz) sample rates differ\n",
+                calib->info.sample_rate, meas->info.sample_rate);
+        wav_reader_close(calib);
+        wav_reader_close(meas);
+        return -1;
+    }
+    if (calib->info.num_channels != NUM_CHANNELS || meas->info.num_channels != NUM_CHANNELS) {
+        fprintf(stderr, "Captures must have %d channel(s)\n", NUM_CHANNELS);
+        wav_reader_close(calib);
+        wav_reader_close(meas);
+        return -1;
+    }
+    
+    double fs = calib->info.sample_rate;
+    if (sample_rate > 0 && fs != sample_rate) {
+        printf("Using capture sample rate of %.0f Hz (requested %.0f Hz)\n", fs, sample_rate);
+    }
+    
+    /* The chirp recorded with the calibration is the one to invert */
+    if (calib->info.has_chirp) {
+        const ChirpParams *stored = &calib->info.chirp;
+        if (stored->duration != chirp_params->duration || stored->start_freq != chirp_params->start_freq
+            || stored->end_freq != chirp_params->end_freq || stored->type != chirp_params->type) {
+            printf("Using chirp parameters stored with the calibration capture\n");
+        }
+        *chirp_out = *stored;
+    } else if (chirp_params->duration <= 0) {
+        fprintf(stderr, "Calibration capture carries no chirp parameters; give them explicitly\n");
+        wav_reader_close(calib);
+        wav_reader_close(meas);
+        return -1;
+    } else {
+        *chirp_out = *chirp_params;
+    }
+    
+    if (meas->info.has_chirp && (meas->info.chirp.type == MLS_CHIRP_TYPE) != (chirp_out->type == MLS_CHIRP_TYPE)) {
+        fprintf(stderr, "Calibration and measurement takes differ in excitation (MLS and sweep)\n");
+        wav_reader_close(calib);
+        wav_reader_close(meas);
+        return -1;
+    }
+    if (chirp_out->type == MLS_CHIRP_TYPE) {
+        const ChirpParams *m = meas->info.has_chirp ? &meas->info.chirp : chirp_out;
+        if (m->mls_order != chirp_out->mls_order || m->mls_periods != chirp_out->mls_periods
+            || m->Tgap != chirp_out->Tgap || chirp_out->mls_order < MLS_MIN_ORDER
+            || chirp_out->mls_order > MLS_MAX_ORDER || chirp_out->mls_periods < 1) {
+            fprintf(stderr, "Calibration (order %d, %d periods) and measurement (order %d, %d periods) MLS takes "
+                    "differ or are invalid\n", chirp_out->mls_order, chirp_out->mls_periods, m->mls_order,
+                    m->mls_periods);
+            wav_reader_close(calib);
+            wav_reader_close(meas);
+            return -1;
+        }
+        int64_t n_needed = mls_first_sample(chirp_out, fs) + (int64_t)chirp_out->mls_periods
+                           * mls_length(chirp_out->mls_order);
+        if (calib->info.num_frames < n_needed || meas->info.num_frames < n_needed) {
+            fprintf(stderr, "Captures are shorter than the MLS take (%lld / %lld frames, need %lld)\n",
+                    (long long)calib->info.num_frames, (long long)meas->info.num_frames, (long long)n_needed);
+            wav_reader_close(calib);
+            wav_reader_close(meas);
+            return -1;
+        }
+        return 0;
+    }
+    
+    if (meas->info.has_chirp && multi_sweep_count(&meas->info.chirp) != multi_sweep_count(chirp_out)) {
+        fprintf(stderr, "Calibration (%d sweeps) and measurement (%d sweeps) takes differ\n",
+                multi_sweep_count(chirp_out), multi_sweep_count(&meas->info.chirp));
+        wav_reader_close(calib);
+        wav_reader_close(meas);
+        return -1;
+    }
+    
+    int n_samples_chirp = (int)(fs * multi_sweep_duration(chirp_out));
+    if (calib->info.num_frames < n_samples_chirp || meas->info.num_frames < n_samples_chirp) {
+        fprintf(stderr, "Captures are shorter than the %.2f s chirp (%lld / %lld frames, need %d)\n",
+                multi_sweep_duration(chirp_out), (long long)calib->info.num_frames,
+                (long long)meas->info.num_frames, n_samples_chirp);
+        wav_reader_close(calib);
+        wav_reader_close(meas);
+        return -1;
+    }
+    return 0;
+}
+
+double open_capture_inputs(WavReader *captures[2], const ChirpParams *chirp, const ProcessingOptions *options,
+                           Decimator dec[2], CaptureInput in[2]) {
+    double fs = captures[0]->info.sample_rate;
+    double f_pass = chirp->end_freq * pow(2.0, FRF_BAND_MARGIN_OCTAVES);
+    int up = 1, down = 1;
+    if (chirp->type == MLS_CHIRP_TYPE) {
+        /* The period is a whole number of samples at the capture rate only */
+        if (options->decimate != DECIMATE_OFF) {
+            printf("MLS takes are deconvolved at the capture rate; not decimating\n");
+        }
+    } else if (options->decimate == DECIMATE_AUTO) {
+        decimation_factor(fs, f_pass, &up, &down);
+    } else if (options->decimate == DECIMATE_FIXED) {
+        up = options->decimate_up;
+        down = options->decimate_down;
+    }
+    
+    memset(dec, 0, 2 * sizeof(Decimator));
+    for (int c = 0; c < 2; c++) {
+        in[c].read = read_capture_samples;
+        in[c].context = captures[c];
+        in[c].chunk = captures[c]->chunk_frames;
+    }
+    if (down == up) {
+        if (options->decimate == DECIMATE_AUTO && chirp->type != MLS_CHIRP_TYPE) {
+            printf("No lower rate keeps %.0f Hz; processing at %.0f Hz\n", f_pass, fs);
+        }
+        return fs;
+    }
+    
+    for (int c = 0; c < 2; c++) {
+        if (decimator_init(&dec[c], up, down, fs, f_pass, read_capture_samples, captures[c],
+                           captures[c]->info.num_frames) != 0) {
+            decimator_free(&dec[0]);
+            return -1.0;
+        }
+        /* About one capture chunk of input per read */
+        in[c].read = decimator_read;
+        in[c].context = &dec[c];
+        in[c].chunk = captures[c]->chunk_frames * up / down > 0 ? captures[c]->chunk_frames * up / down : 1;
+    }
+    double rate = fs * up / down;
+    printf("Decimating captures by %d/%d: %.0f -> %.0f Hz (%d taps per output sample, kept up to %.0f Hz)\n",
+           up, down, fs, rate, dec[0].num_taps, f_pass);
+    return rate;
+}
+
+void close_capture_inputs(WavReader *calib, WavReader *meas, Decimator dec[2]) {
+    decimator_free(&dec[0]);
+    decimator_free(&dec[1]);
+    wav_reader_close(calib);
+    wav_reader_close(meas);
+}
+
+int64_t capture_input_length(const WavReader *capture, const Decimator *dec) {
+    return dec->down > 0 ? decimator_output_length(dec) : capture->info.num_frames;
+}
+
+/* Deconvolves one capture at full length and returns to the time domain, without windowing */
+static int deconvolved_time_signal(kiss_fft_cpx *buf, const CaptureInput *capture,
+                                   const kiss_fft_cpx *inv_filter, kiss_fft_cfg cfg_fwd, kiss_fft_cfg cfg_inv,
+                                   const ChirpParams *chirp, double fs, int nfft, int n_samples_chirp) {
+    if (read_capture_to_complex(buf, nfft, capture, n_samples_chirp) != 0) {
+        return -1;
+    }
+    kiss_fft(cfg_fwd, buf, buf);
+    int band_bins;
+    int band_first = sweep_band_bins(chirp->start_freq, chirp->end_freq, fs, nfft, &band_bins);
+    perform_deconvolution_bins(buf, inv_filter, nfft, band_first, band_bins);
+    kiss_fft(cfg_inv, buf, buf);
+    return 0;
+}
+
+int deconvolve_take(const CaptureInput inputs[2], const ChirpParams *chirp, double fs, int nfft, int n_samples,
+                    kiss_fft_cpx *inv_filter, kiss_fft_cfg cfg_fwd, kiss_fft_cfg cfg_inv,
+                    kiss_fft_cpx *closed_time, kiss_fft_cpx *open_time) {
+    generate_inverse_filter(inv_filter, chirp->amplitude, chirp->start_freq, chirp->end_freq, chirp->duration, fs,
+                            nfft, chirp->type);
+    if (deconvolved_time_signal(closed_time, &inputs[0], inv_filter, cfg_fwd, cfg_inv, chirp, fs, nfft,
+                                n_samples) != 0) {
+        return -1;
+    }
+    return deconvolved_time_signal(open_time, &inputs[1], inv_filter, cfg_fwd, cfg_inv, chirp, fs, nfft, n_samples);
+}
+
+// --- Session store keys ---
+
+/* Bump when a change to the processing chain alters its results, to invalidate stored stages */
+#define PROCESSING_CACHE_VERSION 3
+
+/* Cheap identity of a capture file: inode, size, modification and change times, layout and first
+ * chunk of samples. Any rewrite of the file moves its change time, so the fingerprint changes too. */
+static int capture_fingerprint(WavReader *capture, StoreKey *fingerprint) {
+    struct stat st;
+    int n = capture->info.num_frames < capture->chunk_frames ? (int)capture->info.num_frames : capture->chunk_frames;
+    if (fstat(capture->fd, &st) != 0 || wav_reader_read_native(capture, 0, n, capture->chunk) != 0) {
+        fprintf(stderr, "Failed to read capture samples\n");
+        return -1;
+    }
+    StoreHasher hasher;
+    store_hash_init(&hasher);
+    store_hash_bytes(&hasher, "fingerprint", 11);
+    store_hash_int(&hasher, (int64_t)st.st_dev);
+    store_hash_int(&hasher, (int64_t)st.st_ino);
+    store_hash_int(&hasher, (int64_t)st.st_size);
+    store_hash_int(&hasher, (int64_t)st.st_mtim.tv_sec);
+    store_hash_int(&hasher, (int64_t)st.st_mtim.tv_nsec);
+    store_hash_int(&hasher, (int64_t)st.st_ctim.tv_sec);
+    store_hash_int(&hasher, (int64_t)st.st_ctim.tv_nsec);
+    store_hash_int(&hasher, capture->info.format);
+    store_hash_int(&hasher, capture->info.num_channels);
+    store_hash_double(&hasher, capture->info.sample_rate);
+    store_hash_int(&hasher, capture->info.num_frames);
+    store_hash_bytes(&hasher, capture->chunk, (size_t)n * capture->frame_bytes);
+    *fingerprint = store_hash_final(&hasher);
+    return 0;
+}
+
+/* Content key of a capture: layout, rate and every sample. The samples are only hashed when the
+ * file's fingerprint has no stored key, i.e. on the first run after it was written. */
+static int capture_key(WavReader *capture, StoreKey *key) {
+    StoreKey fingerprint;
+    if (capture_fingerprint(capture, &fingerprint) != 0) {
+        return -1;
+    }
+    if (store_get(DEFAULT_STORE_DIR, fingerprint, "fp", key, sizeof(*key)) == 0) {
+        return 0;
+    }
+
+    StoreHasher hasher;
+    store_hash_init(&hasher);
+    store_hash_int(&hasher, capture->info.format);
+    store_hash_int(&hasher, capture->info.num_channels);
+    store_hash_double(&hasher, capture->info.sample_rate);
+    store_hash_int(&hasher, capture->info.num_frames);
+    for (int64_t first = 0; first < capture->info.num_frames; first += capture->chunk_frames) {
+        int n = capture->info.num_frames - first < capture->chunk_frames ? (int)(capture->info.num_frames - first)
+                                                                         : capture->chunk_frames;
+        if (wav_reader_read_native(capture, first, n, capture->chunk) != 0) {
+            fprintf(stderr, "Failed to read capture samples\n");
+            return -1;
+        }
+        store_hash_bytes(&hasher, capture->chunk, (size_t)n * capture->frame_bytes);
+    }
+    *key = store_hash_final(&hasher);
+
+    char description[64];
+    snprintf(description, sizeof(description), "content key %016llx of a capture file", (unsigned long long)*key);
+    store_put(DEFAULT_STORE_DIR, fingerprint, "fp", key, sizeof(*key), description);
+    return 0;
+}
+
+/* Keeps a copy of a capture in the store so later takes do not replace it */
+static void store_capture(const char *path, StoreKey key, const char *label) {
+    char description[STORE_PATH_MAX];
+    snprintf(description, sizeof(description), "%s capture from %s", label, path);
+    store_import_file(DEFAULT_STORE_DIR, key, "wav", path, description);
+}
+
+static void hash_chirp(StoreHasher *hasher, const ChirpParams *chirp_params) {
+    store_hash_double(hasher, chirp_params->amplitude);
+    store_hash_double(hasher, chirp_params->start_freq);
+    store_hash_double(hasher, chirp_params->end_freq);
+    store_hash_double(hasher, chirp_params->duration);
+    store_hash_int(hasher, chirp_params->type);
+    if (multi_sweep_count(chirp_params) > 1) {
+        store_hash_int(hasher, chirp_params->num_sweeps);
+        store_hash_double(hasher, chirp_params->sweep_stagger);
+        store_hash_double(hasher, chirp_params->sweep_level_step);
+    }
+    if (chirp_params->type == MLS_CHIRP_TYPE) {
+        /* The averaged periods start after Tgap / 2 */
+        store_hash_int(hasher, chirp_params->mls_order);
+        store_hash_int(hasher, chirp_params->mls_periods);
+        store_hash_double(hasher, chirp_params->Tgap);
+    }
+}
+
+/* Key of a windowed linear IR spectrum: its capture and everything the deconvolution uses,
+ * including any decimation and the build precision (the stored spectrum is kiss_fft_cpx as computed) */
+static StoreKey linear_ir_key(StoreKey capture, const ChirpParams *chirp_params, double fs,
+                              int nfft, int npre, int npost, int segmented, const Decimator *dec) {
+    StoreHasher hasher;
+    store_hash_init(&hasher);
+    store_hash_bytes(&hasher, "ir", 2);
+    store_hash_int(&hasher, PROCESSING_CACHE_VERSION);
+    store_hash_int(&hasher, (int64_t)capture);
+    hash_chirp(&hasher, chirp_params);
+    store_hash_double(&hasher, fs);
+    store_hash_int(&hasher, nfft);
+    store_hash_int(&hasher, npre);
+    store_hash_int(&hasher, npost);
+    store_hash_int(&hasher, segmented);
+    if (dec->down > dec->up) {
+        store_hash_bytes(&hasher, "decimate", 8);
+        store_hash_int(&hasher, dec->up);
+        store_hash_int(&hasher, dec->down);
+        store_hash_int(&hasher, dec->num_taps);
+    }
+    store_hash_int(&hasher, (int64_t)sizeof(kiss_fft_scalar));
+    return store_hash_final(&hasher);
+}
+
+/* Key of the FRF file: both linear IRs and the output band/grid */
+static StoreKey frf_key(StoreKey open_ir, StoreKey closed_ir, const FrfExportOptions *export) {
+    StoreHasher hasher;
+    store_hash_init(&hasher);
+    store_hash_bytes(&hasher, "frf", 3);
+    store_hash_int(&hasher, PROCESSING_CACHE_VERSION);
+    store_hash_int(&hasher, FRF_FORMAT_VERSION);
+    store_hash_int(&hasher, (int64_t)open_ir);
+    store_hash_int(&hasher, (int64_t)closed_ir);
+    store_hash_int(&hasher, export->band_limited);
+    store_hash_int(&hasher, export->num_points);
+    store_hash_int(&hasher, export->num_points > 0 ? export->grid_type : 0);
+    return store_hash_final(&hasher);
+}
+
+int take_keys(WavReader *captures[2], const Decimator dec[2], const ChirpParams *chirp_params, double fs, int nfft,
+              int npre, int npost, int segmented, const FrfExportOptions *export, TakeKeys *keys) {
+    if (capture_key(captures[0], &keys->capture[0]) != 0 || capture_key(captures[1], &keys->capture[1]) != 0) {
+        return -1;
+    }
+    store_capture("output/calibration_response.wav", keys->capture[0], "calibration");
+    store_capture("output/measurement_response.wav", keys->capture[1], "measurement");
+    for (int c = 0; c < 2; c++) {
+        keys->ir[c] = linear_ir_key(keys->capture[c], chirp_params, fs, nfft, npre, npost, segmented, &dec[c]);
+    }
+    keys->frf = frf_key(keys->ir[1], keys->ir[0], export);
+    return 0;
+}
+
+// --- Linear IRs ---
+
+/*
+ * Deconvolves one capture and windows its linear IR, leaving the
+ * spectrum in buf. Returns the energy of the deconvolved spectrum
+ * before windowing, or -1 if the capture could not be read.
+ */
+static double compute_linear_ir(kiss_fft_cpx *buf, const CaptureInput *capture, const kiss_fft_cpx *inv_filter,
+                                kiss_fft_cfg cfg_fwd, kiss_fft_cfg cfg_inv, const ChirpParams *chirp, int nfft,
+                                int n_samples_chirp, int npre, int npost, double fs) {
+    if (read_capture_to_complex(buf, nfft, capture, n_samples_chirp) != 0) {
+        return -1.0;
+    }
+    kiss_fft(cfg_fwd, buf, buf);
+    
+    /* The inverse filter, hence the deconvolved spectrum, is zero outside the sweep band */
+    int band_bins;
+    int band_first = sweep_band_bins(chirp->start_freq, chirp->end_freq, fs, nfft, &band_bins);
+    perform_deconvolution_bins(buf, inv_filter, nfft, band_first, band_bins);
+    
+    double energy = 0.0;
+    for (int i = band_first; i < band_first + band_bins && i < nfft / 2; i++) {
+        energy += complex_squared_magnitude(buf[i]);
+    }
+    
+    extract_linear_ir(buf, cfg_inv, cfg_fwd, nfft, n_samples_chirp, npre, npost, fs, 1);
+    return energy;
+}
+
+size_t full_processing_memory(int nfft) {
+    return (size_t)nfft * (7 * sizeof(kiss_fft_cpx) + sizeof(kiss_fft_scalar));
+}
+
+/*
+ * Computes the linear IR spectrum of one capture with the selected path,
+ * leaving it in buf (work_nfft bins): Hadamard deconvolution when an MLS
+ * decoder is given, else segmented or in-memory deconvolution of the
+ * sweep. Returns 0 on success, -1 on failure.
+ */
+static int linear_ir_spectrum(kiss_fft_cpx *buf, const CaptureInput *capture, int report_energy, int segmented,
+                              MlsDecoder *mls, const kiss_fft_cpx *inv_filter, kiss_fft_cfg cfg_fwd,
+                              kiss_fft_cfg cfg_inv, const ChirpParams *chirp_params, double fs, int nfft,
+                              int work_nfft, int n_samples_chirp, int npre, int npost) {
+    if (mls) {
+        return mls_linear_ir(buf, mls, capture->read, capture->context, capture->chunk, chirp_params, fs, npre,
+                             npost, cfg_fwd);
+    }
+    if (segmented) {
+        return segmented_linear_ir(buf, work_nfft, capture->read, capture->context, chirp_params, fs,
+                                   n_samples_chirp, npre, npost, nfft);
+    }
+    double energy = compute_linear_ir(buf, capture, inv_filter, cfg_fwd, cfg_inv, chirp_params, nfft, n_samples_chirp,
+                                      npre, npost, fs);
+    if (energy < 0.0) {
+        return -1;
+    }
+    if (report_energy) {
+        printf("Estimated We: %.6f\n", energy);
+    }
+    return 0;
+}
+
+int linear_ir_stage_init(LinearIrStage *stage, const ChirpParams *chirp, double fs, int nfft, int work_nfft,
+                         int n_samples_chirp, int npre, int npost, int segmented) {
+    memset(stage, 0, sizeof(*stage));
+    stage->chirp = chirp;
+    stage->fs = fs;
+    stage->nfft = nfft;
+    stage->work_nfft = work_nfft;
+    stage->n_samples_chirp = n_samples_chirp;
+    stage->npre = npre;
+    stage->npost = npost;
+    stage->segmented = segmented;
+    
+    /* The full-length inverse filter and plans only when not segmenting, none for MLS */
+    int sweep_in_memory = !segmented && chirp->type != MLS_CHIRP_TYPE;
+    if (!segmented) {
+        stage->cfg_fwd = kiss_fft_alloc(nfft, 0, NULL, NULL);
+    }
+    if (sweep_in_memory) {
+        stage->cfg_inv = kiss_fft_alloc(nfft, 1, NULL, NULL);
+        stage->inv_filter = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * nfft);
+    }
+    if ((!segmented && !stage->cfg_fwd) || (sweep_in_memory && (!stage->cfg_inv || !stage->inv_filter))) {
+        return -1;
+    }
+    return 0;
+}
+
+int linear_ir_get(LinearIrStage *stage, kiss_fft_cpx *buf, const CaptureInput *input, StoreKey capture_key,
+                  StoreKey ir_key, const char *label, int report_energy) {
+    size_t ir_bytes = sizeof(kiss_fft_cpx) * stage->work_nfft;
+    if (store_get(DEFAULT_STORE_DIR, ir_key, "ir", buf, ir_bytes) == 0) {
+        printf("%s linear IR %016llx loaded from store\n", label, (unsigned long long)ir_key);
+        return 0;
+    }
+    
+    const ChirpParams *chirp = stage->chirp;
+    int is_mls = chirp->type == MLS_CHIRP_TYPE;
+    if (!stage->prepared) {
+        if (stage->inv_filter) {
+            generate_inverse_filter(stage->inv_filter, chirp->amplitude, chirp->start_freq, chirp->end_freq,
+                                    chirp->duration, stage->fs, stage->nfft, chirp->type);
+        } else if (is_mls && mls_decoder_init(&stage->mls, chirp->mls_order) != 0) {
+            return -1;
+        }
+        stage->prepared = 1;
+    }
+    if (linear_ir_spectrum(buf, input, report_energy, stage->segmented, is_mls ? &stage->mls : NULL,
+                           stage->inv_filter, stage->cfg_fwd, stage->cfg_inv, chirp, stage->fs, stage->nfft,
+                           stage->work_nfft, stage->n_samples_chirp, stage->npre, stage->npost) != 0) {
+        return -1;
+    }
+    
+    char description[STORE_PATH_MAX];
+    snprintf(description, sizeof(description), "linear IR of capture %016llx, nfft %d at %.0f Hz, npre %d, npost %d%s",
+             (unsigned long long)capture_key, stage->nfft, stage->fs, stage->npre, stage->npost,
+             stage->segmented ? ", segmented" : "");
+    store_put(DEFAULT_STORE_DIR, ir_key, "ir", buf, ir_bytes, description);
+    return 0;
+}
+
+void linear_ir_stage_free(LinearIrStage *stage) {
+    kiss_fft_free(stage->cfg_fwd);
+    kiss_fft_free(stage->cfg_inv);
+    free(stage->inv_filter);
+    mls_decoder_free(&stage->mls);
+    memset(stage, 0, sizeof(*stage));
+}
+
+// --- FRF outputs ---
+
+int export_cached_frf(StoreKey key, const FrfExportOptions *export) {
+    if (store_export_file(DEFAULT_STORE_DIR, key, "frf", DEFAULT_FRF_FILE) != 0) {
+        return -1;
+    }
+    printf("Inputs unchanged: FRF %016llx restored from '%s'\n", (unsigned long long)key, DEFAULT_STORE_DIR);
+    printf("Results saved to '%s'\n", DEFAULT_FRF_FILE);
+    
+    if (export->export_csv) {
+        FrfData frf;
+        if (frf_read(DEFAULT_FRF_FILE, &frf) != 0) {
+            return -1;
+        }
+        int ret = frf_write_csv(DEFAULT_FRF_CSV_FILE, &frf.info, frf.h_lips);
+        frf_free(&frf);
+        if (ret != 0) {
+            return -1;
+        }
+        printf("CSV export saved to '%s'\n", DEFAULT_FRF_CSV_FILE);
+    }
+    return 0;
+}
+
+void add_to_frf_database(StoreKey key, const char *frf_path, const char *subject, const char *session) {
+    FrfData frf;
+    if (frf_read(frf_path, &frf) != 0) {
+        return;
+    }
+    
+    FrfDbEntry entry;
+    memset(&entry, 0, sizeof(entry));
+    entry.key = key;
+    struct stat st;
+    entry.timestamp = stat("output/measurement_response.wav", &st) == 0 ? (int64_t)st.st_mtime : (int64_t)time(NULL);
+    snprintf(entry.subject, sizeof(entry.subject), "%s", subject ? subject : "");
+    snprintf(entry.session, sizeof(entry.session), "%s", session ? session : "");
+    entry.info = frf.info;
+    frf_db_quality(&frf.info, frf.h_lips, frf.open, frf.closed, &entry.quality);
+    
+    int ret = frf_db_append(DEFAULT_FRF_DB_DIR, &entry, frf.h_lips, frf.open, frf.closed);
+    if (ret == 0) {
+        printf("FRF added to database '%s' (subject '%s', session '%s', peak %.1f dB at %.1f Hz)\n",
+               DEFAULT_FRF_DB_DIR, entry.subject, entry.session, entry.quality.peak_db, entry.quality.peak_freq);
+    } else if (ret == 1) {
+        printf("FRF already in database '%s' for subject '%s', session '%s'\n",
+               DEFAULT_FRF_DB_DIR, entry.subject, entry.session);
+    }
+    frf_free(&frf);
+}
+
+int frf_output_axis(FrfInfo *info, const FrfExportOptions *export, int *first_active, int *num_active) {
+    double bin_hz = info->sample_rate / info->nfft;
+    int num_bins = info->nfft / 2;
+    
+    double f_lo = 0.0;
+    double f_hi = (num_bins - 1) * bin_hz;
+    if (export->band_limited) {
+        double margin = pow(2.0, FRF_BAND_MARGIN_OCTAVES);
+        f_lo = info->chirp.start_freq / margin;
+        f_hi = info->chirp.end_freq * margin;
+    }
+    int first_bin = frf_grid_band_bins(&info->grid, f_lo, f_hi, info->sample_rate, info->nfft);
+    
+    if (export->num_points > 0) {
+        info->grid.type = export->grid_type;
+        info->grid.num_points = export->num_points;
+        if (info->grid.type == FRF_GRID_LOG && info->grid.f_min <= 0.0) {
+            info->grid.f_min = bin_hz; /* log grid cannot start at DC */
+        }
+        *first_active = frf_resample_bins(&info->grid, num_bins, bin_hz, num_active);
+    } else {
+        *first_active = first_bin;
+        *num_active = info->grid.num_points;
+    }
+    return first_bin;
+}
+
+int write_frf_outputs(const FrfInfo *info, const FrfExportOptions *export, int first_bin,
+                      const kiss_fft_cpx *h_lips, const kiss_fft_cpx *open, const kiss_fft_cpx *closed,
+                      const char *frf_path, const char *csv_path) {
+    double bin_hz = info->sample_rate / info->nfft;
+    int num_bins = info->nfft / 2;
+    
+    const kiss_fft_cpx *out_h = h_lips + first_bin;
+    const kiss_fft_cpx *out_open = open + first_bin;
+    const kiss_fft_cpx *out_closed = closed + first_bin;
+    kiss_fft_cpx *resampled = NULL;
+    
+    if (export->num_points > 0) {
+        size_t n = (size_t)info->grid.num_points;
+        resampled = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * n * FRF_NUM_ARRAYS);
+        if (!resampled) {
+            fprintf(stderr, "Failed to allocate resampled FRF\n");
+            return -1;
+        }
+        frf_resample(h_lips, num_bins, bin_hz, &info->grid, resampled);
+        frf_resample(open, num_bins, bin_hz, &info->grid, resampled + n);
+        frf_resample(closed, num_bins, bin_hz, &info->grid, resampled + 2 * n);
+        out_h = resampled;
+        out_open = resampled + n;
+        out_closed = resampled + 2 * n;
+    }
+    
+    printf("FRF output: %d %s points from %.1f to %.1f Hz (%d FFT bins)\n", info->grid.num_points,
+           info->grid.type == FRF_GRID_LOG ? "log-spaced" : "linear", info->grid.f_min, info->grid.f_max, num_bins);
+    
+    int ret = frf_write(frf_path, info, out_h, out_open, out_closed);
+    if (ret == 0) {
+        printf("Results saved to '%s'\n", frf_path);
+    }
+    if (ret == 0 && export->export_csv) {
+        ret = frf_write_csv(csv_path, info, out_h);
+        if (ret == 0) {
+            printf("CSV export saved to '%s'\n", csv_path);
+        }
+    }
+    
+    free(resampled);
+    return ret;
+}
+
+void write_peak_rows(FILE *file, const char *prefix, const FrfPeak *peaks, int count) {
+    for (int i = 0; i < count; i++) {
+        fprintf(file, "%s%s,%.2f,%.2f,%.2f,%.2f\n", prefix,
+                peaks[i].type == FRF_PEAK_RESONANCE ? "resonance" : "anti-resonance", peaks[i].frequency,
+                peaks[i].level_db, peaks[i].bandwidth, peaks[i].q);
+    }
+}
+
+/* Analyses the spectrum set in the analyzer, prints the table and writes DEFAULT_PEAKS_CSV_FILE */
+static int write_frf_peaks(FrfPeakAnalyzer *an) {
+    FrfPeak peaks[FRF_PEAKS_MAX];
+    int count = frf_peaks_find(an, peaks, FRF_PEAKS_MAX);
+    
+    FILE *file = fopen(DEFAULT_PEAKS_CSV_FILE, "w");
+    if (!file) {
+        fprintf(stderr, "Failed to create '%s'\n", DEFAULT_PEAKS_CSV_FILE);
+        return -1;
+    }
+    fprintf(file, "Type,Frequency_Hz,Level_dB,Bandwidth_Hz,Q\n");
+    write_peak_rows(file, "", peaks, count);
+    if (fclose(file) != 0) {
+        fprintf(stderr, "Failed to write '%s'\n", DEFAULT_PEAKS_CSV_FILE);
+        return -1;
+    }
+    
+    printf("Resonances (R) and anti-resonances (A) over %.0f-%.0f Hz:\n", an->grid.f_min, an->grid.f_max);
+    for (int i = 0; i < count; i++) {
+        printf("  %s %9.1f Hz %7.1f dB", peaks[i].type == FRF_PEAK_RESONANCE ? "R" : "A", peaks[i].frequency,
+               peaks[i].level_db);
+        if (peaks[i].q > 0.0) {
+            printf("  bandwidth %7.1f Hz  Q %5.1f\n", peaks[i].bandwidth, peaks[i].q);
+        } else {
+            printf("  (no -3 dB points)\n");
+        }
+    }
+    printf("%d peaks saved to '%s'\n", count, DEFAULT_PEAKS_CSV_FILE);
+    return 0;
+}
+
+/* Store key of the peak table of an FRF: the table depends on the peak options too */
+static StoreKey peaks_key(StoreKey frf, const FrfPeakOptions *options) {
+    StoreHasher hasher;
+    store_hash_init(&hasher);
+    store_hash_bytes(&hasher, "peaks", 5);
+    store_hash_int(&hasher, (int64_t)frf);
+    store_hash_double(&hasher, options->smoothing_octaves);
+    store_hash_double(&hasher, options->prominence_db);
+    return store_hash_final(&hasher);
+}
+
+void frf_bin_peaks(StoreKey frf_key, const kiss_fft_cpx *h_lips, int first_active, int num_active, double bin_hz,
+                   const ChirpParams *chirp_params, const FrfPeakOptions *options) {
+    int first = (int)ceil(chirp_params->start_freq / bin_hz);
+    int last = (int)floor(chirp_params->end_freq / bin_hz);
+    if (first < first_active) first = first_active;
+    if (last > first_active + num_active - 1) last = first_active + num_active - 1;
+    
+    FrfGrid grid = { FRF_GRID_LINEAR, first * bin_hz, last * bin_hz, last - first + 1 };
+    FrfPeakAnalyzer an;
+    if (frf_peaks_init(&an, &grid, options) != 0) {
+        return;
+    }
+    frf_peaks_set_spectrum(&an, h_lips + first);
+    if (write_frf_peaks(&an) == 0) {
+        char description[STORE_PATH_MAX];
+        snprintf(description, sizeof(description), "peaks of FRF %016llx over %.0f-%.0f Hz",
+                 (unsigned long long)frf_key, grid.f_min, grid.f_max);
+        store_import_file(DEFAULT_STORE_DIR, peaks_key(frf_key, options), "peaks", DEFAULT_PEAKS_CSV_FILE,
+                          description);
+    }
+    frf_peaks_free(&an);
+}
+
+void restore_frf_peaks(StoreKey frf_key, const FrfPeakOptions *options) {
+    if (store_export_file(DEFAULT_STORE_DIR, peaks_key(frf_key, options), "peaks", DEFAULT_PEAKS_CSV_FILE) == 0) {
+        printf("Peaks restored to '%s'\n", DEFAULT_PEAKS_CSV_FILE);
+        return;
+    }
+    FrfData frf;
+    if (frf_read(DEFAULT_FRF_FILE, &frf) != 0) {
+        return;
+    }
+    FrfDbEntry entry;
+    memset(&entry, 0, sizeof(entry));
+    entry.info = frf.info;
+    int first;
+    int count = frf_db_point_range(&entry, frf.info.chirp.start_freq, frf.info.chirp.end_freq, &first);
+    FrfGrid grid;
+    frf_grid_slice(&grid, &frf.info.grid, first, count);
+    FrfPeakAnalyzer an;
+    if (frf_peaks_init(&an, &grid, options) == 0) {
+        frf_peaks_set_spectrum(&an, frf.h_lips + first);
+        write_frf_peaks(&an);
+        frf_peaks_free(&an);
+    }
+    frf_free(&frf);
+}
@@ -0,0 +1,245 @@
+#ifndef PROCESSING_STAGES_H
+#define PROCESSING_STAGES_H
+
+#include <stdio.h>
+#include "pipeline.h"
+#include "wav_io.h"
+#include "session_store.h"
+#include "mls.h"
+
+/*
+ * Stages shared by the modes that work on the stored captures
+ * (processing, staggered sweeps, parameter sweep, peaks): opening and
+ * reading the captures, their session store keys, the linear IR of a
+ * capture (from the store or computed), and the FRF and peak outputs.
+ */
+
+/* A capture as processing reads it: straight from its reader, or through a decimator */
+typedef struct {
+    SampleSource read;
+    void *context;
+    int chunk;    /* Samples per read */
+} CaptureInput;
+
+/* Session store keys of a take's stages; index 0 is the calibration, 1 the measurement */
+typedef struct {
+    StoreKey capture[2];
+    StoreKey ir[2];   /* Windowed linear IR spectra */
+    StoreKey frf;
+} TakeKeys;
+
+/* Linear IRs of a take, each restored from the session store or computed (see linear_ir_get()) */
+typedef struct {
+    const ChirpParams *chirp;
+    double fs;
+    int nfft;                /* Full-length FFT size */
+    int work_nfft;           /* Bins of the IR spectrum: nfft, or the segmented FFT size */
+    int n_samples_chirp;
+    int npre, npost;
+    int segmented;           /* Segmented (overlap-save) deconvolution */
+    kiss_fft_cfg cfg_fwd;    /* nfft plans: none when segmenting, forward only for MLS */
+    kiss_fft_cfg cfg_inv;
+    kiss_fft_cpx *inv_filter; /* Full-length sweeps only */
+    MlsDecoder mls;          /* MLS takes only */
+    int prepared;            /* Inverse filter or MLS permutations generated (on the first IR computed) */
+} LinearIrStage;
+
+/**
+ * Opens the calibration and measurement captures and checks that they
+ * match: rate, channels, and a length covering the chirp. The chirp
+ * stored with the calibration takes precedence over chirp_params and is
+ * copied to chirp_out.
+ *
+ * Parameters:
+ *   calib, meas: Readers to open
+ *   chirp_params: Chirp parameters (used if the calibration carries none)
+ *   sample_rate: Requested sampling rate (Hz), reported if it differs; 0 if none
+ *   chirp_out: Chirp of the take
+ *
+ * Returns:
+ *   0 with both readers open, -1 on failure with both closed
+ */
+int open_capture_pair(WavReader *calib, WavReader *meas, const ChirpParams *chirp_params, double sample_rate,
+                      ChirpParams *chirp_out);
+
+/**
+ * Sets up how both captures are read: at their own rate, or through a
+ * decimator when the options ask for a lower one. The band to keep is
+ * the sweep plus the FRF band margin. dec[] is zeroed when not
+ * decimating, so close_capture_inputs() is always safe on it.
+ *
+ * Parameters:
+ *   captures: Calibration and measurement readers
+ *   chirp: Chirp of the take
+ *   options: Decimation mode and factor
+ *   dec: Output, the decimators
+ *   in: Output, how each capture is read
+ *
+ * Returns:
+ *   Processing rate (Hz), or -1 if the factor cannot keep the band
+ */
+double open_capture_inputs(WavReader *captures[2], const ChirpParams *chirp, const ProcessingOptions *options,
+                           Decimator dec[2], CaptureInput in[2]);
+
+/**
+ * Closes both captures and their decimators.
+ */
+void close_capture_inputs(WavReader *calib, WavReader *meas, Decimator dec[2]);
+
+/**
+ * Samples of a capture at the processing rate.
+ */
+int64_t capture_input_length(const WavReader *capture, const Decimator *dec);
+
+/**
+ * Deconvolves both captures at full length and returns to the time
+ * domain, without windowing. The inverse filter is generated first.
+ *
+ * Parameters:
+ *   inputs: Calibration and measurement inputs
+ *   chirp, fs: Chirp of the take and processing rate (Hz)
+ *   nfft, n_samples: FFT size and samples of each capture to read
+ *   inv_filter: nfft bins, set to the inverse filter
+ *   cfg_fwd, cfg_inv: nfft plans
+ *   closed_time, open_time: Output, nfft samples each
+ *
+ * Returns:
+ *   0 on success, -1 if a capture could not be read
+ */
+int deconvolve_take(const CaptureInput inputs[2], const ChirpParams *chirp, double fs, int nfft, int n_samples,
+                    kiss_fft_cpx *inv_filter, kiss_fft_cfg cfg_fwd, kiss_fft_cfg cfg_inv,
+                    kiss_fft_cpx *closed_time, kiss_fft_cpx *open_time);
+
+/**
+ * Approximate peak memory of the full-length deconvolution in bytes:
+ * FFT buffers, plans and extract_linear_ir() scratch.
+ */
+size_t full_processing_memory(int nfft);
+
+/**
+ * Keys every stage of a take by its inputs, and keeps a copy of both
+ * captures in the session store. The capture keys hash every sample,
+ * which is only done once per written file (see session_store.h).
+ *
+ * Parameters:
+ *   captures, dec: Calibration and measurement readers and decimators
+ *   chirp_params, fs: Chirp of the take and processing rate (Hz)
+ *   nfft, npre, npost, segmented: Linear IR deconvolution and window
+ *   export: FRF output band and grid
+ *   keys: Output
+ *
+ * Returns:
+ *   0 on success, -1 if a capture could not be read
+ */
+int take_keys(WavReader *captures[2], const Decimator dec[2], const ChirpParams *chirp_params, double fs, int nfft,
+              int npre, int npost, int segmented, const FrfExportOptions *export, TakeKeys *keys);
+
+/**
+ * Prepares the linear IRs of a take, allocating the plans and inverse
+ * filter its deconvolution path needs: MLS takes are deconvolved by
+ * Hadamard transform, sweeps in memory or, with segmented, in segments
+ * of work_nfft (see stream_deconv.h).
+ *
+ * Returns:
+ *   0 on success, -1 on allocation failure (linear_ir_stage_free() is still safe)
+ */
+int linear_ir_stage_init(LinearIrStage *stage, const ChirpParams *chirp, double fs, int nfft, int work_nfft,
+                         int n_samples_chirp, int npre, int npost, int segmented);
+
+/**
+ * Gets the windowed linear IR spectrum of one capture: from the session
+ * store under ir_key, or computed and then stored. The inverse filter
+ * (or MLS permutations) is only generated if an IR has to be computed.
+ *
+ * Parameters:
+ *   stage: From linear_ir_stage_init()
+ *   buf: Output, work_nfft bins
+ *   input: Capture to deconvolve on a store miss
+ *   capture_key, ir_key: Keys of the capture and of its IR (from take_keys())
+ *   label: "Calibration" or "Measurement", for the messages
+ *   report_energy: Print the deconvolved energy We when computed in memory
+ *
+ * Returns:
+ *   0 on success, -1 on failure
+ */
+int linear_ir_get(LinearIrStage *stage, kiss_fft_cpx *buf, const CaptureInput *input, StoreKey capture_key,
+                  StoreKey ir_key, const char *label, int report_energy);
+
+/**
+ * Frees what linear_ir_stage_init() allocated.
+ */
+void linear_ir_stage_free(LinearIrStage *stage);
+
+/**
+ * Restores a stored FRF to DEFAULT_FRF_FILE (and its CSV export if
+ * requested).
+ *
+ * Returns:
+ *   0 on success, -1 if not stored
+ */
+int export_cached_frf(StoreKey key, const FrfExportOptions *export);
+
+/**
+ * Adds the FRF just written to frf_path to the FRF database, labelled
+ * with the subject and session and timestamped with the measurement
+ * capture. Failures are reported but do not fail processing.
+ */
+void add_to_frf_database(StoreKey key, const char *frf_path, const char *subject, const char *session);
+
+/**
+ * Sets the output axis of the FRF, the requested band and grid. The
+ * output only reads bins [*first_active, *first_active + *num_active);
+ * H_lips need only be computed on these.
+ *
+ * Returns:
+ *   First bin of the band
+ */
+int frf_output_axis(FrfInfo *info, const FrfExportOptions *export, int *first_active, int *num_active);
+
+/**
+ * Restricts the spectra to the output axis set by frf_output_axis(),
+ * then writes the binary FRF and optional CSV. Bin-aligned output
+ * without resampling is written straight from the FFT buffers.
+ *
+ * Returns:
+ *   0 on success, -1 on failure
+ */
+int write_frf_outputs(const FrfInfo *info, const FrfExportOptions *export, int first_bin,
+                      const kiss_fft_cpx *h_lips, const kiss_fft_cpx *open, const kiss_fft_cpx *closed,
+                      const char *frf_path, const char *csv_path);
+
+/**
+ * Writes one CSV row per peak; prefix holds any leading columns, each
+ * followed by a comma.
+ */
+void write_peak_rows(FILE *file, const char *prefix, const FrfPeak *peaks, int count);
+
+/**
+ * Extracts the peaks of H_lips from the FFT bins of the sweep band (only
+ * bins [first_active, first_active + num_active) are computed), writes
+ * DEFAULT_PEAKS_CSV_FILE and keeps the table in the session store with
+ * the FRF. Failures are reported but do not fail processing.
+ */
+void frf_bin_peaks(StoreKey frf_key, const kiss_fft_cpx *h_lips, int first_active, int num_active, double bin_hz,
+                   const ChirpParams *chirp_params, const FrfPeakOptions *options);
+
+/**
+ * Restores the peak table of a stored FRF; without one for these options
+ * the FRF restored to DEFAULT_FRF_FILE is analysed on its output grid.
+ */
+void restore_frf_peaks(StoreKey frf_key, const FrfPeakOptions *options);
+
+/**
+ * Processes a take of staggered sweeps (see multi_sweep.h) and closes its
+ * captures. Each capture is deconvolved once at full length; the linear
+ * IR of every sweep is then windowed out at its offset and gives its own
+ * FRF, written to DEFAULT_SWEEP_FRF_FILE and added to the FRF database.
+ * The stages are not kept in the session store.
+ *
+ * Returns:
+ *   0 on success, -1 on failure
+ */
+int process_multi_sweep(WavReader *calib, WavReader *meas, Decimator dec[2], const CaptureInput inputs[2],
+                        const ChirpParams *chirp_params, double fs, const ProcessingOptions *options);
+
+#endif
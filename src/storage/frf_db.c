@@ -0,0 +1,695 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "frf_db.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define FRF_DB_KEYS_MIN_SLOTS 1024
+#define FRF_DB_SLOT_SIZE 16        /* Entry hash (uint64, 0 = empty slot), record number (uint64) */
+#define FRF_DB_REBUILD_CHUNK 256   /* Index records read per call when rebuilding the key table */
+
+// --- Little-endian encoding helpers ---
+
+static void put_u32(unsigned char *p, uint32_t v) {
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+    p[2] = (unsigned char)(v >> 16);
+    p[3] = (unsigned char)(v >> 24);
+}
+
+static void put_u64(unsigned char *p, uint64_t v) {
+    put_u32(p, (uint32_t)v);
+    put_u32(p + 4, (uint32_t)(v >> 32));
+}
+
+static void put_f32(unsigned char *p, float v) {
+    uint32_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    put_u32(p, bits);
+}
+
+static void put_f64(unsigned char *p, double v) {
+    uint64_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    put_u64(p, bits);
+}
+
+static uint32_t get_u32(const unsigned char *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t get_u64(const unsigned char *p) {
+    return (uint64_t)get_u32(p) | ((uint64_t)get_u32(p + 4) << 32);
+}
+
+static float get_f32(const unsigned char *p) {
+    uint32_t bits = get_u32(p);
+    float v;
+    memcpy(&v, &bits, sizeof(v));
+    return v;
+}
+
+static double get_f64(const unsigned char *p) {
+    uint64_t bits = get_u64(p);
+    double v;
+    memcpy(&v, &bits, sizeof(v));
+    return v;
+}
+
+// --- Records ---
+
+/* Labels are stored NUL-padded; the record is zeroed beforehand */
+static void put_name(unsigned char *p, const char *name) {
+    memcpy(p, name, strnlen(name, FRF_DB_NAME_SIZE - 1));
+}
+
+static void encode_record(unsigned char *rec, const FrfDbEntry *entry) {
+    memset(rec, 0, FRF_DB_RECORD_SIZE);
+    put_u64(rec, entry->key);
+    put_u64(rec + 8, (uint64_t)entry->timestamp);
+    put_name(rec + 16, entry->subject);
+    put_name(rec + 48, entry->session);
+    put_u64(rec + 80, entry->data_offset);
+    put_u32(rec + 88, (uint32_t)entry->info.grid.num_points);
+    put_u32(rec + 92, (uint32_t)entry->info.nfft);
+    put_f64(rec + 96, entry->info.sample_rate);
+    put_f32(rec + 104, entry->info.chirp.amplitude);
+    put_f32(rec + 108, entry->info.chirp.start_freq);
+    put_f32(rec + 112, entry->info.chirp.end_freq);
+    put_f32(rec + 116, entry->info.chirp.duration);
+    put_f32(rec + 120, entry->info.chirp.Tgap);
+    put_f32(rec + 124, entry->info.chirp.Tfade);
+    put_u32(rec + 128, (uint32_t)entry->info.chirp.type);
+    put_u32(rec + 132, (uint32_t)entry->info.grid.type);
+    put_f64(rec + 136, entry->info.grid.f_min);
+    put_f64(rec + 144, entry->info.grid.f_max);
+    put_f32(rec + 152, entry->quality.peak_db);
+    put_f32(rec + 156, entry->quality.peak_freq);
+    put_f32(rec + 160, entry->quality.open_level_db);
+    put_f32(rec + 164, entry->quality.closed_level_db);
+}
+
+static void decode_record(const unsigned char *rec, FrfDbEntry *entry) {
+    memset(entry, 0, sizeof(*entry));
+    entry->key = get_u64(rec);
+    entry->timestamp = (int64_t)get_u64(rec + 8);
+    memcpy(entry->subject, rec + 16, FRF_DB_NAME_SIZE - 1);
+    memcpy(entry->session, rec + 48, FRF_DB_NAME_SIZE - 1);
+    entry->data_offset = get_u64(rec + 80);
+    entry->info.grid.num_points = (int)get_u32(rec + 88);
+    entry->info.nfft = (int)get_u32(rec + 92);
+    entry->info.sample_rate = get_f64(rec + 96);
+    entry->info.chirp.amplitude = get_f32(rec + 104);
+    entry->info.chirp.start_freq = get_f32(rec + 108);
+    entry->info.chirp.end_freq = get_f32(rec + 112);
+    entry->info.chirp.duration = get_f32(rec + 116);
+    entry->info.chirp.Tgap = get_f32(rec + 120);
+    entry->info.chirp.Tfade = get_f32(rec + 124);
+    entry->info.chirp.type = (int)get_u32(rec + 128);
+    entry->info.grid.type = (FrfGridType)get_u32(rec + 132);
+    entry->info.grid.f_min = get_f64(rec + 136);
+    entry->info.grid.f_max = get_f64(rec + 144);
+    entry->quality.peak_db = get_f32(rec + 152);
+    entry->quality.peak_freq = get_f32(rec + 156);
+    entry->quality.open_level_db = get_f32(rec + 160);
+    entry->quality.closed_level_db = get_f32(rec + 164);
+}
+
+static size_t entry_data_bytes(const FrfDbEntry *entry) {
+    return sizeof(float_cpx) * (size_t)entry->info.grid.num_points * FRF_NUM_ARRAYS;
+}
+
+static void db_path(char *path, size_t size, const char *dir, const char *file) {
+    snprintf(path, size, "%s/%s", dir, file);
+}
+
+static int check_header(const unsigned char *header, const char *magic) {
+    return memcmp(header, magic, 4) == 0 && get_u32(header + 4) == FRF_DB_VERSION
+           && get_u32(header + 8) == FRF_DB_HEADER_SIZE
+           && (magic[3] != 'X' || get_u32(header + 12) == FRF_DB_RECORD_SIZE);
+}
+
+/*
+ * Reads the whole index. Only complete records count; *valid_bytes is the
+ * length of the file up to the last one (the header alone for a new index).
+ */
+static int read_index(const char *path, FrfDbEntry **entries, size_t *count, off_t *valid_bytes) {
+    *entries = NULL;
+    *count = 0;
+    *valid_bytes = 0;
+
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        return errno == ENOENT ? 0 : -1;
+    }
+
+    unsigned char header[FRF_DB_HEADER_SIZE];
+    size_t got = fread(header, 1, sizeof(header), file);
+    if (got == 0) {
+        fclose(file);
+        return 0;
+    }
+    if (got != sizeof(header) || !check_header(header, "VTDX")) {
+        fprintf(stderr, "'%s' is not an FRF database index\n", path);
+        fclose(file);
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fileno(file), &st) != 0) {
+        fclose(file);
+        return -1;
+    }
+    size_t n = ((size_t)st.st_size - FRF_DB_HEADER_SIZE) / FRF_DB_RECORD_SIZE;
+    *valid_bytes = FRF_DB_HEADER_SIZE + (off_t)(n * FRF_DB_RECORD_SIZE);
+
+    if (n > 0) {
+        unsigned char *records = (unsigned char*)malloc(n * FRF_DB_RECORD_SIZE);
+        *entries = (FrfDbEntry*)malloc(n * sizeof(FrfDbEntry));
+        if (!records || !*entries || fread(records, FRF_DB_RECORD_SIZE, n, file) != n) {
+            fprintf(stderr, "Failed to read FRF database index '%s'\n", path);
+            free(records);
+            free(*entries);
+            *entries = NULL;
+            fclose(file);
+            return -1;
+        }
+        for (size_t i = 0; i < n; i++) {
+            decode_record(records + i * FRF_DB_RECORD_SIZE, &(*entries)[i]);
+        }
+        free(records);
+        *count = n;
+    }
+    fclose(file);
+    return 0;
+}
+
+/* Opens a database file for appending, writing its header if it is new */
+static FILE *open_for_append(const char *path, const char *magic, off_t *end) {
+    FILE *file = fopen(path, "ab+");
+    if (!file || fseeko(file, 0, SEEK_END) != 0) {
+        fprintf(stderr, "Failed to open '%s' for appending\n", path);
+        if (file) fclose(file);
+        return NULL;
+    }
+
+    *end = ftello(file);
+    if (*end == 0) {
+        unsigned char header[FRF_DB_HEADER_SIZE];
+        memset(header, 0, sizeof(header));
+        memcpy(header, magic, 4);
+        put_u32(header + 4, FRF_DB_VERSION);
+        put_u32(header + 8, FRF_DB_HEADER_SIZE);
+        if (magic[3] == 'X') put_u32(header + 12, FRF_DB_RECORD_SIZE);
+        if (fwrite(header, 1, sizeof(header), file) != sizeof(header)) {
+            fclose(file);
+            return NULL;
+        }
+        *end = FRF_DB_HEADER_SIZE;
+    } else {
+        unsigned char header[FRF_DB_HEADER_SIZE];
+        if (fseeko(file, 0, SEEK_SET) != 0 || fread(header, 1, sizeof(header), file) != sizeof(header)
+            || !check_header(header, magic) || fseeko(file, 0, SEEK_END) != 0) {
+            fprintf(stderr, "'%s' is not an FRF database file\n", path);
+            fclose(file);
+            return NULL;
+        }
+    }
+    return file;
+}
+
+// --- Duplicate detection ---
+
+static int pread_all(int fd, void *buf, size_t bytes, off_t offset) {
+    unsigned char *p = (unsigned char *)buf;
+    while (bytes > 0) {
+        ssize_t got = pread(fd, p, bytes, offset);
+        if (got <= 0) {
+            if (got < 0 && errno == EINTR) continue;
+            return -1;
+        }
+        p += got;
+        bytes -= (size_t)got;
+        offset += got;
+    }
+    return 0;
+}
+
+static int pwrite_all(int fd, const void *buf, size_t bytes, off_t offset) {
+    const unsigned char *p = (const unsigned char *)buf;
+    while (bytes > 0) {
+        ssize_t put = pwrite(fd, p, bytes, offset);
+        if (put < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        p += put;
+        bytes -= (size_t)put;
+        offset += put;
+    }
+    return 0;
+}
+
+/* Identity of an entry for duplicate detection: key, subject and session (never 0) */
+static uint64_t entry_hash(const FrfDbEntry *entry) {
+    StoreHasher hasher;
+    store_hash_init(&hasher);
+    store_hash_int(&hasher, (int64_t)entry->key);
+    store_hash_bytes(&hasher, entry->subject, strnlen(entry->subject, FRF_DB_NAME_SIZE));
+    store_hash_bytes(&hasher, "", 1);
+    store_hash_bytes(&hasher, entry->session, strnlen(entry->session, FRF_DB_NAME_SIZE));
+    uint64_t hash = store_hash_final(&hasher);
+    return hash ? hash : 1;
+}
+
+static int same_entry(const FrfDbEntry *a, const FrfDbEntry *b) {
+    return a->key == b->key && strncmp(a->subject, b->subject, FRF_DB_NAME_SIZE) == 0
+           && strncmp(a->session, b->session, FRF_DB_NAME_SIZE) == 0;
+}
+
+static off_t record_offset(uint64_t record) {
+    return FRF_DB_HEADER_SIZE + (off_t)record * FRF_DB_RECORD_SIZE;
+}
+
+static off_t slot_offset(uint64_t slot) {
+    return FRF_DB_HEADER_SIZE + (off_t)slot * FRF_DB_SLOT_SIZE;
+}
+
+/* Places a record in an in-memory key table (linear probing; the table is never full) */
+static void table_insert(unsigned char *table, uint64_t num_slots, uint64_t hash, uint64_t record) {
+    uint64_t slot = hash & (num_slots - 1);
+    while (get_u64(table + slot * FRF_DB_SLOT_SIZE) != 0) {
+        slot = (slot + 1) & (num_slots - 1);
+    }
+    put_u64(table + slot * FRF_DB_SLOT_SIZE, hash);
+    put_u64(table + slot * FRF_DB_SLOT_SIZE + 8, record);
+}
+
+/*
+ * Rewrites the key table from the first num_records index records, sized
+ * so that it stays at most half full for as many appends again. Reads the
+ * index through the locked descriptor: closing another descriptor of the
+ * index would drop the lock.
+ */
+static int rebuild_keys(int keys_fd, int index_fd, uint64_t num_records, uint64_t *num_slots) {
+    uint64_t slots = FRF_DB_KEYS_MIN_SLOTS;
+    while (slots < 4 * (num_records + 1)) {
+        slots *= 2;
+    }
+    unsigned char *table = (unsigned char*)calloc((size_t)slots, FRF_DB_SLOT_SIZE);
+    unsigned char *records = (unsigned char*)malloc((size_t)FRF_DB_REBUILD_CHUNK * FRF_DB_RECORD_SIZE);
+    int ret = -1;
+    if (!table || !records) {
+        goto done;
+    }
+
+    for (uint64_t first = 0; first < num_records; first += FRF_DB_REBUILD_CHUNK) {
+        uint64_t n = num_records - first < FRF_DB_REBUILD_CHUNK ? num_records - first : FRF_DB_REBUILD_CHUNK;
+        if (pread_all(index_fd, records, (size_t)n * FRF_DB_RECORD_SIZE, record_offset(first)) != 0) {
+            goto done;
+        }
+        for (uint64_t i = 0; i < n; i++) {
+            FrfDbEntry entry;
+            decode_record(records + i * FRF_DB_RECORD_SIZE, &entry);
+            table_insert(table, slots, entry_hash(&entry), first + i);
+        }
+    }
+
+    unsigned char header[FRF_DB_HEADER_SIZE];
+    memset(header, 0, sizeof(header));
+    memcpy(header, "VTDK", 4);
+    put_u32(header + 4, FRF_DB_VERSION);
+    put_u32(header + 8, FRF_DB_HEADER_SIZE);
+    put_u64(header + 16, slots);
+    put_u64(header + 24, num_records);
+    if (ftruncate(keys_fd, 0) != 0 || pwrite_all(keys_fd, table, (size_t)slots * FRF_DB_SLOT_SIZE, slot_offset(0)) != 0
+        || pwrite_all(keys_fd, header, sizeof(header), 0) != 0) {
+        goto done;
+    }
+    *num_slots = slots;
+    ret = 0;
+
+done:
+    free(table);
+    free(records);
+    return ret;
+}
+
+/*
+ * Opens the key table of an index holding num_records records, rebuilding
+ * it if it is missing, covers another number of records (an append was
+ * interrupted after its index record) or would pass half full.
+ */
+static int open_keys(const char *path, int index_fd, uint64_t num_records, uint64_t *num_slots) {
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "Failed to open FRF database keys '%s'\n", path);
+        return -1;
+    }
+    unsigned char header[FRF_DB_HEADER_SIZE];
+    *num_slots = 0;
+    if (pread_all(fd, header, sizeof(header), 0) == 0 && check_header(header, "VTDK")) {
+        *num_slots = get_u64(header + 16);
+        if (get_u64(header + 24) != num_records || *num_slots < FRF_DB_KEYS_MIN_SLOTS
+            || (*num_slots & (*num_slots - 1)) != 0) {
+            *num_slots = 0;
+        }
+    }
+    if (*num_slots < 2 * (num_records + 1) && rebuild_keys(fd, index_fd, num_records, num_slots) != 0) {
+        fprintf(stderr, "Failed to rebuild FRF database keys '%s'\n", path);
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/*
+ * Looks an entry up in the key table. Returns 1 if the index already
+ * holds it, 0 with *free_slot set to where it goes otherwise, -1 on a
+ * read error. Hash matches are confirmed against the index record.
+ */
+static int find_key(int keys_fd, int index_fd, uint64_t num_slots, const FrfDbEntry *entry, uint64_t *free_slot) {
+    uint64_t hash = entry_hash(entry);
+    for (uint64_t slot = hash & (num_slots - 1);; slot = (slot + 1) & (num_slots - 1)) {
+        unsigned char s[FRF_DB_SLOT_SIZE];
+        if (pread_all(keys_fd, s, sizeof(s), slot_offset(slot)) != 0) {
+            return -1;
+        }
+        uint64_t stored = get_u64(s);
+        if (stored == 0) {
+            *free_slot = slot;
+            return 0;
+        }
+        if (stored == hash) {
+            unsigned char rec[FRF_DB_RECORD_SIZE];
+            FrfDbEntry existing;
+            if (pread_all(index_fd, rec, sizeof(rec), record_offset(get_u64(s + 8))) != 0) {
+                return -1;
+            }
+            decode_record(rec, &existing);
+            if (same_entry(&existing, entry)) {
+                return 1;
+            }
+        }
+    }
+}
+
+/* Opens (creating) a file for reading and writing and blocks until this process holds its write lock */
+static int open_locked(const char *path) {
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        return -1;
+    }
+    struct flock lock;
+    memset(&lock, 0, sizeof(lock));
+    lock.l_type = F_WRLCK;
+    lock.l_whence = SEEK_SET;
+    while (fcntl(fd, F_SETLKW, &lock) != 0) {
+        if (errno != EINTR) {
+            close(fd);
+            return -1;
+        }
+    }
+    return fd;
+}
+
+// --- Quality ---
+
+void frf_db_quality(const FrfInfo *info, const kiss_fft_cpx *h_lips, const kiss_fft_cpx *open,
+                    const kiss_fft_cpx *closed, FrfDbQuality *quality) {
+    memset(quality, 0, sizeof(*quality));
+
+    FrfDbEntry band;
+    memset(&band, 0, sizeof(band));
+    band.info = *info;
+    int first = 0;
+    int count = frf_db_point_range(&band, info->chirp.start_freq, info->chirp.end_freq, &first);
+    if (count == 0) {
+        first = 0;
+        count = info->grid.num_points;
+    }
+
+    double peak = 0.0, open_power = 0.0, closed_power = 0.0;
+    int peak_index = first;
+    for (int k = first; k < first + count; k++) {
+        double h = h_lips[k].r * h_lips[k].r + h_lips[k].i * h_lips[k].i;
+        if (h > peak) {
+            peak = h;
+            peak_index = k;
+        }
+        open_power += open[k].r * open[k].r + open[k].i * open[k].i;
+        closed_power += closed[k].r * closed[k].r + closed[k].i * closed[k].i;
+    }
+
+    quality->peak_db = (float)(10.0 * log10(peak + 1e-30));
+    quality->peak_freq = (float)frf_grid_frequency(&info->grid, peak_index);
+    quality->open_level_db = (float)(10.0 * log10(open_power / count + 1e-30));
+    quality->closed_level_db = (float)(10.0 * log10(closed_power / count + 1e-30));
+}
+
+// --- Append ---
+
+int frf_db_append(const char *dir, const FrfDbEntry *entry, const kiss_fft_cpx *h_lips,
+                  const kiss_fft_cpx *open, const kiss_fft_cpx *closed) {
+    if (mkdir(dir, 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "Failed to create FRF database directory '%s'\n", dir);
+        return -1;
+    }
+
+    char index_path[STORE_PATH_MAX];
+    char data_path[STORE_PATH_MAX];
+    char keys_path[STORE_PATH_MAX];
+    db_path(index_path, sizeof(index_path), dir, FRF_DB_INDEX_FILE);
+    db_path(data_path, sizeof(data_path), dir, FRF_DB_DATA_FILE);
+    db_path(keys_path, sizeof(keys_path), dir, FRF_DB_KEYS_FILE);
+
+    /* Appenders take turns on the index lock, held until the index is closed; every
+     * access to the index below goes through index_fd, since closing any other
+     * descriptor of it would release the lock */
+    int keys_fd = -1;
+    FILE *data = NULL;
+    int ret = -1;
+    int index_fd = open_locked(index_path);
+    if (index_fd < 0) {
+        fprintf(stderr, "Failed to open and lock FRF database index '%s'\n", index_path);
+        goto done;
+    }
+
+    unsigned char header[FRF_DB_HEADER_SIZE];
+    struct stat st;
+    if (fstat(index_fd, &st) != 0) {
+        goto done;
+    }
+    if (st.st_size == 0) {
+        memset(header, 0, sizeof(header));
+        memcpy(header, "VTDX", 4);
+        put_u32(header + 4, FRF_DB_VERSION);
+        put_u32(header + 8, FRF_DB_HEADER_SIZE);
+        put_u32(header + 12, FRF_DB_RECORD_SIZE);
+        if (pwrite_all(index_fd, header, sizeof(header), 0) != 0) {
+            fprintf(stderr, "Failed to create FRF database index '%s'\n", index_path);
+            goto done;
+        }
+        st.st_size = FRF_DB_HEADER_SIZE;
+    } else if (st.st_size < FRF_DB_HEADER_SIZE || pread_all(index_fd, header, sizeof(header), 0) != 0
+               || !check_header(header, "VTDX")) {
+        fprintf(stderr, "'%s' is not an FRF database index\n", index_path);
+        goto done;
+    }
+
+    /* Drop a torn record left by an interrupted append before adding ours */
+    uint64_t num_records = (uint64_t)(st.st_size - FRF_DB_HEADER_SIZE) / FRF_DB_RECORD_SIZE;
+    if (st.st_size != record_offset(num_records) && ftruncate(index_fd, record_offset(num_records)) != 0) {
+        fprintf(stderr, "Failed to repair FRF database index '%s'\n", index_path);
+        goto done;
+    }
+
+    uint64_t num_slots, slot;
+    keys_fd = open_keys(keys_path, index_fd, num_records, &num_slots);
+    if (keys_fd < 0) {
+        goto done;
+    }
+    int found = find_key(keys_fd, index_fd, num_slots, entry, &slot);
+    if (found != 0) {
+        if (found < 0) fprintf(stderr, "Failed to read FRF database keys '%s'\n", keys_path);
+        ret = found;
+        goto done;
+    }
+
+    /* Spectra first, aligned; the index record only goes out once they are complete */
+    off_t end;
+    data = open_for_append(data_path, "VTDD", &end);
+    if (!data) {
+        goto done;
+    }
+    static const unsigned char zeros[FRF_DB_ALIGN];
+    size_t pad = (size_t)((FRF_DB_ALIGN - end % FRF_DB_ALIGN) % FRF_DB_ALIGN);
+    int failed = pad > 0 && fwrite(zeros, 1, pad, data) != pad;
+
+    FrfDbEntry record = *entry;
+    record.data_offset = (uint64_t)(end + (off_t)pad);
+    const kiss_fft_cpx *arrays[FRF_NUM_ARRAYS] = { h_lips, open, closed };
+    size_t n_points = (size_t)entry->info.grid.num_points;
+    for (int a = 0; a < FRF_NUM_ARRAYS && !failed; a++) {
+        failed = frf_write_bins(data, arrays[a], n_points) != 0;
+    }
+    if (fclose(data) != 0) failed = 1;
+    data = NULL;
+    if (failed) {
+        fprintf(stderr, "Failed to append spectra to '%s'\n", data_path);
+        goto done;
+    }
+
+    unsigned char rec[FRF_DB_RECORD_SIZE];
+    encode_record(rec, &record);
+    if (pwrite_all(index_fd, rec, sizeof(rec), record_offset(num_records)) != 0) {
+        fprintf(stderr, "Failed to append to FRF database index '%s'\n", index_path);
+        goto done;
+    }
+
+    /* The slot, then the record count: a table left behind by a failure here is rebuilt */
+    unsigned char s[FRF_DB_SLOT_SIZE];
+    unsigned char count[8];
+    put_u64(s, entry_hash(entry));
+    put_u64(s + 8, num_records);
+    put_u64(count, num_records + 1);
+    if (pwrite_all(keys_fd, s, sizeof(s), slot_offset(slot)) != 0 || pwrite_all(keys_fd, count, sizeof(count), 24) != 0) {
+        fprintf(stderr, "Failed to update FRF database keys '%s'\n", keys_path);
+    }
+    ret = 0;
+
+done:
+    if (data) fclose(data);
+    if (keys_fd >= 0) close(keys_fd);
+    if (index_fd >= 0) close(index_fd);
+    return ret;
+}
+
+// --- Reading ---
+
+int frf_db_open(FrfDb *db, const char *dir) {
+    memset(db, 0, sizeof(*db));
+
+    char index_path[STORE_PATH_MAX];
+    char data_path[STORE_PATH_MAX];
+    db_path(index_path, sizeof(index_path), dir, FRF_DB_INDEX_FILE);
+    db_path(data_path, sizeof(data_path), dir, FRF_DB_DATA_FILE);
+
+    FrfDbEntry *entries;
+    size_t count;
+    off_t index_bytes;
+    if (read_index(index_path, &entries, &count, &index_bytes) != 0) {
+        return -1;
+    }
+    if (index_bytes == 0) {
+        fprintf(stderr, "No FRF database in '%s'\n", dir);
+        return -1;
+    }
+
+    if (count > 0) {
+        int fd = open(data_path, O_RDONLY);
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) != 0 || st.st_size < FRF_DB_HEADER_SIZE) {
+            fprintf(stderr, "Failed to open FRF database spectra '%s'\n", data_path);
+            if (fd >= 0) close(fd);
+            free(entries);
+            return -1;
+        }
+        void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (map == MAP_FAILED) {
+            fprintf(stderr, "Failed to map '%s'\n", data_path);
+            free(entries);
+            return -1;
+        }
+        if (!check_header((const unsigned char *)map, "VTDD")) {
+            fprintf(stderr, "'%s' is not an FRF database data file\n", data_path);
+            munmap(map, (size_t)st.st_size);
+            free(entries);
+            return -1;
+        }
+        db->data = (const unsigned char *)map;
+        db->data_size = (size_t)st.st_size;
+    }
+
+    /* Keep only records whose spectra are fully present */
+    size_t kept = 0;
+    for (size_t i = 0; i < count; i++) {
+        const FrfDbEntry *e = &entries[i];
+        if (e->info.grid.num_points > 0 && e->data_offset >= FRF_DB_HEADER_SIZE
+            && e->data_offset % FRF_DB_ALIGN == 0 && e->data_offset <= db->data_size
+            && entry_data_bytes(e) <= db->data_size - e->data_offset) {
+            entries[kept++] = *e;
+        }
+    }
+    if (kept < count) {
+        fprintf(stderr, "FRF database '%s': skipped %zu record(s) without spectra\n", dir, count - kept);
+    }
+
+    db->entries = entries;
+    db->num_entries = kept;
+    return 0;
+}
+
+void frf_db_close(FrfDb *db) {
+    if (db->data) {
+        munmap((void *)db->data, db->data_size);
+    }
+    free(db->entries);
+    memset(db, 0, sizeof(*db));
+}
+
+// --- Queries ---
+
+size_t frf_db_query(const FrfDb *db, const FrfDbQuery *query, const FrfDbEntry **results,
+                    size_t max_results) {
+    size_t matches = 0;
+    for (size_t i = 0; i < db->num_entries; i++) {
+        const FrfDbEntry *e = &db->entries[i];
+        if ((query->subject && strcmp(e->subject, query->subject) != 0)
+            || (query->session && strcmp(e->session, query->session) != 0)
+            || (query->time_from && e->timestamp < query->time_from)
+            || (query->time_to && e->timestamp > query->time_to)) {
+            continue;
+        }
+        if (results && matches < max_results) {
+            results[matches] = e;
+        }
+        matches++;
+    }
+    return matches;
+}
+
+const float_cpx *frf_db_array(const FrfDb *db, const FrfDbEntry *entry, FrfArray array) {
+    const float_cpx *base = (const float_cpx *)(db->data + entry->data_offset);
+    return base + (size_t)entry->info.grid.num_points * array;
+}
+
+/* Number of leading points below f (or at most f if inclusive); grids are increasing */
+static int points_below(const FrfGrid *grid, double f, int inclusive) {
+    int lo = 0, hi = grid->num_points;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        double fm = frf_grid_frequency(grid, mid);
+        if (fm < f || (inclusive && fm == f)) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+int frf_db_point_range(const FrfDbEntry *entry, double f_lo, double f_hi, int *first) {
+    int begin = points_below(&entry->info.grid, f_lo, 0);
+    int end = points_below(&entry->info.grid, f_hi, 1);
+    *first = begin;
+    return end > begin ? end - begin : 0;
+}
@@ -0,0 +1,186 @@
+#ifndef FRF_DB_H
+#define FRF_DB_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "frf_io.h"
+#include "session_store.h"
+#include "complex_utils.h"
+
+#define DEFAULT_FRF_DB_DIR "output/frf_db"
+#define FRF_DB_INDEX_FILE "frf_db.idx"
+#define FRF_DB_DATA_FILE "frf_db.dat"
+#define FRF_DB_KEYS_FILE "frf_db.keys"
+#define FRF_DB_NAME_SIZE 32 /* Subject/session label, including the terminating NUL */
+
+/**
+ * Append-only FRF database.
+ *
+ * frf_db.dat holds the spectra of every entry: FRF_NUM_ARRAYS contiguous
+ * complex float32 arrays per entry (FrfArray order), each block starting
+ * on a FRF_DB_ALIGN boundary. frf_db.idx holds one fixed-size record per
+ * entry: subject, session, timestamp, FRF metadata, quality metrics and
+ * the block offset. Both files only ever grow: the spectra are written
+ * before their index record, and a torn trailing record is ignored, so
+ * an interrupted append leaves the database readable.
+ *
+ * Index record layout (FRF_DB_RECORD_SIZE bytes, little-endian):
+ *
+ *   offset  size  field
+ *        0     8  FRF store key (uint64)
+ *        8     8  timestamp (int64, seconds since the epoch)
+ *       16    32  subject (NUL-padded)
+ *       48    32  session (NUL-padded)
+ *       80     8  offset of the spectra in frf_db.dat (uint64)
+ *       88     4  number of points per array
+ *       92     4  nfft of the source spectrum
+ *       96     8  sample rate (float64, Hz)
+ *      104    24  chirp amplitude, start/end frequency, duration,
+ *                 Tgap, Tfade (float32 each)
+ *      128     4  chirp type (int32)
+ *      132     4  grid type (FrfGridType)
+ *      136     8  grid f_min (float64, Hz)
+ *      144     8  grid f_max (float64, Hz)
+ *      152    16  quality: H_lips peak (dB), its frequency (Hz), mean
+ *                 open and closed level in the sweep band (dB), float32
+ *      168    88  reserved (zero)
+ *
+ * Both files start with a FRF_DB_HEADER_SIZE-byte header: magic
+ * ("VTDX" / "VTDD"), version, header size, and for the index the
+ * record size.
+ *
+ * frf_db.keys lets an append find a duplicate without reading the index:
+ * an open-addressing table, at most half full, of 16-byte slots holding a
+ * hash of an entry's key and labels and its record number. Its header
+ * ("VTDK") gives the slot count at offset 16 and the number of index
+ * records covered at offset 24. It is derived data, rebuilt from the
+ * index whenever that count does not match.
+ */
+#define FRF_DB_VERSION 1
+#define FRF_DB_HEADER_SIZE 64
+#define FRF_DB_RECORD_SIZE 256
+#define FRF_DB_ALIGN 64
+
+/**
+ * Quality metrics computed over the sweep band when an entry is added.
+ */
+typedef struct {
+    float peak_db;         /* Largest |H_lips| */
+    float peak_freq;       /* Frequency of peak_db (Hz) */
+    float open_level_db;   /* Mean power of the open-mouth response */
+    float closed_level_db; /* Mean power of the closed-mouth response */
+} FrfDbQuality;
+
+/**
+ * One database entry, decoded from its index record.
+ */
+typedef struct {
+    StoreKey key;          /* Session-store key of the FRF */
+    int64_t timestamp;
+    char subject[FRF_DB_NAME_SIZE];
+    char session[FRF_DB_NAME_SIZE];
+    FrfInfo info;
+    FrfDbQuality quality;
+    uint64_t data_offset;  /* Set by frf_db_append() */
+} FrfDbEntry;
+
+/**
+ * Selection for frf_db_query(). NULL labels and zero times match anything.
+ */
+typedef struct {
+    const char *subject;
+    const char *session;
+    int64_t time_from;     /* Inclusive */
+    int64_t time_to;       /* Inclusive */
+} FrfDbQuery;
+
+/**
+ * Read-only snapshot of a database opened with frf_db_open(). The index
+ * is decoded into entries; the spectra stay in the mapped data file.
+ * Entries appended after opening are not visible until it is reopened.
+ */
+typedef struct {
+    FrfDbEntry *entries;
+    size_t num_entries;
+    const unsigned char *data;
+    size_t data_size;
+} FrfDb;
+
+/**
+ * Computes the quality metrics of an FRF over its sweep band
+ * (info->chirp start to end frequency, clamped to the grid).
+ */
+void frf_db_quality(const FrfInfo *info, const kiss_fft_cpx *h_lips, const kiss_fft_cpx *open,
+                    const kiss_fft_cpx *closed, FrfDbQuality *quality);
+
+/**
+ * Appends an FRF to the database, creating it if needed. An entry with
+ * the same key, subject and session is not added twice. Appenders in
+ * other processes are serialized by an fcntl() write lock on the index;
+ * the cost does not grow with the number of entries.
+ *
+ * Parameters:
+ *   dir: Database directory
+ *   entry: Labels, timestamp, metadata and quality (data_offset is ignored)
+ *   h_lips, open, closed: entry->info.grid.num_points points each
+ *
+ * Returns:
+ *   0 if added, 1 if already present, -1 on failure
+ */
+int frf_db_append(const char *dir, const FrfDbEntry *entry, const kiss_fft_cpx *h_lips,
+                  const kiss_fft_cpx *open, const kiss_fft_cpx *closed);
+
+/**
+ * Opens a database: reads the index and maps the spectra. Records that
+ * are torn or point past the end of the data file are skipped.
+ *
+ * Parameters:
+ *   db: Output database (release with frf_db_close())
+ *   dir: Database directory
+ *
+ * Returns:
+ *   0 on success, -1 on failure (message printed to stderr)
+ */
+int frf_db_open(FrfDb *db, const char *dir);
+
+/**
+ * Unmaps the data file and frees the entries.
+ */
+void frf_db_close(FrfDb *db);
+
+/**
+ * Selects entries in append order.
+ *
+ * Parameters:
+ *   db: Open database
+ *   query: Selection
+ *   results: Receives pointers to the first max_results matches (may be NULL)
+ *   max_results: Capacity of results
+ *
+ * Returns:
+ *   Total number of matches, which may exceed max_results
+ */
+size_t frf_db_query(const FrfDb *db, const FrfDbQuery *query, const FrfDbEntry **results,
+                    size_t max_results);
+
+/**
+ * Returns one spectrum of an entry as a pointer into the mapped data
+ * file (no copy), valid until frf_db_close(). Stored bins are float32
+ * pairs in every build precision.
+ */
+const float_cpx *frf_db_array(const FrfDb *db, const FrfDbEntry *entry, FrfArray array);
+
+/**
+ * Finds the points of an entry whose frequency lies in [f_lo, f_hi].
+ *
+ * Parameters:
+ *   entry: Database entry
+ *   f_lo, f_hi: Frequency range (Hz)
+ *   first: Receives the index of the first point in range
+ *
+ * Returns:
+ *   Number of points in range (0 if none)
+ */
+int frf_db_point_range(const FrfDbEntry *entry, double f_lo, double f_hi, int *first);
+
+#endif
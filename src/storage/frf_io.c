@@ -0,0 +1,223 @@
+#include "frf_io.h"
+#include "complex_utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#define FRF_CSV_BUFFER_SIZE (1 << 20)
+#define FRF_CONVERT_CHUNK 4096 /* Bins narrowed per write in double builds */
+
+// --- Little-endian encoding helpers ---
+
+static void put_u32(unsigned char *p, uint32_t v) {
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+    p[2] = (unsigned char)(v >> 16);
+    p[3] = (unsigned char)(v >> 24);
+}
+
+static void put_f32(unsigned char *p, float v) {
+    uint32_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    put_u32(p, bits);
+}
+
+static void put_f64(unsigned char *p, double v) {
+    uint64_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    put_u32(p, (uint32_t)bits);
+    put_u32(p + 4, (uint32_t)(bits >> 32));
+}
+
+static uint32_t get_u32(const unsigned char *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static float get_f32(const unsigned char *p) {
+    uint32_t bits = get_u32(p);
+    float v;
+    memcpy(&v, &bits, sizeof(v));
+    return v;
+}
+
+static double get_f64(const unsigned char *p) {
+    uint64_t bits = (uint64_t)get_u32(p) | ((uint64_t)get_u32(p + 4) << 32);
+    double v;
+    memcpy(&v, &bits, sizeof(v));
+    return v;
+}
+
+// --- Binary container ---
+
+int frf_write_bins(FILE *file, const kiss_fft_cpx *bins, size_t n) {
+    /* Float builds: kiss_fft_cpx is (float re, float im); arrays go out as-is on little-endian hosts */
+    if (sizeof(kiss_fft_cpx) == sizeof(float_cpx)) {
+        return fwrite(bins, sizeof(kiss_fft_cpx), n, file) == n ? 0 : -1;
+    }
+    float_cpx chunk[FRF_CONVERT_CHUNK];
+    for (size_t done = 0; done < n; done += FRF_CONVERT_CHUNK) {
+        size_t count = n - done < FRF_CONVERT_CHUNK ? n - done : FRF_CONVERT_CHUNK;
+        complex_to_float32(chunk, bins + done, count);
+        if (fwrite(chunk, sizeof(float_cpx), count, file) != count) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int frf_write(const char *filename, const FrfInfo *info, const kiss_fft_cpx *h_lips,
+              const kiss_fft_cpx *open, const kiss_fft_cpx *closed) {
+    unsigned char header[FRF_HEADER_SIZE];
+    memset(header, 0, sizeof(header));
+
+    memcpy(header, "VTFR", 4);
+    put_u32(header + 4, FRF_FORMAT_VERSION);
+    put_u32(header + 8, FRF_HEADER_SIZE);
+    put_u32(header + 12, (uint32_t)info->grid.num_points);
+    put_u32(header + 16, (uint32_t)info->nfft);
+    put_u32(header + 20, FRF_NUM_ARRAYS);
+    put_f64(header + 24, info->sample_rate);
+    put_f32(header + 32, info->chirp.amplitude);
+    put_f32(header + 36, info->chirp.start_freq);
+    put_f32(header + 40, info->chirp.end_freq);
+    put_f32(header + 44, info->chirp.duration);
+    put_f32(header + 48, info->chirp.Tgap);
+    put_f32(header + 52, info->chirp.Tfade);
+    put_u32(header + 56, (uint32_t)info->chirp.type);
+    put_u32(header + 60, (uint32_t)info->grid.type);
+    put_f64(header + 64, info->grid.f_min);
+    put_f64(header + 72, info->grid.f_max);
+
+    FILE *file = fopen(filename, "wb");
+    if (!file) {
+        fprintf(stderr, "Failed to open '%s' for writing FRF\n", filename);
+        return -1;
+    }
+
+    const kiss_fft_cpx *arrays[FRF_NUM_ARRAYS] = { h_lips, open, closed };
+    int failed = fwrite(header, 1, sizeof(header), file) != sizeof(header);
+    size_t n_points = (size_t)info->grid.num_points;
+    for (int a = 0; a < FRF_NUM_ARRAYS && !failed; a++) {
+        failed = frf_write_bins(file, arrays[a], n_points) != 0;
+    }
+    if (fclose(file) != 0) failed = 1;
+
+    if (failed) {
+        fprintf(stderr, "Failed to write FRF to '%s'\n", filename);
+        return -1;
+    }
+    return 0;
+}
+
+int frf_read(const char *filename, FrfData *frf) {
+    memset(frf, 0, sizeof(*frf));
+
+    FILE *file = fopen(filename, "rb");
+    if (!file) {
+        fprintf(stderr, "Failed to open '%s'\n", filename);
+        return -1;
+    }
+
+    unsigned char header[FRF_HEADER_SIZE];
+    memset(header, 0, sizeof(header));
+    if (fread(header, 1, FRF_HEADER_SIZE_V1, file) != FRF_HEADER_SIZE_V1 || memcmp(header, "VTFR", 4) != 0) {
+        fprintf(stderr, "'%s' is not an FRF file\n", filename);
+        fclose(file);
+        return -1;
+    }
+
+    uint32_t version = get_u32(header + 4);
+    uint32_t header_size = get_u32(header + 8);
+    uint32_t num_arrays = get_u32(header + 20);
+    uint32_t min_header = (version == 1) ? FRF_HEADER_SIZE_V1 : FRF_HEADER_SIZE;
+    if (version < 1 || version > FRF_FORMAT_VERSION || header_size < min_header || num_arrays < FRF_NUM_ARRAYS
+        || (version > 1 && fread(header + FRF_HEADER_SIZE_V1, 1, FRF_HEADER_SIZE - FRF_HEADER_SIZE_V1, file)
+                           != FRF_HEADER_SIZE - FRF_HEADER_SIZE_V1)) {
+        fprintf(stderr, "'%s' has unsupported FRF version %u (header %u bytes, %u arrays)\n",
+                filename, version, header_size, num_arrays);
+        fclose(file);
+        return -1;
+    }
+
+    frf->info.grid.num_points = (int)get_u32(header + 12);
+    frf->info.nfft = (int)get_u32(header + 16);
+    frf->info.sample_rate = get_f64(header + 24);
+    frf->info.chirp.amplitude = get_f32(header + 32);
+    frf->info.chirp.start_freq = get_f32(header + 36);
+    frf->info.chirp.end_freq = get_f32(header + 40);
+    frf->info.chirp.duration = get_f32(header + 44);
+    frf->info.chirp.Tgap = get_f32(header + 48);
+    frf->info.chirp.Tfade = get_f32(header + 52);
+    frf->info.chirp.type = (int)get_u32(header + 56);
+
+    if (version == 1) {
+        frf->info.grid.type = FRF_GRID_LINEAR;
+        frf->info.grid.f_min = 0.0;
+        frf->info.grid.f_max = (frf->info.grid.num_points - 1) * frf->info.sample_rate / frf->info.nfft;
+    } else {
+        frf->info.grid.type = (FrfGridType)get_u32(header + 60);
+        frf->info.grid.f_min = get_f64(header + 64);
+        frf->info.grid.f_max = get_f64(header + 72);
+    }
+
+    size_t n_bins = (size_t)frf->info.grid.num_points;
+    kiss_fft_cpx *bins = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * n_bins * FRF_NUM_ARRAYS);
+    if (!bins) {
+        fprintf(stderr, "Failed to allocate %zu FRF bins\n", n_bins);
+        fclose(file);
+        return -1;
+    }
+
+    if (fseek(file, (long)header_size, SEEK_SET) != 0
+        || fread(bins, sizeof(float_cpx), n_bins * FRF_NUM_ARRAYS, file) != n_bins * FRF_NUM_ARRAYS) {
+        fprintf(stderr, "'%s' is truncated: expected %d arrays of %zu bins\n", filename, FRF_NUM_ARRAYS, n_bins);
+        free(bins);
+        fclose(file);
+        return -1;
+    }
+    fclose(file);
+    if (sizeof(kiss_fft_cpx) != sizeof(float_cpx)) {
+        complex_from_float32(bins, (const float_cpx *)bins, n_bins * FRF_NUM_ARRAYS);
+    }
+
+    frf->h_lips = bins + n_bins * FRF_ARRAY_H_LIPS;
+    frf->open = bins + n_bins * FRF_ARRAY_OPEN;
+    frf->closed = bins + n_bins * FRF_ARRAY_CLOSED;
+    return 0;
+}
+
+void frf_free(FrfData *frf) {
+    free(frf->h_lips); /* Start of the shared allocation */
+    memset(frf, 0, sizeof(*frf));
+}
+
+// --- CSV export ---
+
+int frf_write_csv(const char *filename, const FrfInfo *info, const kiss_fft_cpx *h_lips) {
+    FILE *fp = fopen(filename, "w");
+    if (!fp) {
+        fprintf(stderr, "Failed to open output CSV file\n");
+        return -1;
+    }
+    setvbuf(fp, NULL, _IOFBF, FRF_CSV_BUFFER_SIZE);
+
+    fprintf(fp, "Frequency_Hz,Magnitude_dB,Resistance_dB,Reactance_dB,Phase_Rad\n");
+    for (int i = 0; i < info->grid.num_points; i++) {
+        double f = frf_grid_frequency(&info->grid, i);
+        double mag = sqrt(complex_squared_magnitude(h_lips[i]));
+
+        if (mag < 1e-9) mag = 1e-9;
+        double db = 20.0 * log10(mag);
+        double phase = atan2(h_lips[i].i, h_lips[i].r);
+
+        fprintf(fp, "%.2f,%.4f,%.4f,%.4f,%.4f\n", f, db, h_lips[i].r, h_lips[i].i, phase);
+    }
+
+    if (fclose(fp) != 0) {
+        fprintf(stderr, "Failed to write '%s'\n", filename);
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,137 @@
+#ifndef FRF_IO_H
+#define FRF_IO_H
+
+#include <stdio.h>
+#include "config.h"
+#include "kiss_fft.h"
+#include "frf_grid.h"
+
+#define DEFAULT_FRF_FILE "output/real_tract_frf.frf"
+#define DEFAULT_FRF_CSV_FILE "output/real_tract_frf.csv"
+
+/**
+ * Binary FRF container layout (all fields little-endian):
+ *
+ *   offset  size  field
+ *        0     4  magic "VTFR"
+ *        4     4  version (FRF_FORMAT_VERSION)
+ *        8     4  header size in bytes (FRF_HEADER_SIZE)
+ *       12     4  number of points per array
+ *       16     4  nfft of the source spectrum
+ *       20     4  number of arrays (FRF_NUM_ARRAYS)
+ *       24     8  sample rate (float64, Hz)
+ *       32    24  chirp amplitude, start/end frequency, duration,
+ *                 Tgap, Tfade (float32 each)
+ *       56     4  chirp type (int32)
+ *       60     4  grid type (FrfGridType)
+ *       64     8  grid f_min (float64, Hz)
+ *       72     8  grid f_max (float64, Hz)
+ *
+ * followed by FRF_NUM_ARRAYS contiguous arrays of complex float32
+ * (re, im) pairs, one per grid point, in FrfArray order, whatever
+ * the build precision.
+ * Version 1 files (64-byte header) hold the bins 0 .. n-1 of the
+ * spectrum, i.e. a linear grid from 0 to (n - 1) * sample_rate / nfft.
+ */
+#define FRF_FORMAT_VERSION 2
+#define FRF_HEADER_SIZE 80
+#define FRF_HEADER_SIZE_V1 64
+#define FRF_NUM_ARRAYS 3
+
+typedef enum {
+    FRF_ARRAY_H_LIPS = 0, /* Regularized open/closed ratio */
+    FRF_ARRAY_OPEN = 1,   /* Windowed linear response, open mouth (measurement) */
+    FRF_ARRAY_CLOSED = 2  /* Windowed linear response, closed mouth (calibration) */
+} FrfArray;
+
+/**
+ * Metadata stored in the FRF header. Point k is at
+ * frf_grid_frequency(&grid, k); grid.num_points is the array length.
+ */
+typedef struct {
+    double sample_rate;
+    int nfft;
+    FrfGrid grid;
+    ChirpParams chirp;
+} FrfInfo;
+
+/**
+ * How processing mode writes its FRF.
+ */
+typedef struct {
+    int band_limited;     /* 1: keep the sweep band plus FRF_BAND_MARGIN_OCTAVES */
+    int num_points;       /* 0: keep FFT bins; otherwise resample onto grid_type */
+    FrfGridType grid_type;
+    int export_csv;       /* 1: also write the CSV export */
+} FrfExportOptions;
+
+/**
+ * FRF loaded by frf_read(). The three arrays share one allocation.
+ */
+typedef struct {
+    FrfInfo info;
+    kiss_fft_cpx *h_lips;
+    kiss_fft_cpx *open;
+    kiss_fft_cpx *closed;
+} FrfData;
+
+/**
+ * Writes an FRF container: the header, then the three spectra as bulk
+ * writes of contiguous arrays (no per-point formatting).
+ *
+ * Parameters:
+ *   filename: Output path
+ *   info: Header metadata; grid.num_points entries are taken from each array
+ *   h_lips: H_lips spectrum
+ *   open: Open-mouth (measurement) spectrum
+ *   closed: Closed-mouth (calibration) spectrum
+ *
+ * Returns:
+ *   0 on success, -1 on failure
+ */
+int frf_write(const char *filename, const FrfInfo *info, const kiss_fft_cpx *h_lips,
+              const kiss_fft_cpx *open, const kiss_fft_cpx *closed);
+
+/**
+ * Writes n bins as complex float32 pairs: one bulk write in float
+ * builds, narrowed in chunks in double builds.
+ *
+ * Returns:
+ *   0 on success, -1 on write failure
+ */
+int frf_write_bins(FILE *file, const kiss_fft_cpx *bins, size_t n);
+
+/**
+ * Reads an FRF container (version 1 or 2), checking magic, version and
+ * that the file holds every array announced by the header.
+ *
+ * Parameters:
+ *   filename: Path to the file
+ *   frf: Output data (release with frf_free())
+ *
+ * Returns:
+ *   0 on success, -1 on failure (message printed to stderr)
+ */
+int frf_read(const char *filename, FrfData *frf);
+
+/**
+ * Releases the arrays allocated by frf_read().
+ */
+void frf_free(FrfData *frf);
+
+/**
+ * Exports H_lips as CSV with columns
+ * Frequency_Hz,Magnitude_dB,Resistance_dB,Reactance_dB,Phase_Rad,
+ * one row per grid point.
+ *
+ * Parameters:
+ *   filename: Output path
+ *   info: Header metadata (grid)
+ *   h_lips: H_lips spectrum
+ *
+ * Returns:
+ *   0 on success, -1 on failure
+ */
+int frf_write_csv(const char *filename, const FrfInfo *info, const kiss_fft_cpx *h_lips);
+
+#endif
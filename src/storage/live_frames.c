@@ -0,0 +1,191 @@
+#define _POSIX_C_SOURCE 200809L
+#include "live_frames.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define LIVE_FRAMES_MAGIC "VTLV"
+#define LIVE_FRAMES_READ_TRIES 100 /* Reads of a slot overwritten meanwhile before giving up */
+
+/* Header and slot header, as laid out in live_frames.h */
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t header_size;
+    uint32_t num_points;
+    uint32_t num_slots;
+    uint32_t slot_size;
+    uint32_t period;
+    uint32_t first_bin;
+    double sample_rate;
+    uint64_t count;
+    unsigned char reserved[16];
+} FrameFileHeader;
+
+typedef struct {
+    uint64_t sequence;
+    uint64_t frame;
+    double time;
+    float process_ms;
+    uint32_t periods;
+} FrameSlotHeader;
+
+static FrameFileHeader *file_header(const LiveFrames *frames) {
+    return (FrameFileHeader *)frames->map;
+}
+
+static FrameSlotHeader *slot_header(const LiveFrames *frames, uint64_t frame) {
+    size_t slot = (size_t)(frame % LIVE_FRAMES_NUM_SLOTS);
+    return (FrameSlotHeader *)(frames->map + LIVE_FRAMES_HEADER_SIZE + slot * frames->slot_size);
+}
+
+static size_t frame_slot_size(int num_points) {
+    size_t size = LIVE_FRAMES_SLOT_HEADER_SIZE + 3 * (size_t)num_points * sizeof(float_cpx);
+    return (size + LIVE_FRAMES_ALIGN - 1) / LIVE_FRAMES_ALIGN * LIVE_FRAMES_ALIGN;
+}
+
+int live_frames_create(LiveFrames *frames, const char *path, int num_points, double sample_rate, int period,
+                       int first_bin) {
+    memset(frames, 0, sizeof(*frames));
+    frames->slot_size = frame_slot_size(num_points);
+    frames->map_size = LIVE_FRAMES_HEADER_SIZE + LIVE_FRAMES_NUM_SLOTS * frames->slot_size;
+
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "Failed to create live frame file '%s'\n", path);
+        return -1;
+    }
+    if (ftruncate(fd, (off_t)frames->map_size) != 0) {
+        fprintf(stderr, "Failed to size live frame file '%s'\n", path);
+        close(fd);
+        return -1;
+    }
+    void *map = mmap(NULL, frames->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "Failed to map live frame file '%s'\n", path);
+        return -1;
+    }
+    frames->map = (unsigned char *)map;
+    frames->num_points = num_points;
+    frames->sample_rate = sample_rate;
+    frames->period = period;
+    frames->first_bin = first_bin;
+
+    FrameFileHeader *header = file_header(frames);
+    memcpy(header->magic, LIVE_FRAMES_MAGIC, 4);
+    header->version = LIVE_FRAMES_VERSION;
+    header->header_size = LIVE_FRAMES_HEADER_SIZE;
+    header->num_points = (uint32_t)num_points;
+    header->num_slots = LIVE_FRAMES_NUM_SLOTS;
+    header->slot_size = (uint32_t)frames->slot_size;
+    header->period = (uint32_t)period;
+    header->first_bin = (uint32_t)first_bin;
+    header->sample_rate = sample_rate;
+    __atomic_store_n(&header->count, 0, __ATOMIC_RELEASE);
+    return 0;
+}
+
+static void write_array(float_cpx *dst, const kiss_fft_cpx *src, int n) {
+    if (src) {
+        complex_to_float32(dst, src, (size_t)n);
+    } else {
+        memset(dst, 0, sizeof(float_cpx) * (size_t)n);
+    }
+}
+
+void live_frames_publish(LiveFrames *frames, const LiveFrameInfo *info, const kiss_fft_cpx *h_lips,
+                         const kiss_fft_cpx *open, const kiss_fft_cpx *closed) {
+    FrameSlotHeader *slot = slot_header(frames, info->frame);
+    float_cpx *arrays = (float_cpx *)((unsigned char *)slot + LIVE_FRAMES_SLOT_HEADER_SIZE);
+    int n = frames->num_points;
+
+    /* Odd sequence while the slot is inconsistent */
+    __atomic_store_n(&slot->sequence, 2 * info->frame + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    slot->frame = info->frame;
+    slot->time = info->time;
+    slot->process_ms = info->process_ms;
+    slot->periods = info->periods;
+    write_array(arrays, h_lips, n);
+    write_array(arrays + n, open, n);
+    write_array(arrays + 2 * n, closed, n);
+    __atomic_store_n(&slot->sequence, 2 * (info->frame + 1), __ATOMIC_RELEASE);
+    __atomic_store_n(&file_header(frames)->count, info->frame + 1, __ATOMIC_RELEASE);
+}
+
+int live_frames_open(LiveFrames *frames, const char *path) {
+    memset(frames, 0, sizeof(*frames));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Failed to open live frame file '%s'\n", path);
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < LIVE_FRAMES_HEADER_SIZE) {
+        fprintf(stderr, "Live frame file '%s' is truncated\n", path);
+        close(fd);
+        return -1;
+    }
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "Failed to map live frame file '%s'\n", path);
+        return -1;
+    }
+    frames->map = (unsigned char *)map;
+    frames->map_size = (size_t)st.st_size;
+
+    const FrameFileHeader *header = file_header(frames);
+    if (memcmp(header->magic, LIVE_FRAMES_MAGIC, 4) != 0 || header->version != LIVE_FRAMES_VERSION
+        || header->header_size != LIVE_FRAMES_HEADER_SIZE || header->num_slots != LIVE_FRAMES_NUM_SLOTS
+        || header->slot_size != frame_slot_size((int)header->num_points)
+        || frames->map_size < LIVE_FRAMES_HEADER_SIZE + LIVE_FRAMES_NUM_SLOTS * (size_t)header->slot_size) {
+        fprintf(stderr, "'%s' is not a live frame file\n", path);
+        live_frames_close(frames);
+        return -1;
+    }
+    frames->num_points = (int)header->num_points;
+    frames->sample_rate = header->sample_rate;
+    frames->period = (int)header->period;
+    frames->first_bin = (int)header->first_bin;
+    frames->slot_size = header->slot_size;
+    return 0;
+}
+
+int live_frames_read_latest(const LiveFrames *frames, LiveFrameInfo *info, float_cpx *arrays) {
+    const FrameFileHeader *header = file_header(frames);
+    for (int tries = 0; tries < LIVE_FRAMES_READ_TRIES; tries++) {
+        uint64_t count = __atomic_load_n(&header->count, __ATOMIC_ACQUIRE);
+        if (count == 0) {
+            return 0;
+        }
+        const FrameSlotHeader *slot = slot_header(frames, count - 1);
+        uint64_t sequence = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+        if (sequence != 2 * count) {
+            continue;
+        }
+        info->frame = slot->frame;
+        info->time = slot->time;
+        info->process_ms = slot->process_ms;
+        info->periods = slot->periods;
+        memcpy(arrays, (const unsigned char *)slot + LIVE_FRAMES_SLOT_HEADER_SIZE,
+               3 * (size_t)frames->num_points * sizeof(float_cpx));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&slot->sequence, __ATOMIC_RELAXED) == sequence) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void live_frames_close(LiveFrames *frames) {
+    if (frames->map) {
+        munmap(frames->map, frames->map_size);
+    }
+    memset(frames, 0, sizeof(*frames));
+}
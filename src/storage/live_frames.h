@@ -0,0 +1,124 @@
+#ifndef LIVE_FRAMES_H
+#define LIVE_FRAMES_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "complex_utils.h"
+
+#define DEFAULT_LIVE_FRAME_FILE "output/live_frf.bin"
+#define LIVE_FRAMES_VERSION 1
+#define LIVE_FRAMES_HEADER_SIZE 64
+#define LIVE_FRAMES_SLOT_HEADER_SIZE 32
+#define LIVE_FRAMES_NUM_SLOTS 4
+#define LIVE_FRAMES_ALIGN 64
+
+/**
+ * Shared frame buffer of live mode: a memory-mapped file that one writer
+ * fills with FRF frames while any number of processes map it and read
+ * the latest one. Nothing is appended; the newest frames overwrite a
+ * ring of LIVE_FRAMES_NUM_SLOTS slots. Put the file on a tmpfs
+ * (/dev/shm) to keep it off the disk.
+ *
+ * Header (LIVE_FRAMES_HEADER_SIZE bytes, host byte order):
+ *
+ *   offset  size  field
+ *        0     4  magic "VTLV"
+ *        4     4  version (uint32)
+ *        8     4  header size (uint32)
+ *       12     4  points per array (uint32)
+ *       16     4  number of slots (uint32)
+ *       20     4  slot size in bytes (uint32)
+ *       24     4  excitation period = FFT size (uint32)
+ *       28     4  first bin (uint32): point k is at (first bin + k) * sample rate / period
+ *       32     8  sample rate (float64, Hz)
+ *       40     8  frames published (uint64); the latest is in slot (count - 1) % slots
+ *       48    16  reserved (zero)
+ *
+ * Slot n starts at header size + n * slot size:
+ *
+ *        0     8  sequence (uint64): odd while the slot is written, 2 * (frame + 1) once complete
+ *        8     8  frame number (uint64, from 0)
+ *       16     8  time of the frame's last period since the stream started (float64, s)
+ *       24     4  processing time of the frame (float32, ms)
+ *       28     4  periods averaged so far (uint32)
+ *       32        H_lips, open and closed responses: three arrays of
+ *                 complex float32 (re, im), points per array each
+ *
+ * A reader copies a slot and then checks that its sequence did not
+ * change and is even; otherwise the writer overwrote it meanwhile and
+ * the read is retried.
+ */
+
+/* One frame's metadata */
+typedef struct {
+    uint64_t frame;
+    double time;       /* s since the stream started */
+    float process_ms;  /* Time spent computing the frame */
+    uint32_t periods;  /* Periods averaged so far */
+} LiveFrameInfo;
+
+/* Mapped frame file */
+typedef struct {
+    unsigned char *map;
+    size_t map_size;
+    int num_points;
+    double sample_rate;
+    int period;
+    int first_bin;
+    size_t slot_size;
+} LiveFrames;
+
+/**
+ * Creates (or replaces) the frame file and maps it for writing.
+ *
+ * Parameters:
+ *   frames: Output mapping (release with live_frames_close())
+ *   path: File to create
+ *   num_points: Points per array
+ *   sample_rate: Sampling rate (Hz)
+ *   period: Excitation period (samples)
+ *   first_bin: Bin of the first point
+ *
+ * Returns:
+ *   0 on success, -1 (with a message) on failure
+ */
+int live_frames_create(LiveFrames *frames, const char *path, int num_points, double sample_rate, int period,
+                       int first_bin);
+
+/**
+ * Publishes a frame: writes it to the next slot, then bumps the frame
+ * count. Any array may be NULL (written as zeros).
+ *
+ * Parameters:
+ *   info: Frame metadata; info->frame must be the number of frames published so far
+ *   h_lips, open, closed: num_points values each
+ */
+void live_frames_publish(LiveFrames *frames, const LiveFrameInfo *info, const kiss_fft_cpx *h_lips,
+                         const kiss_fft_cpx *open, const kiss_fft_cpx *closed);
+
+/**
+ * Maps an existing frame file for reading and validates its header.
+ *
+ * Returns:
+ *   0 on success, -1 (with a message) on failure
+ */
+int live_frames_open(LiveFrames *frames, const char *path);
+
+/**
+ * Copies the latest complete frame.
+ *
+ * Parameters:
+ *   info: Output metadata
+ *   arrays: Output, three arrays of num_points complex float32 (H_lips, open, closed)
+ *
+ * Returns:
+ *   1 if a frame was read, 0 if none has been published yet
+ */
+int live_frames_read_latest(const LiveFrames *frames, LiveFrameInfo *info, float_cpx *arrays);
+
+/**
+ * Unmaps the file.
+ */
+void live_frames_close(LiveFrames *frames);
+
+#endif
@@ -0,0 +1,224 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "session_store.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+#define STORE_COPY_CHUNK (1 << 16)
+#define STORE_INDEX_LINE_MAX 1024
+
+// --- Hashing ---
+
+void store_hash_init(StoreHasher *hasher) {
+    hasher->state = FNV_OFFSET_BASIS;
+}
+
+void store_hash_bytes(StoreHasher *hasher, const void *data, size_t bytes) {
+    const unsigned char *p = (const unsigned char *)data;
+    uint64_t h = hasher->state;
+    for (size_t i = 0; i < bytes; i++) {
+        h ^= p[i];
+        h *= FNV_PRIME;
+    }
+    hasher->state = h;
+}
+
+void store_hash_int(StoreHasher *hasher, int64_t value) {
+    unsigned char b[8];
+    for (int i = 0; i < 8; i++) {
+        b[i] = (unsigned char)((uint64_t)value >> (8 * i));
+    }
+    store_hash_bytes(hasher, b, sizeof(b));
+}
+
+void store_hash_double(StoreHasher *hasher, double value) {
+    int64_t bits;
+    if (value == 0.0) value = 0.0; /* -0.0 and 0.0 hash alike */
+    memcpy(&bits, &value, sizeof(bits));
+    store_hash_int(hasher, bits);
+}
+
+StoreKey store_hash_final(const StoreHasher *hasher) {
+    return hasher->state;
+}
+
+// --- Entries ---
+
+void store_entry_path(char *path, size_t size, const char *dir, StoreKey key, const char *ext) {
+    snprintf(path, size, "%s/%016llx.%s", dir, (unsigned long long)key, ext);
+}
+
+static int ensure_dir(const char *dir) {
+    if (mkdir(dir, 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "Failed to create store directory '%s'\n", dir);
+        return -1;
+    }
+    return 0;
+}
+
+/* Records an entry in the index, replacing the line of an earlier write of the same entry.
+ * The index is rewritten via a temporary file, so it holds one line per entry. */
+static void update_index(const char *dir, StoreKey key, const char *ext, const char *description) {
+    char path[STORE_PATH_MAX];
+    char tmp_path[STORE_PATH_MAX + 8];
+    char prefix[64];
+    snprintf(path, sizeof(path), "%s/%s", dir, STORE_INDEX_FILE);
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    int prefix_len = snprintf(prefix, sizeof(prefix), "%016llx\t%s\t", (unsigned long long)key, ext);
+
+    FILE *out = fopen(tmp_path, "w");
+    if (!out) {
+        return; /* The index is informational; entries remain usable */
+    }
+    int failed = 0;
+    FILE *in = fopen(path, "r");
+    if (in) {
+        char line[STORE_INDEX_LINE_MAX];
+        int keep = 1;
+        int at_start = 1;
+        while (!failed && fgets(line, sizeof(line), in)) {
+            /* Lines longer than the buffer arrive in pieces; only the first piece carries the key */
+            if (at_start) {
+                keep = strncmp(line, prefix, (size_t)prefix_len) != 0;
+            }
+            at_start = strchr(line, '\n') != NULL;
+            if (keep && fputs(line, out) == EOF) {
+                failed = 1;
+            }
+        }
+        fclose(in);
+    }
+
+    char stamp[32];
+    time_t now = time(NULL);
+    strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+    if (fprintf(out, "%s%s\t%s\n", prefix, stamp, description ? description : "") < 0) {
+        failed = 1;
+    }
+    if (fclose(out) != 0 || failed || rename(tmp_path, path) != 0) {
+        remove(tmp_path);
+    }
+}
+
+int store_get(const char *dir, StoreKey key, const char *ext, void *data, size_t bytes) {
+    char path[STORE_PATH_MAX];
+    store_entry_path(path, sizeof(path), dir, key, ext);
+
+    struct stat st;
+    if (stat(path, &st) != 0 || (size_t)st.st_size != bytes) {
+        return -1;
+    }
+
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        return -1;
+    }
+    size_t got = fread(data, 1, bytes, file);
+    fclose(file);
+    return got == bytes ? 0 : -1;
+}
+
+/* Writes via <path>.tmp and renames, so readers never see partial entries */
+static int write_entry(const char *dir, StoreKey key, const char *ext, FILE *src,
+                       const void *data, size_t bytes) {
+    char path[STORE_PATH_MAX];
+    char tmp_path[STORE_PATH_MAX + 8];
+    store_entry_path(path, sizeof(path), dir, key, ext);
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+    FILE *file = fopen(tmp_path, "wb");
+    if (!file) {
+        fprintf(stderr, "Failed to open '%s' for writing\n", tmp_path);
+        return -1;
+    }
+
+    int failed = 0;
+    if (src) {
+        char *chunk = (char*)malloc(STORE_COPY_CHUNK);
+        if (!chunk) {
+            failed = 1;
+        }
+        size_t n;
+        while (!failed && (n = fread(chunk, 1, STORE_COPY_CHUNK, src)) > 0) {
+            failed = fwrite(chunk, 1, n, file) != n;
+        }
+        if (ferror(src)) failed = 1;
+        free(chunk);
+    } else {
+        failed = fwrite(data, 1, bytes, file) != bytes;
+    }
+    if (fclose(file) != 0) failed = 1;
+
+    if (failed || rename(tmp_path, path) != 0) {
+        fprintf(stderr, "Failed to write store entry '%s'\n", path);
+        remove(tmp_path);
+        return -1;
+    }
+    return 0;
+}
+
+int store_put(const char *dir, StoreKey key, const char *ext, const void *data, size_t bytes,
+              const char *description) {
+    if (ensure_dir(dir) != 0 || write_entry(dir, key, ext, NULL, data, bytes) != 0) {
+        return -1;
+    }
+    update_index(dir, key, ext, description);
+    return 0;
+}
+
+int store_import_file(const char *dir, StoreKey key, const char *ext, const char *src_path,
+                      const char *description) {
+    char path[STORE_PATH_MAX];
+    struct stat st;
+    store_entry_path(path, sizeof(path), dir, key, ext);
+    if (stat(path, &st) == 0) {
+        return 0;
+    }
+
+    FILE *src = fopen(src_path, "rb");
+    if (!src) {
+        fprintf(stderr, "Failed to open '%s'\n", src_path);
+        return -1;
+    }
+    int ret = (ensure_dir(dir) == 0) ? write_entry(dir, key, ext, src, NULL, 0) : -1;
+    fclose(src);
+
+    if (ret == 0) {
+        update_index(dir, key, ext, description);
+    }
+    return ret;
+}
+
+int store_export_file(const char *dir, StoreKey key, const char *ext, const char *dst_path) {
+    char path[STORE_PATH_MAX];
+    store_entry_path(path, sizeof(path), dir, key, ext);
+
+    FILE *src = fopen(path, "rb");
+    if (!src) {
+        return -1;
+    }
+    FILE *dst = fopen(dst_path, "wb");
+    char *chunk = (char*)malloc(STORE_COPY_CHUNK);
+    int failed = !dst || !chunk;
+
+    size_t n;
+    while (!failed && (n = fread(chunk, 1, STORE_COPY_CHUNK, src)) > 0) {
+        failed = fwrite(chunk, 1, n, dst) != n;
+    }
+    if (ferror(src)) failed = 1;
+    if (dst && fclose(dst) != 0) failed = 1;
+    fclose(src);
+    free(chunk);
+
+    if (failed) {
+        fprintf(stderr, "Failed to copy store entry '%s' to '%s'\n", path, dst_path);
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,96 @@
+#ifndef SESSION_STORE_H
+#define SESSION_STORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define DEFAULT_STORE_DIR "output/store"
+#define STORE_INDEX_FILE "index.txt"
+#define STORE_PATH_MAX 512
+
+/**
+ * Content-addressed session store.
+ *
+ * Every capture and derived artifact lives in DEFAULT_STORE_DIR as
+ * <key>.<ext>, where key is a 64-bit FNV-1a hash of the artifact's
+ * inputs (or, for captures, of their samples and layout). Entries are
+ * never overwritten by later runs, so earlier results stay available;
+ * index.txt records one line per entry with a description of its inputs;
+ * rewriting an entry replaces its line.
+ */
+typedef uint64_t StoreKey;
+
+typedef struct {
+    uint64_t state;
+} StoreHasher;
+
+/**
+ * Starts a new hash.
+ */
+void store_hash_init(StoreHasher *hasher);
+
+/**
+ * Feeds raw bytes into the hash.
+ */
+void store_hash_bytes(StoreHasher *hasher, const void *data, size_t bytes);
+
+/**
+ * Feeds a number into the hash (value, not its textual form).
+ */
+void store_hash_int(StoreHasher *hasher, int64_t value);
+void store_hash_double(StoreHasher *hasher, double value);
+
+/**
+ * Returns the key of everything fed so far.
+ */
+StoreKey store_hash_final(const StoreHasher *hasher);
+
+/**
+ * Formats the path of an entry: <dir>/<16 hex digits>.<ext>
+ */
+void store_entry_path(char *path, size_t size, const char *dir, StoreKey key, const char *ext);
+
+/**
+ * Loads an entry of exactly bytes bytes.
+ *
+ * Returns:
+ *   0 on a hit, -1 if the entry is missing or has another size
+ */
+int store_get(const char *dir, StoreKey key, const char *ext, void *data, size_t bytes);
+
+/**
+ * Stores an entry (written to a temporary file, then renamed into place)
+ * and records it in the index, replacing any earlier line for the entry.
+ *
+ * Parameters:
+ *   dir: Store directory (created if needed)
+ *   key: Entry key
+ *   ext: Entry kind, used as file extension
+ *   data, bytes: Contents
+ *   description: One-line description of the inputs for the index
+ *
+ * Returns:
+ *   0 on success, -1 on failure
+ */
+int store_put(const char *dir, StoreKey key, const char *ext, const void *data, size_t bytes,
+              const char *description);
+
+/**
+ * Copies an existing file into the store under key, unless the entry
+ * already exists.
+ *
+ * Returns:
+ *   0 on success (or if already present), -1 on failure
+ */
+int store_import_file(const char *dir, StoreKey key, const char *ext, const char *src_path,
+                      const char *description);
+
+/**
+ * Copies a stored entry to dst_path.
+ *
+ * Returns:
+ *   0 on success, -1 if the entry is missing or the copy failed
+ */
+int store_export_file(const char *dir, StoreKey key, const char *ext, const char *dst_path);
+
+#endif
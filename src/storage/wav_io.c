@@ -0,0 +1,362 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include "wav_io.h"
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define WAV_FORMAT_PCM 1
+#define WAV_FORMAT_IEEE_FLOAT 3
+#define WAV_FORMAT_EXTENSIBLE 0xFFFE
+#define WAV_FMT_CHUNK_SIZE 16
+#define WAV_DS64_CHUNK_SIZE 28
+#define WAV_VTCH_CHUNK_SIZE 28 /* 6 float32 chirp fields + int32 type */
+#define WAV_VTCH_MULTI_SIZE 12 /* Appended for staggered sweeps: int32 count, float32 stagger and level step */
+#define WAV_VTCH_MLS_SIZE 8    /* Appended after those for MLS takes: int32 order and periods */
+#define RIFF_SIZE_LIMIT 0xFFFFFFFFULL
+#define WAV_HEADER_SCAN 4096 /* Bytes read up front by wav_reader_open() to find the data chunk */
+
+// --- Little-endian encoding helpers ---
+
+static void put_u16(FILE *f, uint16_t v) {
+    unsigned char b[2] = { (unsigned char)v, (unsigned char)(v >> 8) };
+    fwrite(b, 1, 2, f);
+}
+
+static void put_u32(FILE *f, uint32_t v) {
+    unsigned char b[4] = { (unsigned char)v, (unsigned char)(v >> 8), (unsigned char)(v >> 16), (unsigned char)(v >> 24) };
+    fwrite(b, 1, 4, f);
+}
+
+static void put_u64(FILE *f, uint64_t v) {
+    put_u32(f, (uint32_t)v);
+    put_u32(f, (uint32_t)(v >> 32));
+}
+
+static void put_f32(FILE *f, float v) {
+    uint32_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    put_u32(f, bits);
+}
+
+static uint16_t get_u16(const unsigned char *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t get_u32(const unsigned char *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t get_u64(const unsigned char *p) {
+    return (uint64_t)get_u32(p) | ((uint64_t)get_u32(p + 4) << 32);
+}
+
+static float get_f32(const unsigned char *p) {
+    uint32_t bits = get_u32(p);
+    float v;
+    memcpy(&v, &bits, sizeof(v));
+    return v;
+}
+
+// --- Writing ---
+
+static uint64_t data_bytes(const WavInfo *info) {
+    return (uint64_t)info->num_frames * info->num_channels * sample_format_bytes(info->format);
+}
+
+FILE *wav_write_begin(const char *filename, const WavInfo *info) {
+    FILE *f = fopen(filename, "wb");
+    if (!f) {
+        fprintf(stderr, "Failed to open '%s' for writing\n", filename);
+        return NULL;
+    }
+
+    int sample_bytes = sample_format_bytes(info->format);
+    uint64_t n_data = data_bytes(info);
+    /* Single-sweep chunks keep the original size */
+    int is_mls = info->chirp.mls_order > 0;
+    uint32_t vtch_size = WAV_VTCH_CHUNK_SIZE + (info->chirp.num_sweeps > 1 || is_mls ? WAV_VTCH_MULTI_SIZE : 0)
+                         + (is_mls ? WAV_VTCH_MLS_SIZE : 0);
+    uint64_t chunks = 4 + (8 + WAV_FMT_CHUNK_SIZE) + (info->has_chirp ? 8 + vtch_size : 0) + 8 + n_data + (n_data & 1);
+    int is_rf64 = chunks > RIFF_SIZE_LIMIT;
+
+    if (is_rf64) {
+        uint64_t riff_size = chunks + 8 + WAV_DS64_CHUNK_SIZE;
+        fwrite("RF64", 1, 4, f);
+        put_u32(f, 0xFFFFFFFFu);
+        fwrite("WAVE", 1, 4, f);
+        fwrite("ds64", 1, 4, f);
+        put_u32(f, WAV_DS64_CHUNK_SIZE);
+        put_u64(f, riff_size);
+        put_u64(f, n_data);
+        put_u64(f, (uint64_t)info->num_frames);
+        put_u32(f, 0); // No extra chunk size table
+    } else {
+        fwrite("RIFF", 1, 4, f);
+        put_u32(f, (uint32_t)chunks);
+        fwrite("WAVE", 1, 4, f);
+    }
+
+    fwrite("fmt ", 1, 4, f);
+    put_u32(f, WAV_FMT_CHUNK_SIZE);
+    put_u16(f, info->format == SAMPLE_FORMAT_FLOAT32 ? WAV_FORMAT_IEEE_FLOAT : WAV_FORMAT_PCM);
+    put_u16(f, (uint16_t)info->num_channels);
+    put_u32(f, (uint32_t)info->sample_rate);
+    put_u32(f, (uint32_t)(info->sample_rate * info->num_channels * sample_bytes));
+    put_u16(f, (uint16_t)(info->num_channels * sample_bytes));
+    put_u16(f, (uint16_t)(8 * sample_bytes));
+
+    if (info->has_chirp) {
+        fwrite("vtch", 1, 4, f);
+        put_u32(f, vtch_size);
+        put_f32(f, info->chirp.amplitude);
+        put_f32(f, info->chirp.start_freq);
+        put_f32(f, info->chirp.end_freq);
+        put_f32(f, info->chirp.duration);
+        put_f32(f, info->chirp.Tgap);
+        put_f32(f, info->chirp.Tfade);
+        put_u32(f, (uint32_t)info->chirp.type);
+        if (vtch_size > WAV_VTCH_CHUNK_SIZE) {
+            put_u32(f, (uint32_t)info->chirp.num_sweeps);
+            put_f32(f, info->chirp.sweep_stagger);
+            put_f32(f, info->chirp.sweep_level_step);
+        }
+        if (is_mls) {
+            put_u32(f, (uint32_t)info->chirp.mls_order);
+            put_u32(f, (uint32_t)info->chirp.mls_periods);
+        }
+    }
+
+    fwrite("data", 1, 4, f);
+    put_u32(f, is_rf64 ? 0xFFFFFFFFu : (uint32_t)n_data);
+
+    if (ferror(f)) {
+        fprintf(stderr, "Failed to write WAV header to '%s'\n", filename);
+        fclose(f);
+        return NULL;
+    }
+    return f;
+}
+
+int wav_write_end(FILE *file, const WavInfo *info) {
+    if (data_bytes(info) & 1) {
+        fputc(0, file); // Chunks are word-aligned
+    }
+    int failed = ferror(file);
+    if (fclose(file) != 0) failed = 1;
+    return failed ? -1 : 0;
+}
+
+// --- Reading ---
+
+static int parse_fmt(const unsigned char *p, uint32_t size, WavInfo *info) {
+    if (size < WAV_FMT_CHUNK_SIZE) return -1;
+
+    uint16_t tag = get_u16(p);
+    uint16_t bits = get_u16(p + 14);
+    if (tag == WAV_FORMAT_EXTENSIBLE && size >= 40) {
+        tag = get_u16(p + 24); // First two bytes of the sub-format GUID
+    }
+
+    info->num_channels = get_u16(p + 2);
+    info->sample_rate = (double)get_u32(p + 4);
+
+    if (tag == WAV_FORMAT_IEEE_FLOAT && bits == 32) {
+        info->format = SAMPLE_FORMAT_FLOAT32;
+    } else if (tag == WAV_FORMAT_PCM && bits == 16) {
+        info->format = SAMPLE_FORMAT_INT16;
+    } else if (tag == WAV_FORMAT_PCM && bits == 24) {
+        info->format = SAMPLE_FORMAT_INT24;
+    } else if (tag == WAV_FORMAT_PCM && bits == 32) {
+        info->format = SAMPLE_FORMAT_INT32;
+    } else {
+        return -1;
+    }
+
+    return (info->num_channels > 0 && info->sample_rate > 0) ? 0 : -1;
+}
+
+static void parse_vtch(const unsigned char *p, uint64_t size, WavInfo *info) {
+    info->chirp.amplitude = get_f32(p);
+    info->chirp.start_freq = get_f32(p + 4);
+    info->chirp.end_freq = get_f32(p + 8);
+    info->chirp.duration = get_f32(p + 12);
+    info->chirp.Tgap = get_f32(p + 16);
+    info->chirp.Tfade = get_f32(p + 20);
+    info->chirp.type = (int)get_u32(p + 24);
+    if (size >= WAV_VTCH_CHUNK_SIZE + WAV_VTCH_MULTI_SIZE) {
+        info->chirp.num_sweeps = (int)get_u32(p + 28);
+        info->chirp.sweep_stagger = get_f32(p + 32);
+        info->chirp.sweep_level_step = get_f32(p + 36);
+    }
+    if (size >= WAV_VTCH_CHUNK_SIZE + WAV_VTCH_MULTI_SIZE + WAV_VTCH_MLS_SIZE) {
+        info->chirp.mls_order = (int)get_u32(p + 40);
+        info->chirp.mls_periods = (int)get_u32(p + 44);
+    }
+    info->has_chirp = 1;
+}
+
+/*
+ * Walks the chunks of a WAV/RF64 file whose first avail bytes are in
+ * bytes, and checks the data chunk against the full file size. Only the
+ * chunk headers and the fmt/ds64/vtch bodies have to be within avail.
+ */
+static int parse_wav(const unsigned char *bytes, size_t avail, uint64_t file_size, const char *filename,
+                     WavInfo *info, uint64_t *data_offset) {
+    memset(info, 0, sizeof(*info));
+
+    int is_rf64 = avail >= 12 && memcmp(bytes, "RF64", 4) == 0;
+    if (avail < 12 || (!is_rf64 && memcmp(bytes, "RIFF", 4) != 0) || memcmp(bytes + 8, "WAVE", 4) != 0) {
+        fprintf(stderr, "'%s' is not a WAV/RF64 file\n", filename);
+        return -1;
+    }
+
+    uint64_t rf64_data_size = 0;
+    int has_fmt = 0;
+    int has_data = 0;
+    uint64_t n_data = 0;
+    uint64_t pos = 12;
+
+    while (pos + 8 <= avail) {
+        const unsigned char *chunk = bytes + pos;
+        uint64_t size = get_u32(chunk + 4);
+        const unsigned char *body = chunk + 8;
+
+        if (memcmp(chunk, "data", 4) == 0) {
+            if (is_rf64 && size == 0xFFFFFFFFu) size = rf64_data_size;
+            *data_offset = pos + 8;
+            n_data = size;
+            has_data = 1;
+            break;
+        }
+        if (pos + 8 + size > avail) break;
+
+        if (memcmp(chunk, "ds64", 4) == 0 && size >= WAV_DS64_CHUNK_SIZE) {
+            rf64_data_size = get_u64(body + 8);
+        } else if (memcmp(chunk, "fmt ", 4) == 0) {
+            if (parse_fmt(body, (uint32_t)size, info) != 0) {
+                fprintf(stderr, "'%s' uses an unsupported WAV sample format\n", filename);
+                return -1;
+            }
+            has_fmt = 1;
+        } else if (memcmp(chunk, "vtch", 4) == 0 && size >= WAV_VTCH_CHUNK_SIZE) {
+            parse_vtch(body, size, info);
+        }
+
+        pos += 8 + size + (size & 1);
+    }
+
+    if (!has_fmt || !has_data) {
+        fprintf(stderr, "'%s' is missing its fmt or data chunk\n", filename);
+        return -1;
+    }
+
+    size_t frame_bytes = (size_t)info->num_channels * sample_format_bytes(info->format);
+    uint64_t available = file_size - *data_offset;
+    if (n_data > available) {
+        fprintf(stderr, "'%s' is truncated: header announces %llu data bytes, file holds %llu\n",
+                filename, (unsigned long long)n_data, (unsigned long long)available);
+        return -1;
+    }
+    if (n_data % frame_bytes != 0) {
+        fprintf(stderr, "'%s' data size is not a whole number of frames\n", filename);
+        return -1;
+    }
+
+    info->num_frames = (int64_t)(n_data / frame_bytes);
+    return 0;
+}
+
+// --- Chunked reading ---
+
+int wav_reader_open(const char *filename, int chunk_frames, WavReader *reader) {
+    memset(reader, 0, sizeof(*reader));
+    reader->fd = -1;
+
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Failed to open '%s'\n", filename);
+        return -1;
+    }
+
+    struct stat st;
+    unsigned char header[WAV_HEADER_SCAN];
+    ssize_t got = (fstat(fd, &st) == 0) ? pread(fd, header, sizeof(header), 0) : -1;
+    if (got < 12) {
+        fprintf(stderr, "'%s' is too short to be a WAV file\n", filename);
+        close(fd);
+        return -1;
+    }
+    if (parse_wav(header, (size_t)got, (uint64_t)st.st_size, filename, &reader->info, &reader->data_offset) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    reader->frame_bytes = reader->info.num_channels * sample_format_bytes(reader->info.format);
+    reader->chunk_frames = chunk_frames > 0 ? chunk_frames : WAV_READ_CHUNK_FRAMES;
+    reader->chunk = (unsigned char*)malloc((size_t)reader->chunk_frames * reader->frame_bytes);
+    if (!reader->chunk) {
+        fprintf(stderr, "Failed to allocate read buffer for '%s'\n", filename);
+        close(fd);
+        return -1;
+    }
+    reader->fd = fd;
+    return 0;
+}
+
+int wav_reader_read_native(WavReader *reader, int64_t first_frame, int num_frames, void *dst) {
+    if (first_frame < 0 || num_frames < 0 || first_frame + num_frames > reader->info.num_frames) {
+        return -1;
+    }
+    unsigned char *out = (unsigned char *)dst;
+    size_t remaining = (size_t)num_frames * reader->frame_bytes;
+    off_t offset = (off_t)(reader->data_offset + (uint64_t)first_frame * reader->frame_bytes);
+    while (remaining > 0) {
+        ssize_t got = pread(reader->fd, out, remaining, offset);
+        if (got <= 0) {
+            return -1;
+        }
+        out += got;
+        offset += got;
+        remaining -= (size_t)got;
+    }
+    return 0;
+}
+
+int wav_reader_read(WavReader *reader, int64_t first_frame, int num_frames, float *dst) {
+    int channels = reader->info.num_channels;
+
+    /* Frames outside the capture read as silence */
+    if (first_frame < 0) {
+        int lead = -first_frame < num_frames ? (int)-first_frame : num_frames;
+        memset(dst, 0, sizeof(float) * (size_t)lead * channels);
+        dst += (size_t)lead * channels;
+        first_frame += lead;
+        num_frames -= lead;
+    }
+    int64_t in_file = reader->info.num_frames - first_frame;
+    int n_read = in_file <= 0 ? 0 : (in_file < num_frames ? (int)in_file : num_frames);
+
+    for (int done = 0; done < n_read; done += reader->chunk_frames) {
+        int n = n_read - done < reader->chunk_frames ? n_read - done : reader->chunk_frames;
+        if (wav_reader_read_native(reader, first_frame + done, n, reader->chunk) != 0) {
+            fprintf(stderr, "Failed to read frames %lld-%lld of capture\n",
+                    (long long)(first_frame + done), (long long)(first_frame + done + n));
+            return -1;
+        }
+        sample_format_to_float(reader->chunk, reader->info.format, dst + (size_t)done * channels, n * channels);
+    }
+    memset(dst + (size_t)n_read * channels, 0, sizeof(float) * (size_t)(num_frames - n_read) * channels);
+    return 0;
+}
+
+void wav_reader_close(WavReader *reader) {
+    if (reader->fd >= 0) {
+        close(reader->fd);
+    }
+    free(reader->chunk);
+    memset(reader, 0, sizeof(*reader));
+    reader->fd = -1;
+}
@@ -0,0 +1,103 @@
+#ifndef WAV_IO_H
+#define WAV_IO_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "config.h"
+#include "sample_format.h"
+
+/**
+ * Capture metadata carried by a WAV/RF64 file.
+ * Sample rate, channels and format live in the standard 'fmt ' chunk;
+ * chirp parameters in a 'vtch' chunk that other readers skip.
+ */
+typedef struct {
+    double sample_rate;
+    int num_channels;
+    SampleFormat format;
+    int64_t num_frames;
+    int has_chirp;     /* 1 if chirp holds the 'vtch' chunk contents */
+    ChirpParams chirp;
+} WavInfo;
+
+/**
+ * Sequential or random access to a WAV/RF64 file through fixed-size
+ * reads, for captures too long to map or to hold in memory. Only the
+ * header and one chunk of native samples are resident at a time.
+ */
+#define WAV_READ_CHUNK_FRAMES 65536
+
+typedef struct {
+    WavInfo info;
+    int fd;
+    uint64_t data_offset;  /* Byte offset of the first sample */
+    int frame_bytes;
+    int chunk_frames;
+    unsigned char *chunk;  /* chunk_frames native frames */
+} WavReader;
+
+/**
+ * Opens a WAV file for writing and emits its header.
+ * Switches to RF64 (with a 'ds64' chunk) when the data exceeds the
+ * 4 GiB RIFF limit. The caller then writes exactly
+ * info->num_frames * info->num_channels native samples to the returned
+ * stream and calls wav_write_end().
+ * 
+ * Parameters:
+ *   filename: Output path
+ *   info: Layout and metadata; num_frames must be final
+ * 
+ * Returns:
+ *   Open stream positioned at the first sample, or NULL on failure
+ */
+FILE *wav_write_begin(const char *filename, const WavInfo *info);
+
+/**
+ * Finishes a file started with wav_write_begin() (pad byte, close).
+ * 
+ * Returns:
+ *   0 on success, -1 on failure
+ */
+int wav_write_end(FILE *file, const WavInfo *info);
+
+/**
+ * Opens a WAV/RF64 file for chunked reading and validates it: RIFF/RF64
+ * + WAVE magic, a supported 'fmt ' chunk (PCM 16/24/32-bit or IEEE float
+ * 32-bit), and a 'data' chunk whose size fits in the file and is a whole
+ * number of frames. Only the first few KiB are read to find the data chunk.
+ * 
+ * Parameters:
+ *   filename: Path to the file
+ *   chunk_frames: Frames per read (0 for WAV_READ_CHUNK_FRAMES)
+ *   reader: Output reader (release with wav_reader_close())
+ * 
+ * Returns:
+ *   0 on success, -1 on failure (message printed to stderr)
+ */
+int wav_reader_open(const char *filename, int chunk_frames, WavReader *reader);
+
+/**
+ * Reads frames [first_frame, first_frame + num_frames) in the native
+ * format, which must lie within the file.
+ * 
+ * Returns:
+ *   0 on success, -1 on failure
+ */
+int wav_reader_read_native(WavReader *reader, int64_t first_frame, int num_frames, void *dst);
+
+/**
+ * Reads frames [first_frame, first_frame + num_frames) as interleaved
+ * float, one chunk at a time. Frames before the start or past the end
+ * of the capture read as zero.
+ * 
+ * Returns:
+ *   0 on success, -1 on a read error
+ */
+int wav_reader_read(WavReader *reader, int64_t first_frame, int num_frames, float *dst);
+
+/**
+ * Closes a reader opened with wav_reader_open().
+ */
+void wav_reader_close(WavReader *reader);
+
+#endif
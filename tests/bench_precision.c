@@ -0,0 +1,236 @@
+#define _POSIX_C_SOURCE 200809L
+#include "processing.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_REPETITIONS 3
+#define ECHO_DELAY 37
+#define NUM_SWEEPS 4
+#define BENCH_SPECTRA_FILE "output/bench_precision_%s.raw" /* Band spectra of each sweep, float64 pairs */
+
+/* Exponential sweeps as measurements use them, up to long high-resolution takes */
+typedef struct {
+    double fs;
+    float f0, f1, T;
+} BenchSweep;
+
+static const BenchSweep sweeps[NUM_SWEEPS] = {
+    { 48000.0, 50.0f, 20000.0f, 2.0f },
+    { 48000.0, 50.0f, 20000.0f, 10.0f },
+    { 48000.0, 20.0f, 20000.0f, 40.0f },
+    { 96000.0, 20.0f, 40000.0f, 40.0f },
+};
+
+static const char *precision_name(int is_double) {
+    return is_double ? "double" : "float";
+}
+
+/* Compared bins: [1.5 f0, f1 / 1.5], away from the edges of the inverse filter */
+static int band_bins(const BenchSweep *s, int nfft, int *first) {
+    *first = (int)ceil(1.5 * s->f0 * nfft / s->fs);
+    int last = (int)floor(s->f1 / 1.5 * nfft / s->fs);
+    return last - *first + 1;
+}
+
+/*
+ * Runs the chain of run_processing_mode() on a sweep (closed capture)
+ * and its echo 0.5 z^-5 + 0.25 z^-(5 + ECHO_DELAY) (open capture).
+ * Copies H_lips then the closed linear IR spectrum over the compared bins
+ * into band (re, im pairs) if not NULL. Returns the wall time of the
+ * chain in seconds, negative on failure.
+ */
+static double run_chain(const BenchSweep *s, double *band) {
+    int n = (int)(s->fs * s->T);
+    int nfft = calculate_next_power_of_two(n);
+
+    float *closed = (float*)malloc(sizeof(float) * n);
+    float *open = (float*)malloc(sizeof(float) * n);
+    kiss_fft_cpx *buf_closed = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * nfft);
+    kiss_fft_cpx *buf_open = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * nfft);
+    kiss_fft_cpx *inv_filter = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * nfft);
+    kiss_fft_cpx *h = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * nfft);
+    kiss_fft_scalar *epsilon = (kiss_fft_scalar*)malloc(sizeof(kiss_fft_scalar) * nfft);
+    kiss_fft_cfg cfg_fwd = kiss_fft_alloc(nfft, 0, NULL, NULL);
+    kiss_fft_cfg cfg_inv = kiss_fft_alloc(nfft, 1, NULL, NULL);
+    double elapsed = -1.0;
+
+    if (!closed || !open || !buf_closed || !buf_open || !inv_filter || !h || !epsilon || !cfg_fwd || !cfg_inv) {
+        fprintf(stderr, "Failed to allocate benchmark buffers (nfft %d)\n", nfft);
+        goto done;
+    }
+
+    /* Captures as recorded: float samples, in both builds */
+    generate_chirp(closed, 0.5f, s->f0, s->f1, s->T, (float)s->fs, 1, 0.0f, 0.0f);
+    for (int i = 0; i < n; i++) {
+        open[i] = (i >= 5 ? 0.5f * closed[i - 5] : 0.0f) + (i >= 5 + ECHO_DELAY ? 0.25f * closed[i - 5 - ECHO_DELAY] : 0.0f);
+    }
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+
+    generate_inverse_filter(inv_filter, 0.5f, s->f0, s->f1, s->T, (float)s->fs, nfft, 1);
+    int npre, npost;
+    linear_ir_window(s->f0, s->f1, s->T, s->fs, &npre, &npost);
+    kiss_fft_cpx *bufs[2] = { buf_closed, buf_open };
+    const float *captures[2] = { closed, open };
+    for (int c = 0; c < 2; c++) {
+        for (int i = 0; i < nfft; i++) {
+            bufs[c][i].r = i < n ? captures[c][i] : 0;
+            bufs[c][i].i = 0;
+        }
+        kiss_fft(cfg_fwd, bufs[c], bufs[c]);
+        perform_deconvolution(bufs[c], inv_filter, nfft);
+        extract_linear_ir(bufs[c], cfg_inv, cfg_fwd, nfft, n, npre, npost, s->fs, 0);
+    }
+    generate_epsilon(epsilon, s->f0, s->f1, (float)s->fs, nfft);
+    compute_h_lips(h, buf_open, buf_closed, epsilon, nfft);
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    elapsed = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+
+    if (band) {
+        int first;
+        int count = band_bins(s, nfft, &first);
+        for (int k = 0; k < count; k++) {
+            band[2 * k] = h[first + k].r;
+            band[2 * k + 1] = h[first + k].i;
+            band[2 * (count + k)] = buf_closed[first + k].r;
+            band[2 * (count + k) + 1] = buf_closed[first + k].i;
+        }
+    }
+
+done:
+    free(closed);
+    free(open);
+    free(buf_closed);
+    free(buf_open);
+    free(inv_filter);
+    free(h);
+    free(epsilon);
+    kiss_fft_free(cfg_fwd);
+    kiss_fft_free(cfg_inv);
+    return elapsed;
+}
+
+/* RMS error of H_lips against the echo system, relative to its RMS (dB) */
+static double echo_error_db(const BenchSweep *s, int nfft, const double *band) {
+    int first;
+    int count = band_bins(s, nfft, &first);
+    double err2 = 0.0, ref2 = 0.0;
+    for (int k = 0; k < count; k++) {
+        double w = 2.0 * M_PI * (first + k) / nfft;
+        double ref_r = 0.5 * cos(5 * w) + 0.25 * cos((5 + ECHO_DELAY) * w);
+        double ref_i = -0.5 * sin(5 * w) - 0.25 * sin((5 + ECHO_DELAY) * w);
+        err2 += (band[2 * k] - ref_r) * (band[2 * k] - ref_r) + (band[2 * k + 1] - ref_i) * (band[2 * k + 1] - ref_i);
+        ref2 += ref_r * ref_r + ref_i * ref_i;
+    }
+    return 10.0 * log10(err2 / ref2);
+}
+
+/* Largest difference between two spectra: relative to the second (dB), and in phase (degrees) */
+static void compare_spectra(const double *a, const double *b, int count, double *max_db, double *max_deg) {
+    double max_rel = 0.0;
+    *max_deg = 0.0;
+    for (int k = 0; k < count; k++) {
+        double ar = a[2 * k], ai = a[2 * k + 1], br = b[2 * k], bi = b[2 * k + 1];
+        double rel = hypot(ar - br, ai - bi) / (hypot(br, bi) + 1e-300);
+        if (rel > max_rel) max_rel = rel;
+        double deg = fabs(atan2(ai * br - ar * bi, ar * br + ai * bi)) * 180.0 / M_PI;
+        if (deg > *max_deg) *max_deg = deg;
+    }
+    *max_db = 20.0 * log10(max_rel + 1e-300);
+}
+
+/*
+ * Times the chain on each sweep and reports its accuracy. The band
+ * spectra are saved for the other build: run both
+ *   make bench_precision && ./bench_precision
+ *   make PRECISION=double bench_precision && ./bench_precision
+ * and the second run reports how far the two precisions are apart.
+ */
+void bench_precision(void) {
+    int is_double = sizeof(kiss_fft_scalar) == sizeof(double);
+    char own_path[64], other_path[64];
+    snprintf(own_path, sizeof(own_path), BENCH_SPECTRA_FILE, precision_name(is_double));
+    snprintf(other_path, sizeof(other_path), BENCH_SPECTRA_FILE, precision_name(!is_double));
+    FILE *own = fopen(own_path, "wb");
+    FILE *other = fopen(other_path, "rb");
+    if (!own) {
+        fprintf(stderr, "Failed to create %s (does output/ exist?)\n", own_path);
+    }
+
+    printf("--- PROCESSING PRECISION: %s (kiss_fft_scalar of %zu bytes) ---\n", precision_name(is_double),
+           sizeof(kiss_fft_scalar));
+    printf("Closed capture: exponential sweep; open capture: its 0.5 z^-5 + 0.25 z^-%d echo\n", 5 + ECHO_DELAY);
+    printf("Over [1.5 f0, f1 / 1.5]: H_lips error against the echo system; largest difference of H_lips\n"
+           "and of the closed linear IR to the %s build%s\n", precision_name(!is_double),
+           other ? "" : " (not run yet)");
+    printf("%8s %13s %6s %9s %10s %10s %10s %10s %10s\n", "Rate", "Band (Hz)", "T (s)", "nfft", "Time (ms)",
+           "Echo (dB)", "H (dB)", "H (deg)", "IR (dB)");
+
+    for (int i = 0; i < NUM_SWEEPS; i++) {
+        const BenchSweep *s = &sweeps[i];
+        int nfft = calculate_next_power_of_two((int)(s->fs * s->T));
+        int first;
+        int count = band_bins(s, nfft, &first);
+        size_t band_size = 4 * (size_t)count; /* H_lips and closed IR pairs */
+        double *band = (double*)malloc(sizeof(double) * band_size);
+        double *other_band = (double*)malloc(sizeof(double) * band_size);
+        if (!band || !other_band) {
+            fprintf(stderr, "Failed to allocate band spectra\n");
+            free(band);
+            free(other_band);
+            break;
+        }
+
+        double best = -1.0;
+        for (int rep = 0; rep < BENCH_REPETITIONS; rep++) {
+            double elapsed = run_chain(s, rep == 0 ? band : NULL);
+            if (elapsed < 0.0) break;
+            if (best < 0.0 || elapsed < best) best = elapsed;
+        }
+        if (best < 0.0) {
+            free(band);
+            free(other_band);
+            break;
+        }
+
+        /* Spectra files: per sweep, the bin count (int32) then H_lips and closed IR pairs */
+        int32_t stored = count;
+        if (own) {
+            fwrite(&stored, sizeof(stored), 1, own);
+            fwrite(band, sizeof(double), band_size, own);
+        }
+        int has_other = other && fread(&stored, sizeof(stored), 1, other) == 1 && stored == count
+                        && fread(other_band, sizeof(double), band_size, other) == band_size;
+
+        printf("%8.0f %6.0f-%-6.0f %6.0f %9d %10.1f %10.1f", s->fs, s->f0, s->f1, s->T, nfft, best * 1e3,
+               echo_error_db(s, nfft, band));
+        if (has_other) {
+            double h_db, h_deg, ir_db, ir_deg;
+            compare_spectra(band, other_band, count, &h_db, &h_deg);
+            compare_spectra(band + 2 * count, other_band + 2 * count, count, &ir_db, &ir_deg);
+            printf(" %10.1f %10.5f %10.1f\n", h_db, h_deg, ir_db);
+        } else {
+            printf(" %10s %10s %10s\n", "-", "-", "-");
+        }
+        free(band);
+        free(other_band);
+    }
+
+    if (own) {
+        fclose(own);
+        printf("Band spectra saved to %s\n", own_path);
+    }
+    if (other) {
+        fclose(other);
+    }
+}
+
+int main(void) {
+    bench_precision();
+    return 0;
+}
@@ -0,0 +1,109 @@
+#include "processing.h"
+#include "config.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+
+#define BENCH_REPETITIONS 3
+
+/*
+ * Runs the processing chain of run_processing_mode() on a synthetic
+ * exponential sweep (the chirp itself is used as both captures), with
+ * full-band output: H_lips over the non-negative frequencies.
+ * Returns the CPU time in seconds, or a negative value on failure.
+ */
+static double run_chain(double fs, float f0, float f1, float T) {
+    int n_samples_chirp = (int)(fs * T);
+    int nfft = calculate_next_power_of_two(n_samples_chirp);
+
+    float *chirp = (float*)calloc(n_samples_chirp, sizeof(float));
+    kiss_fft_cpx *buf_closed = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * nfft);
+    kiss_fft_cpx *buf_open = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * nfft);
+    kiss_fft_cpx *inv_filter = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * nfft);
+    kiss_fft_cpx *h_result = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * nfft);
+    kiss_fft_scalar *epsilon = (kiss_fft_scalar*)malloc(sizeof(kiss_fft_scalar) * nfft);
+
+    if (!chirp || !buf_closed || !buf_open || !inv_filter || !h_result || !epsilon) {
+        fprintf(stderr, "Failed to allocate benchmark buffers\n");
+        free(chirp);
+        free(buf_closed);
+        free(buf_open);
+        free(inv_filter);
+        free(h_result);
+        free(epsilon);
+        return -1.0;
+    }
+
+    generate_chirp(chirp, 1.0f, f0, f1, T, (float)fs, 1, 0.0f, 0.0f);
+
+    clock_t start = clock();
+
+    kiss_fft_cfg cfg_fwd = kiss_fft_alloc(nfft, 0, NULL, NULL);
+    kiss_fft_cfg cfg_inv = kiss_fft_alloc(nfft, 1, NULL, NULL);
+
+    for (int i = 0; i < nfft; i++) {
+        buf_closed[i].r = (i < n_samples_chirp) ? chirp[i] : 0.0f;
+        buf_closed[i].i = 0.0f;
+        buf_open[i] = buf_closed[i];
+    }
+
+    generate_inverse_filter(inv_filter, 1.0f, f0, f1, T, (float)fs, nfft, 1);
+    kiss_fft(cfg_fwd, buf_closed, buf_closed);
+    kiss_fft(cfg_fwd, buf_open, buf_open);
+    int band_bins;
+    int band_first = sweep_band_bins(f0, f1, fs, nfft, &band_bins);
+    perform_deconvolution_bins(buf_closed, inv_filter, nfft, band_first, band_bins);
+    perform_deconvolution_bins(buf_open, inv_filter, nfft, band_first, band_bins);
+    generate_epsilon_bins(epsilon, f0, f1, (float)fs, nfft, EPSILON_TRANSITION_HZ, 0, nfft / 2);
+
+    int npre, npost;
+    linear_ir_window(f0, f1, T, fs, &npre, &npost);
+
+    extract_linear_ir(buf_closed, cfg_inv, cfg_fwd, nfft, n_samples_chirp, npre, npost, fs, 0);
+    extract_linear_ir(buf_open, cfg_inv, cfg_fwd, nfft, n_samples_chirp, npre, npost, fs, 0);
+    compute_h_lips(h_result, buf_open, buf_closed, epsilon, nfft / 2);
+
+    kiss_fft_free(cfg_fwd);
+    kiss_fft_free(cfg_inv);
+
+    double elapsed = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    free(chirp);
+    free(buf_closed);
+    free(buf_open);
+    free(inv_filter);
+    free(h_result);
+    free(epsilon);
+
+    return elapsed;
+}
+
+void bench_sample_rates(void) {
+    const double rates[NUM_STANDARD_SAMPLE_RATES] = STANDARD_SAMPLE_RATES;
+    float f0 = 200.0f;
+    float f1 = 12000.0f;
+    float T = 1.5f;
+
+    printf("--- PROCESSING COST PER SAMPLE RATE ---\n");
+    printf("Sweep: %.0f-%.0f Hz, %.2f s, best of %d runs\n", f0, f1, T, BENCH_REPETITIONS);
+    printf("%12s %10s %12s %14s\n", "Rate (Hz)", "nfft", "Time (ms)", "ns / sample");
+
+    for (int r = 0; r < NUM_STANDARD_SAMPLE_RATES; r++) {
+        double fs = rates[r];
+        int nfft = calculate_next_power_of_two((int)(fs * T));
+        double best = -1.0;
+
+        for (int rep = 0; rep < BENCH_REPETITIONS; rep++) {
+            double elapsed = run_chain(fs, f0, f1, T);
+            if (elapsed < 0.0) return;
+            if (best < 0.0 || elapsed < best) best = elapsed;
+        }
+
+        printf("%12.0f %10d %12.2f %14.2f\n", fs, nfft, best * 1e3, best * 1e9 / (fs * T));
+    }
+}
+
+int main(void) {
+    bench_sample_rates();
+    return 0;
+}
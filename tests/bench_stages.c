@@ -0,0 +1,485 @@
+#define _POSIX_C_SOURCE 200809L
+#include "pipeline.h"
+#include "processing.h"
+#include "welch.h"
+#include "test_signals.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define BENCH_WARMUP 1        /* Untimed runs before the timed ones */
+#define BENCH_REPETITIONS 9   /* Timed runs of each stage */
+#define BENCH_JSON_FILE "output/bench.json"
+#define BENCH_F0 100.0f
+#define BENCH_F1 16000.0f
+#define BENCH_TGAP 0.5f
+#define BENCH_TFADE 0.05f
+#define ECHO_LATENCY 5   /* Open capture: 0.5 z^-ECHO_LATENCY + 0.25 z^-(ECHO_LATENCY + ECHO_DELAY) */
+#define ECHO_DELAY 37
+
+/* Synthetic takes: exponential sweeps at each standard rate, short to long */
+static const double sample_rates[] = { 44100.0, 48000.0, 96000.0 };
+static const float durations[] = { 1.0f, 4.0f, 16.0f };
+#define NUM_RATES ((int)(sizeof(sample_rates) / sizeof(sample_rates[0])))
+#define NUM_DURATIONS ((int)(sizeof(durations) / sizeof(durations[0])))
+
+static const int fft_sizes[] = { 1024, 4096, 16384, 65536, 262144, 1048576 };
+#define NUM_FFT_SIZES ((int)(sizeof(fft_sizes) / sizeof(fft_sizes[0])))
+
+/* estimate_delay() correlates every lag of half the signal: quadratic, so it is timed on short signals */
+static const int delay_sizes[] = { 1024, 4096, 16384 };
+#define NUM_DELAY_SIZES ((int)(sizeof(delay_sizes) / sizeof(delay_sizes[0])))
+
+/* Buffers of one take, shared by the stages */
+typedef struct {
+    ChirpParams chirp;
+    double fs;
+    int n_take;        /* Capture samples: sweep plus silence padding */
+    int nfft;          /* As run_processing_mode(): next power of two of the sweep */
+    int npre, npost;
+    float *closed, *open;
+    kiss_fft_cpx *spectrum_closed, *spectrum_open;  /* Deconvolved, before extract_linear_ir() */
+    kiss_fft_cpx *inv_filter, *buf, *out, *h;
+    kiss_fft_scalar *epsilon;
+    kiss_fft_cfg cfg_fwd, cfg_inv;
+    int delay_size;    /* estimate_delay stage only */
+    ProcessingOptions options;
+} BenchTake;
+
+/* A timed stage, and what it needs redone, untimed, before each run (may be NULL) */
+typedef struct {
+    const char *name;
+    void (*prepare)(BenchTake *take);
+    int (*run)(BenchTake *take);
+} BenchStage;
+
+typedef struct {
+    double min, median, p90, max, mean;   /* ms */
+} BenchStats;
+
+static int saved_stdout = -1;
+
+/* run_processing_mode() reports every step; the benchmark prints its own table */
+static void quiet_begin(void) {
+    fflush(stdout);
+    saved_stdout = dup(STDOUT_FILENO);
+    int null_fd = open("/dev/null", O_WRONLY);
+    if (null_fd >= 0) {
+        dup2(null_fd, STDOUT_FILENO);
+        close(null_fd);
+    }
+}
+
+static void quiet_end(void) {
+    fflush(stdout);
+    if (saved_stdout >= 0) {
+        dup2(saved_stdout, STDOUT_FILENO);
+        close(saved_stdout);
+        saved_stdout = -1;
+    }
+}
+
+static double now_ms(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e3 + t.tv_nsec / 1e6;
+}
+
+/* Removes a file or a directory tree; missing paths are not an error */
+static int remove_tree(const char *path) {
+    struct stat st;
+    if (lstat(path, &st) != 0) {
+        return 0;
+    }
+    if (!S_ISDIR(st.st_mode)) {
+        return unlink(path);
+    }
+    DIR *dir = opendir(path);
+    if (!dir) {
+        return -1;
+    }
+    int ret = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
+            continue;
+        }
+        char child[1024];
+        snprintf(child, sizeof(child), "%s/%s", path, entry->d_name);
+        if (remove_tree(child) != 0) {
+            ret = -1;
+        }
+    }
+    closedir(dir);
+    return rmdir(path) == 0 ? ret : -1;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+/* Nearest-rank percentile of sorted samples */
+static double percentile(const double *sorted, int n, double q) {
+    int rank = (int)ceil(q * n);
+    return sorted[rank < 1 ? 0 : rank - 1];
+}
+
+/* BENCH_WARMUP untimed then repetitions timed runs of a stage; -1 if a run fails */
+static int time_stage(const BenchStage *stage, BenchTake *take, int repetitions, BenchStats *stats) {
+    double *samples = (double*)malloc(sizeof(double) * repetitions);
+    if (!samples) {
+        fprintf(stderr, "Failed to allocate benchmark samples\n");
+        return -1;
+    }
+    for (int r = -BENCH_WARMUP; r < repetitions; r++) {
+        if (stage->prepare) {
+            stage->prepare(take);
+        }
+        double start = now_ms();
+        if (stage->run(take) != 0) {
+            fprintf(stderr, "Stage %s failed\n", stage->name);
+            free(samples);
+            return -1;
+        }
+        if (r >= 0) {
+            samples[r] = now_ms() - start;
+        }
+    }
+    qsort(samples, repetitions, sizeof(double), compare_doubles);
+    stats->mean = 0.0;
+    for (int r = 0; r < repetitions; r++) {
+        stats->mean += samples[r] / repetitions;
+    }
+    stats->min = samples[0];
+    stats->median = percentile(samples, repetitions, 0.5);
+    stats->p90 = percentile(samples, repetitions, 0.9);
+    stats->max = samples[repetitions - 1];
+    free(samples);
+    return 0;
+}
+
+/* One result object; take is NULL for stages that only depend on a size */
+static void write_result(FILE *json, int *first, const char *stage, const BenchTake *take, int n, int nfft,
+                         const BenchStats *stats) {
+    fprintf(json, "%s\n    { \"stage\": \"%s\"", *first ? "" : ",", stage);
+    if (take) {
+        fprintf(json, ", \"sample_rate\": %.0f, \"duration\": %g", take->fs, take->chirp.duration);
+    }
+    fprintf(json, ", \"n\": %d, \"nfft\": %d, \"min_ms\": %.4f, \"median_ms\": %.4f, \"p90_ms\": %.4f, "
+            "\"max_ms\": %.4f, \"mean_ms\": %.4f }", n, nfft, stats->min, stats->median, stats->p90, stats->max,
+            stats->mean);
+    *first = 0;
+    printf("  %-23s n %8d  nfft %8d  median %10.3f ms  p90 %10.3f ms  (min %.3f, max %.3f)\n", stage, n, nfft,
+           stats->median, stats->p90, stats->min, stats->max);
+}
+
+static int stage_chirp(BenchTake *t) {
+    generate_chirp(t->closed, t->chirp.amplitude, t->chirp.start_freq, t->chirp.end_freq, t->chirp.duration,
+                   (float)t->fs, t->chirp.type, t->chirp.Tgap, t->chirp.Tfade);
+    return 0;
+}
+
+static int stage_delay(BenchTake *t) {
+    return estimate_delay(t->open, t->closed, t->delay_size) == -ECHO_LATENCY ? 0 : -1;
+}
+
+static int stage_inverse_filter(BenchTake *t) {
+    generate_inverse_filter(t->inv_filter, t->chirp.amplitude, t->chirp.start_freq, t->chirp.end_freq,
+                            t->chirp.duration, (float)t->fs, t->nfft, t->chirp.type);
+    return 0;
+}
+
+static int stage_fft(BenchTake *t) {
+    kiss_fft(t->cfg_fwd, t->buf, t->out);
+    return 0;
+}
+
+/* The transformed closed capture, restored before each in-place stage */
+static void prepare_capture_spectrum(BenchTake *t) {
+    memcpy(t->buf, t->out, sizeof(kiss_fft_cpx) * t->nfft);
+}
+
+static int stage_deconvolution(BenchTake *t) {
+    perform_deconvolution(t->buf, t->inv_filter, t->nfft);
+    return 0;
+}
+
+static void prepare_deconvolved(BenchTake *t) {
+    memcpy(t->buf, t->spectrum_closed, sizeof(kiss_fft_cpx) * t->nfft);
+}
+
+static int stage_linear_ir(BenchTake *t) {
+    extract_linear_ir(t->buf, t->cfg_inv, t->cfg_fwd, t->nfft, (int)(t->fs * t->chirp.duration), t->npre,
+                      t->npost, t->fs, 0);
+    return 0;
+}
+
+static int stage_h_lips(BenchTake *t) {
+    compute_h_lips(t->h, t->spectrum_open, t->spectrum_closed, t->epsilon, t->nfft);
+    return 0;
+}
+
+/* Every run starts from an empty session store and FRF database, so nothing is restored */
+static void prepare_processing(BenchTake *t) {
+    (void)t;
+    remove_tree(DEFAULT_STORE_DIR);
+    remove_tree("output/frf_db");
+}
+
+static int stage_processing(BenchTake *t) {
+    quiet_begin();
+    int ret = run_processing_mode(&t->chirp, t->fs, &t->options);
+    quiet_end();
+    return ret;
+}
+
+static void take_free(BenchTake *t) {
+    free(t->closed);
+    free(t->open);
+    free(t->spectrum_closed);
+    free(t->spectrum_open);
+    free(t->inv_filter);
+    free(t->buf);
+    free(t->out);
+    free(t->h);
+    free(t->epsilon);
+    kiss_fft_free(t->cfg_fwd);
+    kiss_fft_free(t->cfg_inv);
+    memset(t, 0, sizeof(*t));
+}
+
+/* Closed capture: the sweep; open capture: its echo */
+static void synthesize_captures(float *closed, float *open, int n) {
+    for (int i = 0; i < n; i++) {
+        open[i] = (i >= ECHO_LATENCY ? 0.5f * closed[i - ECHO_LATENCY] : 0.0f)
+                  + (i >= ECHO_LATENCY + ECHO_DELAY ? 0.25f * closed[i - ECHO_LATENCY - ECHO_DELAY] : 0.0f);
+    }
+}
+
+/* Allocates a take's buffers and plans, with nfft points and n capture samples */
+static int take_alloc(BenchTake *t, int n, int nfft) {
+    t->n_take = n;
+    t->nfft = nfft;
+    t->closed = (float*)calloc(n, sizeof(float));
+    t->open = (float*)calloc(n, sizeof(float));
+    t->spectrum_closed = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * nfft);
+    t->spectrum_open = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * nfft);
+    t->inv_filter = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * nfft);
+    t->buf = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * nfft);
+    t->out = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * nfft);
+    t->h = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * nfft);
+    t->epsilon = (kiss_fft_scalar*)malloc(sizeof(kiss_fft_scalar) * nfft);
+    t->cfg_fwd = kiss_fft_alloc(nfft, 0, NULL, NULL);
+    t->cfg_inv = kiss_fft_alloc(nfft, 1, NULL, NULL);
+    if (!t->closed || !t->open || !t->spectrum_closed || !t->spectrum_open || !t->inv_filter || !t->buf || !t->out
+        || !t->h || !t->epsilon || !t->cfg_fwd || !t->cfg_inv) {
+        fprintf(stderr, "Failed to allocate benchmark buffers (nfft %d)\n", nfft);
+        return -1;
+    }
+    return 0;
+}
+
+/* Capture of a take, zero-padded to nfft and transformed */
+static void transform_capture(BenchTake *t, const float *capture, kiss_fft_cpx *spectrum) {
+    for (int i = 0; i < t->nfft; i++) {
+        t->buf[i].r = i < t->n_take ? capture[i] : 0;
+        t->buf[i].i = 0;
+    }
+    kiss_fft(t->cfg_fwd, t->buf, spectrum);
+}
+
+/* Times the stages of run_processing_mode() and the whole mode on one synthetic take */
+static int bench_take(double fs, float duration, int repetitions, FILE *json, int *first) {
+    BenchTake t;
+    memset(&t, 0, sizeof(t));
+    t.fs = fs;
+    t.chirp.amplitude = 0.5f;
+    t.chirp.start_freq = BENCH_F0;
+    t.chirp.end_freq = BENCH_F1;
+    t.chirp.duration = duration;
+    t.chirp.type = 1;
+    t.chirp.Tgap = BENCH_TGAP;
+    t.chirp.Tfade = BENCH_TFADE;
+    int n_sweep = (int)(fs * duration);
+    int ret = -1;
+    if (take_alloc(&t, (int)(fs * (duration + BENCH_TGAP)), calculate_next_power_of_two(n_sweep)) != 0) {
+        goto done;
+    }
+    linear_ir_window(t.chirp.start_freq, t.chirp.end_freq, duration, fs, &t.npre, &t.npost);
+
+    /* The processing defaults of the command line, with the store and database in the scratch directory */
+    t.options.export.band_limited = 1;
+    t.options.export.grid_type = FRF_GRID_LOG;
+    t.options.memory_budget = (size_t)DEFAULT_PROCESSING_MEMORY_MB << 20;
+    t.options.welch_overlap = WELCH_DEFAULT_OVERLAP;
+    t.options.peaks.smoothing_octaves = FRF_PEAKS_DEFAULT_SMOOTHING;
+    t.options.peaks.prominence_db = FRF_PEAKS_DEFAULT_PROMINENCE;
+
+    printf("%.0f Hz, %g s sweep (%d capture samples, nfft %d):\n", fs, duration, t.n_take, t.nfft);
+    BenchStats stats;
+    const BenchStage chirp_stage = { "generate_chirp", NULL, stage_chirp };
+    if (time_stage(&chirp_stage, &t, repetitions, &stats) != 0) goto done;
+    write_result(json, first, chirp_stage.name, &t, t.n_take, 0, &stats);
+    synthesize_captures(t.closed, t.open, t.n_take);
+
+    const BenchStage inverse_stage = { "generate_inverse_filter", NULL, stage_inverse_filter };
+    if (time_stage(&inverse_stage, &t, repetitions, &stats) != 0) goto done;
+    write_result(json, first, inverse_stage.name, &t, n_sweep, t.nfft, &stats);
+
+    /* Deconvolved spectra of both captures, the inputs of the later stages */
+    transform_capture(&t, t.open, t.spectrum_open);
+    perform_deconvolution(t.spectrum_open, t.inv_filter, t.nfft);
+    transform_capture(&t, t.closed, t.spectrum_closed);
+    perform_deconvolution(t.spectrum_closed, t.inv_filter, t.nfft);
+    transform_capture(&t, t.closed, t.out);
+    generate_epsilon(t.epsilon, t.chirp.start_freq, t.chirp.end_freq, (float)fs, t.nfft);
+
+    const BenchStage deconv_stage = { "perform_deconvolution", prepare_capture_spectrum, stage_deconvolution };
+    if (time_stage(&deconv_stage, &t, repetitions, &stats) != 0) goto done;
+    write_result(json, first, deconv_stage.name, &t, n_sweep, t.nfft, &stats);
+
+    const BenchStage ir_stage = { "extract_linear_ir", prepare_deconvolved, stage_linear_ir };
+    if (time_stage(&ir_stage, &t, repetitions, &stats) != 0) goto done;
+    write_result(json, first, ir_stage.name, &t, n_sweep, t.nfft, &stats);
+
+    const BenchStage h_stage = { "compute_h_lips", NULL, stage_h_lips };
+    if (time_stage(&h_stage, &t, repetitions, &stats) != 0) goto done;
+    write_result(json, first, h_stage.name, &t, n_sweep, t.nfft, &stats);
+
+    /* The whole mode on the same captures, written as the measurement modes write them */
+    AudioView chirp_view = audio_view_make(t.closed, SAMPLE_FORMAT_FLOAT32, t.n_take, fs);
+    AudioView open_view = audio_view_make(t.open, SAMPLE_FORMAT_FLOAT32, t.n_take, fs);
+    quiet_begin();
+    int saved = save_response_files(chirp_view, chirp_view, t.n_take, &t.chirp, 1) == 0
+                && save_response_files(open_view, chirp_view, t.n_take, &t.chirp, 0) == 0;
+    quiet_end();
+    if (!saved) goto done;
+    const BenchStage processing_stage = { "run_processing_mode", prepare_processing, stage_processing };
+    if (time_stage(&processing_stage, &t, repetitions, &stats) != 0) goto done;
+    write_result(json, first, processing_stage.name, &t, t.n_take, t.nfft, &stats);
+    printf("\n");
+    ret = 0;
+
+done:
+    take_free(&t);
+    return ret;
+}
+
+/* kiss_fft on noise at each size, out of place */
+static int bench_fft(int repetitions, FILE *json, int *first) {
+    printf("kiss_fft (forward, complex):\n");
+    for (int s = 0; s < NUM_FFT_SIZES; s++) {
+        BenchTake t;
+        memset(&t, 0, sizeof(t));
+        int nfft = fft_sizes[s];
+        if (take_alloc(&t, 1, nfft) != 0) {
+            take_free(&t);
+            return -1;
+        }
+        unsigned state = 1;
+        for (int i = 0; i < nfft; i++) {
+            t.buf[i].r = (kiss_fft_scalar)noise(&state);
+            t.buf[i].i = 0;
+        }
+        BenchStats stats;
+        const BenchStage fft_stage = { "kiss_fft", NULL, stage_fft };
+        int ret = time_stage(&fft_stage, &t, repetitions, &stats);
+        if (ret == 0) {
+            write_result(json, first, fft_stage.name, NULL, nfft, nfft, &stats);
+        }
+        take_free(&t);
+        if (ret != 0) {
+            return -1;
+        }
+    }
+    printf("\n");
+    return 0;
+}
+
+/* estimate_delay() of a sweep and a delayed copy, as in the loopback alignment, checking the lag it finds */
+static int bench_delay(int repetitions, FILE *json, int *first) {
+    printf("estimate_delay (48000 Hz sweep delayed by %d samples):\n", ECHO_LATENCY);
+    int max_n = delay_sizes[NUM_DELAY_SIZES - 1];
+    BenchTake t;
+    memset(&t, 0, sizeof(t));
+    int ret = -1;
+    if (take_alloc(&t, max_n, 1) != 0) {
+        goto done;
+    }
+    t.fs = 48000.0;
+    generate_chirp(t.closed, 0.5f, BENCH_F0, BENCH_F1, (float)(max_n / t.fs), (float)t.fs, 1, 0.0f, 0.0f);
+    for (int i = ECHO_LATENCY; i < max_n; i++) {
+        t.open[i] = 0.5f * t.closed[i - ECHO_LATENCY];
+    }
+    for (int s = 0; s < NUM_DELAY_SIZES; s++) {
+        BenchStats stats;
+        t.delay_size = delay_sizes[s];
+        const BenchStage delay_stage = { "estimate_delay", NULL, stage_delay };
+        if (time_stage(&delay_stage, &t, repetitions, &stats) != 0) goto done;
+        write_result(json, first, delay_stage.name, NULL, t.delay_size, 0, &stats);
+    }
+    printf("\n");
+    ret = 0;
+
+done:
+    take_free(&t);
+    return ret;
+}
+
+int main(int argc, char **argv) {
+    const char *json_path = argc > 1 ? argv[1] : BENCH_JSON_FILE;
+    int repetitions = argc > 2 ? atoi(argv[2]) : BENCH_REPETITIONS;
+    if (repetitions < 1) {
+        fprintf(stderr, "Usage: %s [results.json] [repetitions >= 1]\n", argv[0]);
+        return 1;
+    }
+
+    FILE *json = fopen(json_path, "w");
+    if (!json) {
+        fprintf(stderr, "Failed to open '%s' for writing\n", json_path);
+        return 1;
+    }
+
+    /* run_processing_mode() works on output/ of the current directory: give it a scratch one */
+    char cwd[1024], scratch[] = "/tmp/bench_stages_XXXXXX";
+    if (!getcwd(cwd, sizeof(cwd)) || !mkdtemp(scratch) || chdir(scratch) != 0 || mkdir("output", 0755) != 0) {
+        fprintf(stderr, "Failed to set up a scratch directory\n");
+        fclose(json);
+        return 1;
+    }
+
+    const char *precision = sizeof(kiss_fft_scalar) == sizeof(double) ? "double" : "float";
+    printf("Processing stage benchmark: %s build, %d warm-up and %d timed runs per stage\n\n", precision,
+           BENCH_WARMUP, repetitions);
+    fprintf(json, "{\n  \"precision\": \"%s\",\n  \"warmup\": %d,\n  \"repetitions\": %d,\n  \"results\": [",
+            precision, BENCH_WARMUP, repetitions);
+
+    int first = 1, ret = 0;
+    double start = now_ms();
+    if (bench_fft(repetitions, json, &first) != 0 || bench_delay(repetitions, json, &first) != 0) {
+        ret = 1;
+    }
+    for (int r = 0; r < NUM_RATES && ret == 0; r++) {
+        for (int d = 0; d < NUM_DURATIONS && ret == 0; d++) {
+            if (bench_take(sample_rates[r], durations[d], repetitions, json, &first) != 0) {
+                ret = 1;
+            }
+        }
+    }
+    fprintf(json, "\n  ]\n}\n");
+    fclose(json);
+
+    if (chdir(cwd) != 0 || remove_tree(scratch) != 0) {
+        fprintf(stderr, "Failed to remove scratch directory '%s'\n", scratch);
+    }
+    if (ret == 0) {
+        printf("Done in %.1f s; results in '%s'\n", (now_ms() - start) / 1e3, json_path);
+    }
+    return ret;
+}
@@ -0,0 +1,224 @@
+#define _POSIX_C_SOURCE 200809L
+#include "pa_stub.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * PortAudio stand-in for the audio tests, linked instead of
+ * -lportaudio. Device 0 is a mono/stereo duplex loopback: the input is
+ * the output PA_STUB_LATENCY frames later. A started stream runs its
+ * callback on its own thread, as fast as it can, and calls the finished
+ * callback with the stream's user data once the callback returns
+ * something other than paContinue or the stream is stopped or aborted,
+ * as PortAudio does.
+ */
+
+#define STUB_CHANNELS 2
+#define STUB_HISTORY (1 << 16) /* Output frames kept for the loopback, > PA_STUB_LATENCY + a buffer */
+
+typedef struct {
+    PaStreamCallback *callback;
+    PaStreamFinishedCallback *finished;
+    void *user_data;
+    int channels;
+    unsigned long frames_per_buffer;
+    PaStreamInfo info;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    int started;
+    int stop;          /* Set by Pa_StopStream() / Pa_AbortStream(), read by the stream thread */
+    int active;
+    float *history;    /* STUB_HISTORY frames of output */
+    long long frames;
+} StubStream;
+
+static const PaDeviceInfo stub_device = {
+    2, "stub loopback", 0, STUB_CHANNELS, STUB_CHANNELS, 0.005, 0.005, 0.05, 0.05, 48000.0
+};
+
+PaError Pa_Initialize(void) {
+    return paNoError;
+}
+
+PaError Pa_Terminate(void) {
+    return paNoError;
+}
+
+const char *Pa_GetErrorText(PaError error_code) {
+    return error_code == paNoError ? "Success" : "Stub error";
+}
+
+PaDeviceIndex Pa_GetDeviceCount(void) {
+    return 1;
+}
+
+PaDeviceIndex Pa_GetDefaultInputDevice(void) {
+    return 0;
+}
+
+PaDeviceIndex Pa_GetDefaultOutputDevice(void) {
+    return 0;
+}
+
+const PaDeviceInfo *Pa_GetDeviceInfo(PaDeviceIndex device) {
+    return device == 0 ? &stub_device : NULL;
+}
+
+PaError Pa_IsFormatSupported(const PaStreamParameters *input, const PaStreamParameters *output,
+                             double sample_rate) {
+    (void)sample_rate;
+    if ((input && (input->device != 0 || input->sampleFormat != paFloat32))
+        || (output && (output->device != 0 || output->sampleFormat != paFloat32))) {
+        return paSampleFormatNotSupported;
+    }
+    return paFormatIsSupported;
+}
+
+PaError Pa_OpenStream(PaStream **stream, const PaStreamParameters *input, const PaStreamParameters *output,
+                      double sample_rate, unsigned long frames_per_buffer, PaStreamFlags flags,
+                      PaStreamCallback *callback, void *user_data) {
+    (void)flags;
+    if (!input || !output || !callback || Pa_IsFormatSupported(input, output, sample_rate) != paFormatIsSupported
+        || input->channelCount != output->channelCount || input->channelCount > STUB_CHANNELS) {
+        return paInvalidDevice;
+    }
+    StubStream *s = (StubStream*)calloc(1, sizeof(StubStream));
+    if (!s) {
+        return paInsufficientMemory;
+    }
+    s->history = (float*)calloc((size_t)STUB_HISTORY * input->channelCount, sizeof(float));
+    if (!s->history || pthread_mutex_init(&s->lock, NULL) != 0) {
+        free(s->history);
+        free(s);
+        return paInsufficientMemory;
+    }
+    s->callback = callback;
+    s->user_data = user_data;
+    s->channels = input->channelCount;
+    s->frames_per_buffer = frames_per_buffer > 0 ? frames_per_buffer : 256;
+    s->info.structVersion = 1;
+    s->info.inputLatency = input->suggestedLatency;
+    s->info.outputLatency = output->suggestedLatency;
+    s->info.sampleRate = sample_rate;
+    *stream = s;
+    return paNoError;
+}
+
+PaError Pa_SetStreamFinishedCallback(PaStream *stream, PaStreamFinishedCallback *finished) {
+    ((StubStream*)stream)->finished = finished;
+    return paNoError;
+}
+
+static int stub_stopping(StubStream *s) {
+    pthread_mutex_lock(&s->lock);
+    int stop = s->stop;
+    pthread_mutex_unlock(&s->lock);
+    return stop;
+}
+
+static void *stub_stream_thread(void *arg) {
+    StubStream *s = (StubStream*)arg;
+    unsigned long n = s->frames_per_buffer;
+    float *in = (float*)malloc(sizeof(float) * n * s->channels);
+    float *out = (float*)malloc(sizeof(float) * n * s->channels);
+    int result = in && out ? paContinue : paAbort;
+    while (result == paContinue && !stub_stopping(s)) {
+        for (unsigned long i = 0; i < n; i++) {
+            long long src = s->frames + (long long)i - PA_STUB_LATENCY;
+            for (int ch = 0; ch < s->channels; ch++) {
+                in[i * s->channels + ch] = src >= 0 ? s->history[(src % STUB_HISTORY) * s->channels + ch] : 0.0f;
+            }
+        }
+        result = s->callback(in, out, n, NULL, 0, s->user_data);
+        for (unsigned long i = 0; i < n; i++) {
+            long long dst = (s->frames + (long long)i) % STUB_HISTORY;
+            memcpy(&s->history[dst * s->channels], &out[i * s->channels], sizeof(float) * s->channels);
+        }
+        s->frames += (long long)n;
+    }
+    free(in);
+    free(out);
+    if (s->finished) {
+        s->finished(s->user_data);
+    }
+    pthread_mutex_lock(&s->lock);
+    s->active = 0;
+    pthread_mutex_unlock(&s->lock);
+    return NULL;
+}
+
+PaError Pa_StartStream(PaStream *stream) {
+    StubStream *s = (StubStream*)stream;
+    if (s->started) {
+        return paStreamIsNotStopped;
+    }
+    s->active = 1;
+    if (pthread_create(&s->thread, NULL, stub_stream_thread, s) != 0) {
+        s->active = 0;
+        return paInternalError;
+    }
+    s->started = 1;
+    return paNoError;
+}
+
+PaError Pa_StopStream(PaStream *stream) {
+    StubStream *s = (StubStream*)stream;
+    if (!s->started) {
+        return paStreamIsStopped;
+    }
+    pthread_mutex_lock(&s->lock);
+    s->stop = 1;
+    pthread_mutex_unlock(&s->lock);
+    pthread_join(s->thread, NULL);
+    s->started = 0;
+    return paNoError;
+}
+
+PaError Pa_AbortStream(PaStream *stream) {
+    return Pa_StopStream(stream);
+}
+
+PaError Pa_CloseStream(PaStream *stream) {
+    StubStream *s = (StubStream*)stream;
+    if (s->started) {
+        Pa_StopStream(stream);
+    }
+    pthread_mutex_destroy(&s->lock);
+    free(s->history);
+    free(s);
+    return paNoError;
+}
+
+PaError Pa_IsStreamActive(PaStream *stream) {
+    StubStream *s = (StubStream*)stream;
+    pthread_mutex_lock(&s->lock);
+    int active = s->active;
+    pthread_mutex_unlock(&s->lock);
+    return active;
+}
+
+const PaStreamInfo *Pa_GetStreamInfo(PaStream *stream) {
+    return &((StubStream*)stream)->info;
+}
+
+/* Blocking I/O is not emulated: the callback paths are what the tests drive */
+PaError Pa_ReadStream(PaStream *stream, void *buffer, unsigned long frames) {
+    (void)stream;
+    (void)buffer;
+    (void)frames;
+    return paCanNotReadFromACallbackStream;
+}
+
+PaError Pa_WriteStream(PaStream *stream, const void *buffer, unsigned long frames) {
+    (void)stream;
+    (void)buffer;
+    (void)frames;
+    return paCanNotWriteToACallbackStream;
+}
+
+void Pa_Sleep(long msec) {
+    struct timespec t = { msec / 1000, (msec % 1000) * 1000000L };
+    nanosleep(&t, NULL);
+}
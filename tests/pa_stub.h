@@ -0,0 +1,13 @@
+#ifndef PA_STUB_H
+#define PA_STUB_H
+
+#include <portaudio.h>
+
+/*
+ * Frames between a sample played on the stub loopback device and its
+ * return at the input; at least a buffer, as the stub fills each input
+ * buffer from output that has already been played.
+ */
+#define PA_STUB_LATENCY 4800
+
+#endif
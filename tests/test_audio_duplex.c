@@ -0,0 +1,95 @@
+#include "audio_io.h"
+#include "audio_tuning.h"
+#include "pa_stub.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define TAKE_RATE 48000.0f
+#define TAKE_SAMPLES 48000
+#define LOOP_PERIOD 4096
+
+/* Largest difference between the recording and the playback PA_STUB_LATENCY samples earlier */
+static double loopback_error(const float *playback, const float *record, int n) {
+    double max_err = 0.0;
+    for (int i = 0; i < n; i++) {
+        double expected = i >= PA_STUB_LATENCY ? playback[i - PA_STUB_LATENCY] : 0.0;
+        double err = fabs(record[i] - expected);
+        if (err > max_err) max_err = err;
+    }
+    return max_err;
+}
+
+void test_audio_duplex(void) {
+    printf("--- DUPLEX HANDLE TEST (stub PortAudio loopback, %d frames latency) ---\n", PA_STUB_LATENCY);
+
+    float *playback = (float*)malloc(sizeof(float) * TAKE_SAMPLES);
+    float *record = (float*)malloc(sizeof(float) * TAKE_SAMPLES);
+    if (!playback || !record || audio_init() != 0) {
+        fprintf(stderr, "Failed to set up the duplex test\n");
+        free(playback);
+        free(record);
+        return;
+    }
+    for (int i = 0; i < TAKE_SAMPLES; i++) {
+        playback[i] = (float)(0.5 * sin(2.0 * M_PI * 440.0 * i / TAKE_RATE));
+    }
+
+    /* The finished callback must find the handle behind the stream's user data and wake the waiter */
+    AudioDuplexHandle *take = audio_duplex_start(0, 0, TAKE_RATE, playback, record, TAKE_SAMPLES, 1);
+    if (!take) {
+        printf("audio_duplex_start failed\n");
+        goto done;
+    }
+    int waited = audio_duplex_wait(take, 5.0);
+    printf("Take: wait %d (should be 0, not 1 for a timeout), done %d (should be 1)\n", waited,
+           audio_duplex_is_done(take));
+    AudioDuplexStats stats;
+    audio_duplex_get_stats(take, &stats);
+    printf("  xruns %d/%d (should be 0/0), latency in %.3f s, out %.3f s (should be 0.050, 0.050)\n",
+           stats.input_overflows, stats.output_underflows, stats.input_latency, stats.output_latency);
+    printf("  close %d (should be 0), loopback error %.3g (should be 0)\n", audio_duplex_close(take),
+           loopback_error(playback, record, TAKE_SAMPLES));
+
+    /* Tuned native start, as the tuner's probes and the measurement modes use */
+    AudioStreamTuning tuning = { 64, 0.005, 0.005 };
+    take = audio_duplex_start_native(0, 0, TAKE_RATE, playback, record, SAMPLE_FORMAT_FLOAT32, TAKE_SAMPLES, 1,
+                                     &tuning);
+    waited = take ? audio_duplex_wait(take, 5.0) : -1;
+    printf("Native take, 64 frames per buffer: wait %d (should be 0), close %d (should be 0)\n", waited,
+           take ? audio_duplex_close(take) : -1);
+
+    /* Blocking wrapper: waits without a timeout, so it would hang without the completion signal */
+    printf("audio_duplex_callback: %d (should be 0)\n",
+           audio_duplex_callback(0, 0, TAKE_RATE, playback, record, TAKE_SAMPLES, 1));
+
+    /* A loop stream never completes on its own; closing it stops it cleanly */
+    float *ring = (float*)calloc(4 * LOOP_PERIOD, sizeof(float));
+    take = ring ? audio_duplex_start_loop(0, 0, TAKE_RATE, playback, LOOP_PERIOD, ring, 4 * LOOP_PERIOD, 1, NULL)
+                : NULL;
+    if (take) {
+        waited = audio_duplex_wait(take, 0.1);
+        long long frames = audio_duplex_frames_recorded(take);
+        printf("Loop stream: wait %d (should be 1), %s frames recorded (should be some), close %d (should be 0)\n",
+               waited, frames > 0 ? "some" : "no", audio_duplex_close(take));
+    } else {
+        printf("audio_duplex_start_loop failed\n");
+    }
+    free(ring);
+
+    /* Every probe of the tuner is a take that has to be reported complete */
+    AudioStreamTuning tuned = { 0, 0.0, 0.0 };
+    int tuned_ok = audio_tune_duplex(0, 0, TAKE_RATE, 1, &tuned);
+    printf("Tuner: %d (should be 0), %lu frames per buffer (should be %d, the smallest stable)\n", tuned_ok,
+           tuned.frames_per_buffer, TUNING_MIN_FRAMES);
+
+done:
+    audio_terminate();
+    free(playback);
+    free(record);
+}
+
+int main(void) {
+    test_audio_duplex();
+    return 0;
+}
@@ -0,0 +1,207 @@
+#include "clock_drift.h"
+#include "decimate.h"
+#include "processing.h"
+#include "test_signals.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TAKE_LATENCY 300     /* Samples between the sent and the recorded sweep */
+#define ECHO_DELAY 20        /* System 0.1 + 0.5 z^-ECHO_DELAY + 0.1 z^-(2 ECHO_DELAY): linear phase, */
+                             /* as the drift fit assumes a constant group delay */
+#define ALIGNED_DELAY (TAKE_LATENCY + ECHO_DELAY)
+#define NOISE_LEVEL 1e-3     /* Uniform noise added to the recording */
+#define IR_FROM (-64)        /* IR samples compared against the drift-free one */
+#define IR_TO 128
+#define LEVEL_FROM_HZ 100.0  /* Band where the IR levels are compared */
+#define LEVEL_TO_HZ 15000.0
+#define LEVEL_STEP_HZ 100.0
+
+/*
+ * A take through the echo system recorded TAKE_LATENCY samples late by an
+ * input clock ppm off the output clock: the sweep generated at the input
+ * rate is what the input device samples.
+ */
+static void record_take(float *y, int n, double fs, double ppm, const ChirpParams *chirp, double *ratio) {
+    float fs_in = (float)(fs * (1.0 + ppm * 1e-6));
+    *ratio = fs_in / fs;
+    int n_in = (int)(chirp->duration * fs_in) + 1;
+    float *x = (float*)calloc(n_in, sizeof(float));
+    unsigned state = 1;
+    generate_chirp(x, chirp->amplitude, chirp->start_freq, chirp->end_freq, chirp->duration, fs_in, chirp->type,
+                   0.0f, 0.0f);
+    for (int i = 0; i < n; i++) {
+        int j = i - TAKE_LATENCY;
+        double s = 0.0;
+        for (int e = 0; e < 3; e++) {
+            int k = j - e * ECHO_DELAY;
+            s += k >= 0 && k < n_in ? (e == 1 ? 0.5 : 0.1) * x[k] : 0.0;
+        }
+        y[i] = (float)(s + NOISE_LEVEL * noise(&state));
+    }
+    free(x);
+}
+
+/* Linear IR of an aligned take (n samples) into ir (nfft), by the inverse filter of the sweep */
+static void deconvolve(float *ir, const float *take, int n, const kiss_fft_cpx *inv_filter, int nfft,
+                       kiss_fft_cfg cfg_fwd, kiss_fft_cfg cfg_inv, kiss_fft_cpx *work) {
+    for (int i = 0; i < nfft; i++) {
+        work[i].r = i < n ? take[i] : 0.0f;
+        work[i].i = 0.0f;
+    }
+    kiss_fft(cfg_fwd, work, work);
+    perform_deconvolution(work, inv_filter, nfft);
+    kiss_fft(cfg_inv, work, work);
+    for (int i = 0; i < nfft; i++) {
+        ir[i] = (float)(work[i].r / nfft);
+    }
+}
+
+/* Level of the IR window of ir at f (dB) */
+static double window_level(const float *ir, int nfft, double f, double fs) {
+    double re = 0.0, im = 0.0;
+    for (int k = IR_FROM; k < IR_TO; k++) {
+        double x = ir[(k + nfft) % nfft];
+        re += x * cos(2.0 * M_PI * f * k / fs);
+        im -= x * sin(2.0 * M_PI * f * k / fs);
+    }
+    return 10.0 * log10(re * re + im * im + 1e-300);
+}
+
+/* Largest |ir| in the IR window, and its largest level difference from ref's over LEVEL_FROM_HZ to LEVEL_TO_HZ (dB) */
+static void compare_ir(const float *ir, const float *ref, int nfft, double fs, double *peak, double *level_db) {
+    *peak = 0.0;
+    for (int k = IR_FROM; k < IR_TO; k++) {
+        double x = fabs(ir[(k + nfft) % nfft]);
+        if (x > *peak) *peak = x;
+    }
+    *level_db = 0.0;
+    for (double f = LEVEL_FROM_HZ; f <= LEVEL_TO_HZ; f += LEVEL_STEP_HZ) {
+        double d = fabs(window_level(ir, nfft, f, fs) - window_level(ref, nfft, f, fs));
+        if (d > *level_db) *level_db = d;
+    }
+}
+
+static void drift_case(int type, double ppm) {
+    const double fs = 48000.0;
+    ChirpParams chirp = { 0.5f, 50.0f, 16000.0f, 4.0f, type, 0.0f, 0.0f, 0, 0.0f, 0.0f, 0, 0 };
+    int sweep = (int)(chirp.duration * fs);
+    int n = sweep + (int)(0.5 * fs);
+    int nfft = calculate_next_power_of_two(n);
+    float *ref = (float*)calloc(n, sizeof(float));
+    float *take = (float*)malloc(sizeof(float) * n);
+    float *clean = (float*)malloc(sizeof(float) * n);
+    float *corrected = (float*)malloc(sizeof(float) * n);
+    float *ir_clean = (float*)malloc(sizeof(float) * nfft);
+    float *ir_plain = (float*)malloc(sizeof(float) * nfft);
+    float *ir_fixed = (float*)malloc(sizeof(float) * nfft);
+    kiss_fft_cpx *inv_filter = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * nfft);
+    kiss_fft_cpx *work = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * nfft);
+    kiss_fft_cfg cfg_fwd = kiss_fft_alloc(nfft, 0, NULL, NULL);
+    kiss_fft_cfg cfg_inv = kiss_fft_alloc(nfft, 1, NULL, NULL);
+    if (!ref || !take || !clean || !corrected || !ir_clean || !ir_plain || !ir_fixed || !inv_filter || !work
+        || !cfg_fwd || !cfg_inv) {
+        fprintf(stderr, "Failed to allocate test buffers\n");
+        return;
+    }
+    generate_chirp(ref, chirp.amplitude, chirp.start_freq, chirp.end_freq, chirp.duration, (float)fs, type, 0.0f, 0.0f);
+    double ratio, unused;
+    record_take(take, n, fs, ppm, &chirp, &ratio);
+    record_take(clean, n, fs, 0.0, &chirp, &unused);
+
+    /* The main tap is where the constant delay lands */
+    ClockDrift drift;
+    int ret = estimate_clock_drift(take, ref, n, &chirp, fs, 0, ALIGNED_DELAY, &drift);
+    printf("%s sweep, %+.0f ppm (%.1f samples over the sweep): estimated %+.2f ppm (should be %+.2f), offset %.2f "
+           "(should be %d), %d segments, residual %.3f samples%s\n", type == 0 ? "Linear" : "Exponential",
+           ppm, (ratio - 1.0) * sweep, clock_drift_ppm(&drift), (ratio - 1.0) * 1e6, drift.offset, ALIGNED_DELAY,
+           drift.num_segments, drift.residual, ret == 0 ? "" : " FAILED");
+    printf("  resampled: %s (should be %s)\n", fabs(drift.ratio - 1.0) * n >= DRIFT_CORRECTION_SAMPLES ? "yes" : "no",
+           ppm != 0.0 ? "yes" : "no");
+
+    /* Drift-free take and the drifting one aligned by the constant delay, as without correction */
+    Resampler r;
+    MemorySource src = { take, n, 0 };
+    if (resampler_init(&r, drift.offset, drift.ratio, memory_source, &src, n) != 0) {
+        return;
+    }
+    for (int first = 0; first < n; first += 4999) {
+        int count = n - first < 4999 ? n - first : 4999;
+        resampler_read(&r, first, count, corrected + first);
+    }
+    resampler_free(&r);
+    memmove(take, take + ALIGNED_DELAY, sizeof(float) * (n - ALIGNED_DELAY));
+    memset(take + n - ALIGNED_DELAY, 0, sizeof(float) * ALIGNED_DELAY);
+    memmove(clean, clean + ALIGNED_DELAY, sizeof(float) * (n - ALIGNED_DELAY));
+    memset(clean + n - ALIGNED_DELAY, 0, sizeof(float) * ALIGNED_DELAY);
+
+    generate_inverse_filter(inv_filter, chirp.amplitude, chirp.start_freq, chirp.end_freq, chirp.duration, (float)fs,
+                            nfft, type);
+    deconvolve(ir_clean, clean, n, inv_filter, nfft, cfg_fwd, cfg_inv, work);
+    deconvolve(ir_plain, take, n, inv_filter, nfft, cfg_fwd, cfg_inv, work);
+    deconvolve(ir_fixed, corrected, n, inv_filter, nfft, cfg_fwd, cfg_inv, work);
+    double peak_clean, peak_plain, peak_fixed, level_clean, level_plain, level_fixed;
+    compare_ir(ir_clean, ir_clean, nfft, fs, &peak_clean, &level_clean);
+    compare_ir(ir_plain, ir_clean, nfft, fs, &peak_plain, &level_plain);
+    compare_ir(ir_fixed, ir_clean, nfft, fs, &peak_fixed, &level_fixed);
+    printf("  linear IR peak: drift-free %.4f, constant delay only %.4f, resampled %.4f (should match drift-free)\n",
+           peak_clean, peak_plain, peak_fixed);
+    printf("  level against drift-free, %.0f-%.0f Hz: constant delay only %.2f dB, resampled %.2f dB "
+           "(should be below 0.1)\n", LEVEL_FROM_HZ, LEVEL_TO_HZ, level_plain, level_fixed);
+
+    free(ref);
+    free(take);
+    free(clean);
+    free(corrected);
+    free(ir_clean);
+    free(ir_plain);
+    free(ir_fixed);
+    free(inv_filter);
+    free(work);
+    kiss_fft_free(cfg_fwd);
+    kiss_fft_free(cfg_inv);
+}
+
+/* Delayed sine through the resampler: largest error against the exact samples, in dB */
+static double resampler_error(double f, double offset, double ratio) {
+    const double fs = 48000.0;
+    int n = 48000;
+    float *x = (float*)malloc(sizeof(float) * n);
+    float *y = (float*)malloc(sizeof(float) * n);
+    for (int i = 0; i < n; i++) {
+        x[i] = (float)sin(2.0 * M_PI * f * i / fs);
+    }
+    Resampler r;
+    MemorySource src = { x, n, 0 };
+    double max_error = 0.0;
+    if (resampler_init(&r, offset, ratio, memory_source, &src, n) == 0 && resampler_read(&r, 0, n, y) == 0) {
+        /* Away from the edges, where the filter sees the zero padding */
+        for (int m = n / 4; m < 3 * n / 4; m++) {
+            double e = fabs(y[m] - sin(2.0 * M_PI * f * (offset + ratio * m) / fs));
+            if (e > max_error) max_error = e;
+        }
+    }
+    resampler_free(&r);
+    free(x);
+    free(y);
+    return 20.0 * log10(max_error + 1e-300);
+}
+
+void test_clock_drift(void) {
+    printf("--- CLOCK DRIFT TEST ---\n");
+
+    printf("Resampler, 1000 Hz sine read 0.37 samples late at 1.0001: error %.1f dB (should be below -90)\n",
+           resampler_error(1000.0, 0.37, 1.0001));
+    printf("Resampler, 15000 Hz sine read 12.5 samples late at 0.9995: error %.1f dB (should be below -90)\n",
+           resampler_error(15000.0, 12.5, 0.9995));
+
+    drift_case(1, 80.0);
+    drift_case(1, -150.0);
+    drift_case(1, 0.0);
+    drift_case(0, 80.0);
+}
+
+int main(void) {
+    test_clock_drift();
+    return 0;
+}
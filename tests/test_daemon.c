@@ -0,0 +1,250 @@
+#define _POSIX_C_SOURCE 200809L
+#include "daemon.h"
+#include "wav_io.h"
+#include "test_signals.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#define TEST_SOCKET "output/test_daemon.sock"
+#define ECHO_DELAY 37
+
+static int write_capture(const char *path, const float *x, int n, const VtSweep *sweep, int wav) {
+    FILE *f;
+    WavInfo info;
+    memset(&info, 0, sizeof(info));
+    if (wav) {
+        info.sample_rate = sweep->sample_rate;
+        info.num_channels = 1;
+        info.format = SAMPLE_FORMAT_FLOAT32;
+        info.num_frames = n;
+        info.has_chirp = 1;
+        info.chirp.amplitude = sweep->amplitude;
+        info.chirp.start_freq = sweep->start_freq;
+        info.chirp.end_freq = sweep->end_freq;
+        info.chirp.duration = sweep->duration;
+        info.chirp.type = sweep->type;
+        f = wav_write_begin(path, &info);
+    } else {
+        f = fopen(path, "wb");
+    }
+    if (!f) {
+        fprintf(stderr, "Failed to create %s (does output/ exist?)\n", path);
+        return -1;
+    }
+    fwrite(x, sizeof(float), (size_t)n, f);
+    return wav ? wav_write_end(f, &info) : fclose(f);
+}
+
+static int connect_daemon(void) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, TEST_SOCKET);
+
+    /* The daemon may still be starting */
+    for (int attempt = 0; attempt < 100; attempt++) {
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd >= 0 && connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0) {
+            return fd;
+        }
+        if (fd >= 0) close(fd);
+        struct timespec wait = { 0, 20000000 };
+        nanosleep(&wait, NULL);
+    }
+    return -1;
+}
+
+static int read_exact(int fd, void *dst, size_t size) {
+    unsigned char *p = (unsigned char *)dst;
+    while (size > 0) {
+        ssize_t n = read(fd, p, size);
+        if (n <= 0) return -1;
+        p += n;
+        size -= (size_t)n;
+    }
+    return 0;
+}
+
+/* Sends one request and reads its reply line (without the newline) */
+static int request(int fd, const char *line, char *reply, size_t reply_size) {
+    if (write(fd, line, strlen(line)) != (ssize_t)strlen(line) || write(fd, "\n", 1) != 1) {
+        return -1;
+    }
+    size_t used = 0;
+    while (used + 1 < reply_size) {
+        if (read_exact(fd, reply + used, 1) != 0) return -1;
+        if (reply[used] == '\n') break;
+        used++;
+    }
+    reply[used] = '\0';
+    return 0;
+}
+
+/* Sends a process request; returns the max H_lips error against the echo system, or -1 */
+static double process(int fd, const char *line, const VtSweep *sweep, char *reply, size_t reply_size) {
+    int points = 0;
+    if (request(fd, line, reply, reply_size) != 0 || sscanf(reply, "ok points=%d", &points) != 1) {
+        return -1.0;
+    }
+    double *freq = (double *)malloc(sizeof(double) * points);
+    float *spectra = (float *)malloc(sizeof(float) * 6 * points);
+    double max_err = -1.0;
+    if (freq && spectra && read_exact(fd, freq, sizeof(double) * points) == 0
+        && read_exact(fd, spectra, sizeof(float) * 6 * points) == 0) {
+        max_err = 0.0;
+        for (int k = 0; k < points; k++) {
+            if (freq[k] < 1.5 * sweep->start_freq || freq[k] > sweep->end_freq / 1.5) continue;
+            double w = 2.0 * M_PI * freq[k] / sweep->sample_rate;
+            double ref_r = 0.5 * cos(5 * w) + 0.25 * cos((5 + ECHO_DELAY) * w);
+            double ref_i = -0.5 * sin(5 * w) - 0.25 * sin((5 + ECHO_DELAY) * w);
+            double err = hypot(spectra[2 * k] - ref_r, spectra[2 * k + 1] - ref_i);
+            if (err > max_err) max_err = err;
+        }
+    }
+    free(freq);
+    free(spectra);
+    return max_err;
+}
+
+void test_daemon(void) {
+    VtSweep sweep = { 16000.0, 100.0f, 4000.0f, 4.0f, 0.5f, 1 };
+    int n = (int)(sweep.sample_rate * sweep.duration);
+
+    printf("--- PROCESSING DAEMON TEST ---\n");
+
+    float *closed = (float*)malloc(sizeof(float) * n);
+    float *open = (float*)malloc(sizeof(float) * n);
+    if (!closed || !open) {
+        fprintf(stderr, "Failed to allocate captures\n");
+        free(closed);
+        free(open);
+        return;
+    }
+    make_sweep(closed, n, sweep.sample_rate, sweep.start_freq, sweep.end_freq, sweep.duration, sweep.amplitude);
+    for (int i = 0; i < n; i++) {
+        open[i] = (i >= 5 ? 0.5f * closed[i - 5] : 0.0f) + (i >= 5 + ECHO_DELAY ? 0.25f * closed[i - 5 - ECHO_DELAY] : 0.0f);
+    }
+    int written = write_capture("output/test_daemon_calibration.wav", closed, n, &sweep, 1) == 0
+                  && write_capture("output/test_daemon_measurement.wav", open, n, &sweep, 1) == 0
+                  && write_capture("output/test_daemon_calibration.raw", closed, n, &sweep, 0) == 0
+                  && write_capture("output/test_daemon_measurement.raw", open, n, &sweep, 0) == 0;
+    free(open);
+    if (!written) {
+        free(closed);
+        return;
+    }
+
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        return;
+    }
+    if (pid == 0) {
+        /* Daemon log lines go to stdout alongside the test output */
+        _exit(run_daemon_mode(TEST_SOCKET) == 0 ? 0 : 1);
+    }
+
+    int fd = connect_daemon();
+    if (fd < 0) {
+        fprintf(stderr, "Failed to connect to %s\n", TEST_SOCKET);
+        kill(pid, SIGTERM);
+        waitpid(pid, NULL, 0);
+        free(closed);
+        return;
+    }
+
+    char reply[256];
+    request(fd, "ping", reply, sizeof(reply));
+    printf("ping: '%s' (should be 'ok pong')\n", reply);
+
+    const char *wav_job = "process calibration=output/test_daemon_calibration.wav "
+                          "measurement=output/test_daemon_measurement.wav band=sweep";
+    double err = process(fd, wav_job, &sweep, reply, sizeof(reply));
+    printf("First WAV job: '%s'\n", reply);
+    printf("  max H_lips error %.4f (should be < 0.15)\n", err);
+    err = process(fd, wav_job, &sweep, reply, sizeof(reply));
+    printf("Second WAV job: '%s'\n", reply);
+    printf("  max H_lips error %.4f, warm=1 calibration_cached=1 expected\n", err);
+    /* Same path and size, rewritten within the same second: the mtime nanoseconds tell it apart */
+    write_capture("output/test_daemon_calibration.wav", closed, n, &sweep, 1);
+    err = process(fd, wav_job, &sweep, reply, sizeof(reply));
+    printf("Rewritten calibration: '%s'\n", reply);
+    printf("  max H_lips error %.4f, warm=1 calibration_cached=0 expected\n", err);
+    err = process(fd, "process calibration=output/test_daemon_calibration.wav "
+                      "measurement=output/test_daemon_measurement.wav sample_rate=16000 start_freq=100 "
+                      "end_freq=4000 duration=4 band=sweep", &sweep, reply, sizeof(reply));
+    printf("WAV job repeating the stored chirp: '%s'\n", reply);
+    printf("  max H_lips error %.4f, warm=1 calibration_cached=1 expected\n", err);
+
+    const char *raw_job = "process calibration_raw=output/test_daemon_calibration.raw "
+                          "measurement_raw=output/test_daemon_measurement.raw sample_rate=16000 start_freq=100 "
+                          "end_freq=4000 duration=4 chirp_type=exponential amplitude=0.5 band=sweep";
+    err = process(fd, raw_job, &sweep, reply, sizeof(reply));
+    printf("Raw job: '%s'\n", reply);
+    printf("  max H_lips error %.4f, warm=1 calibration_cached=0 expected\n", err);
+    err = process(fd, raw_job, &sweep, reply, sizeof(reply));
+    printf("Second raw job: '%s'\n", reply);
+    printf("  max H_lips error %.4f, warm=1 calibration_cached=1 expected\n", err);
+    write_capture("output/test_daemon_calibration.raw", closed, n, &sweep, 0);
+    err = process(fd, raw_job, &sweep, reply, sizeof(reply));
+    printf("Rewritten raw calibration: '%s'\n", reply);
+    printf("  max H_lips error %.4f, warm=1 calibration_cached=0 expected\n", err);
+
+    /* The stored chirps must agree with the job and with each other */
+    request(fd, "process calibration=output/test_daemon_calibration.wav "
+                "measurement=output/test_daemon_measurement.wav start_freq=200", reply, sizeof(reply));
+    printf("WAV job with another start_freq: '%s' (should be an error)\n", reply);
+    request(fd, "process calibration=output/test_daemon_calibration.wav "
+                "measurement=output/test_daemon_measurement.wav sample_rate=48000", reply, sizeof(reply));
+    printf("WAV job with another sample_rate: '%s' (should be an error)\n", reply);
+    VtSweep other = sweep;
+    other.end_freq = 3000.0f;
+    write_capture("output/test_daemon_other.wav", closed, n, &other, 1);
+    free(closed);
+    request(fd, "process calibration=output/test_daemon_calibration.wav "
+                "measurement=output/test_daemon_other.wav", reply, sizeof(reply));
+    printf("Measurement taken with another sweep: '%s' (should be an error)\n", reply);
+
+    request(fd, "process calibration=output/missing.wav measurement=output/missing.wav", reply, sizeof(reply));
+    printf("Missing capture: '%s' (should be an error)\n", reply);
+    request(fd, "process calibration_raw=output/test_daemon_calibration.raw "
+                "measurement_raw=output/test_daemon_measurement.raw", reply, sizeof(reply));
+    printf("Raw job without sweep: '%s' (should be an error)\n", reply);
+    request(fd, "process calibration_raw=output/test_daemon_calibration.raw "
+                "measurement=output/test_daemon_measurement.wav sample_rate=16000 start_freq=100 "
+                "end_freq=4000 duration=4", reply, sizeof(reply));
+    printf("Raw calibration, WAV measurement: '%s' (should be an error)\n", reply);
+    request(fd, "process calibration=output/test_daemon_calibration.wav "
+                "measurement_raw=output/test_daemon_measurement.raw", reply, sizeof(reply));
+    printf("WAV calibration, raw measurement: '%s' (should be an error)\n", reply);
+    request(fd, "resample", reply, sizeof(reply));
+    printf("Unknown request: '%s' (should be an error)\n", reply);
+
+    request(fd, "shutdown", reply, sizeof(reply));
+    printf("shutdown: '%s'\n", reply);
+    close(fd);
+
+    int status = 0;
+    waitpid(pid, &status, 0);
+    printf("Daemon exit status %d (should be 0), socket removed: %s\n",
+           WIFEXITED(status) ? WEXITSTATUS(status) : -1, access(TEST_SOCKET, F_OK) != 0 ? "yes" : "no");
+
+    remove("output/test_daemon_calibration.wav");
+    remove("output/test_daemon_measurement.wav");
+    remove("output/test_daemon_calibration.raw");
+    remove("output/test_daemon_measurement.raw");
+    remove("output/test_daemon_other.wav");
+}
+
+int main(void) {
+    test_daemon();
+    return 0;
+}
@@ -0,0 +1,221 @@
+#include "decimate.h"
+#include "processing.h"
+#include "test_signals.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ECHO_FIRST 8  /* Echo system 0.5 z^-ECHO_FIRST + 0.25 z^-(ECHO_FIRST + ECHO_DELAY) at 48 kHz, */
+#define ECHO_DELAY 36  /* both multiples of 4 so it has the same response at 12 kHz */
+#define CAPTURE_TAIL_S 0.25 /* Silence recorded after the sweep, so the echo is not cut off */
+
+/* Decimates x (n samples at fs) by up / down into a new array of *n_out samples */
+static float *decimate_array(const float *x, int n, double fs, int up, int down, double f_pass, int *n_out,
+                             int *num_taps) {
+    MemorySource src = { x, n, 0 };
+    Decimator d;
+    if (decimator_init(&d, up, down, fs, f_pass, memory_source, &src, n) != 0) {
+        return NULL;
+    }
+    *n_out = (int)decimator_output_length(&d);
+    *num_taps = d.num_taps;
+    float *y = (float*)malloc(sizeof(float) * *n_out);
+    /* Odd-sized reads, to cross block boundaries */
+    for (int first = 0; y && first < *n_out; first += 4999) {
+        int count = *n_out - first < 4999 ? *n_out - first : 4999;
+        if (decimator_read(&d, first, count, y + first) != 0) {
+            free(y);
+            y = NULL;
+        }
+    }
+    decimator_free(&d);
+    return y;
+}
+
+/* The echo system on x, with its delays divided by factor */
+static void echo(float *y, const float *x, int n, int factor) {
+    int d1 = ECHO_FIRST / factor, d2 = (ECHO_FIRST + ECHO_DELAY) / factor;
+    for (int i = 0; i < n; i++) {
+        y[i] = (i >= d1 ? 0.5f * x[i - d1] : 0.0f) + (i >= d2 ? 0.25f * x[i - d2] : 0.0f);
+    }
+}
+
+/* Output level of a unit sine at f after decimation, in dB, and its largest error against the ideal output (dB) */
+static void sine_response(double fs, int up, int down, double f_pass, double f, double *gain_db, double *error_db) {
+    int n = (int)fs;
+    float *x = (float*)malloc(sizeof(float) * n);
+    for (int i = 0; i < n; i++) {
+        x[i] = (float)sin(2.0 * M_PI * f * i / fs);
+    }
+    int n_out, taps;
+    float *y = decimate_array(x, n, fs, up, down, f_pass, &n_out, &taps);
+    if (!y) {
+        free(x);
+        *gain_db = *error_db = 0.0;
+        return;
+    }
+
+    /* Away from the edges, where the filter sees the zero padding */
+    double fs_out = fs * up / down;
+    double power = 0.0, max_error = 0.0;
+    int from = n_out / 4, to = 3 * n_out / 4;
+    for (int m = from; m < to; m++) {
+        power += (double)y[m] * y[m];
+        double ideal = f < fs_out / 2.0 ? sin(2.0 * M_PI * f * m / fs_out) : 0.0;
+        double e = fabs(y[m] - ideal);
+        if (e > max_error) max_error = e;
+    }
+    *gain_db = 10.0 * log10(2.0 * power / (to - from) + 1e-300);
+    *error_db = 20.0 * log10(max_error + 1e-300);
+    free(x);
+    free(y);
+}
+
+/* H_lips of an open/closed capture pair of n samples, as processing mode computes it */
+static int chain_h_lips(kiss_fft_cpx *h, const float *open, const float *closed, int n, double fs, float f0, float f1,
+                        float T) {
+    int nfft = calculate_next_power_of_two(n);
+    kiss_fft_cpx *inv_filter = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * nfft);
+    kiss_fft_cpx *buf_open = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * nfft);
+    kiss_fft_cpx *buf_closed = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * nfft);
+    kiss_fft_scalar *epsilon = (kiss_fft_scalar*)malloc(sizeof(kiss_fft_scalar) * nfft);
+    kiss_fft_cfg cfg_fwd = kiss_fft_alloc(nfft, 0, NULL, NULL);
+    kiss_fft_cfg cfg_inv = kiss_fft_alloc(nfft, 1, NULL, NULL);
+    int ret = -1;
+    if (inv_filter && buf_open && buf_closed && epsilon && cfg_fwd && cfg_inv) {
+        generate_inverse_filter(inv_filter, 0.5f, f0, f1, T, (float)fs, nfft, 1);
+        int npre, npost;
+        linear_ir_window(f0, f1, T, fs, &npre, &npost);
+        kiss_fft_cpx *bufs[2] = { buf_open, buf_closed };
+        const float *x[2] = { open, closed };
+        for (int c = 0; c < 2; c++) {
+            for (int i = 0; i < nfft; i++) {
+                bufs[c][i].r = i < n ? x[c][i] : 0.0f;
+                bufs[c][i].i = 0.0f;
+            }
+            kiss_fft(cfg_fwd, bufs[c], bufs[c]);
+            perform_deconvolution(bufs[c], inv_filter, nfft);
+            extract_linear_ir(bufs[c], cfg_inv, cfg_fwd, nfft, n, npre, npost, fs, 0);
+        }
+        generate_epsilon(epsilon, f0, f1, (float)fs, nfft);
+        compute_h_lips(h, buf_open, buf_closed, epsilon, nfft);
+        ret = 0;
+    }
+    free(inv_filter);
+    free(buf_open);
+    free(buf_closed);
+    free(epsilon);
+    kiss_fft_free(cfg_fwd);
+    kiss_fft_free(cfg_inv);
+    return ret;
+}
+
+void test_decimate(void) {
+    printf("--- DECIMATION TEST ---\n");
+
+    /* Factor choice */
+    int up, down;
+    int lowered = decimation_factor(48000.0, 3000.0 * pow(2.0, 1.0 / 3.0), &up, &down);
+    printf("48000 Hz keeping 3780 Hz: %d/%d (should be 1/5), lowered %d\n", up, down, lowered);
+    decimation_factor(44100.0, 5000.0, &up, &down);
+    printf("44100 Hz keeping 5000 Hz: %d/%d -> %.0f Hz (should be 2/7 -> 12600 Hz)\n", up, down, 44100.0 * up / down);
+    lowered = decimation_factor(44100.0, 20000.0, &up, &down);
+    printf("44100 Hz keeping 20000 Hz: %d/%d, lowered %d (should be 1/1, 0)\n", up, down, lowered);
+    Decimator rejected;
+    printf("1/4 at 48000 Hz keeping 6000 Hz: init %d (should be -1)\n",
+           decimator_init(&rejected, 1, 4, 48000.0, 6000.0, memory_source, NULL, 0));
+
+    /* Pass band and aliasing */
+    double gain, error;
+    sine_response(48000.0, 1, 4, 4000.0, 1000.0, &gain, &error);
+    printf("1/4, 1000 Hz sine: gain %.4f dB (should be 0), error %.1f dB\n", gain, error);
+    sine_response(48000.0, 1, 4, 4000.0, 3900.0, &gain, &error);
+    printf("1/4, 3900 Hz sine: gain %.4f dB (should be 0), error %.1f dB\n", gain, error);
+    sine_response(48000.0, 1, 4, 4000.0, 10000.0, &gain, &error);
+    printf("1/4, 10000 Hz sine (aliases to 2000 Hz): %.1f dB (should be below -%.0f)\n", gain,
+           DECIMATION_ATTENUATION_DB - 10.0);
+    sine_response(44100.0, 2, 7, 5000.0, 4000.0, &gain, &error);
+    printf("2/7, 4000 Hz sine: gain %.4f dB (should be 0), error %.1f dB\n", gain, error);
+    sine_response(44100.0, 2, 7, 5000.0, 9000.0, &gain, &error);
+    printf("2/7, 9000 Hz sine (aliases to 3600 Hz): %.1f dB (should be below -%.0f)\n", gain,
+           DECIMATION_ATTENUATION_DB - 10.0);
+
+    /* Whole chain at 48 kHz, decimated to 12 kHz, and natively at 12 kHz: bins line up (same bin width) */
+    const double fs = 48000.0;
+    const float f0 = 50.0f, f1 = 3000.0f, T = 4.0f;
+    const int factor = 4;
+    double fs_dec = fs / factor;
+    int n = (int)(fs * (T + CAPTURE_TAIL_S));
+    int n_native = (int)(fs_dec * (T + CAPTURE_TAIL_S));
+    int nfft = calculate_next_power_of_two(n);
+    float *closed = (float*)calloc(n, sizeof(float));
+    float *open = (float*)malloc(sizeof(float) * n);
+    float *closed_native = (float*)calloc(n_native, sizeof(float));
+    float *open_native = (float*)malloc(sizeof(float) * n_native);
+    kiss_fft_cpx *h_full = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * nfft);
+    kiss_fft_cpx *h_dec = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * nfft);
+    kiss_fft_cpx *h_native = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * nfft);
+    if (!closed || !open || !closed_native || !open_native || !h_full || !h_dec || !h_native) {
+        fprintf(stderr, "Failed to allocate test buffers\n");
+        return;
+    }
+    generate_chirp(closed, 0.5f, f0, f1, T, (float)fs, 1, 0.0f, 0.0f);
+    echo(open, closed, n, 1);
+    generate_chirp(closed_native, 0.5f, f0, f1, T, (float)fs_dec, 1, 0.0f, 0.0f);
+    echo(open_native, closed_native, n_native, factor);
+
+    double f_pass = f1 * pow(2.0, 1.0 / 3.0);
+    int n_dec, taps;
+    float *closed_dec = decimate_array(closed, n, fs, 1, factor, f_pass, &n_dec, &taps);
+    float *open_dec = decimate_array(open, n, fs, 1, factor, f_pass, &n_dec, &taps);
+    int nfft_dec = calculate_next_power_of_two(n_dec);
+    if (!closed_dec || !open_dec || chain_h_lips(h_full, open, closed, n, fs, f0, f1, T) != 0
+        || chain_h_lips(h_dec, open_dec, closed_dec, n_dec, fs_dec, f0, f1, T) != 0
+        || chain_h_lips(h_native, open_native, closed_native, n_native, fs_dec, f0, f1, T) != 0) {
+        fprintf(stderr, "Chain failed\n");
+        return;
+    }
+    printf("Chain: %.0f Hz, nfft %d; decimated 1/%d (%d taps per output): %.0f Hz, nfft %d\n", fs, nfft, factor, taps,
+           fs_dec, nfft_dec);
+    printf("  FFT buffers: %.1f MiB -> %.1f MiB (%.0fx less)\n", 3.0 * nfft * sizeof(kiss_fft_cpx) / 1048576.0,
+           3.0 * nfft_dec * sizeof(kiss_fft_cpx) / 1048576.0, (double)nfft / nfft_dec);
+
+    /* Over [1.5 f0, f1 / 1.5]: decimated against native, and each against the echo system */
+    int first = (int)ceil(1.5 * f0 * nfft / fs);
+    int last = (int)floor(f1 / 1.5 * nfft / fs);
+    double max_rel = 0.0, max_deg = 0.0, err_full = 0.0, err_dec = 0.0, err_native = 0.0, ref2 = 0.0;
+    for (int k = first; k <= last; k++) {
+        double w = 2.0 * M_PI * k / nfft;
+        double ref_r = 0.5 * cos(ECHO_FIRST * w) + 0.25 * cos((ECHO_FIRST + ECHO_DELAY) * w);
+        double ref_i = -0.5 * sin(ECHO_FIRST * w) - 0.25 * sin((ECHO_FIRST + ECHO_DELAY) * w);
+        double ar = h_dec[k].r, ai = h_dec[k].i, br = h_native[k].r, bi = h_native[k].i;
+        double rel = hypot(ar - br, ai - bi) / hypot(br, bi);
+        if (rel > max_rel) max_rel = rel;
+        double deg = fabs(atan2(ai * br - ar * bi, ar * br + ai * bi)) * 180.0 / M_PI;
+        if (deg > max_deg) max_deg = deg;
+        err_full += (h_full[k].r - ref_r) * (h_full[k].r - ref_r) + (h_full[k].i - ref_i) * (h_full[k].i - ref_i);
+        err_dec += (ar - ref_r) * (ar - ref_r) + (ai - ref_i) * (ai - ref_i);
+        err_native += (br - ref_r) * (br - ref_r) + (bi - ref_i) * (bi - ref_i);
+        ref2 += ref_r * ref_r + ref_i * ref_i;
+    }
+    printf("  %d bins from %.0f to %.0f Hz: decimated vs native %.0f Hz at most %.1f dB, %.3f degrees apart\n",
+           last - first + 1, first * fs / nfft, last * fs / nfft, fs_dec, 20.0 * log10(max_rel), max_deg);
+    printf("  Error against the echo system: %.1f dB decimated, %.1f dB native (should be about equal), "
+           "%.1f dB at %.0f Hz\n", 10.0 * log10(err_dec / ref2), 10.0 * log10(err_native / ref2),
+           10.0 * log10(err_full / ref2), fs);
+
+    free(closed);
+    free(open);
+    free(closed_native);
+    free(open_native);
+    free(closed_dec);
+    free(open_dec);
+    free(h_full);
+    free(h_dec);
+    free(h_native);
+}
+
+int main(void) {
+    test_decimate();
+    return 0;
+}
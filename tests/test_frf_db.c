@@ -0,0 +1,188 @@
+#define _POSIX_C_SOURCE 200809L
+#include "frf_db.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#define TEST_DB_DIR "output/test_frf_db"
+#define TEST_POINTS 300
+#define TEST_WRITERS 4
+#define TEST_WRITER_ENTRIES 25
+
+/* Fills the three arrays with values that identify the entry */
+static void fill_spectra(kiss_fft_cpx *spectra, int n, int id) {
+    for (int a = 0; a < FRF_NUM_ARRAYS; a++) {
+        for (int k = 0; k < n; k++) {
+            spectra[a * n + k].r = (float)(id * 1000 + a * 100) + k * 0.25f;
+            spectra[a * n + k].i = (float)-id;
+        }
+    }
+}
+
+static void make_entry(FrfDbEntry *entry, int id, const char *subject, const char *session, int64_t timestamp) {
+    memset(entry, 0, sizeof(*entry));
+    entry->key = 0x1000 + (StoreKey)id;
+    entry->timestamp = timestamp;
+    snprintf(entry->subject, sizeof(entry->subject), "%s", subject);
+    snprintf(entry->session, sizeof(entry->session), "%s", session);
+    entry->info.sample_rate = 48000.0;
+    entry->info.nfft = 1 << 17;
+    entry->info.chirp.start_freq = 100.0f;
+    entry->info.chirp.end_freq = 2000.0f;
+    entry->info.chirp.duration = 10.0f;
+    entry->info.chirp.type = 1;
+    entry->info.grid.type = FRF_GRID_LOG;
+    entry->info.grid.f_min = 80.0;
+    entry->info.grid.f_max = 2500.0;
+    entry->info.grid.num_points = TEST_POINTS;
+}
+
+void test_frf_db(void) {
+    char path[STORE_PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s", TEST_DB_DIR, FRF_DB_INDEX_FILE);
+    remove(path);
+    snprintf(path, sizeof(path), "%s/%s", TEST_DB_DIR, FRF_DB_DATA_FILE);
+    remove(path);
+    snprintf(path, sizeof(path), "%s/%s", TEST_DB_DIR, FRF_DB_KEYS_FILE);
+    remove(path);
+
+    kiss_fft_cpx *spectra = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * TEST_POINTS * FRF_NUM_ARRAYS);
+    if (!spectra) {
+        fprintf(stderr, "Failed to allocate spectra\n");
+        return;
+    }
+
+    printf("--- FRF DATABASE TEST ---\n");
+
+    /* Two subjects, two sessions, increasing timestamps */
+    const char *subjects[] = { "s01", "s02", "s01", "s02", "s01" };
+    const char *sessions[] = { "a", "a", "b", "b", "b" };
+    int added = 0;
+    for (int id = 0; id < 5; id++) {
+        FrfDbEntry entry;
+        make_entry(&entry, id, subjects[id], sessions[id], 1700000000 + id * 3600);
+        fill_spectra(spectra, TEST_POINTS, id);
+        frf_db_quality(&entry.info, spectra, spectra + TEST_POINTS, spectra + 2 * TEST_POINTS, &entry.quality);
+        if (frf_db_append(TEST_DB_DIR, &entry, spectra, spectra + TEST_POINTS, spectra + 2 * TEST_POINTS) == 0) {
+            added++;
+        }
+    }
+    FrfDbEntry again;
+    make_entry(&again, 2, "s01", "b", 1700000000);
+    int duplicate = frf_db_append(TEST_DB_DIR, &again, spectra, spectra + TEST_POINTS, spectra + 2 * TEST_POINTS);
+    printf("Appended %d of 5 entries (should be 5), duplicate append returned %d (should be 1)\n", added, duplicate);
+
+    /* A torn trailing record, as left by an interrupted append */
+    snprintf(path, sizeof(path), "%s/%s", TEST_DB_DIR, FRF_DB_INDEX_FILE);
+    FILE *index = fopen(path, "ab");
+    if (index) {
+        fwrite("torn", 1, 4, index);
+        fclose(index);
+    }
+
+    FrfDb db;
+    if (frf_db_open(&db, TEST_DB_DIR) != 0) {
+        fprintf(stderr, "Failed to open %s (does output/ exist?)\n", TEST_DB_DIR);
+        free(spectra);
+        return;
+    }
+    printf("Opened database: %zu entries (should be 5)\n", db.num_entries);
+
+    const FrfDbEntry *results[8];
+    FrfDbQuery by_subject = { "s01", NULL, 0, 0 };
+    FrfDbQuery by_session = { NULL, "b", 0, 0 };
+    FrfDbQuery by_time = { "s02", NULL, 1700000000 + 3600, 1700000000 + 3 * 3600 };
+    FrfDbQuery none = { "s03", NULL, 0, 0 };
+    size_t n_subject = frf_db_query(&db, &by_subject, results, 8);
+    size_t n_session = frf_db_query(&db, &by_session, NULL, 0);
+    size_t n_time = frf_db_query(&db, &by_time, results, 8);
+    size_t n_none = frf_db_query(&db, &none, NULL, 0);
+    printf("Query subject s01: %zu (should be 3), session b: %zu (should be 3), "
+           "s02 in time range: %zu (should be 2), s03: %zu (should be 0)\n", n_subject, n_session, n_time, n_none);
+
+    /* Spectra come straight from the mapping and match what was appended */
+    double max_err = 0.0;
+    int aligned = 1;
+    for (size_t i = 0; i < db.num_entries; i++) {
+        const FrfDbEntry *e = &db.entries[i];
+        int id = (int)(e->key - 0x1000);
+        fill_spectra(spectra, TEST_POINTS, id);
+        for (int a = 0; a < FRF_NUM_ARRAYS; a++) {
+            const float_cpx *stored = frf_db_array(&db, e, (FrfArray)a);
+            aligned &= ((uintptr_t)stored % sizeof(float_cpx)) == 0;
+            for (int k = 0; k < TEST_POINTS; k++) {
+                double err = fabs(stored[k].r - spectra[a * TEST_POINTS + k].r)
+                             + fabs(stored[k].i - spectra[a * TEST_POINTS + k].i);
+                if (err > max_err) max_err = err;
+            }
+        }
+    }
+    printf("Mapped spectra: max error %.3g (should be 0), aligned %s\n", max_err, aligned ? "yes" : "no");
+
+    /* Frequency range within one entry */
+    int first = 0;
+    int count = frf_db_point_range(&db.entries[0], 500.0, 1000.0, &first);
+    double f_first = frf_grid_frequency(&db.entries[0].info.grid, first);
+    double f_last = frf_grid_frequency(&db.entries[0].info.grid, first + count - 1);
+    int below = first > 0 ? frf_grid_frequency(&db.entries[0].info.grid, first - 1) < 500.0 : 1;
+    printf("Points in 500-1000 Hz: %d (%.1f-%.1f Hz, bounds %s)\n", count, f_first, f_last,
+           (below && f_first >= 500.0 && f_last <= 1000.0) ? "ok" : "WRONG");
+
+    printf("Quality of entry 0: peak %.2f dB at %.1f Hz, open %.2f dB, closed %.2f dB\n",
+           db.entries[0].quality.peak_db, db.entries[0].quality.peak_freq,
+           db.entries[0].quality.open_level_db, db.entries[0].quality.closed_level_db);
+
+    frf_db_close(&db);
+
+    /* The key table is derived from the index: without it, duplicates are still found */
+    snprintf(path, sizeof(path), "%s/%s", TEST_DB_DIR, FRF_DB_KEYS_FILE);
+    remove(path);
+    fill_spectra(spectra, TEST_POINTS, 2);
+    duplicate = frf_db_append(TEST_DB_DIR, &again, spectra, spectra + TEST_POINTS, spectra + 2 * TEST_POINTS);
+    printf("Duplicate append after deleting the key table returned %d (should be 1)\n", duplicate);
+
+    /* Several processes appending at once take turns on the index lock */
+    for (int w = 0; w < TEST_WRITERS; w++) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            int failures = 0;
+            for (int i = 0; i < TEST_WRITER_ENTRIES; i++) {
+                int id = 100 + w * TEST_WRITER_ENTRIES + i;
+                FrfDbEntry entry;
+                make_entry(&entry, id, "s03", "c", 1700100000 + id);
+                fill_spectra(spectra, TEST_POINTS, id);
+                failures += frf_db_append(TEST_DB_DIR, &entry, spectra, spectra + TEST_POINTS,
+                                          spectra + 2 * TEST_POINTS) != 0;
+            }
+            _exit(failures ? 1 : 0);
+        }
+    }
+    int writer_failures = 0;
+    for (int w = 0; w < TEST_WRITERS; w++) {
+        int status = 0;
+        if (wait(&status) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) writer_failures++;
+    }
+
+    int intact = 0;
+    if (frf_db_open(&db, TEST_DB_DIR) == 0) {
+        for (size_t i = 0; i < db.num_entries; i++) {
+            const FrfDbEntry *e = &db.entries[i];
+            int id = (int)(e->key - 0x1000);
+            const float_cpx *closed = frf_db_array(&db, e, FRF_ARRAY_CLOSED);
+            fill_spectra(spectra, TEST_POINTS, id);
+            intact += closed[TEST_POINTS - 1].r == spectra[3 * TEST_POINTS - 1].r;
+        }
+        frf_db_close(&db);
+    }
+    printf("%d processes appending %d entries each: %d failed (should be 0), %d entries intact (should be %d)\n",
+           TEST_WRITERS, TEST_WRITER_ENTRIES, writer_failures, intact, 5 + TEST_WRITERS * TEST_WRITER_ENTRIES);
+    free(spectra);
+}
+
+int main(void) {
+    test_frf_db();
+    return 0;
+}
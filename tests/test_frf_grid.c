@@ -0,0 +1,93 @@
+#include "frf_grid.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+
+/* Smooth resonance-like test spectrum, evaluated at any frequency */
+static kiss_fft_cpx resonance(double f) {
+    double f0 = 600.0, q = 8.0;
+    double x = f / f0 - f0 / (f + 1e-9);
+    double denom = 1.0 + q * q * x * x;
+    kiss_fft_cpx z;
+    z.r = (float)(1.0 / denom);
+    z.i = (float)(-q * x / denom);
+    return z;
+}
+
+void test_frf_grid(void) {
+    double fs = 44100.0;
+    int nfft = 1 << 16;
+    int num_bins = nfft / 2;
+    double bin_hz = fs / nfft;
+
+    kiss_fft_cpx *bins = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * num_bins);
+    kiss_fft_cpx *out = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * num_bins);
+    if (!bins || !out) {
+        fprintf(stderr, "Failed to allocate spectrum buffers\n");
+        free(bins);
+        free(out);
+        return;
+    }
+    for (int k = 0; k < num_bins; k++) {
+        bins[k] = resonance(k * bin_hz);
+    }
+
+    printf("--- FRF GRID TEST ---\n");
+
+    /* Band-limited bins: exact copy of the band */
+    FrfGrid band;
+    int first = frf_grid_band_bins(&band, 200.0 / pow(2.0, FRF_BAND_MARGIN_OCTAVES),
+                                   1200.0 * pow(2.0, FRF_BAND_MARGIN_OCTAVES), fs, nfft);
+    frf_resample(bins, num_bins, bin_hz, &band, out);
+    double max_err = 0.0;
+    for (int k = 0; k < band.num_points; k++) {
+        double err = fabs(out[k].r - bins[first + k].r) + fabs(out[k].i - bins[first + k].i);
+        if (err > max_err) max_err = err;
+    }
+    printf("Band bins: %d of %d (%.1fx smaller), %.1f-%.1f Hz, max error %.3g (should be ~0)\n",
+           band.num_points, num_bins, (double)num_bins / band.num_points, band.f_min, band.f_max, max_err);
+
+    /* Log grid finer than the bins at low frequency: cubic interpolation */
+    FrfGrid log_grid = { FRF_GRID_LOG, 200.0, 1200.0, 2000 };
+    frf_resample(bins, num_bins, bin_hz, &log_grid, out);
+    max_err = 0.0;
+    for (int k = 0; k < log_grid.num_points; k++) {
+        kiss_fft_cpx ref = resonance(frf_grid_frequency(&log_grid, k));
+        double err = fabs(out[k].r - ref.r) + fabs(out[k].i - ref.i);
+        if (err > max_err) max_err = err;
+    }
+    printf("Log grid (%d points, 200-1200 Hz): max interpolation error %.3g (should be < 1e-4)\n",
+           log_grid.num_points, max_err);
+
+    /* A slice of the log grid keeps the frequencies of its points */
+    FrfGrid slice;
+    frf_grid_slice(&slice, &log_grid, 500, 1000);
+    max_err = 0.0;
+    for (int k = 0; k < slice.num_points; k++) {
+        double err = fabs(frf_grid_frequency(&slice, k) - frf_grid_frequency(&log_grid, 500 + k));
+        if (err > max_err) max_err = err;
+    }
+    printf("Slice of points 500-1499: max frequency difference %.3g Hz (should be < 1e-9)\n", max_err);
+
+    /* Coarse linear grid: cell averages of a constant spectrum stay constant */
+    for (int k = 0; k < num_bins; k++) {
+        bins[k].r = 1.0f;
+        bins[k].i = -0.5f;
+    }
+    FrfGrid coarse = { FRF_GRID_LINEAR, 100.0, 20000.0, 50 };
+    frf_resample(bins, num_bins, bin_hz, &coarse, out);
+    max_err = 0.0;
+    for (int k = 0; k < coarse.num_points; k++) {
+        double err = fabs(out[k].r - 1.0) + fabs(out[k].i + 0.5);
+        if (err > max_err) max_err = err;
+    }
+    printf("Coarse grid (%d points): max averaging error %.3g (should be ~0)\n", coarse.num_points, max_err);
+
+    free(bins);
+    free(out);
+}
+
+int main(void) {
+    test_frf_grid();
+    return 0;
+}
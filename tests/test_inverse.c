@@ -3,6 +3,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <math.h>
+#include <string.h>
 
 void test_inverse_filter_quality(void) {
     int nfft = 131072;
@@ -35,8 +36,22 @@ void test_inverse_filter_quality(void) {
     // 3. Generate Inverse Filter
     generate_inverse_filter(inv_filter, A, f0, f1, T, fs, nfft, 0); // 0 = linear
 
-    // 4. Perform Deconvolution (Multiply in Freq Domain)
-    perform_deconvolution(chirp_spectrum, inv_filter, nfft);
+    // 4. Perform Deconvolution (Multiply in Freq Domain), over the sweep band only
+    kiss_fft_cpx *full_band = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * nfft);
+    memcpy(full_band, chirp_spectrum, sizeof(kiss_fft_cpx) * nfft);
+    perform_deconvolution(full_band, inv_filter, nfft);
+
+    int band_bins;
+    int band_first = sweep_band_bins(f0, f1, fs, nfft, &band_bins);
+    perform_deconvolution_bins(chirp_spectrum, inv_filter, nfft, band_first, band_bins);
+
+    int mismatches = 0;
+    for (int k = 0; k < nfft; k++) {
+        if (chirp_spectrum[k].r != full_band[k].r || chirp_spectrum[k].i != full_band[k].i) {
+            mismatches++;
+        }
+    }
+    free(full_band);
 
     // 5. Inverse FFT to get Impulse Response
     kiss_fft(cfg_inv, chirp_spectrum, time_result);
@@ -63,6 +78,8 @@ void test_inverse_filter_quality(void) {
     // Check width of peak (should be sharp)
     float side_val = fabs(time_result[(max_idx + 1) % nfft].r);
     printf("Side Lobe Level: %f (Should be small)\n", side_val);
+    printf("Band-limited deconvolution: %d of %d bins computed, %d differ from all bins (Should be 0)\n",
+           2 * band_bins, nfft, mismatches);
 
     free(chirp_spectrum); 
     free(inv_filter); 
@@ -72,7 +89,47 @@ void test_inverse_filter_quality(void) {
     kiss_fft_free(cfg_inv);
 }
 
+/*
+ * The pre-window of the linear IR holds its negative lags, which the
+ * inverse FFT leaves at the end of all nfft samples, not of the chirp.
+ */
+void test_linear_ir_negative_lags(void) {
+    int nfft = 4096;
+    int n_samples_chirp = 3000; /* Not a power of two */
+    int nimp_pre = 400, nimp_post = 400;
+    int lag = 300;              /* In the fade-in of the pre-window, where it is 0.5 */
+    double fs = 16000.0;
+
+    kiss_fft_cpx *spectrum = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * nfft);
+    kiss_fft_cfg cfg_fwd = kiss_fft_alloc(nfft, 0, NULL, NULL);
+    kiss_fft_cfg cfg_inv = kiss_fft_alloc(nfft, 1, NULL, NULL);
+
+    // Spectrum of a unit impulse at lag -lag, scaled for the unnormalized inverse FFT
+    for (int k = 0; k < nfft; k++) {
+        double phase = 2.0 * M_PI * k * lag / nfft;
+        spectrum[k].r = (float)(cos(phase) / nfft);
+        spectrum[k].i = (float)(sin(phase) / nfft);
+    }
+    extract_linear_ir(spectrum, cfg_inv, cfg_fwd, nfft, n_samples_chirp, nimp_pre, nimp_post, fs, 0);
+
+    // Windowed and advanced by nimp_pre: 0.5 exp(2j pi k lag / nfft) on every bin up to Nyquist
+    double max_err = 0.0;
+    for (int k = 1; k < nfft / 2; k++) {
+        double phase = 2.0 * M_PI * k * lag / nfft;
+        double err = hypot(spectrum[k].r - 0.5 * cos(phase), spectrum[k].i - 0.5 * sin(phase));
+        if (err > max_err) max_err = err;
+    }
+    printf("--- LINEAR IR NEGATIVE LAGS TEST ---\n");
+    printf("Impulse at lag -%d, chirp of %d samples, nfft %d: error %.2e (Should be below 1e-4)\n", lag,
+           n_samples_chirp, nfft, max_err);
+
+    free(spectrum);
+    kiss_fft_free(cfg_fwd);
+    kiss_fft_free(cfg_inv);
+}
+
 int main() {
     test_inverse_filter_quality();
+    test_linear_ir_negative_lags();
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,219 @@
+#include "live_frf.h"
+#include "live_frames.h"
+#include "processing.h"
+#include "test_signals.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FS 48000.0
+#define PERIOD 4096
+#define START_FREQ 100.0f
+#define END_FREQ 16000.0f
+#define AMPLITUDE 0.5f
+#define NOISE_LEVEL 0.01 /* Uniform noise added to the recording in the smoothing case */
+#define FRAME_FILE "output/test_live_frf.bin"
+
+static const Tap CLOSED_TAPS[] = { { 0, 0.1 }, { 20, 0.5 }, { 40, 0.1 } };
+static const Tap OPEN_TAPS[] = { { 0, 0.8 }, { 30, 0.3 }, { 57, -0.1 } };
+#define NUM_TAPS 3
+
+/* Steady-state period of the periodic excitation x through the taps, delayed by shift */
+static void record_period(float *y, const float *x, const Tap *taps, int shift, double noise_level, unsigned *state) {
+    for (int i = 0; i < PERIOD; i++) {
+        double s = 0.0;
+        for (int t = 0; t < NUM_TAPS; t++) {
+            s += taps[t].gain * x[((i - taps[t].delay - shift) % PERIOD + PERIOD) % PERIOD];
+        }
+        y[i] = (float)(s + noise_level * noise(state));
+    }
+}
+
+/* Largest level (dB) difference of a against ref over n points */
+static double level_error_db(const kiss_fft_cpx *a, const kiss_fft_cpx *ref, int n) {
+    double worst = 0.0;
+    for (int j = 0; j < n; j++) {
+        double d = fabs(20.0 * log10((hypot(a[j].r, a[j].i) + 1e-300) / (hypot(ref[j].r, ref[j].i) + 1e-300)));
+        if (d > worst) worst = d;
+    }
+    return worst;
+}
+
+/* Largest distance of a from ref relative to ref over n points */
+static double relative_error(const kiss_fft_cpx *a, const kiss_fft_cpx *ref, int n) {
+    double worst = 0.0;
+    for (int j = 0; j < n; j++) {
+        double d = hypot(a[j].r - ref[j].r, a[j].i - ref[j].i) / hypot(ref[j].r, ref[j].i);
+        if (d > worst) worst = d;
+    }
+    return worst;
+}
+
+static void excitation_case(LiveExcitation type, const char *label) {
+    float x[PERIOD];
+    LiveEstimator est;
+    if (live_estimator_init(&est, x, PERIOD, FS, START_FREQ, END_FREQ, AMPLITUDE, type, 0.0) != 0) {
+        printf("%s: init failed\n", label);
+        return;
+    }
+    double peak = 0.0, power = 0.0;
+    for (int i = 0; i < PERIOD; i++) {
+        if (fabs(x[i]) > peak) peak = fabs(x[i]);
+        power += (double)x[i] * x[i];
+    }
+    double lo = 1e300, hi = 0.0;
+    for (int j = 0; j < est.num_bins; j++) {
+        double m = hypot(est.excitation[j].r, est.excitation[j].i);
+        if (m < lo) lo = m;
+        if (m > hi) hi = m;
+    }
+    printf("%s: bins %d to %d, peak %.4f, crest factor %.2f, |X| spread %.4f dB\n", label, est.first_bin,
+           est.first_bin + est.num_bins - 1, peak, peak / sqrt(power / PERIOD), 20.0 * log10(hi / lo));
+    live_estimator_free(&est);
+}
+
+static void test_live_frf(void) {
+    printf("Testing periodic live FRF estimation (%d-sample period at %.0f Hz)\n\n", PERIOD, FS);
+
+    /* Excitation */
+    excitation_case(LIVE_EXCITATION_CHIRP, "Chirp");
+    excitation_case(LIVE_EXCITATION_MULTISINE, "Multisine");
+    printf("  (peaks should be %.4f, spreads below 0.01 dB; the chirp's crest factor below 2, "
+           "the multisine's about twice that)\n", AMPLITUDE);
+    printf("Default period at 48 kHz: %d (should be 4096), at 192 kHz: %d (should be 16384)\n\n",
+           live_default_period(48000.0), live_default_period(192000.0));
+
+    float x[PERIOD], y[PERIOD];
+    LiveEstimator est;
+    if (live_estimator_init(&est, x, PERIOD, FS, START_FREQ, END_FREQ, AMPLITUDE, LIVE_EXCITATION_CHIRP, 0.0) != 0) {
+        printf("init failed\n");
+        return;
+    }
+    int n = est.num_bins;
+    kiss_fft_cpx *expected = (kiss_fft_cpx*)calloc(n, sizeof(kiss_fft_cpx));
+    kiss_fft_cpx *h_lips = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * n);
+    unsigned state = 1;
+
+    /* Loop latency: the largest tap of the open system, plus the shift */
+    record_period(y, x, OPEN_TAPS, 1000, 0.0, &state);
+    printf("Delay: %d (should be 1000)\n", live_estimator_delay(&est, y));
+    record_period(y, x, CLOSED_TAPS, 4000, 0.0, &state);
+    printf("Delay across the period boundary: %d (should be %d)\n\n", live_estimator_delay(&est, y),
+           (4000 + 20) % PERIOD);
+
+    /* Calibration fold: an IR longer than the period, 50 samples of it before the linear IR */
+    int ir_len = PERIOD + 1500, nimp_pre = 50;
+    kiss_fft_cpx *ir = (kiss_fft_cpx*)calloc(ir_len, sizeof(kiss_fft_cpx));
+    for (int i = 0; i < ir_len; i++) {
+        ir[i].r = (kiss_fft_scalar)(exp(-(double)abs(i - nimp_pre) / 800.0) * cos(0.05 * i));
+    }
+    live_estimator_set_calibration(&est, ir, ir_len, nimp_pre, 2.0);
+    for (int j = 0; j < n; j++) {
+        double re = 0.0, im = 0.0;
+        for (int i = 0; i < ir_len; i++) {
+            double w = -2.0 * M_PI * (double)(est.first_bin + j) * (i - nimp_pre) / PERIOD;
+            re += 2.0 * ir[i].r * cos(w);
+            im += 2.0 * ir[i].r * sin(w);
+        }
+        expected[j].r = (kiss_fft_scalar)re;
+        expected[j].i = (kiss_fft_scalar)im;
+    }
+    printf("Folded calibration vs. its DFT on the excited bins: %.2e relative (should be below 1e-4)\n\n",
+           relative_error(est.closed, expected, n));
+    free(ir);
+
+    /* H_lips of two echo systems; the common latency cancels */
+    ir = (kiss_fft_cpx*)calloc(PERIOD, sizeof(kiss_fft_cpx));
+    for (int t = 0; t < NUM_TAPS; t++) {
+        ir[CLOSED_TAPS[t].delay + 10].r = (kiss_fft_scalar)CLOSED_TAPS[t].gain;
+    }
+    live_estimator_set_calibration(&est, ir, PERIOD, 0, 1.0);
+    record_period(y, x, OPEN_TAPS, 10, 0.0, &state);
+    live_estimator_add_period(&est, y);
+    live_estimator_h_lips(&est, h_lips);
+    int inner = 0;
+    for (int j = 0; j < n; j++) {
+        if (est.epsilon[est.first_bin + j] != 0.0f) continue;
+        kiss_fft_cpx o = taps_response(OPEN_TAPS, NUM_TAPS, est.first_bin + j, PERIOD);
+        kiss_fft_cpx c = taps_response(CLOSED_TAPS, NUM_TAPS, est.first_bin + j, PERIOD);
+        expected[inner] = complex_division(o, c);
+        h_lips[inner++] = h_lips[j];
+    }
+    printf("H_lips vs. the systems' ratio on %d unregularized bins: %.2e dB (should be below 0.001 dB)\n\n",
+           inner, level_error_db(h_lips, expected, inner));
+    free(ir);
+
+    /* Smoothing: one noisy period against the running average of many */
+    for (int j = 0; j < n; j++) {
+        expected[j] = taps_response(OPEN_TAPS, NUM_TAPS, est.first_bin + j, PERIOD);
+    }
+    live_estimator_free(&est);
+    live_estimator_init(&est, x, PERIOD, FS, START_FREQ, END_FREQ, AMPLITUDE, LIVE_EXCITATION_CHIRP, 0.5);
+    record_period(y, x, OPEN_TAPS, 0, NOISE_LEVEL, &state);
+    live_estimator_add_period(&est, y);
+    double single = relative_error(est.open, expected, n);
+    for (int p = 1; p < 100; p++) {
+        record_period(y, x, OPEN_TAPS, 0, NOISE_LEVEL, &state);
+        live_estimator_add_period(&est, y);
+    }
+    double averaged = relative_error(est.open, expected, n);
+    printf("Noisy open response after 1 period: %.4f, after %d with a 0.5 s time constant: %.4f relative\n", single,
+           est.periods, averaged);
+    printf("  (the average should be at least 2.5 times closer: about 30 periods' worth of noise)\n\n");
+    live_estimator_free(&est);
+    free(expected);
+    free(h_lips);
+}
+
+static void test_live_frames(void) {
+    printf("Testing the live frame file\n\n");
+    const int n = 100;
+    LiveFrames writer, reader;
+    if (live_frames_create(&writer, FRAME_FILE, n, FS, PERIOD, 9) != 0 || live_frames_open(&reader, FRAME_FILE) != 0) {
+        printf("Frame file setup failed\n");
+        return;
+    }
+    printf("Header: %d points, %.0f Hz, period %d, first bin %d (should be 100, 48000, 4096, 9)\n",
+           reader.num_points, reader.sample_rate, reader.period, reader.first_bin);
+
+    LiveFrameInfo info;
+    float_cpx *arrays = (float_cpx*)malloc(sizeof(float_cpx) * 3 * n);
+    printf("Read before any frame: %d (should be 0)\n", live_frames_read_latest(&reader, &info, arrays));
+
+    /* More frames than slots; the arrays carry the frame number */
+    kiss_fft_cpx *h = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * n);
+    const int num_frames = 2 * LIVE_FRAMES_NUM_SLOTS + 1;
+    for (int f = 0; f < num_frames; f++) {
+        for (int j = 0; j < n; j++) {
+            h[j].r = (kiss_fft_scalar)(f + 0.01 * j);
+            h[j].i = (kiss_fft_scalar)(-f);
+        }
+        LiveFrameInfo out = { (uint64_t)f, 0.1 * f, 1.5f, (uint32_t)(4 * f) };
+        live_frames_publish(&writer, &out, h, h, NULL);
+    }
+    int ok = live_frames_read_latest(&reader, &info, arrays);
+    int data_ok = 1;
+    for (int j = 0; j < n; j++) {
+        float want = (float)(num_frames - 1 + 0.01 * j);
+        if (arrays[j].r != want || arrays[n + j].r != want || arrays[j].i != -(float)(num_frames - 1)
+            || arrays[2 * n + j].r != 0.0f || arrays[2 * n + j].i != 0.0f) {
+            data_ok = 0;
+        }
+    }
+    printf("Latest: read %d, frame %llu, time %.1f s, %u periods, %.1f ms (should be 1, %d, %.1f, %d, 1.5)\n", ok,
+           (unsigned long long)info.frame, info.time, info.periods, info.process_ms, num_frames - 1,
+           0.1 * (num_frames - 1), 4 * (num_frames - 1));
+    printf("Arrays match the latest frame, closed zeroed: %s (should be yes)\n", data_ok ? "yes" : "no");
+
+    free(arrays);
+    free(h);
+    live_frames_close(&reader);
+    live_frames_close(&writer);
+    remove(FRAME_FILE);
+}
+
+int main(void) {
+    test_live_frf();
+    test_live_frames();
+    return 0;
+}
@@ -0,0 +1,314 @@
+#include "mls.h"
+#include "processing.h"
+#include "test_signals.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define FS 48000.0
+#define ORDER 14
+#define AMPLITUDE 0.5f
+#define NOISE_LEVEL 0.05     /* Uniform noise added to the recording in the averaging case */
+#define DC_OFFSET 0.2        /* Offset added to the recording in the DC case */
+#define LEVEL_FROM_HZ 100.0  /* Band where the spectra are compared */
+#define LEVEL_TO_HZ 16000.0
+#define BENCH_REPETITIONS 5
+
+static const Tap TAPS[] = { { 0, 0.1 }, { 20, 0.5 }, { 40, 0.1 }, { 333, -0.2 } };
+#define NUM_TAPS 4
+
+/* Recording of excitation x (n samples) through the taps, with a DC offset and noise */
+static void record_take(float *y, const float *x, int n, double dc, double noise_level, unsigned *state) {
+    filter_taps(y, x, n, TAPS, NUM_TAPS, noise_level, state);
+    for (int i = 0; i < n; i++) {
+        y[i] += (float)dc;
+    }
+}
+
+/* Largest distance of ir from the taps' IR, less the offset, over n lags */
+static double ir_error(const kiss_fft_scalar *ir, int n, double offset) {
+    double worst = 0.0;
+    for (int k = 0; k < n; k++) {
+        double want = offset;
+        for (int t = 0; t < NUM_TAPS; t++) {
+            if (TAPS[t].delay == k) want += TAPS[t].gain;
+        }
+        double d = fabs(ir[k] - want);
+        if (d > worst) worst = d;
+    }
+    return worst;
+}
+
+static double taps_sum(void) {
+    double s = 0.0;
+    for (int t = 0; t < NUM_TAPS; t++) {
+        s += TAPS[t].gain;
+    }
+    return s;
+}
+
+/* The take of chirp: excitation and its recording through the taps */
+static float *take_recording(const ChirpParams *chirp, int *n_total, double dc, double noise_level) {
+    *n_total = 2 * (int)((chirp->Tgap / 2) * FS) + mls_excitation_samples(chirp);
+    float *x = (float*)malloc(sizeof(float) * *n_total);
+    float *y = (float*)malloc(sizeof(float) * *n_total);
+    unsigned state = 1;
+    if (!x || !y || generate_mls(x, chirp, (float)FS) != 0) {
+        free(x);
+        free(y);
+        return NULL;
+    }
+    record_take(y, x, *n_total, dc, noise_level, &state);
+    free(x);
+    return y;
+}
+
+static void test_sequences(void) {
+    printf("Testing the sequences and the Hadamard transform\n\n");
+
+    /* Maximal: the windows of one period take every non-zero index once, and so do the lags */
+    int maximal = 1;
+    for (int order = MLS_MIN_ORDER; order <= MLS_MAX_ORDER; order++) {
+        MlsDecoder dec;
+        if (mls_decoder_init(&dec, order) != 0) {
+            printf("Order %d: init failed\n", order);
+            return;
+        }
+        unsigned char *seen_in = (unsigned char*)calloc((size_t)dec.length + 1, 1);
+        unsigned char *seen_out = (unsigned char*)calloc((size_t)dec.length + 1, 1);
+        for (int n = 0; n < dec.length; n++) {
+            if (dec.in_index[n] == 0 || dec.in_index[n] > (uint32_t)dec.length || seen_in[dec.in_index[n]]++
+                || dec.out_index[n] == 0 || dec.out_index[n] > (uint32_t)dec.length || seen_out[dec.out_index[n]]++) {
+                maximal = 0;
+            }
+        }
+        free(seen_in);
+        free(seen_out);
+        mls_decoder_free(&dec);
+    }
+    printf("Orders %d to %d give maximal sequences: %s (should be yes)\n", MLS_MIN_ORDER, MLS_MAX_ORDER,
+           maximal ? "yes" : "no");
+
+    /* Fast transform against the Sylvester matrix */
+    const int order = 8, n = 1 << order;
+    kiss_fft_scalar data[1 << 8], fast[1 << 8];
+    unsigned state = 7;
+    for (int i = 0; i < n; i++) {
+        data[i] = fast[i] = (kiss_fft_scalar)noise(&state);
+    }
+    fast_hadamard_transform(fast, order);
+    double worst = 0.0;
+    for (int i = 0; i < n; i++) {
+        double s = 0.0;
+        for (int j = 0; j < n; j++) {
+            s += (__builtin_popcount(i & j) & 1) ? -data[j] : data[j];
+        }
+        if (fabs(fast[i] - s) > worst) worst = fabs(fast[i] - s);
+    }
+    printf("Fast Hadamard transform vs. the matrix product (%d points): %.2e (should be below 1e-4)\n\n", n, worst);
+}
+
+static void test_generate(void) {
+    printf("Testing the MLS take\n\n");
+    ChirpParams chirp = { 0 };
+    chirp.type = MLS_CHIRP_TYPE;
+    chirp.amplitude = AMPLITUDE;
+    chirp.duration = 0.5f;
+    chirp.Tgap = 0.1f;
+    chirp.Tfade = 0.01f;
+    if (mls_check(&chirp, FS) != 0) {
+        printf("mls_check failed\n");
+        return;
+    }
+    int length = mls_length(chirp.mls_order);
+    printf("Order for a 0.5 s period: %d, periods %d, duration %.4f s (should be 15, %d, %.4f)\n", chirp.mls_order,
+           chirp.mls_periods, chirp.duration, MLS_DEFAULT_PERIODS, (MLS_DEFAULT_PERIODS + 1) * 32767 / FS);
+
+    int gap = (int)(0.05 * FS);
+    int n_total = 2 * gap + mls_excitation_samples(&chirp);
+    float *x = (float*)malloc(sizeof(float) * n_total);
+    if (!x || generate_mls(x, &chirp, (float)FS) != 0) {
+        printf("generate_mls failed\n");
+        free(x);
+        return;
+    }
+    int silent = 1, periodic = 1, levels = 1;
+    for (int i = 0; i < gap; i++) {
+        if (x[i] != 0.0f || x[n_total - 1 - i] != 0.0f) silent = 0;
+    }
+    int first = mls_first_sample(&chirp, FS);
+    for (int i = first; i < first + chirp.mls_periods * length; i++) {
+        if (fabsf(x[i]) != AMPLITUDE) levels = 0;
+        if (i >= first + length && x[i] != x[i - length]) periodic = 0;
+    }
+    int n_fade = (int)(chirp.Tfade * FS);
+    printf("First averaged sample: %d (should be %d)\n", first, gap + length);
+    printf("Gaps silent: %s, averaged periods at +/-%.1f: %s, periodic: %s (should be yes)\n", silent ? "yes" : "no",
+           AMPLITUDE, levels ? "yes" : "no", periodic ? "yes" : "no");
+    printf("Lead-in faded: first %.4f, mid-fade %.4f of full (should be 0, about 0.5)\n", fabsf(x[gap]) / AMPLITUDE,
+           fabsf(x[gap + n_fade / 2]) / AMPLITUDE);
+
+    chirp.type = 1;
+    mls_check(&chirp, FS);
+    printf("Sweep chirp MLS fields cleared: order %d, periods %d (should be 0, 0)\n\n", chirp.mls_order,
+           chirp.mls_periods);
+    free(x);
+}
+
+static void test_deconvolution(void) {
+    printf("Testing MLS deconvolution (order %d at %.0f Hz)\n\n", ORDER, FS);
+    ChirpParams chirp = { 0 };
+    chirp.type = MLS_CHIRP_TYPE;
+    chirp.amplitude = AMPLITUDE;
+    chirp.mls_order = ORDER;
+    chirp.mls_periods = 4;
+    chirp.Tgap = 0.05f;
+    chirp.Tfade = 0.01f;
+    mls_check(&chirp, FS);
+
+    MlsDecoder dec;
+    if (mls_decoder_init(&dec, ORDER) != 0) {
+        printf("init failed\n");
+        return;
+    }
+    int length = dec.length, nfft = length + 1;
+    kiss_fft_scalar *ir = (kiss_fft_scalar*)malloc(sizeof(kiss_fft_scalar) * length);
+    int first = mls_first_sample(&chirp, FS), n_total;
+    double offset = -taps_sum() / nfft;
+
+    /* Exact IR of the averaged periods, with and without a DC offset */
+    float *y = take_recording(&chirp, &n_total, 0.0, 0.0);
+    mls_decoder_reset(&dec);
+    mls_decoder_add(&dec, y + first, chirp.mls_periods * length);
+    mls_decoder_ir(&dec, AMPLITUDE, ir);
+    printf("IR vs. the taps: %.2e off the -sum(h) / 2^%d offset (should be below 1e-5)\n", ir_error(ir, length, offset),
+           ORDER);
+    free(y);
+    y = take_recording(&chirp, &n_total, DC_OFFSET, 0.0);
+    mls_decoder_reset(&dec);
+    for (int start = 0; start < chirp.mls_periods * length; start += 1000) {
+        int count = chirp.mls_periods * length - start < 1000 ? chirp.mls_periods * length - start : 1000;
+        mls_decoder_add(&dec, y + first + start, count);
+    }
+    mls_decoder_ir(&dec, AMPLITUDE, ir);
+    printf("IR with a %.1f DC offset, added in 1000-sample blocks: %.2e off the offset less %.1f / (A 2^%d) "
+           "(should be below 1e-5)\n", DC_OFFSET, ir_error(ir, length, offset - DC_OFFSET / (AMPLITUDE * nfft)),
+           DC_OFFSET, ORDER);
+    free(y);
+
+    /* Averaging: the noise falls with the square root of the periods */
+    ChirpParams noisy = chirp;
+    double err[2];
+    for (int c = 0; c < 2; c++) {
+        noisy.mls_periods = c == 0 ? 1 : 16;
+        y = take_recording(&noisy, &n_total, 0.0, NOISE_LEVEL);
+        mls_decoder_reset(&dec);
+        mls_decoder_add(&dec, y + first, noisy.mls_periods * length);
+        mls_decoder_ir(&dec, AMPLITUDE, ir);
+        err[c] = ir_error(ir, length, offset);
+        free(y);
+    }
+    printf("Noisy IR after 1 period: %.2e, after 16: %.2e (the average should be about 4 times closer)\n\n", err[0],
+           err[1]);
+
+    /* Windowed spectrum against the taps' response */
+    int npre, npost;
+    mls_ir_window(&chirp, FS, &npre, &npost);
+    printf("IR window: %d before, %d after (should be %d, %d)\n", npre, npost, (int)(MLS_PRE_WINDOW_S * FS),
+           (int)(0.2 * FS));
+    y = take_recording(&chirp, &n_total, 0.0, 0.0);
+    MemorySource src = { y, n_total, 0 };
+    kiss_fft_cpx *spectrum = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * nfft);
+    kiss_fft_cfg cfg = kiss_fft_alloc(nfft, 0, NULL, NULL);
+    if (mls_linear_ir(spectrum, &dec, memory_source, &src, 4096, &chirp, FS, npre, npost, cfg) != 0) {
+        printf("mls_linear_ir failed\n");
+    } else {
+        double worst = 0.0;
+        for (int k = (int)(LEVEL_FROM_HZ * nfft / FS); k <= (int)(LEVEL_TO_HZ * nfft / FS); k++) {
+            double re = 0.0, im = 0.0;
+            for (int t = 0; t < NUM_TAPS; t++) {
+                double w = -2.0 * M_PI * k * TAPS[t].delay / nfft;
+                re += nfft * TAPS[t].gain * cos(w);
+                im += nfft * TAPS[t].gain * sin(w);
+            }
+            double d = fabs(20.0 * log10(hypot(spectrum[k].r, spectrum[k].i) / hypot(re, im)));
+            if (d > worst) worst = d;
+        }
+        int zero = spectrum[nfft / 2 + 1].r == 0.0f && spectrum[nfft - 1].i == 0.0f;
+        printf("Linear IR spectrum vs. nfft times the taps' response, %.0f to %.0f Hz: %.4f dB\n", LEVEL_FROM_HZ,
+               LEVEL_TO_HZ, worst);
+        printf("  (should be below 0.1 dB: the windowed -sum(h) / 2^%d offset)\n", ORDER);
+        printf("Negative frequencies zeroed: %s (should be yes)\n", zero ? "yes" : "no");
+        MemorySource truncated = { y, first, 0 };
+        int short_ok = mls_linear_ir(spectrum, &dec, memory_source, &truncated, 4096, &chirp, FS, npre, npost, cfg);
+        printf("Capture shorter than the take: %d (should be -1)\n\n", short_ok);
+    }
+    kiss_fft_free(cfg);
+    free(spectrum);
+    free(y);
+    free(ir);
+    mls_decoder_free(&dec);
+}
+
+/* Deconvolution cost of one period: the Hadamard path against the sweep path's FFT, inverse filter and IFFT */
+static void bench_deconvolution(void) {
+    printf("Deconvolution cost per period, best of %d runs\n", BENCH_REPETITIONS);
+    printf("%6s %10s %14s %14s\n", "Order", "Samples", "Hadamard (ms)", "Sweep FFT (ms)");
+    for (int order = 12; order <= 18; order += 2) {
+        MlsDecoder dec;
+        if (mls_decoder_init(&dec, order) != 0) {
+            return;
+        }
+        int length = dec.length, nfft = length + 1;
+        float *y = (float*)malloc(sizeof(float) * length);
+        kiss_fft_scalar *ir = (kiss_fft_scalar*)malloc(sizeof(kiss_fft_scalar) * length);
+        kiss_fft_cpx *buf = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * nfft);
+        kiss_fft_cpx *inv_filter = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * nfft);
+        kiss_fft_cfg cfg_fwd = kiss_fft_alloc(nfft, 0, NULL, NULL);
+        kiss_fft_cfg cfg_inv = kiss_fft_alloc(nfft, 1, NULL, NULL);
+        unsigned state = 3;
+        for (int i = 0; i < length; i++) {
+            y[i] = (float)noise(&state);
+        }
+        generate_inverse_filter(inv_filter, AMPLITUDE, 100.0f, 16000.0f, (float)(length / FS), (float)FS, nfft, 1);
+
+        double best_mls = -1.0, best_fft = -1.0;
+        for (int rep = 0; rep < BENCH_REPETITIONS; rep++) {
+            clock_t start = clock();
+            mls_decoder_reset(&dec);
+            mls_decoder_add(&dec, y, length);
+            mls_decoder_ir(&dec, AMPLITUDE, ir);
+            double t = (double)(clock() - start) / CLOCKS_PER_SEC;
+            if (best_mls < 0.0 || t < best_mls) best_mls = t;
+
+            start = clock();
+            for (int i = 0; i < nfft; i++) {
+                buf[i].r = i < length ? y[i] : 0.0f;
+                buf[i].i = 0.0f;
+            }
+            kiss_fft(cfg_fwd, buf, buf);
+            perform_deconvolution(buf, inv_filter, nfft);
+            kiss_fft(cfg_inv, buf, buf);
+            t = (double)(clock() - start) / CLOCKS_PER_SEC;
+            if (best_fft < 0.0 || t < best_fft) best_fft = t;
+        }
+        printf("%6d %10d %14.3f %14.3f\n", order, length, best_mls * 1e3, best_fft * 1e3);
+
+        kiss_fft_free(cfg_fwd);
+        kiss_fft_free(cfg_inv);
+        free(y);
+        free(ir);
+        free(buf);
+        free(inv_filter);
+        mls_decoder_free(&dec);
+    }
+}
+
+int main(void) {
+    test_sequences();
+    test_generate();
+    test_deconvolution();
+    bench_deconvolution();
+    return 0;
+}
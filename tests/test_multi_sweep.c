@@ -0,0 +1,193 @@
+#include "multi_sweep.h"
+#include "processing.h"
+#include "test_signals.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ECHO_DELAY 20        /* System 0.1 + 0.5 z^-ECHO_DELAY + 0.1 z^-(2 ECHO_DELAY) */
+#define SQUARE_LEVEL 0.05    /* Quadratic distortion ahead of the system: x + SQUARE_LEVEL x^2 */
+#define NOISE_LEVEL 1e-4     /* Uniform noise added to the recording */
+#define LEVEL_FROM_HZ 200.0  /* Band where the IRs are compared */
+#define LEVEL_TO_HZ 15000.0
+
+/* Recording of excitation x (n samples) through the distortion and the echo system */
+static void record_take(float *y, const float *x, int n, double square) {
+    unsigned state = 1;
+    for (int i = 0; i < n; i++) {
+        double s = 0.0;
+        for (int e = 0; e < 3; e++) {
+            int k = i - e * ECHO_DELAY;
+            double u = k >= 0 ? x[k] + square * x[k] * x[k] : 0.0;
+            s += (e == 1 ? 0.5 : 0.1) * u;
+        }
+        y[i] = (float)(s + NOISE_LEVEL * noise(&state));
+    }
+}
+
+/* Take (n samples) deconvolved with the single-sweep inverse filter, back in the time domain */
+static void deconvolve(kiss_fft_cpx *time_signal, const float *take, int n, const kiss_fft_cpx *inv_filter, int nfft,
+                       kiss_fft_cfg cfg_fwd, kiss_fft_cfg cfg_inv) {
+    for (int i = 0; i < nfft; i++) {
+        time_signal[i].r = i < n ? take[i] : 0.0f;
+        time_signal[i].i = 0.0f;
+    }
+    kiss_fft(cfg_fwd, time_signal, time_signal);
+    perform_deconvolution(time_signal, inv_filter, nfft);
+    kiss_fft(cfg_inv, time_signal, time_signal);
+    for (int i = 0; i < nfft; i++) {
+        time_signal[i].r /= nfft;
+        time_signal[i].i /= nfft;
+    }
+}
+
+/* Largest level (dB) and phase (rad) difference of a against ref over LEVEL_FROM_HZ to LEVEL_TO_HZ */
+static void compare_spectra(const kiss_fft_cpx *a, const kiss_fft_cpx *ref, int nfft, double fs, double *level_db,
+                            double *phase) {
+    *level_db = 0.0;
+    *phase = 0.0;
+    for (int k = (int)(LEVEL_FROM_HZ * nfft / fs); k <= (int)(LEVEL_TO_HZ * nfft / fs); k++) {
+        double ma = hypot(a[k].r, a[k].i), mr = hypot(ref[k].r, ref[k].i);
+        double d = fabs(20.0 * log10((ma + 1e-300) / (mr + 1e-300)));
+        double p = fabs(atan2((double)a[k].i * ref[k].r - (double)a[k].r * ref[k].i,
+                              (double)a[k].r * ref[k].r + (double)a[k].i * ref[k].i));
+        if (d > *level_db) *level_db = d;
+        if (p > *phase) *phase = p;
+    }
+}
+
+/*
+ * Three sweeps 6 dB apart through the system (with quadratic distortion
+ * square), recorded in one take and separated; each IR is compared against
+ * a single sweep through the linear system alone, windowed the same way.
+ */
+static void separation_case(float stagger, double square, const char *label) {
+    const double fs = 48000.0;
+    ChirpParams chirp = { 0.4f, 100.0f, 16000.0f, 4.0f, 1, 0.0f, 0.05f, 3, stagger, 6.0f, 0, 0 };
+    int n_take = (int)(multi_sweep_duration(&chirp) * fs);
+    int nfft = calculate_next_power_of_two(n_take);
+    int npre, npost;
+    linear_ir_window(chirp.start_freq, chirp.end_freq, chirp.duration, fs, &npre, &npost);
+
+    float *x = (float*)malloc(sizeof(float) * n_take);
+    float *take = (float*)malloc(sizeof(float) * n_take);
+    kiss_fft_cpx *inv_filter = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * nfft);
+    kiss_fft_cpx *time_signal = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * nfft);
+    kiss_fft_cpx *ref = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * nfft);
+    kiss_fft_cpx *spectrum = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * nfft);
+    kiss_fft_cpx *rotated = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * nfft);
+    kiss_fft_cpx *work = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * nfft);
+    kiss_fft_cfg cfg_fwd = kiss_fft_alloc(nfft, 0, NULL, NULL);
+    kiss_fft_cfg cfg_inv = kiss_fft_alloc(nfft, 1, NULL, NULL);
+    if (!x || !take || !inv_filter || !time_signal || !ref || !spectrum || !rotated || !work || !cfg_fwd || !cfg_inv) {
+        fprintf(stderr, "Failed to allocate test buffers\n");
+        return;
+    }
+    generate_inverse_filter(inv_filter, chirp.amplitude, chirp.start_freq, chirp.end_freq, chirp.duration, (float)fs,
+                            nfft, chirp.type);
+
+    /* Reference: the first sweep alone through the linear system */
+    memset(x, 0, sizeof(float) * n_take);
+    generate_chirp(x, chirp.amplitude, chirp.start_freq, chirp.end_freq, chirp.duration, (float)fs, chirp.type, 0.0f,
+                   chirp.Tfade);
+    record_take(take, x, n_take, 0.0);
+    deconvolve(time_signal, take, n_take, inv_filter, nfft, cfg_fwd, cfg_inv);
+    separate_sweep_ir(time_signal, rotated, work, ref, cfg_fwd, nfft, 0.0, 1.0, npre, npost, fs, 0, nfft / 2 + 1);
+
+    /* All sweeps in one take, deconvolved once */
+    if (generate_multi_sweep(x, &chirp, (float)fs) != 0) {
+        return;
+    }
+    record_take(take, x, n_take, square);
+    deconvolve(time_signal, take, n_take, inv_filter, nfft, cfg_fwd, cfg_inv);
+    printf("%s, stagger %.3f s, distortion %.2f: %d sweeps, %.2f s take, peak %.2f\n", label, chirp.sweep_stagger,
+           square, multi_sweep_count(&chirp), (double)n_take / fs, find_peak_amplitude(x, n_take));
+    for (int k = 0; k < multi_sweep_count(&chirp); k++) {
+        double level_db, phase;
+        separate_sweep_ir(time_signal, rotated, work, spectrum, cfg_fwd, nfft, multi_sweep_offset(&chirp, fs, k),
+                          multi_sweep_gain(&chirp, k), npre, npost, fs, 0, nfft / 2 + 1);
+        compare_spectra(spectrum, ref, nfft, fs, &level_db, &phase);
+        printf("  sweep %d at %.1f dB: against the single linear sweep, %.0f-%.0f Hz: %.3f dB, %.4f rad\n", k + 1,
+               20.0 * log10(multi_sweep_gain(&chirp, k)), LEVEL_FROM_HZ, LEVEL_TO_HZ, level_db, phase);
+    }
+
+    free(x);
+    free(take);
+    free(inv_filter);
+    free(time_signal);
+    free(ref);
+    free(spectrum);
+    free(rotated);
+    free(work);
+    kiss_fft_free(cfg_fwd);
+    kiss_fft_free(cfg_inv);
+}
+
+/* An impulse read back from a fractional offset: largest phase error against the expected half-sample delay */
+static double fractional_offset_error(void) {
+    const double fs = 48000.0;
+    int nfft = 4096, npre = 256, npost = 512;
+    kiss_fft_cpx *time_signal = (kiss_fft_cpx*)calloc(nfft, sizeof(kiss_fft_cpx));
+    kiss_fft_cpx *rotated = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * nfft);
+    kiss_fft_cpx *work = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * nfft);
+    kiss_fft_cpx *spectrum = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * nfft);
+    kiss_fft_cfg cfg_fwd = kiss_fft_alloc(nfft, 0, NULL, NULL);
+    double max_error = -1.0;
+    if (time_signal && rotated && work && spectrum && cfg_fwd) {
+        time_signal[1000].r = 1.0f;
+        separate_sweep_ir(time_signal, rotated, work, spectrum, cfg_fwd, nfft, 999.5, 1.0, npre, npost, fs, 0,
+                          nfft / 2 + 1);
+        max_error = 0.0;
+        for (int k = 0; k <= nfft / 2; k++) {
+            double expected = -2.0 * M_PI * k * 0.5 / nfft;
+            double e = fabs(remainder(atan2(spectrum[k].i, spectrum[k].r) - expected, 2.0 * M_PI));
+            if (e > max_error) max_error = e;
+        }
+    }
+    free(time_signal);
+    free(rotated);
+    free(work);
+    free(spectrum);
+    kiss_fft_free(cfg_fwd);
+    return max_error;
+}
+
+void test_multi_sweep(void) {
+    printf("--- MULTIPLE SWEEP TEST ---\n");
+
+    ChirpParams chirp = { 0.4f, 100.0f, 16000.0f, 4.0f, 1, 0.0f, 0.0f, 3, 0.0f, 6.0f, 0, 0 };
+    double min_stagger = multi_sweep_min_stagger(&chirp, 48000.0);
+    int ret = multi_sweep_check(&chirp, 48000.0);
+    printf("Default stagger: %.3f s (should be %.3f, rounded up to the ms), check %d (should be 0)\n",
+           chirp.sweep_stagger, min_stagger, ret);
+    chirp.sweep_stagger = (float)(0.5 * min_stagger);
+    printf("Half the stagger: check %d (should be -1)\n", multi_sweep_check(&chirp, 48000.0));
+    chirp.sweep_stagger = 0.0f;
+    chirp.type = 0;
+    printf("Linear sweeps: check %d (should be -1)\n", multi_sweep_check(&chirp, 48000.0));
+    chirp.num_sweeps = 1;
+    printf("Single linear sweep: check %d (should be 0), duration %.2f s (should be 4.00)\n",
+           multi_sweep_check(&chirp, 48000.0), multi_sweep_duration(&chirp));
+
+    printf("Impulse read at a fractional offset: phase error %.2e rad (should be below 1e-4)\n",
+           fractional_offset_error());
+
+    chirp.type = 1;
+    chirp.num_sweeps = 3;
+    float stagger = (float)(ceil(min_stagger * 1000.0) / 1000.0);
+    separation_case(stagger, 0.0, "Linear system");
+    printf("  (should all be below 0.05 dB and 0.01 rad)\n");
+    separation_case(stagger, SQUARE_LEVEL, "Distorting system");
+    printf("  (should all be below 0.2 dB and 0.02 rad: the sweeps intermodulate where they overlap)\n");
+
+    /* The next sweep's linear IR inside each IR window */
+    int npre, npost;
+    linear_ir_window(chirp.start_freq, chirp.end_freq, chirp.duration, 48000.0, &npre, &npost);
+    separation_case((float)(0.5 * npost / 48000.0), 0.0, "Stagger inside the IR window");
+    printf("  (sweeps 1 and 2 should be off by several dB, sweep 3 with no sweep after it far less)\n");
+}
+
+int main(void) {
+    test_multi_sweep();
+    return 0;
+}
@@ -0,0 +1,195 @@
+#define _POSIX_C_SOURCE 200809L
+#include "param_sweep.h"
+#include "processing.h"
+#include "frf_grid.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define ECHO_DELAY 37
+
+static double now_ms(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e3 + t.tv_nsec / 1e6;
+}
+
+/* Capture spectrum times inverse filter, in the time domain (the parameter sweep input) */
+static void raw_time_signal(kiss_fft_cpx *buf, const float *x, int n, int nfft, const kiss_fft_cpx *inv_filter,
+                            kiss_fft_cfg cfg_fwd, kiss_fft_cfg cfg_inv) {
+    for (int i = 0; i < nfft; i++) {
+        buf[i].r = i < n ? x[i] : 0.0f;
+        buf[i].i = 0.0f;
+    }
+    kiss_fft(cfg_fwd, buf, buf);
+    perform_deconvolution(buf, inv_filter, nfft);
+    kiss_fft(cfg_inv, buf, buf);
+}
+
+/* Same as processing mode: deconvolve, window, regularize */
+static void processing_h_lips(kiss_fft_cpx *h, kiss_fft_cpx *open, kiss_fft_cpx *closed, const float *x_open,
+                              const float *x_closed, int n, int nfft, const kiss_fft_cpx *inv_filter,
+                              kiss_fft_cfg cfg_fwd, kiss_fft_cfg cfg_inv, int npre, int npost, double fs,
+                              const kiss_fft_scalar *epsilon) {
+    kiss_fft_cpx *pair[2] = { open, closed };
+    const float *x[2] = { x_open, x_closed };
+    for (int c = 0; c < 2; c++) {
+        for (int i = 0; i < nfft; i++) {
+            pair[c][i].r = i < n ? x[c][i] : 0.0f;
+            pair[c][i].i = 0.0f;
+        }
+        kiss_fft(cfg_fwd, pair[c], pair[c]);
+        perform_deconvolution(pair[c], inv_filter, nfft);
+        extract_linear_ir(pair[c], cfg_inv, cfg_fwd, nfft, n, npre, npost, fs, 0);
+    }
+    compute_h_lips(h, open, closed, epsilon, nfft);
+}
+
+void test_param_sweep(void) {
+    const double fs = 16000.0;
+    const float f0 = 100.0f, f1 = 4000.0f, T = 4.0f;
+    int n = (int)(fs * T);
+    int nfft = calculate_next_power_of_two(n);
+
+    printf("--- PARAMETER SWEEP TEST ---\n");
+
+    float *closed = (float*)malloc(sizeof(float) * n);
+    float *open = (float*)malloc(sizeof(float) * n);
+    kiss_fft_cpx *inv_filter = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * nfft);
+    kiss_fft_cpx *open_time = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * nfft);
+    kiss_fft_cpx *closed_time = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * nfft);
+    kiss_fft_cpx *h = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * nfft);
+    kiss_fft_cpx *open_ir = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * nfft);
+    kiss_fft_cpx *closed_ir = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * nfft);
+    kiss_fft_scalar *epsilon = (kiss_fft_scalar*)malloc(sizeof(kiss_fft_scalar) * nfft);
+    kiss_fft_cfg cfg_fwd = kiss_fft_alloc(nfft, 0, NULL, NULL);
+    kiss_fft_cfg cfg_inv = kiss_fft_alloc(nfft, 1, NULL, NULL);
+    if (!closed || !open || !inv_filter || !open_time || !closed_time || !h || !open_ir || !closed_ir || !epsilon
+        || !cfg_fwd || !cfg_inv) {
+        fprintf(stderr, "Failed to allocate test buffers\n");
+        return;
+    }
+
+    /* Closed: the sweep itself; open: 0.5 x[n - 5] + 0.25 x[n - 5 - ECHO_DELAY] */
+    generate_chirp(closed, 0.5f, f0, f1, T, (float)fs, 1, 0.0f, 0.0f);
+    for (int i = 0; i < n; i++) {
+        open[i] = (i >= 5 ? 0.5f * closed[i - 5] : 0.0f) + (i >= 5 + ECHO_DELAY ? 0.25f * closed[i - 5 - ECHO_DELAY] : 0.0f);
+    }
+    generate_inverse_filter(inv_filter, 0.5f, f0, f1, T, (float)fs, nfft, 1);
+
+    ParamSetting defaults;
+    linear_ir_window(f0, f1, T, fs, &defaults.npre, &defaults.npost);
+    defaults.fade = LINEAR_IR_FADE;
+    defaults.epsilon_hz = (float)EPSILON_TRANSITION_HZ;
+
+    /* Reference: one processing-mode run, timed */
+    double start = now_ms();
+    generate_epsilon(epsilon, f0, f1, (float)fs, nfft);
+    processing_h_lips(h, open_ir, closed_ir, open, closed, n, nfft, inv_filter, cfg_fwd, cfg_inv,
+                      defaults.npre, defaults.npost, fs, epsilon);
+    double single_ms = now_ms() - start;
+
+    /* Grid: 4 x 3 x 2 x 4 = 96 settings */
+    ParamSweepGrid grid;
+    memset(&grid, 0, sizeof(grid));
+    float pre[] = { 0.05f, 0.1f, 0.2f, 0.3f }, post[] = { 0.1f, 0.2f, 0.4f }, fade[] = { 0.25f, 0.5f };
+    float eps[] = { 10.0f, 25.0f, 50.0f, 100.0f };
+    grid.pre_s.count = 4;
+    memcpy(grid.pre_s.values, pre, sizeof(pre));
+    grid.post_s.count = 3;
+    memcpy(grid.post_s.values, post, sizeof(post));
+    grid.fade.count = 2;
+    memcpy(grid.fade.values, fade, sizeof(fade));
+    grid.epsilon_hz.count = 4;
+    memcpy(grid.epsilon_hz.values, eps, sizeof(eps));
+
+    int count = param_sweep_expand(&grid, &defaults, fs, NULL);
+    ParamSetting *settings = (ParamSetting*)malloc(sizeof(ParamSetting) * (count + 1));
+    ParamMetrics *serial = (ParamMetrics*)malloc(sizeof(ParamMetrics) * (count + 1));
+    ParamMetrics *parallel = (ParamMetrics*)malloc(sizeof(ParamMetrics) * (count + 1));
+    if (!settings || !serial || !parallel) {
+        fprintf(stderr, "Failed to allocate settings\n");
+        return;
+    }
+    param_sweep_expand(&grid, &defaults, fs, settings);
+    settings[count] = defaults; /* Last: the processing default, which must reproduce the reference */
+    count++;
+    printf("Grid of %d settings (+1 default)\n", count - 1);
+
+    /* The sweep's bins are every (nfft / size)-th bin of the processing spectrum */
+    int size = param_sweep_fft_size(settings, count, &defaults, nfft);
+    int stride = nfft / size;
+    printf("Window FFT size %d (should be 16384, every %d bins of %d)\n", size, stride, nfft);
+    for (int q = 0; q < size; q++) {
+        h[q] = h[q * stride];
+    }
+    FrfGrid band;
+    double margin = pow(2.0, FRF_BAND_MARGIN_OCTAVES);
+    int first_bin = frf_grid_band_bins(&band, f0 / margin, f1 * margin, fs, size);
+    ParamMetrics expected;
+    param_sweep_metrics(h, first_bin, band.num_points, NULL, fs / size, &expected);
+
+    start = now_ms();
+    raw_time_signal(closed_time, closed, n, nfft, inv_filter, cfg_fwd, cfg_inv);
+    raw_time_signal(open_time, open, n, nfft, inv_filter, cfg_fwd, cfg_inv);
+    double raw_ms = now_ms() - start;
+
+    start = now_ms();
+    int ret1 = param_sweep_run(open_time, closed_time, nfft, fs, f0, f1, settings, count, &defaults, 1, serial);
+    double serial_ms = now_ms() - start;
+    start = now_ms();
+    int ret4 = param_sweep_run(open_time, closed_time, nfft, fs, f0, f1, settings, count, &defaults, 4, parallel);
+    double parallel_ms = now_ms() - start;
+    printf("Return values: %d, %d (should be 0, 0)\n", ret1, ret4);
+
+    int identical = memcmp(serial, parallel, sizeof(ParamMetrics) * count) == 0;
+    printf("1 and 4 threads give identical tables: %s\n", identical ? "yes" : "NO");
+
+    const ParamMetrics *d = &serial[count - 1];
+    printf("Default setting vs processing path: peak %.4f / %.4f dB at %.1f / %.1f Hz, ripple %.5f / %.5f dB\n",
+           d->peak_db, expected.peak_db, d->peak_hz, expected.peak_hz, d->ripple_db, expected.ripple_db);
+    printf("  delta to reference %.6f dB (should be 0)\n", d->delta_db);
+
+    /* Shorter windows smooth H_lips and move it further from the default */
+    int smoothest = 0, farthest = 0;
+    for (int i = 1; i < count; i++) {
+        if (serial[i].ripple_db < serial[smoothest].ripple_db) smoothest = i;
+        if (serial[i].delta_db > serial[farthest].delta_db) farthest = i;
+    }
+    printf("Smoothest: pre %d, post %d, fade %.2f (ripple %.5f dB); farthest from default: pre %d, post %d (%.4f dB)\n",
+           settings[smoothest].npre, settings[smoothest].npost, settings[smoothest].fade, serial[smoothest].ripple_db,
+           settings[farthest].npre, settings[farthest].npost, serial[farthest].delta_db);
+
+    printf("One processing run: %.1f ms; raw deconvolution once: %.1f ms\n", single_ms, raw_ms);
+    printf("%d settings: %.1f ms on 1 thread, %.1f ms on 4 threads (%.2f runs' worth)\n", count, serial_ms,
+           parallel_ms, (raw_ms + parallel_ms) / single_ms);
+
+    /* A run is six FFTs of nfft; a window is one FFT of nfft / 4, plus a pass over the band for each of its settings */
+    int windows = 4 * 3 * 2 + 2; /* The grid's, the default's and the reference's */
+    int threads = param_sweep_cpu_count() < 4 ? param_sweep_cpu_count() : 4;
+    printf("  per distinct IR window and its settings: %.2f runs (should be about 0.05, below 0.1)\n",
+           serial_ms / windows / single_ms);
+    printf("  on %d thread(s): should be about %.1f runs' worth (0.5 + %d windows x 0.05 / %d)\n", threads,
+           0.5 + windows * 0.05 / threads, windows, threads);
+
+    free(settings);
+    free(serial);
+    free(parallel);
+    free(closed);
+    free(open);
+    free(inv_filter);
+    free(open_time);
+    free(closed_time);
+    free(h);
+    free(open_ir);
+    free(closed_ir);
+    free(epsilon);
+    kiss_fft_free(cfg_fwd);
+    kiss_fft_free(cfg_inv);
+}
+
+int main(void) {
+    test_param_sweep();
+    return 0;
+}
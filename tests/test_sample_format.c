@@ -0,0 +1,51 @@
+#include "sample_format.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <math.h>
+
+void test_integer_to_float(void) {
+    int n = 1000; // Spans several conversion blocks
+    int16_t *pcm16 = (int16_t*)malloc(sizeof(int16_t) * n);
+    uint8_t *pcm24 = (uint8_t*)malloc(3 * n);
+    int32_t *pcm32 = (int32_t*)malloc(sizeof(int32_t) * n);
+    float *out = (float*)malloc(sizeof(float) * n);
+
+    // Full-scale ramp from -1 to just below +1
+    for (int i = 0; i < n; i++) {
+        double x = -1.0 + 2.0 * i / n;
+        int32_t v24 = (int32_t)floor(x * 8388608.0);
+        pcm16[i] = (int16_t)floor(x * 32768.0);
+        pcm24[3 * i] = (uint8_t)(v24 & 0xFF);
+        pcm24[3 * i + 1] = (uint8_t)((v24 >> 8) & 0xFF);
+        pcm24[3 * i + 2] = (uint8_t)((v24 >> 16) & 0xFF);
+        pcm32[i] = (int32_t)floor(x * 2147483648.0);
+    }
+
+    const void *inputs[3] = { pcm16, pcm24, pcm32 };
+    SampleFormat formats[3] = { SAMPLE_FORMAT_INT16, SAMPLE_FORMAT_INT24, SAMPLE_FORMAT_INT32 };
+
+    printf("--- SAMPLE FORMAT CONVERSION TEST ---\n");
+    for (int f = 0; f < 3; f++) {
+        sample_format_to_float(inputs[f], formats[f], out, n);
+
+        double max_err = 0.0;
+        for (int i = 0; i < n; i++) {
+            double err = fabs(out[i] - (-1.0 + 2.0 * i / n));
+            if (err > max_err) max_err = err;
+        }
+        printf("%-6s: %d bytes/sample, first %.6f (should be -1.0), max error %.3g (should be <= %.3g)\n",
+               sample_format_name(formats[f]), sample_format_bytes(formats[f]), out[0], max_err,
+               sample_format_scale(formats[f]) + 1e-7);
+    }
+
+    free(pcm16);
+    free(pcm24);
+    free(pcm32);
+    free(out);
+}
+
+int main(void) {
+    test_integer_to_float();
+    return 0;
+}
@@ -0,0 +1,75 @@
+#ifndef TEST_SIGNALS_H
+#define TEST_SIGNALS_H
+
+#include "kiss_fft.h"
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * Signals and sample sources shared by the tests.
+ */
+
+/* Deterministic uniform noise in [-1, 1] */
+static inline double noise(unsigned *state) {
+    *state = *state * 1664525u + 1013904223u;
+    return (double)(*state >> 8) / (double)(1u << 23) - 1.0;
+}
+
+/* Tap of a sparse FIR system */
+typedef struct {
+    int delay;
+    double gain;
+} Tap;
+
+/* y = taps applied to x (zero before its start), plus uniform noise of the given level */
+static inline void filter_taps(float *y, const float *x, int n, const Tap *taps, int num_taps, double noise_level,
+                               unsigned *state) {
+    for (int i = 0; i < n; i++) {
+        double s = 0.0;
+        for (int t = 0; t < num_taps; t++) {
+            int k = i - taps[t].delay;
+            s += k >= 0 ? taps[t].gain * x[k] : 0.0;
+        }
+        y[i] = (float)(s + noise_level * noise(state));
+    }
+}
+
+/* Frequency response of the taps on bin k of an n-point DFT */
+static inline kiss_fft_cpx taps_response(const Tap *taps, int num_taps, int k, int n) {
+    kiss_fft_cpx h = { 0, 0 };
+    for (int t = 0; t < num_taps; t++) {
+        double w = -2.0 * M_PI * k * taps[t].delay / n;
+        h.r += (kiss_fft_scalar)(taps[t].gain * cos(w));
+        h.i += (kiss_fft_scalar)(taps[t].gain * sin(w));
+    }
+    return h;
+}
+
+/* Exponential sweep of n samples at fs, as the measurement program plays it (no gap, no fade) */
+static inline void make_sweep(float *x, int n, double fs, double f0, double f1, double duration, float amplitude) {
+    double L = (1.0 / f0) * ceil(f0 * duration / log(f1 / f0));
+    for (int i = 0; i < n; i++) {
+        double t = i / fs;
+        x[i] = amplitude * (float)sin(2 * M_PI * f0 * L * exp(t / L));
+    }
+}
+
+/* Capture samples from memory, for the modules that read through a sample source */
+typedef struct {
+    const float *samples;
+    int64_t length;
+    int reads; /* Calls so far */
+} MemorySource;
+
+static inline int memory_source(void *context, int64_t first, int count, float *dst) {
+    MemorySource *src = (MemorySource*)context;
+    if (first < 0 || first + count > src->length) {
+        return -1;
+    }
+    memcpy(dst, src->samples + first, sizeof(float) * count);
+    src->reads++;
+    return 0;
+}
+
+#endif
@@ -0,0 +1,120 @@
+#include "stream_deconv.h"
+#include "processing.h"
+#include "test_signals.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#define ECHO_DELAY 37 /* Samples between the direct path and the echo of the test system */
+
+/* Response of the test system, 0.5 x[n - 5] + 0.25 x[n - 5 - ECHO_DELAY] */
+static void apply_system(const float *chirp, float *response, int n) {
+    for (int i = 0; i < n; i++) {
+        float direct = i >= 5 ? chirp[i - 5] : 0.0f;
+        float echo = i >= 5 + ECHO_DELAY ? chirp[i - 5 - ECHO_DELAY] : 0.0f;
+        response[i] = 0.5f * direct + 0.25f * echo;
+    }
+}
+
+/* Largest error of a spectrum against the test system between f_lo and f_hi */
+static double band_error(const kiss_fft_cpx *spectrum, int nfft, double scale, double fs, double f_lo, double f_hi) {
+    double max_err = 0.0;
+    for (int k = 0; k <= nfft / 2; k++) {
+        double f = (double)k * fs / nfft;
+        if (f < f_lo || f > f_hi) continue;
+        double w = 2.0 * M_PI * f / fs;
+        double ref_r = 0.5 * cos(5 * w) + 0.25 * cos((5 + ECHO_DELAY) * w);
+        double ref_i = -0.5 * sin(5 * w) - 0.25 * sin((5 + ECHO_DELAY) * w);
+        double err = hypot(spectrum[k].r / scale - ref_r, spectrum[k].i / scale - ref_i);
+        if (err > max_err) max_err = err;
+    }
+    return max_err;
+}
+
+static void compare_paths(int type, double fs, float f0, float f1, float T) {
+    ChirpParams chirp;
+    memset(&chirp, 0, sizeof(chirp));
+    chirp.amplitude = 0.5f;
+    chirp.start_freq = f0;
+    chirp.end_freq = f1;
+    chirp.duration = T;
+    chirp.type = type;
+
+    int n = (int)(fs * T);
+    int nfft = calculate_next_power_of_two(n);
+    int npre, npost;
+    linear_ir_window(f0, f1, T, fs, &npre, &npost);
+    int nfft_out = segmented_ir_nfft(npre, npost, nfft);
+
+    float *x = (float*)calloc(n, sizeof(float));
+    float *response = (float*)malloc(sizeof(float) * n);
+    kiss_fft_cpx *full = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * nfft);
+    kiss_fft_cpx *inv_filter = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * nfft);
+    kiss_fft_cpx *segmented = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * nfft_out);
+    if (!x || !response || !full || !inv_filter || !segmented) {
+        fprintf(stderr, "Failed to allocate test buffers\n");
+        free(x);
+        free(response);
+        free(full);
+        free(inv_filter);
+        free(segmented);
+        return;
+    }
+    generate_chirp(x, chirp.amplitude, f0, f1, T, (float)fs, type, 0.0f, 0.0f);
+    apply_system(x, response, n);
+
+    /* In-memory path */
+    kiss_fft_cfg cfg_fwd = kiss_fft_alloc(nfft, 0, NULL, NULL);
+    kiss_fft_cfg cfg_inv = kiss_fft_alloc(nfft, 1, NULL, NULL);
+    for (int i = 0; i < nfft; i++) {
+        full[i].r = i < n ? response[i] : 0.0f;
+        full[i].i = 0.0f;
+    }
+    generate_inverse_filter(inv_filter, chirp.amplitude, f0, f1, T, (float)fs, nfft, type);
+    kiss_fft(cfg_fwd, full, full);
+    perform_deconvolution(full, inv_filter, nfft);
+    extract_linear_ir(full, cfg_inv, cfg_fwd, nfft, n, npre, npost, fs, 0);
+
+    /* Segmented path, reading the response in blocks */
+    MemorySource source = { response, n, 0 };
+    int ret = segmented_linear_ir(segmented, nfft_out, memory_source, &source, &chirp, fs, n, npre, npost, nfft);
+
+    /* Both are scaled like the in-memory transforms of size nfft; compare at common frequencies */
+    double f_lo = f0 * 1.5, f_hi = f1 / 1.5;
+    int step = nfft / nfft_out;
+    double max_diff = 0.0;
+    for (int k = 0; k <= nfft_out / 2; k++) {
+        double f = (double)k * fs / nfft_out;
+        if (f < f_lo || f > f_hi) continue;
+        double diff = hypot(full[k * step].r - segmented[k].r, full[k * step].i - segmented[k].i) / nfft;
+        if (diff > max_diff) max_diff = diff;
+    }
+    printf("%s sweep %.0f-%.0f Hz, %.1f s at %.0f Hz (nfft %d, segmented spectrum %d bins, %d reads)\n",
+           type == 0 ? "Linear" : "Exponential", f0, f1, T, fs, nfft, nfft_out, source.reads);
+    printf("  error against the system: in-memory %.4f, segmented %.4f (window ripple, should be close)%s\n",
+           band_error(full, nfft, nfft, fs, f_lo, f_hi), band_error(segmented, nfft_out, nfft, fs, f_lo, f_hi),
+           ret == 0 ? "" : " FAILED");
+    printf("  max difference between paths: %.4f (should be < 0.03)\n", max_diff);
+    printf("  working memory: %.1f MiB in memory, %.1f MiB segmented\n",
+           nfft * (7.0 * sizeof(kiss_fft_cpx) + sizeof(float)) / 1048576.0,
+           (segmented_ir_memory(npre, npost) + nfft_out * sizeof(kiss_fft_cpx)) / 1048576.0);
+
+    kiss_fft_free(cfg_fwd);
+    kiss_fft_free(cfg_inv);
+    free(x);
+    free(response);
+    free(full);
+    free(inv_filter);
+    free(segmented);
+}
+
+void test_stream_deconv(void) {
+    printf("--- SEGMENTED DECONVOLUTION TEST ---\n");
+    compare_paths(1, 16000.0, 100.0f, 4000.0f, 6.0f);
+    compare_paths(0, 16000.0, 100.0f, 4000.0f, 6.0f);
+}
+
+int main(void) {
+    test_stream_deconv();
+    return 0;
+}
@@ -0,0 +1,93 @@
+#include "vtimpedance.h"
+#include "test_signals.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+
+#define ECHO_DELAY 37 /* Samples between the direct path and the echo of the test system */
+
+void test_vtimpedance(void) {
+    VtSweep sweep = { 16000.0, 100.0f, 4000.0f, 4.0f, 0.5f, 1 };
+
+    printf("--- SHARED LIBRARY API TEST ---\n");
+    printf("API version %d (should be %d)\n", vt_api_version(), VT_API_VERSION);
+
+    VtContext *ctx = vt_context_create(&sweep);
+    if (!ctx) {
+        fprintf(stderr, "Failed to create context\n");
+        return;
+    }
+    int n = (int)vt_capture_length(ctx);
+    float *closed = (float*)malloc(sizeof(float) * n);
+    float *open = (float*)malloc(sizeof(float) * n);
+    if (!closed || !open) {
+        fprintf(stderr, "Failed to allocate captures\n");
+        free(closed);
+        free(open);
+        vt_context_destroy(ctx);
+        return;
+    }
+
+    /* Closed: the sweep itself; open: 0.5 x[n - 5] + 0.25 x[n - 5 - ECHO_DELAY] */
+    make_sweep(closed, n, sweep.sample_rate, sweep.start_freq, sweep.end_freq, sweep.duration, sweep.amplitude);
+    for (int i = 0; i < n; i++) {
+        open[i] = (i >= 5 ? 0.5f * closed[i - 5] : 0.0f) + (i >= 5 + ECHO_DELAY ? 0.25f * closed[i - 5 - ECHO_DELAY] : 0.0f);
+    }
+
+    int no_calibration = vt_process(ctx, open, n, NULL, NULL, NULL);
+    int too_short = vt_set_calibration(ctx, closed, n - 1);
+    printf("Without calibration: %d, short capture: %d (should be -1, -1)\n", no_calibration, too_short);
+
+    remove("output/windowed_calibration_response.raw");
+    vt_set_calibration(ctx, closed, n);
+
+    /* Band-limited bins: H_lips against the known system over the sweep band */
+    vt_set_output(ctx, 1, VT_OUTPUT_BINS, 0);
+    int points = vt_output_points(ctx);
+    float *h = (float*)malloc(sizeof(float) * 2 * points);
+    double *freq = (double*)malloc(sizeof(double) * points);
+    if (h && freq && vt_process(ctx, open, n, h, NULL, NULL) == 0) {
+        vt_output_frequencies(ctx, freq);
+        double max_err = 0.0;
+        for (int k = 0; k < points; k++) {
+            if (freq[k] < 1.5 * sweep.start_freq || freq[k] > sweep.end_freq / 1.5) continue;
+            double w = 2.0 * M_PI * freq[k] / sweep.sample_rate;
+            double ref_r = 0.5 * cos(5 * w) + 0.25 * cos((5 + ECHO_DELAY) * w);
+            double ref_i = -0.5 * sin(5 * w) - 0.25 * sin((5 + ECHO_DELAY) * w);
+            double err = hypot(h[2 * k] - ref_r, h[2 * k + 1] - ref_i);
+            if (err > max_err) max_err = err;
+        }
+        printf("Band bins: %d points, %.1f-%.1f Hz, max H_lips error %.4f (should be < 0.15, IR window ripple)\n",
+               points, freq[0], freq[points - 1], max_err);
+    }
+    free(h);
+    free(freq);
+
+    /* Log grid into caller arrays */
+    vt_set_output(ctx, 1, VT_OUTPUT_LOG, 200);
+    points = vt_output_points(ctx);
+    h = (float*)malloc(sizeof(float) * 2 * points);
+    float *spectra = (float*)malloc(sizeof(float) * 4 * points);
+    freq = (double*)malloc(sizeof(double) * points);
+    if (h && spectra && freq && vt_process(ctx, open, n, h, spectra, spectra + 2 * points) == 0) {
+        vt_output_frequencies(ctx, freq);
+        printf("Log grid: %d points (should be 200), %.1f-%.1f Hz, ratio %.4f (should be constant)\n",
+               points, freq[0], freq[points - 1], freq[1] / freq[0]);
+    }
+    free(h);
+    free(spectra);
+    free(freq);
+
+    FILE *debug = fopen("output/windowed_calibration_response.raw", "rb");
+    printf("Debug files written: %s (should be no)\n", debug ? "yes" : "no");
+    if (debug) fclose(debug);
+
+    free(closed);
+    free(open);
+    vt_context_destroy(ctx);
+}
+
+int main(void) {
+    test_vtimpedance();
+    return 0;
+}
@@ -0,0 +1,133 @@
+#include "welch.h"
+#include "processing.h"
+#include "test_signals.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SEGMENT 4096
+#define NUM_SAMPLES 400000
+#define FIRST_BIN 20     /* Bins compared: away from DC and Nyquist */
+#define LAST_BIN 2000
+
+static const Tap CLOSED_TAPS[] = { { 0, 1.0 }, { 5, 0.3 } };
+static const Tap OPEN_TAPS[] = { { 0, 0.8 }, { 12, 0.3 }, { 30, -0.1 } };
+static const Tap GAIN_TAP[] = { { 3, 0.5 } };
+
+/* Mean |H1|, |H2| and coherence over the compared bins */
+static void mean_result(const WelchEstimator *est, double *h1, double *h2, double *coherence) {
+    int n = LAST_BIN - FIRST_BIN + 1;
+    kiss_fft_cpx *a = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * n);
+    kiss_fft_cpx *b = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * n);
+    kiss_fft_scalar *c = (kiss_fft_scalar*)malloc(sizeof(kiss_fft_scalar) * n);
+    welch_result(est, FIRST_BIN, n, a, b, c);
+    *h1 = *h2 = *coherence = 0.0;
+    for (int j = 0; j < n; j++) {
+        *h1 += hypot(a[j].r, a[j].i) / n;
+        *h2 += hypot(b[j].r, b[j].i) / n;
+        *coherence += c[j] / (double)n;
+    }
+    free(a);
+    free(b);
+    free(c);
+}
+
+static void test_welch(void) {
+    printf("Testing Welch H1/H2 estimation (%d-sample segments, %d samples)\n\n", SEGMENT, NUM_SAMPLES);
+
+    WelchEstimator est;
+    printf("Segment 3000: init %d (should be -1)\n", welch_init(&est, 3000, 0.5));
+    if (welch_init(&est, SEGMENT, WELCH_DEFAULT_OVERLAP) != 0) {
+        printf("init failed\n");
+        return;
+    }
+    printf("Result before any segment: %d (should be -1)\n", welch_result(&est, 0, 1, NULL, NULL, NULL));
+
+    float *e = (float*)malloc(sizeof(float) * NUM_SAMPLES);
+    float *x = (float*)malloc(sizeof(float) * NUM_SAMPLES);
+    float *y = (float*)malloc(sizeof(float) * NUM_SAMPLES);
+    unsigned state = 1;
+    for (int i = 0; i < NUM_SAMPLES; i++) {
+        e[i] = (float)noise(&state);
+    }
+
+    /* Two systems driven by one excitation: H1 = H2 = their ratio, coherence 1 */
+    filter_taps(x, e, NUM_SAMPLES, CLOSED_TAPS, 2, 0.0, &state);
+    filter_taps(y, e, NUM_SAMPLES, OPEN_TAPS, 3, 0.0, &state);
+    welch_add(&est, x, y, NUM_SAMPLES);
+    int n = LAST_BIN - FIRST_BIN + 1;
+    kiss_fft_cpx *h1 = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * n);
+    kiss_fft_cpx *h2 = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * n);
+    kiss_fft_scalar *coherence = (kiss_fft_scalar*)malloc(sizeof(kiss_fft_scalar) * n);
+    welch_result(&est, FIRST_BIN, n, h1, h2, coherence);
+    double worst1 = 0.0, worst2 = 0.0, lowest = 1.0;
+    for (int j = 0; j < n; j++) {
+        kiss_fft_cpx want = complex_division(taps_response(OPEN_TAPS, 3, FIRST_BIN + j, SEGMENT),
+                                             taps_response(CLOSED_TAPS, 2, FIRST_BIN + j, SEGMENT));
+        double d1 = hypot(h1[j].r - want.r, h1[j].i - want.i) / hypot(want.r, want.i);
+        double d2 = hypot(h2[j].r - want.r, h2[j].i - want.i) / hypot(want.r, want.i);
+        if (d1 > worst1) worst1 = d1;
+        if (d2 > worst2) worst2 = d2;
+        if (coherence[j] < lowest) lowest = coherence[j];
+    }
+    printf("Segments: %lld, hop %d (should be %d, %d)\n", (long long)est.segments, est.hop,
+           (NUM_SAMPLES - SEGMENT) / (SEGMENT / 2) + 1, SEGMENT / 2);
+    printf("Ratio of two systems: H1 %.2e, H2 %.2e relative, lowest coherence %.6f\n", worst1, worst2, lowest);
+    printf("  (should be below 5e-3 and above 0.999: leakage of the tails across segment edges)\n");
+
+    /* The same samples in odd-sized blocks, and through sample sources, give the same sums */
+    kiss_fft_cpx *blocks = (kiss_fft_cpx*)malloc(sizeof(kiss_fft_cpx) * n);
+    welch_reset(&est);
+    for (int start = 0; start < NUM_SAMPLES; start += 777) {
+        int count = NUM_SAMPLES - start < 777 ? NUM_SAMPLES - start : 777;
+        welch_add(&est, x + start, y + start, count);
+    }
+    welch_result(&est, FIRST_BIN, n, blocks, NULL, NULL);
+    int same = 1;
+    for (int j = 0; j < n; j++) {
+        if (blocks[j].r != h1[j].r || blocks[j].i != h1[j].i) same = 0;
+    }
+    welch_reset(&est);
+    MemorySource xs = { x, NUM_SAMPLES, 0 }, ys = { y, NUM_SAMPLES, 0 };
+    int ret = welch_add_sources(&est, memory_source, &xs, memory_source, &ys, 0, NUM_SAMPLES, 65536);
+    welch_result(&est, FIRST_BIN, n, blocks, NULL, NULL);
+    for (int j = 0; j < n; j++) {
+        if (blocks[j].r != h1[j].r || blocks[j].i != h1[j].i) same = 0;
+    }
+    printf("777-sample blocks and 64k-sample source reads (%d) give identical H1: %s (should be 0, yes)\n\n", ret,
+           same ? "yes" : "no");
+
+    /*
+     * Noise on the output (variance 1/12 against 1/12 of signal): H1 stays
+     * at the gain, H2 doubles, coherence is 0.5. Noise on the input: H2
+     * stays, H1 halves.
+     */
+    double m1, m2, mc;
+    filter_taps(y, e, NUM_SAMPLES, GAIN_TAP, 1, 0.5, &state);
+    welch_reset(&est);
+    welch_add(&est, e, y, NUM_SAMPLES);
+    mean_result(&est, &m1, &m2, &mc);
+    printf("Output noise: |H1| %.3f, |H2| %.3f, coherence %.3f (should be about 0.5, 1.0, 0.5)\n", m1, m2, mc);
+    filter_taps(x, e, NUM_SAMPLES, GAIN_TAP, 1, 0.0, &state);
+    for (int i = 0; i < NUM_SAMPLES; i++) {
+        y[i] = (float)(e[i] + noise(&state));
+    }
+    welch_reset(&est);
+    welch_add(&est, y, x, NUM_SAMPLES);
+    mean_result(&est, &m1, &m2, &mc);
+    printf("Input noise: |H1| %.3f, |H2| %.3f, coherence %.3f (should be about 0.25, 0.5, 0.5)\n", m1, m2, mc);
+
+    free(e);
+    free(x);
+    free(y);
+    free(h1);
+    free(h2);
+    free(coherence);
+    free(blocks);
+    welch_free(&est);
+}
+
+int main(void) {
+    test_welch();
+    return 0;
+}
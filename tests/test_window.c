@@ -20,7 +20,7 @@ void test_generate_tukey_window(void) {
     printf("  nfade_post: %d\n", nfade_post);
     
     // Allocate and initialize window array to zeros
-    float *window = (float*)calloc(len_window, sizeof(float));
+    kiss_fft_scalar *window = (kiss_fft_scalar*)calloc(len_window, sizeof(kiss_fft_scalar));
     if (!window) {
         fprintf(stderr, "Failed to allocate window buffer\n");
         return;
@@ -37,7 +37,12 @@ void test_generate_tukey_window(void) {
         return;
     }
     
-    size_t written = fwrite(window, sizeof(float), len_window, outfile);
+    // Saved as float32 whatever the build precision
+    size_t written = 0;
+    for (int i = 0; i < len_window; i++) {
+        float value = (float)window[i];
+        written += fwrite(&value, sizeof(float), 1, outfile);
+    }
     fclose(outfile);
     
     printf("\nWindow saved to output/tukey_window_generated.raw\n");
@@ -58,7 +63,7 @@ void test_generate_tukey_window(void) {
     printf("  window[%d] = %.6f (end, should be 0.0)\n", len_window - 1, window[len_window - 1]);
     
     // Calculate statistics
-    float min_val = window[0], max_val = window[0];
+    kiss_fft_scalar min_val = window[0], max_val = window[0];
     for (int i = 0; i < len_window; i++) {
         if (window[i] < min_val) min_val = window[i];
         if (window[i] > max_val) max_val = window[i];